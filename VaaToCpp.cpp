@@ -1,11 +1,89 @@
 #include "tokenizing.h"
+#include "assembling.h"
+#include "building.h"
+#include "caching.h"
+#include "compiling.h"
+#include "interpreting.h"
+#include "jitting.h"
 #include "parsing.h"
+#include "optimizing.h"
+#include "options.h"
+#include "sourcemap.h"
+#include <fstream>
 
-int main()
+// tokenize the program in the named file, leaving standard input to the program
+// returns false, after printing an error, if the file cannot be read
+static bool readProgram(const string &name, token tokens[], int &numTokens)
+{
+   ifstream program(name);
+   if (!program) {
+      cerr << "Error: unable to read " << name << endl;
+      return false;
+   }
+   streambuf *input = cin.rdbuf(program.rdbuf());
+   numTokens = tokenize(tokens);
+   cin.rdbuf(input);
+   return true;
+}
+
+int main(int argc, char *argv[])
 {
    token tokens[MaxTokens];
    int numTokens;
 
+   if (!readOptions(argc, argv)) return 1;
+
+   if (options.layoutProfile != "" && !loadLayoutProfile(options.layoutProfile)) {
+      cerr << "Error: unable to read layout profile " << options.layoutProfile << endl;
+      return 1;
+   }
+
+   // a program run at once is read from its file, leaving standard input to it
+   if (options.runFile != "") {
+      if (!readProgram(options.runFile, tokens, numTokens)) return 1;
+      int status = runProgram(tokens, numTokens);
+      return (status == -1) ? 1 : status;
+   }
+
+   if (options.cacheStats) return printCacheStats() ? 0 : 1;
+
+   // a program built at once is compiled as it is translated
+   if (options.buildFile != "") {
+      if (!readProgram(options.buildFile, tokens, numTokens)) return 1;
+      int status = buildProgram(tokens, numTokens);
+      return (status == -1) ? 1 : status;
+   }
+
+   // bytecode is run from its file as it is, and a program compiled to it first
+   if (options.execFile != "") {
+      int status = -1;
+      string image = "";
+      if (isBytecodeFile(options.execFile)) {
+         status = runBytecodeFile(options.execFile);
+      } else if (readProgram(options.execFile, tokens, numTokens)
+         && compileBytecode(tokens, numTokens, image)) {
+         status = runBytecode(image);
+      }
+      return (status == -1) ? 1 : status;
+   }
+
    numTokens = tokenize(tokens);
-   parse(tokens, numTokens);
+
+   if (options.bytecode) {
+      string image = "";
+      if (!compileBytecode(tokens, numTokens, image)) return 1;
+      cout.write(image.data(), image.size()).flush();
+      return cout ? 0 : 1;
+   }
+
+   startSourceMap();
+   if (options.assembly) {
+      assemble(tokens, numTokens);
+   } else {
+      parse(tokens, numTokens);
+   }
+   if (!finishSourceMap()) {
+      cerr << "Error: unable to write source map " << options.sourceMap << endl;
+      return 1;
+   }
 }
@@ -0,0 +1,791 @@
+#include "analyzing.h"
+#include "symbols.h"
+#include <set>
+
+using std::set;
+
+// the storage an array may refer to: "global <name>" for global arrays,
+//    "local <procedure> <name>" for local arrays, "struct" for arrays
+//    within structs, and "unknown" when it cannot be determined
+typedef set<string> aliasRoots;
+
+// all procedures found in the program, keyed by name
+static unordered_map<string, procedureInfo> procedures;
+
+// the names of all global variables, mapped to whether they are arrays
+static unordered_map<string, bool> globalNames;
+
+// the positions of the Begin and End tokens of the main routine
+static int mainStart = -1;
+static int mainEnd = -1;
+
+// the storage each array parameter may refer to, keyed by procedure name
+static unordered_map<string, vector<aliasRoots>> paramRoots;
+
+// the arrays each procedure and its callees access by name rather than
+//    through parameters, with procedures still being analyzed left empty
+static unordered_map<string, aliasRoots> namedRoots;
+
+
+static void analyzeArrayAliases(token tokens[], int size);
+static void analyzeTextParams(token tokens[], int size);
+
+// whether each procedure may write to non-local variables,
+//    with procedures still being analyzed marked as false
+static unordered_map<string, bool> procedureWrites;
+
+// whether each procedure depends only on its parameters and has no effects,
+//    with procedures still being analyzed marked as true
+static unordered_map<string, bool> procedurePurity;
+
+
+// scan the token sequence and record the header of every procedure definition
+void collectProcedures(token tokens[], int size)
+{
+   procedures.clear();
+   globalNames.clear();
+   procedureWrites.clear();
+   procedurePurity.clear();
+   mainStart = -1;
+   mainEnd = -1;
+
+   for (int currPos = 0; currPos < size; currPos++) {
+      if (tokens[currPos].ttype == TokenType::GlobalDef && currPos + 1 < size) {
+         // the name follows the array or structtype keyword and type for composites
+         int namePos = currPos + 1;
+         bool isArray = (tokens[namePos].ttype == TokenType::Array);
+         if (isArray) namePos += 1;
+         if (tokens[namePos].ttype == TokenType::StructType) namePos += 2;
+         if (namePos < size) globalNames[tokens[namePos].content] = isArray;
+         continue;
+      }
+
+      if (tokens[currPos].ttype == TokenType::Main && currPos + 1 < size) {
+         mainStart = currPos + 1;
+         mainEnd = findBlockEnd(tokens, mainStart, size);
+         continue;
+      }
+
+      if (tokens[currPos].ttype != TokenType::ProcDef) continue;
+
+      procedureInfo proc;
+      proc.defPos = currPos;
+
+      int pos = currPos + 1;
+      if (pos + 1 >= size || tokens[pos].ttype != TokenType::Identifier
+         || tokens[pos + 1].ttype != TokenType::Left) continue;
+
+      proc.name = tokens[pos].content;
+      pos += 2;
+
+      bool valid = true;
+      while (pos < size && tokens[pos].ttype != TokenType::Right) {
+         paramInfo param;
+         param.isArray = false;
+         param.isRestrict = false;
+         param.isConstRef = false;
+
+         if (tokens[pos].ttype == TokenType::Array) {
+            param.isArray = true;
+            pos++;
+         } else if (tokens[pos].ttype == TokenType::StructType) {
+            pos++;
+            if (pos >= size) break;
+            param.structType = tokens[pos].content;
+         }
+
+         if (pos + 1 >= size || tokens[pos + 1].ttype != TokenType::Identifier) {
+            valid = false;
+            break;
+         }
+
+         param.ptype = tokens[pos].ttype;
+         param.name = tokens[pos + 1].content;
+         proc.params.push_back(param);
+         pos += 2;
+      }
+
+      if (!valid || pos + 1 >= size) continue;
+      pos++;
+
+      proc.returnType = TokenType::VoidType;
+      if (tokens[pos].ttype == TokenType::IntType
+         || tokens[pos].ttype == TokenType::RealType
+         || tokens[pos].ttype == TokenType::TextType
+         || tokens[pos].ttype == TokenType::BoolType
+         || tokens[pos].ttype == TokenType::VoidType) {
+         proc.returnType = tokens[pos].ttype;
+         pos++;
+      }
+
+      if (pos >= size || tokens[pos].ttype != TokenType::Begin) continue;
+
+      proc.bodyStart = pos;
+      proc.bodyEnd = findBlockEnd(tokens, pos, size);
+      if (proc.bodyEnd == -1) continue;
+
+      procedures[proc.name] = proc;
+   }
+
+   analyzeArrayAliases(tokens, size);
+   analyzeTextParams(tokens, size);
+}
+
+
+// returns the procedure with the given name, or nullptr if none exists
+const procedureInfo *findProcedure(string name)
+{
+   auto it = procedures.find(name);
+   return (it != procedures.end()) ? &it->second : nullptr;
+}
+
+
+// returns true if the name is declared as a global variable
+bool isGlobalName(string name)
+{
+   return globalNames.count(name) != 0;
+}
+
+
+// returns true if the name is declared as a global array
+bool isGlobalArray(string name)
+{
+   auto it = globalNames.find(name);
+   return (it != globalNames.end()) && it->second;
+}
+
+
+// returns true if a call to the named procedure may change any variable
+//    other than its own locals
+bool procedureMayWrite(token tokens[], int size, string name)
+{
+   auto known = procedureWrites.find(name);
+   if (known != procedureWrites.end()) return known->second;
+
+   const procedureInfo *proc = findProcedure(name);
+   if (!proc) return true;
+
+   // recursive calls do not add any writes of their own
+   procedureWrites[name] = false;
+
+   // parameters passed by value and declared locals can be written freely,
+   //    unless a global of the same name might be meant instead
+   unordered_map<string, bool> locals;
+   for (size_t i = 0; i < proc->params.size(); i++) {
+      if (!proc->params[i].isArray && proc->params[i].structType.empty()) {
+         locals[proc->params[i].name] = true;
+      }
+   }
+   for (int pos = proc->bodyStart; pos < proc->bodyEnd; pos++) {
+      if (tokens[pos].ttype == TokenType::VarDef && pos + 1 < size
+         && tokens[pos + 1].ttype == TokenType::Identifier
+         && !isGlobalName(tokens[pos + 1].content)) {
+         locals[tokens[pos + 1].content] = true;
+      }
+   }
+
+   bool writes = false;
+
+   for (int pos = proc->bodyStart; pos < proc->bodyEnd && !writes; pos++) {
+      switch (tokens[pos].ttype) {
+         case ArraySet:
+         case StructElemSet:
+         case StructIndirElemSet:
+            writes = true;
+            break;
+         case Read:
+            writes = !locals.count(tokens[pos + 1].content);
+            break;
+         case Set:
+            writes = (tokens[pos + 1].ttype != TokenType::Identifier
+               || !locals.count(tokens[pos + 1].content));
+            break;
+         case AddAdd:
+         case SubSub:
+         case AddAddPre:
+         case SubSubPre:
+            writes = !locals.count(tokens[pos + 1].content);
+            break;
+         case Call:
+            writes = procedureMayWrite(tokens, size, tokens[pos + 1].content);
+            break;
+         default:
+            break;
+      }
+   }
+
+   procedureWrites[name] = writes;
+   return writes;
+}
+
+
+// returns the position of the End token that closes the block
+// opened by the Begin token at currPos, or -1 if it is unterminated
+int findBlockEnd(token tokens[], int currPos, int size)
+{
+   int depth = 0;
+
+   for (; currPos < size; currPos++) {
+      if (tokens[currPos].ttype == TokenType::Begin) {
+         depth++;
+      } else if (tokens[currPos].ttype == TokenType::End) {
+         depth--;
+         if (depth == 0) return currPos;
+      }
+   }
+   return -1;
+}
+
+
+// returns the position of the last token of the expression
+// starting at currPos, or -1 if it is malformed
+int skipExpression(token tokens[], int currPos, int size)
+{
+   if (currPos >= size) return -1;
+
+   switch (tokens[currPos].ttype) {
+      case Identifier:
+      case IntLit:
+      case RealLit:
+      case TextLit:
+      case BoolLit:
+         return currPos;
+      case Left:
+         return findBracketEnd(tokens, currPos, size);
+      case Call:
+         if (currPos + 2 >= size) return -1;
+         return findBracketEnd(tokens, currPos + 2, size);
+      case ArrayAccess:
+         // the array itself, followed by the index
+         currPos = skipExpression(tokens, currPos + 1, size);
+         if (currPos == -1 || currPos + 1 >= size) return -1;
+         return currPos + 1;
+      case ArraySize:
+         return skipExpression(tokens, currPos + 1, size);
+      case StructElemAccess:
+      case StructIndirElemAccess:
+         // the struct itself, followed by the element name
+         currPos = skipExpression(tokens, currPos + 1, size);
+         if (currPos == -1 || currPos + 1 >= size) return -1;
+         return currPos + 1;
+      default:
+         return -1;
+   }
+}
+
+
+// returns the position of the Right token matching the Left token at currPos,
+// or -1 if it is unmatched
+int findBracketEnd(token tokens[], int currPos, int size)
+{
+   int depth = 0;
+
+   for (; currPos < size; currPos++) {
+      if (tokens[currPos].ttype == TokenType::Left) {
+         depth++;
+      } else if (tokens[currPos].ttype == TokenType::Right) {
+         depth--;
+         if (depth == 0) return currPos;
+      }
+   }
+   return -1;
+}
+
+
+// returns the position of the last token of the statement
+// starting at currPos, or -1 if it is malformed
+int skipStatement(token tokens[], int currPos, int size)
+{
+   if (currPos + 1 >= size) return -1;
+
+   switch (tokens[currPos].ttype) {
+      case Call:
+         return skipExpression(tokens, currPos, size);
+      case Write:
+      case Return:
+         return skipExpression(tokens, currPos + 1, size);
+      case Read:
+         return currPos + 1;
+      case Left:
+         return findBracketEnd(tokens, currPos, size);
+      case VarDef:
+         if (tokens[currPos + 1].ttype == TokenType::Array) return skipExpression(tokens, currPos + 4, size);
+         if (tokens[currPos + 1].ttype == TokenType::StructType) return currPos + 3;
+         return currPos + 2;
+      case Set:
+         // the variable or struct element, then the value
+         currPos = skipExpression(tokens, currPos + 1, size);
+         if (currPos == -1) return -1;
+         return skipExpression(tokens, currPos + 1, size);
+      case ArraySet:
+         // the array, the index, then the value
+         currPos = skipExpression(tokens, currPos + 1, size);
+         if (currPos == -1) return -1;
+         return skipExpression(tokens, currPos + 2, size);
+      case StructElemSet:
+      case StructIndirElemSet:
+         // the struct, the element name, then the value
+         return skipExpression(tokens, currPos + 3, size);
+      case If:
+         // the condition, the loop body, then the optional else body
+         currPos = findBracketEnd(tokens, currPos + 1, size);
+         if (currPos == -1) return -1;
+         currPos = findBlockEnd(tokens, currPos + 1, size);
+         if (currPos == -1 || currPos + 1 >= size) return currPos;
+         if (tokens[currPos + 1].ttype != TokenType::Else) return currPos;
+         return findBlockEnd(tokens, currPos + 2, size);
+      default:
+         return -1;
+   }
+}
+
+
+// find the procedure whose body contains the position,
+// or nullptr if it is within the main routine
+const procedureInfo *enclosingProcedure(int currPos)
+{
+   for (auto it = procedures.begin(); it != procedures.end(); it++) {
+      if (it->second.bodyStart < currPos && currPos < it->second.bodyEnd) {
+         return &it->second;
+      }
+   }
+   return nullptr;
+}
+
+
+// find the storage that an array argument of a call may refer to
+static aliasRoots argumentRoots(token tokens[], int currPos, const procedureInfo *proc)
+{
+   aliasRoots roots;
+
+   if (tokens[currPos].ttype == TokenType::StructElemAccess
+      || tokens[currPos].ttype == TokenType::StructIndirElemAccess) {
+      roots.insert("struct");
+      return roots;
+   }
+
+   if (tokens[currPos].ttype != TokenType::Identifier) {
+      roots.insert("unknown");
+      return roots;
+   }
+
+   string name = tokens[currPos].content;
+
+   // parameters hide locals, which hide globals
+   for (size_t i = 0; proc && i < proc->params.size(); i++) {
+      if (proc->params[i].name == name) {
+         return proc->params[i].isArray ? paramRoots[proc->name][i] : roots;
+      }
+   }
+
+   int bodyStart = proc ? proc->bodyStart : mainStart;
+   int bodyEnd = proc ? proc->bodyEnd : mainEnd;
+
+   for (int pos = bodyStart; pos + 2 < bodyEnd; pos++) {
+      if (tokens[pos].ttype == TokenType::VarDef && tokens[pos + 1].ttype == TokenType::Array
+         && tokens[pos + 2].content == name) {
+         roots.insert("local " + (proc ? proc->name : "main") + " " + name);
+         return roots;
+      }
+   }
+
+   roots.insert(isGlobalArray(name) ? "global " + name : "unknown");
+   return roots;
+}
+
+
+// find the positions of the arguments of the call at currPos
+static vector<int> callArguments(token tokens[], int currPos, int size)
+{
+   vector<int> args;
+
+   for (currPos += 3; currPos != -1 && currPos < size
+      && tokens[currPos].ttype != TokenType::Right; currPos++) {
+      args.push_back(currPos);
+      currPos = skipExpression(tokens, currPos, size);
+   }
+   return args;
+}
+
+
+// find the arrays a procedure and its callees access by name
+static const aliasRoots &findNamedRoots(token tokens[], int size, const procedureInfo &proc)
+{
+   auto known = namedRoots.find(proc.name);
+   if (known != namedRoots.end()) return known->second;
+
+   aliasRoots roots;
+   namedRoots[proc.name] = roots;
+
+   for (int pos = proc.bodyStart; pos < proc.bodyEnd; pos++) {
+      if (tokens[pos].ttype == TokenType::StructElemAccess
+         || tokens[pos].ttype == TokenType::StructIndirElemAccess) {
+         roots.insert("struct");
+      } else if (tokens[pos].ttype == TokenType::Identifier && isGlobalArray(tokens[pos].content)) {
+         // the name may be hidden by a parameter or local of the same name
+         bool hidden = false;
+         for (size_t i = 0; i < proc.params.size(); i++) {
+            hidden = hidden || (proc.params[i].name == tokens[pos].content);
+         }
+         for (int decl = proc.bodyStart; decl + 2 < proc.bodyEnd; decl++) {
+            hidden = hidden || (tokens[decl].ttype == TokenType::VarDef
+               && (tokens[decl + 1].content == tokens[pos].content
+                  || tokens[decl + 2].content == tokens[pos].content));
+         }
+         if (!hidden) roots.insert("global " + tokens[pos].content);
+      } else if (tokens[pos].ttype == TokenType::Call && pos + 1 < size) {
+         const procedureInfo *callee = findProcedure(tokens[pos + 1].content);
+         if (!callee) continue;
+         const aliasRoots &calleeRoots = findNamedRoots(tokens, size, *callee);
+         roots.insert(calleeRoots.begin(), calleeRoots.end());
+      }
+   }
+
+   namedRoots[proc.name] = roots;
+   return namedRoots[proc.name];
+}
+
+
+// returns true if two sets of storage may overlap
+static bool rootsOverlap(const aliasRoots &first, const aliasRoots &second)
+{
+   if (first.count("unknown") || second.count("unknown")) return true;
+
+   for (auto it = first.begin(); it != first.end(); it++) {
+      if (second.count(*it)) return true;
+   }
+   return false;
+}
+
+
+// decide which array parameters can be marked as never aliasing any other
+//    array used while their procedure runs, based on every call in the program
+static void analyzeArrayAliases(token tokens[], int size)
+{
+   paramRoots.clear();
+   namedRoots.clear();
+
+   vector<int> calls;
+   for (int currPos = 0; currPos + 2 < size; currPos++) {
+      if (tokens[currPos].ttype == TokenType::Call && findProcedure(tokens[currPos + 1].content)) {
+         calls.push_back(currPos);
+      }
+   }
+
+   for (auto it = procedures.begin(); it != procedures.end(); it++) {
+      paramRoots[it->first] = vector<aliasRoots>(it->second.params.size());
+   }
+
+   // arrays passed on through parameters reach further procedures,
+   //    so keep going until no parameter can refer to anything new
+   bool changed = true;
+   while (changed) {
+      changed = false;
+
+      for (size_t c = 0; c < calls.size(); c++) {
+         const procedureInfo *callee = findProcedure(tokens[calls[c] + 1].content);
+         const procedureInfo *caller = enclosingProcedure(calls[c]);
+         vector<int> args = callArguments(tokens, calls[c], size);
+
+         for (size_t i = 0; i < args.size() && i < callee->params.size(); i++) {
+            if (!callee->params[i].isArray) continue;
+
+            aliasRoots roots = argumentRoots(tokens, args[i], caller);
+            aliasRoots &known = paramRoots[callee->name][i];
+            size_t before = known.size();
+            known.insert(roots.begin(), roots.end());
+            changed = changed || (known.size() != before);
+         }
+      }
+   }
+
+   for (auto it = procedures.begin(); it != procedures.end(); it++) {
+      procedureInfo &proc = it->second;
+      const aliasRoots &named = findNamedRoots(tokens, size, proc);
+
+      for (size_t i = 0; i < proc.params.size(); i++) {
+         if (!proc.params[i].isArray) continue;
+         proc.params[i].isRestrict = !rootsOverlap(paramRoots[proc.name][i], named);
+      }
+
+      // at every call, no two array arguments may share storage
+      for (size_t c = 0; c < calls.size(); c++) {
+         if (tokens[calls[c] + 1].content != proc.name) continue;
+
+         const procedureInfo *caller = enclosingProcedure(calls[c]);
+         vector<int> args = callArguments(tokens, calls[c], size);
+
+         for (size_t i = 0; i < args.size() && i < proc.params.size(); i++) {
+            for (size_t j = 0; j < args.size() && j < proc.params.size(); j++) {
+               if (i == j || !proc.params[i].isArray || !proc.params[j].isArray) continue;
+
+               if (rootsOverlap(argumentRoots(tokens, args[i], caller),
+                  argumentRoots(tokens, args[j], caller))) {
+                  proc.params[i].isRestrict = false;
+               }
+            }
+         }
+      }
+   }
+}
+
+
+// returns true if the variable read at currPos is a local or value parameter
+//    that is never read again once the statement holding the read has run
+bool isLastUse(token tokens[], int currPos, int size)
+{
+   string name = tokens[currPos].content;
+   const procedureInfo *proc = enclosingProcedure(currPos);
+   int bodyStart = proc ? proc->bodyStart : mainStart;
+   int bodyEnd = proc ? proc->bodyEnd : mainEnd;
+
+   if (bodyStart == -1 || bodyEnd == -1 || currPos <= bodyStart || currPos >= bodyEnd) return false;
+
+   // whether the innermost declaration of the variable has been found,
+   //    and whether a loop body lies between it and the read
+   bool declared = false;
+   bool inLoop = false;
+
+   for (size_t i = 0; proc && i < proc->params.size(); i++) {
+      if (proc->params[i].name == name) {
+         // arrays, structs and read-only text are passed by reference
+         if (proc->params[i].isArray || !proc->params[i].structType.empty()
+            || proc->params[i].isConstRef) return false;
+         declared = true;
+      }
+   }
+
+   // descend through the blocks holding the read to find its statement
+   int stmtPos = bodyStart + 1;
+   int stmtEnd = -1;
+
+   while (stmtEnd == -1) {
+      if (stmtPos >= bodyEnd) return false;
+
+      int end = skipStatement(tokens, stmtPos, size);
+      if (end == -1) return false;
+
+      if (tokens[stmtPos].ttype == TokenType::VarDef) {
+         string declName;
+         typeInfo type;
+         if (readDeclaration(tokens, stmtPos + 1, size, declName, type) != -1 && declName == name) {
+            declared = true;
+            inLoop = false;
+         }
+      }
+
+      if (currPos < stmtPos || currPos > end) {
+         stmtPos = end + 1;
+      } else if (tokens[stmtPos].ttype != TokenType::If) {
+         stmtEnd = end;
+      } else {
+         // loop conditions and loop bodies run repeatedly, else bodies only once
+         int condEnd = findBracketEnd(tokens, stmtPos + 1, size);
+         if (condEnd == -1 || currPos <= condEnd) return false;
+
+         int loopEnd = findBlockEnd(tokens, condEnd + 1, size);
+         if (loopEnd == -1) return false;
+
+         if (currPos < loopEnd) {
+            inLoop = true;
+            stmtPos = condEnd + 2;
+         } else {
+            stmtPos = loopEnd + 3;
+         }
+      }
+   }
+
+   if (!declared || inLoop) return false;
+
+   // any later mention of the name, even one shadowing it, keeps the value alive
+   for (int pos = stmtPos; pos < bodyEnd; pos++) {
+      if (pos != currPos && tokens[pos].ttype == TokenType::Identifier
+         && tokens[pos].content == name) return false;
+   }
+   return true;
+}
+
+
+// mark the text parameters that each procedure only ever reads, which can be
+//    passed by reference as long as nothing the procedure does could change
+//    the caller's storage behind them
+static void analyzeTextParams(token tokens[], int size)
+{
+   for (auto it = procedures.begin(); it != procedures.end(); it++) {
+      procedureInfo &proc = it->second;
+
+      if (procedureMayWrite(tokens, size, proc.name)) continue;
+
+      for (size_t i = 0; i < proc.params.size(); i++) {
+         paramInfo &param = proc.params[i];
+         if (param.isArray || param.ptype != TokenType::TextType) continue;
+
+         param.isConstRef = true;
+         for (int pos = proc.bodyStart; pos + 1 < proc.bodyEnd; pos++) {
+            if ((tokens[pos].ttype == TokenType::Set || tokens[pos].ttype == TokenType::Read)
+               && tokens[pos + 1].content == param.name) {
+               param.isConstRef = false;
+               break;
+            }
+
+            // self tail calls assign their arguments to the parameters
+            if (isSelfTailCall(tokens, pos, size)) {
+               vector<int> args = callArguments(tokens, pos + 1, size);
+               if (tokens[args[i]].content != param.name
+                  || skipExpression(tokens, args[i], size) != args[i]) {
+                  param.isConstRef = false;
+                  break;
+               }
+            }
+         }
+      }
+   }
+}
+
+
+// returns true if the return statement at currPos returns the result of calling
+//    its own procedure, passing on every struct unchanged, so the call can
+//    become a jump back to the start of the procedure
+bool isSelfTailCall(token tokens[], int currPos, int size)
+{
+   if (currPos + 2 >= size || tokens[currPos].ttype != TokenType::Return
+      || tokens[currPos + 1].ttype != TokenType::Call) return false;
+
+   const procedureInfo *proc = enclosingProcedure(currPos);
+   if (!proc || tokens[currPos + 2].content != proc->name) return false;
+
+   vector<int> args = callArguments(tokens, currPos + 1, size);
+   if (args.size() != proc->params.size()) return false;
+
+   // the parameters must be assignable by name wherever the call is
+   for (int pos = proc->bodyStart; pos < proc->bodyEnd; pos++) {
+      string declName;
+      typeInfo type;
+      if (tokens[pos].ttype != TokenType::VarDef
+         || readDeclaration(tokens, pos + 1, size, declName, type) == -1) continue;
+
+      for (size_t i = 0; i < proc->params.size(); i++) {
+         if (proc->params[i].name == declName) return false;
+      }
+   }
+
+   // struct parameters are references, which cannot be made to refer elsewhere
+   for (size_t i = 0; i < args.size(); i++) {
+      if (!proc->params[i].structType.empty()
+         && (tokens[args[i]].content != proc->params[i].name
+            || skipExpression(tokens, args[i], size) != args[i])) return false;
+   }
+   return true;
+}
+
+
+// returns true if the procedure contains a self tail call
+bool hasSelfTailCall(token tokens[], int size, string name)
+{
+   const procedureInfo *proc = findProcedure(name);
+   if (!proc) return false;
+
+   for (int pos = proc->bodyStart; pos < proc->bodyEnd; pos++) {
+      if (isSelfTailCall(tokens, pos, size)) return true;
+   }
+   return false;
+}
+
+
+// returns true if the return statement at currPos returns the result of calling
+//    another procedure with the same primitive parameter and return types, from
+//    a procedure with nothing to destroy or refer to once it has made the call
+bool isSiblingTailCall(token tokens[], int currPos, int size)
+{
+   if (currPos + 2 >= size || tokens[currPos].ttype != TokenType::Return
+      || tokens[currPos + 1].ttype != TokenType::Call) return false;
+
+   const procedureInfo *caller = enclosingProcedure(currPos);
+   const procedureInfo *callee = findProcedure(tokens[currPos + 2].content);
+   if (!caller || !callee || caller == callee) return false;
+
+   if (caller->returnType != callee->returnType
+      || caller->params.size() != callee->params.size()) return false;
+
+   for (size_t i = 0; i < caller->params.size(); i++) {
+      const paramInfo &param = caller->params[i];
+      if (param.isArray || !param.structType.empty() || param.ptype == TokenType::TextType
+         || param.ptype != callee->params[i].ptype || callee->params[i].isArray
+         || !callee->params[i].structType.empty()) return false;
+   }
+
+   // locals with destructors, or which the arguments could point into
+   for (int pos = caller->bodyStart; pos + 2 < caller->bodyEnd; pos++) {
+      if (tokens[pos].ttype == TokenType::VarDef
+         && (tokens[pos + 1].ttype == TokenType::Array || tokens[pos + 1].ttype == TokenType::StructType
+            || tokens[pos + 2].ttype == TokenType::TextType)) return false;
+   }
+   return true;
+}
+
+
+// returns true if any return statement in the program is a sibling tail call
+bool hasSiblingTailCalls(token tokens[], int size)
+{
+   for (int pos = 0; pos < size; pos++) {
+      if (isSiblingTailCall(tokens, pos, size)) return true;
+   }
+   return false;
+}
+
+
+// returns true if a call to the named procedure only computes its result from
+//    its primitive and text parameters, without reading or writing anything
+//    else, reading input or writing output
+bool procedureIsPure(token tokens[], int size, string name)
+{
+   auto known = procedurePurity.find(name);
+   if (known != procedurePurity.end()) return known->second;
+
+   const procedureInfo *proc = findProcedure(name);
+   if (!proc || procedureMayWrite(tokens, size, name)) return false;
+
+   // recursive calls do not add any effects of their own
+   procedurePurity[name] = true;
+
+   unordered_map<string, bool> locals;
+   bool pure = true;
+
+   for (size_t i = 0; i < proc->params.size(); i++) {
+      if (proc->params[i].isArray || !proc->params[i].structType.empty()) pure = false;
+      locals[proc->params[i].name] = true;
+   }
+
+   for (int pos = proc->bodyStart; pos < proc->bodyEnd && pure; pos++) {
+      string declName;
+      typeInfo type;
+
+      switch (tokens[pos].ttype) {
+         case VarDef:
+            if (readDeclaration(tokens, pos + 1, size, declName, type) != -1) {
+               locals[declName] = true;
+            }
+            break;
+         case Read:
+         case Write:
+         case StructElemAccess:
+         case StructIndirElemAccess:
+            pure = false;
+            break;
+         case Call:
+            pure = procedureIsPure(tokens, size, tokens[pos + 1].content);
+            pos++;
+            break;
+         case Identifier:
+            if (isGlobalName(tokens[pos].content) && !locals.count(tokens[pos].content)) {
+               pure = false;
+            }
+            break;
+         default:
+            break;
+      }
+   }
+
+   procedurePurity[name] = pure;
+   return pure;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "tokenizing.h"
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+
+// each procedure parameter has a type (a primitive type, or the element
+//    type of an array), a name, and the struct type name for struct params,
+//    array params record whether they can never alias other arrays in use,
+//    and text params whether they are only ever read
+struct paramInfo {
+   TokenType ptype;
+   string name;
+   bool isArray;
+   bool isRestrict;
+   bool isConstRef;
+   string structType;
+};
+
+
+// each procedure records its name, the positions of its definition
+//    and body tokens, its parameters and its return type
+struct procedureInfo {
+   string name;
+   int defPos;
+   int bodyStart;
+   int bodyEnd;
+   vector<paramInfo> params;
+   TokenType returnType;
+};
+
+
+// scan the token sequence and record the header of every procedure definition
+void collectProcedures(token tokens[], int size);
+
+
+// returns the procedure with the given name, or nullptr if none exists
+const procedureInfo *findProcedure(string name);
+
+
+// find the procedure whose body contains the position,
+// or nullptr if it is within the main routine
+const procedureInfo *enclosingProcedure(int currPos);
+
+
+// returns true if the name is declared as a global variable
+bool isGlobalName(string name);
+
+
+// returns true if the name is declared as a global array
+bool isGlobalArray(string name);
+
+
+// returns true if a call to the named procedure may change any variable
+//    other than its own locals
+bool procedureMayWrite(token tokens[], int size, string name);
+
+
+// returns the position of the End token that closes the block
+// opened by the Begin token at currPos, or -1 if it is unterminated
+int findBlockEnd(token tokens[], int currPos, int size);
+
+
+// returns the position of the last token of the expression
+// starting at currPos, or -1 if it is malformed
+int skipExpression(token tokens[], int currPos, int size);
+
+
+// returns the position of the Right token matching the Left token at currPos,
+// or -1 if it is unmatched
+int findBracketEnd(token tokens[], int currPos, int size);
+
+
+// returns the position of the last token of the statement
+// starting at currPos, or -1 if it is malformed
+int skipStatement(token tokens[], int currPos, int size);
+
+
+// returns true if the variable read at currPos is a local or value parameter
+//    that is never read again once the statement holding the read has run
+bool isLastUse(token tokens[], int currPos, int size);
+
+
+// returns true if the return statement at currPos returns the result of calling
+//    its own procedure, passing on every struct unchanged, so the call can
+//    become a jump back to the start of the procedure
+bool isSelfTailCall(token tokens[], int currPos, int size);
+
+
+// returns true if the procedure contains a self tail call
+bool hasSelfTailCall(token tokens[], int size, string name);
+
+
+// returns true if the return statement at currPos returns the result of calling
+//    another procedure with the same primitive parameter and return types, from
+//    a procedure with nothing to destroy or refer to once it has made the call
+bool isSiblingTailCall(token tokens[], int currPos, int size);
+
+
+// returns true if any return statement in the program is a sibling tail call
+bool hasSiblingTailCalls(token tokens[], int size);
+
+
+// returns true if a call to the named procedure only computes its result from
+//    its primitive and text parameters, without reading or writing anything
+//    else, reading input or writing output
+bool procedureIsPure(token tokens[], int size, string name);
@@ -0,0 +1,801 @@
+// the runtime linked into programs translated with --asm: starting and ending
+//    the program, buffered input and output, storage for arrays and reference
+//    counted text; it uses neither the C nor the C++ library, talking to the
+//    kernel directly, so the program can be linked by ld with nothing else
+//
+// it is built once along with the translator (see the makefile), with
+//    -ffreestanding -nostdlib, and every name it exports starts with vurb_;
+//    built again with VURB_JIT defined, it is linked into the translator
+//    itself for --run, using the library's copies and starting nothing
+#include "asmruntime.h"
+#include <float.h>
+#include <limits.h>
+#include <stddef.h>
+
+extern "C" {
+
+#ifdef VURB_JIT
+void *memcpy(void *target, const void *source, size_t count);
+void *memmove(void *target, const void *source, size_t count);
+#else
+// the procedure the main routine is translated to, returning the exit status
+long vurb_main();
+
+
+// the compiler may turn copies and clears into calls to these; copies
+//    forward and clears use the string instructions, which current processors
+//    run a cache line at a time
+void *memcpy(void *target, const void *source, size_t count)
+{
+   void *to = target;
+   asm volatile("rep movsb" : "+D"(to), "+S"(source), "+c"(count) : : "memory");
+   return target;
+}
+
+void *memmove(void *target, const void *source, size_t count)
+{
+   char *to = (char *)target;
+   const char *from = (const char *)source;
+   if (to < from) {
+      return memcpy(target, source, count);
+   } else {
+      while (count--) to[count] = from[count];
+   }
+   return target;
+}
+
+void *memset(void *target, int value, size_t count)
+{
+   void *to = target;
+   asm volatile("rep stosb" : "+D"(to), "+c"(count) : "a"(value) : "memory");
+   return target;
+}
+#endif
+
+}
+
+
+// --- the kernel -----------------------------------------------------------
+
+static const long SysRead = 0;
+static const long SysWrite = 1;
+static const long SysFstat = 5;
+static const long SysLseek = 8;
+static const long SysMmap = 9;
+static const long SysExitGroup = 231;
+
+static long vurb_syscall(long number, long a = 0, long b = 0, long c = 0,
+   long d = 0, long e = 0, long f = 0)
+{
+   long result;
+   register long r10 __asm__("r10") = d;
+   register long r8 __asm__("r8") = e;
+   register long r9 __asm__("r9") = f;
+   __asm__ volatile ("syscall"
+      : "=a"(result)
+      : "a"(number), "D"(a), "S"(b), "d"(c), "r"(r10), "r"(r8), "r"(r9)
+      : "rcx", "r11", "memory");
+   return result;
+}
+
+// the kernel's struct stat on x86-64
+struct vurb_FileStatus {
+   unsigned long device, inode, links;
+   unsigned int mode, user, group, padding;
+   unsigned long specialDevice;
+   long size, blockSize, blocks;
+   unsigned long times[6];
+   long reserved[3];
+};
+
+static void *vurb_mapMemory(size_t bytes)
+{
+   const long ProtReadWrite = 3, MapPrivateAnonymous = 0x22;
+   long mapped = vurb_syscall(SysMmap, 0, bytes, ProtReadWrite, MapPrivateAnonymous, -1, 0);
+   if (mapped < 0 && mapped > -4096) {
+      static const char message[] = "Error: out of memory\n";
+      vurb_syscall(SysWrite, 2, (long)message, sizeof(message) - 1);
+      vurb_syscall(SysExitGroup, 1);
+   }
+   return (void *)mapped;
+}
+
+
+// --- storage ----------------------------------------------------------------
+
+// blocks are a power of two in size, cut one after another from chunks of a
+//    megabyte, or mapped on their own when larger, and once given back are
+//    kept on a list for their size to be taken again; fresh blocks are mapped
+//    zeroed, and blocks taken again are cleared when asked
+struct vurb_Blocks {
+   static const size_t smallest = 32;
+   static const size_t chunk = 1 << 20;
+   static const int classes = 48;
+   char *lists[classes];
+   char *next;
+   char *last;
+
+   static int sizeClass(size_t &bytes) {
+      if (bytes <= smallest) {
+         bytes = smallest;
+         return 0;
+      }
+      int top = 64 - __builtin_clzl(bytes - 1);
+      bytes = (size_t)1 << top;
+      return top - 5;
+   }
+
+   char *take(size_t &bytes, bool clear) {
+      int sc = sizeClass(bytes);
+      char *block = lists[sc];
+      if (block) {
+         lists[sc] = *(char **)block;
+         if (clear) {
+            for (size_t i = 0; i < bytes / sizeof(long); i++) ((long *)block)[i] = 0;
+         } else {
+            *(char **)block = nullptr;
+         }
+         return block;
+      }
+      if (bytes >= chunk) return (char *)vurb_mapMemory(bytes);
+      if ((size_t)(last - next) < bytes) {
+         next = (char *)vurb_mapMemory(chunk);
+         last = next + chunk;
+      }
+      block = next;
+      next += bytes;
+      return block;
+   }
+
+   void give(char *block, size_t bytes) {
+      int sc = sizeClass(bytes);
+      *(char **)block = lists[sc];
+      lists[sc] = block;
+   }
+};
+
+static vurb_Blocks vurb_blocks;
+
+extern "C" {
+
+// returns zeroed storage for an array of the given size in bytes
+void *vurb_arrayTake(long bytes)
+{
+   size_t rounded = bytes > 0 ? bytes : 1;
+   return vurb_blocks.take(rounded, true);
+}
+
+// gives back the storage of an array once it goes out of scope
+void vurb_arrayGive(void *elements, long bytes)
+{
+   vurb_blocks.give((char *)elements, bytes > 0 ? bytes : 1);
+}
+
+}
+
+
+// --- text -------------------------------------------------------------------
+
+// text is immutable and shared: a null pointer is empty text, and literals
+//    live in the program's data with a count of references too large to ever
+//    fall to zero; text only referred to once may be appended to in place
+struct vurb_Text {
+   long references;
+   long length;
+   long capacity;
+   char characters[1];
+};
+
+static const long TextHeader = (long)offsetof(vurb_Text, characters);
+
+static vurb_Text *vurb_newText(long length)
+{
+   size_t bytes = TextHeader + (length > 0 ? length : 1);
+   vurb_Text *text = (vurb_Text *)vurb_blocks.take(bytes, false);
+   text->references = 1;
+   text->length = length;
+   text->capacity = bytes - TextHeader;
+   return text;
+}
+
+static void vurb_copyText(char *target, const char *source, long length)
+{
+   memcpy(target, source, length);
+}
+
+static long vurb_textLength(const vurb_Text *text)
+{
+   return text ? text->length : 0;
+}
+
+extern "C" {
+
+// drops a reference to the text, giving back its storage with the last one
+void vurb_textRelease(vurb_Text *text)
+{
+   if (text && --text->references == 0) {
+      vurb_blocks.give((char *)text, TextHeader + text->capacity);
+   }
+}
+
+}
+
+static void vurb_releaseOwned(vurb_Text *left, vurb_Text *right, long owned)
+{
+   if (owned & 1) vurb_textRelease(left);
+   if (owned & 2) vurb_textRelease(right);
+}
+
+// returns text holding the characters of text followed by more, appended in
+//    place when the caller holds the only reference to text and it has room,
+//    and taking over that reference either way
+static vurb_Text *vurb_extendText(vurb_Text *text, const char *more, long count)
+{
+   long length = vurb_textLength(text);
+   if (text && text->references == 1 && length + count <= text->capacity) {
+      vurb_copyText(text->characters + length, more, count);
+      text->length += count;
+      return text;
+   }
+
+   // text grown a piece at a time has room made for as much again
+   vurb_Text *joined = vurb_newText(length + count > 2 * length ? length + count : 2 * length);
+   joined->length = length + count;
+   if (text) vurb_copyText(joined->characters, text->characters, length);
+   vurb_copyText(joined->characters + length, more, count);
+   vurb_textRelease(text);
+   return joined;
+}
+
+extern "C" {
+
+// returns left followed by right; the low bits of owned say which of the two
+//    the caller passes its reference to, and an owned left may be reused
+vurb_Text *vurb_textConcat(vurb_Text *left, vurb_Text *right, long owned)
+{
+   if (!right) {
+      if (left && !(owned & 1)) left->references++;
+      return left;
+   }
+   if (!left && (owned & 2)) return right;
+
+   if (!(owned & 1) && left) left->references++;
+   vurb_Text *joined = vurb_extendText(left, right->characters, right->length);
+   if (owned & 2) vurb_textRelease(right);
+   return joined;
+}
+
+// appends more to the end of the text variable at target
+void vurb_textAppend(vurb_Text **target, vurb_Text *more, long owned)
+{
+   if (!more) return;
+   if (!*target) {
+      if (!(owned & 1)) more->references++;
+      *target = more;
+      return;
+   }
+   *target = vurb_extendText(*target, more->characters, more->length);
+   if (owned & 1) vurb_textRelease(more);
+}
+
+// returns less than, equal to or greater than zero as left sorts before,
+//    the same as or after right
+long vurb_textCompare(vurb_Text *left, vurb_Text *right, long owned)
+{
+   long leftLength = vurb_textLength(left);
+   long rightLength = vurb_textLength(right);
+   long shorter = leftLength < rightLength ? leftLength : rightLength;
+   long result = 0;
+   for (long i = 0; i < shorter && result == 0; i++) {
+      result = (long)(unsigned char)left->characters[i] - (long)(unsigned char)right->characters[i];
+   }
+   if (result == 0) result = (leftLength > rightLength) - (leftLength < rightLength);
+   vurb_releaseOwned(left, right, owned);
+   return result;
+}
+
+// releases count text values in a row, leaving them empty
+void vurb_textReleaseAll(vurb_Text **texts, long count)
+{
+   for (long i = 0; i < count; i++) {
+      vurb_textRelease(texts[i]);
+      texts[i] = nullptr;
+   }
+}
+
+// copies a struct of the given number of 8 byte words, where texts lists how
+//    many of the words hold text and then which they are
+void vurb_structCopy(long *target, const long *source, long words, const long *texts)
+{
+   for (long i = 0; i < texts[0]; i++) {
+      vurb_Text *text = (vurb_Text *)source[texts[i + 1]];
+      if (text) text->references++;
+   }
+   for (long i = 0; i < texts[0]; i++) {
+      vurb_textRelease((vurb_Text *)target[texts[i + 1]]);
+   }
+   if (target != source) {
+      for (long i = 0; i < words; i++) target[i] = source[i];
+   }
+}
+
+// releases the text held in a struct, leaving it empty
+void vurb_structRelease(long *target, const long *texts)
+{
+   for (long i = 0; i < texts[0]; i++) {
+      vurb_textRelease((vurb_Text *)target[texts[i + 1]]);
+      target[texts[i + 1]] = 0;
+   }
+}
+
+}
+
+
+// --- output -----------------------------------------------------------------
+
+// buffers everything written until it is full, input is waited for or the
+//    program ends
+struct vurb_Output {
+   char buffer[1 << 16];
+   size_t used;
+
+   void send(const char *text, size_t length) {
+      while (length > 0) {
+         long count = vurb_syscall(SysWrite, 1, (long)text, length);
+         if (count <= 0) return;
+         text += count;
+         length -= count;
+      }
+   }
+
+   void flush() {
+      send(buffer, used);
+      used = 0;
+   }
+
+   void put(const char *text, size_t length) {
+      if (length > sizeof(buffer) - used) {
+         flush();
+         if (length > sizeof(buffer)) {
+            send(text, length);
+            return;
+         }
+      }
+      for (size_t i = 0; i < length; i++) buffer[used + i] = text[i];
+      used += length;
+   }
+
+   void put(char c) {
+      if (used == sizeof(buffer)) flush();
+      buffer[used++] = c;
+   }
+};
+
+static vurb_Output vurb_out;
+
+static char *vurb_formatInteger(char *digits, long value)
+{
+   char reversed[24];
+   int length = 0;
+   unsigned long magnitude = (value < 0) ? 0 - (unsigned long)value : value;
+   do {
+      reversed[length++] = '0' + magnitude % 10;
+      magnitude /= 10;
+   } while (magnitude != 0);
+   if (value < 0) *digits++ = '-';
+   while (length > 0) *digits++ = reversed[--length];
+   return digits;
+}
+
+// powers of ten up to the largest held exactly in a long double
+static long double vurb_powerOfTen(int exponent)
+{
+   static const int exact = 27;
+   long double power = 1;
+   long double large = 1;
+   for (int i = 0; i < exact; i++) large *= 10;
+   while (exponent > exact) {
+      power *= large;
+      exponent -= exact;
+   }
+   for (int i = 0; i < exponent; i++) power *= 10;
+   return power;
+}
+
+// returns value times ten to the power of exponent, rounded once when the
+//    power is held exactly
+static long double vurb_scale(long double value, int exponent)
+{
+   return exponent >= 0 ? value * vurb_powerOfTen(exponent) : value / vurb_powerOfTen(-exponent);
+}
+
+// writes a real to 6 significant digits as printf's %g does: the digits are
+//    found in long double arithmetic, exact for the ties that round to even
+static char *vurb_formatReal(char *digits, double value)
+{
+   union { double real; unsigned long bits; } number = {value};
+   int binaryExponent = (int)((number.bits >> 52) & 0x7ff);
+   unsigned long fraction = number.bits & ((1ul << 52) - 1);
+   if (number.bits >> 63) *digits++ = '-';
+
+   if (binaryExponent == 0x7ff) {
+      const char *name = fraction ? "nan" : "inf";
+      for (int i = 0; i < 3; i++) *digits++ = name[i];
+      return digits;
+   }
+   if (binaryExponent == 0 && fraction == 0) {
+      *digits++ = '0';
+      return digits;
+   }
+
+   // find the decimal exponent that leaves 6 digits before the point
+   long double magnitude = (number.bits >> 63) ? -(long double)value : (long double)value;
+   int exponent = (int)((binaryExponent - 1023) * 0.30103);
+   long double scaled = vurb_scale(magnitude, 5 - exponent);
+   while (scaled >= 1000000) scaled = vurb_scale(magnitude, 5 - ++exponent);
+   while (scaled < 100000) scaled = vurb_scale(magnitude, 5 - --exponent);
+
+   long whole = (long)scaled;
+   long double rest = scaled - whole;
+   if (rest > 0.5L || (rest == 0.5L && (whole & 1))) whole++;
+   if (whole == 1000000) {
+      whole = 100000;
+      exponent++;
+   }
+
+   char figures[6];
+   for (int i = 5; i >= 0; i--) {
+      figures[i] = '0' + whole % 10;
+      whole /= 10;
+   }
+   int shown = 6;
+   while (shown > 1 && figures[shown - 1] == '0') shown--;
+
+   if (exponent < -4 || exponent >= 6) {
+      *digits++ = figures[0];
+      if (shown > 1) {
+         *digits++ = '.';
+         for (int i = 1; i < shown; i++) *digits++ = figures[i];
+      }
+      *digits++ = 'e';
+      *digits++ = exponent < 0 ? '-' : '+';
+      int power = exponent < 0 ? -exponent : exponent;
+      if (power >= 100) *digits++ = '0' + power / 100;
+      *digits++ = '0' + power / 10 % 10;
+      *digits++ = '0' + power % 10;
+      return digits;
+   }
+
+   if (exponent < 0) {
+      *digits++ = '0';
+      *digits++ = '.';
+      for (int i = 0; i < -exponent - 1; i++) *digits++ = '0';
+      for (int i = 0; i < shown; i++) *digits++ = figures[i];
+      return digits;
+   }
+
+   for (int i = 0; i <= exponent; i++) *digits++ = figures[i];
+   if (shown > exponent + 1) {
+      *digits++ = '.';
+      for (int i = exponent + 1; i < shown; i++) *digits++ = figures[i];
+   }
+   return digits;
+}
+
+extern "C" {
+
+// each value written goes on a line of its own
+void vurb_writeInteger(long value)
+{
+   char digits[24];
+   vurb_out.put(digits, vurb_formatInteger(digits, value) - digits);
+   vurb_out.put('\n');
+}
+
+void vurb_writeReal(double value)
+{
+   char digits[32];
+   vurb_out.put(digits, vurb_formatReal(digits, value) - digits);
+   vurb_out.put('\n');
+}
+
+void vurb_writeBool(long value)
+{
+   vurb_out.put(value ? '1' : '0');
+   vurb_out.put('\n');
+}
+
+void vurb_writeText(vurb_Text *text, long owned)
+{
+   if (text) vurb_out.put(text->characters, text->length);
+   vurb_out.put('\n');
+   if (owned & 1) vurb_textRelease(text);
+}
+
+}
+
+
+// --- input ------------------------------------------------------------------
+
+// reads standard input in large blocks, or maps it when it is a file, and
+//    parses each whitespace separated value in place, leaving every later
+//    read alone once one has failed as cin does;
+//    output is flushed before waiting for more input, so prompts still appear
+struct vurb_Input {
+   char buffer[1 << 16];
+   const char *next;
+   const char *end;
+   bool ready;
+   bool atEnd;
+   bool failed;
+
+   void open() {
+      const long SeekCurrent = 1, RegularFile = 0100000, FileType = 0170000;
+      ready = true;
+      next = end = buffer;
+      vurb_FileStatus info;
+      long offset = vurb_syscall(SysLseek, 0, 0, SeekCurrent);
+      if (vurb_syscall(SysFstat, 0, (long)&info) == 0 && (info.mode & FileType) == RegularFile
+         && offset >= 0 && offset < info.size) {
+         const long ProtRead = 1, MapPrivate = 2;
+         long mapped = vurb_syscall(SysMmap, 0, info.size, ProtRead, MapPrivate, 0, 0);
+         if (mapped >= 0 || mapped < -4096) {
+            next = (const char *)mapped + offset;
+            end = (const char *)mapped + info.size;
+            atEnd = true;
+         }
+      }
+   }
+
+   static bool isSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+   // keep the unread input and add as much more as can be read at once
+   bool refill() {
+      if (atEnd) return false;
+      size_t kept = end - next;
+      if (kept == sizeof(buffer)) return false;
+      memmove(buffer, next, kept);
+      next = buffer;
+      end = buffer + kept;
+      vurb_out.flush();
+      long count = vurb_syscall(SysRead, 0, (long)(buffer + kept), sizeof(buffer) - kept);
+      if (count <= 0) {
+         atEnd = true;
+         return false;
+      }
+      end += count;
+      return true;
+   }
+
+   // skip to the next value, returning false if there is none
+   bool start() {
+      if (!ready) open();
+      if (failed) return false;
+      for (;;) {
+         while (next < end && isSpace(*next)) next++;
+         if (next < end) return true;
+         if (!refill()) {
+            failed = true;
+            return false;
+         }
+      }
+   }
+
+   // returns the end of the value at next, with all of it in memory
+   const char *word() {
+      const char *scan = next;
+      for (;;) {
+         while (scan < end && !isSpace(*scan)) scan++;
+         if (scan < end) return scan;
+
+         // refilling moves the unread input to the front of the buffer,
+         //    even when there is no more to read
+         size_t length = scan - next;
+         bool isRefilled = refill();
+         scan = next + length;
+         if (!isRefilled) return scan;
+      }
+   }
+};
+
+static vurb_Input vurb_in;
+
+static bool vurb_parseInteger(const char *&next, const char *last, long &value)
+{
+   const char *scan = next;
+   bool negative = false;
+   if (last - scan > 1 && (*scan == '+' || *scan == '-')) negative = (*scan++ == '-');
+   if (scan == last || *scan < '0' || *scan > '9') {
+      value = 0;
+      return false;
+   }
+   unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : LONG_MAX;
+   unsigned long magnitude = 0;
+   bool overflow = false;
+   for (; scan < last && *scan >= '0' && *scan <= '9'; scan++) {
+      unsigned long digit = *scan - '0';
+      if (magnitude > (limit - digit) / 10) {
+         overflow = true;
+      } else {
+         magnitude = magnitude * 10 + digit;
+      }
+   }
+   next = scan;
+   if (overflow) {
+      value = negative ? LONG_MIN : LONG_MAX;
+      return false;
+   }
+   value = negative ? (long)(0 - magnitude) : (long)magnitude;
+   return true;
+}
+
+// returns the real written in decimal from first to last: up to 18
+//    significant digits are kept, and the value is rounded once where
+//    both they and the power of ten are exact in a double
+static double vurb_decimalToReal(const char *first, const char *last)
+{
+   static const double exactPowers[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+   };
+
+   bool negative = (*first == '-');
+   if (*first == '+' || *first == '-') first++;
+
+   long mantissa = 0;
+   int kept = 0;
+   long exponent = 0;
+   bool fraction = false;
+   for (; first < last && ((*first >= '0' && *first <= '9') || *first == '.'); first++) {
+      if (*first == '.') {
+         fraction = true;
+         continue;
+      }
+      if (kept < 18) {
+         if (mantissa != 0 || *first != '0') {
+            mantissa = mantissa * 10 + (*first - '0');
+            kept++;
+         }
+         if (fraction) exponent--;
+      } else if (!fraction) {
+         exponent++;
+      }
+   }
+
+   if (first < last && (*first == 'e' || *first == 'E')) {
+      first++;
+      bool below = (*first == '-');
+      if (*first == '+' || *first == '-') first++;
+      long power = 0;
+      for (; first < last && *first >= '0' && *first <= '9'; first++) {
+         if (power < 100000) power = power * 10 + (*first - '0');
+      }
+      exponent += below ? -power : power;
+   }
+
+   double value = 0;
+   if (mantissa == 0 || exponent < -400) {
+      value = 0;
+   } else if (exponent > 400) {
+      value = DBL_MAX * 2;
+   } else if (mantissa < (1l << 53) && exponent >= -22 && exponent <= 22) {
+      value = exponent >= 0 ? mantissa * exactPowers[exponent] : mantissa / exactPowers[-exponent];
+   } else {
+      value = (double)vurb_scale((long double)mantissa, (int)exponent);
+   }
+   return negative ? -value : value;
+}
+
+static bool vurb_parseReal(const char *&next, const char *last, double &value)
+{
+   // find the decimal digits cin would take
+   const char *scan = next;
+   if (scan < last && (*scan == '+' || *scan == '-')) scan++;
+   const char *mantissa = scan;
+   while (scan < last && *scan >= '0' && *scan <= '9') scan++;
+   bool hasDigits = (scan != mantissa);
+   if (scan < last && *scan == '.') {
+      const char *fraction = ++scan;
+      while (scan < last && *scan >= '0' && *scan <= '9') scan++;
+      hasDigits = hasDigits || (scan != fraction);
+   }
+   if (hasDigits && scan < last && (*scan == 'e' || *scan == 'E')) {
+      scan++;
+      if (scan < last && (*scan == '+' || *scan == '-')) scan++;
+      if (scan == last || *scan < '0' || *scan > '9') hasDigits = false;
+      while (scan < last && *scan >= '0' && *scan <= '9') scan++;
+   }
+   if (!hasDigits) {
+      value = 0;
+      return false;
+   }
+   value = vurb_decimalToReal(next, scan);
+   next = scan;
+   if (value > DBL_MAX || value < -DBL_MAX) {
+      value = (value > 0) ? DBL_MAX : -DBL_MAX;
+      return false;
+   }
+   return true;
+}
+
+extern "C" {
+
+// each read leaves the variable at value unchanged if there is no more input
+void vurb_readInteger(long *value)
+{
+   if (!vurb_in.start()) return;
+   const char *last = vurb_in.word();
+   if (!vurb_parseInteger(vurb_in.next, last, *value)) vurb_in.failed = true;
+}
+
+void vurb_readBool(long *value)
+{
+   long number;
+   if (!vurb_in.start()) return;
+   const char *last = vurb_in.word();
+   if (!vurb_parseInteger(vurb_in.next, last, number)) {
+      *value = (number != 0);
+      vurb_in.failed = true;
+   } else if (number == 0 || number == 1) {
+      *value = (number == 1);
+   } else {
+      *value = 1;
+      vurb_in.failed = true;
+   }
+}
+
+void vurb_readReal(double *value)
+{
+   if (!vurb_in.start()) return;
+   const char *last = vurb_in.word();
+   if (!vurb_parseReal(vurb_in.next, last, *value)) vurb_in.failed = true;
+}
+
+void vurb_readText(vurb_Text **value)
+{
+   if (!vurb_in.start()) return;
+   vurb_Text *text = nullptr;
+   for (;;) {
+      const char *scan = vurb_in.next;
+      while (scan < vurb_in.end && !vurb_Input::isSpace(*scan)) scan++;
+      if (scan != vurb_in.next) text = vurb_extendText(text, vurb_in.next, scan - vurb_in.next);
+      vurb_in.next = scan;
+      if (scan < vurb_in.end || !vurb_in.refill()) break;
+   }
+   vurb_textRelease(*value);
+   *value = text;
+}
+
+
+// --- starting and ending ----------------------------------------------------
+
+#ifdef VURB_JIT
+// runs the main routine of a program translated into memory, returning its
+//    exit status once its output is written
+long vurb_run(long (*main)())
+{
+   long status = main();
+   vurb_out.flush();
+   return status & 0xff;
+}
+
+}
+#else
+void vurb_start()
+{
+   long status = vurb_main();
+   vurb_out.flush();
+   vurb_syscall(SysExitGroup, status & 0xff);
+}
+
+}
+
+// the kernel starts the program with the stack aligned for a call
+__asm__(
+   "\t.text\n"
+   "\t.globl _start\n"
+   "_start:\n"
+   "\txor %ebp, %ebp\n"
+   "\tcall vurb_start\n"
+   "\thlt\n");
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+// the functions of the runtime in asmruntime.cpp, for the translator's own use
+//    of the copy built into it: --run calls them from the machine code it
+//    makes, and --exec from the bytecode interpreter
+//
+// text is a pointer to a block of three 8 byte words, its count of references,
+//    its length and its capacity, followed by its characters; a null pointer
+//    is empty text
+extern "C" {
+struct vurb_Text;
+void *vurb_arrayTake(long bytes);
+void vurb_arrayGive(void *elements, long bytes);
+void vurb_textRelease(vurb_Text *text);
+vurb_Text *vurb_textConcat(vurb_Text *left, vurb_Text *right, long owned);
+void vurb_textAppend(vurb_Text **target, vurb_Text *more, long owned);
+long vurb_textCompare(vurb_Text *left, vurb_Text *right, long owned);
+void vurb_textReleaseAll(vurb_Text **texts, long count);
+void vurb_structCopy(long *target, const long *source, long words, const long *texts);
+void vurb_structRelease(long *target, const long *texts);
+void vurb_writeInteger(long value);
+void vurb_writeReal(double value);
+void vurb_writeBool(long value);
+void vurb_writeText(vurb_Text *text, long owned);
+void vurb_readInteger(long *value);
+void vurb_readBool(long *value);
+void vurb_readReal(double *value);
+void vurb_readText(vurb_Text **value);
+long vurb_run(long (*main)());
+}
+
+// text literals never have their storage given back, as they start with
+//    more references than could ever be dropped
+const long LiteralReferences = 1l << 62;
@@ -0,0 +1,2113 @@
+#include "assembling.h"
+#include "analyzing.h"
+#include "asmruntime.h"
+#include "optimizing.h"
+#include "parsing.h"
+#include "sourcemap.h"
+#include "symbols.h"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
+using std::cout;
+using std::map;
+using std::to_string;
+using std::vector;
+
+// where a variable is kept: in a register, in the frame of its procedure, in
+//    the program's data, or in storage found through a pointer in the frame,
+//    as struct and array parameters and arrays too large for the frame are
+enum asmStorage { InRegister, InFrame, InData, ThroughPointer };
+
+// a variable's type and where it is kept: the register or the label of its
+//    data, or the frame offset of its value or of the pointer to it; arrays
+//    also record their number of elements, or -1 if that is kept in the frame
+//    at countOffset, and whether their storage is given back with the scope
+struct asmVariable {
+   string name;
+   typeInfo type;
+   asmStorage storage;
+   string location;
+   long offset;
+   long count;
+   long countOffset;
+   bool ownsStorage;
+};
+
+// an element of a struct, offset bytes from its start
+struct asmElement {
+   string name;
+   typeInfo type;
+   long offset;
+};
+
+// the layout of a struct type: every value takes 8 bytes, with arrays and
+//    structs within it laid out in place, and texts lists the 8 byte words
+//    holding text, which copies and releases have to look after
+struct asmStruct {
+   vector<asmElement> elements;
+   long bytes;
+   vector<long> texts;
+};
+
+// a register, or memory at a displacement from a base register or a label,
+//    with an index register scaled by 8 for array elements
+struct asmOperand {
+   string reg;
+   string base;
+   string label;
+   long displacement;
+   string index;
+};
+
+// arrays larger than this are kept apart from the frame, as the C++ does
+const long FrameArrayBytes = 64 * 1024;
+
+// the registers kept across calls, given to the integer and boolean scalars
+//    of a procedure used the most
+static const char *calleeSaved[] = {"%rbx", "%r12", "%r13", "%r14", "%r15"};
+static const int CalleeSavedCount = 5;
+
+static unordered_map<string, asmStruct> structLayouts;
+
+// the variables in scope, innermost last: the first scope holds the globals,
+//    the second the parameters of the procedure being translated
+static vector<vector<asmVariable>> asmScopes;
+
+// the registers chosen for scalars of the procedure being translated, by the
+//    position of their declaration, or minus one more than their parameter number
+static unordered_map<int, string> chosenRegisters;
+
+// the procedure being translated: how many registers it saves, the bytes of
+//    frame given out so far, the bytes pushed below the frame, which calls
+//    out of the program keep to a multiple of 16, its return type and labels,
+//    and the frame slots for values waiting while variables are released
+//    and for scalars read through the runtime from registers
+static int savedRegisters = 0;
+static long frameBytes = 0;
+static long stackDepth = 0;
+static TokenType returnType = TokenType::VoidType;
+static string returnLabel = "";
+static string tailLabel = "";
+static long returnSlot = 0;
+static long scratchSlot = 0;
+
+static int labelCount = 0;
+
+// the constants written out after the code: reals by their bits,
+//    and text literals by their characters
+static map<unsigned long, string> realConstants;
+static map<string, string> textConstants;
+
+static int asmGlobal(token tokens[], int currPos, int size);
+static int asmStructDef(token tokens[], int currPos, int size);
+static int asmProcedure(token tokens[], int currPos, int size);
+static int asmMain(token tokens[], int currPos, int size);
+static int asmBody(token tokens[], int currPos, int size);
+static int asmStatement(token tokens[], int currPos, int size);
+static int asmValue(token tokens[], int currPos, int size, bool &owned);
+static int asmConverted(token tokens[], int currPos, int size, TokenType type);
+static int asmBranch(token tokens[], int currPos, int size, const string &label, bool when);
+static int asmCall(token tokens[], int currPos, int size);
+
+
+// translate the token sequence to x86-64 assembly for the GNU assembler,
+//    to be linked by ld with the runtime in asmruntime.o,
+// writing the results to standard output,
+// with any error messages directed to standard error
+// returns false if the program is malformed
+bool assemble(token tokens[], int size)
+{
+   collectProcedures(tokens, size);
+   asmScopes.assign(1, vector<asmVariable>());
+
+   markSourceFile();
+
+   int currPos = 0;
+   while (currPos < size && tokens[currPos].ttype == TokenType::GlobalDef) {
+      currPos = asmGlobal(tokens, currPos, size);
+      if (currPos == -1) {
+         printSectionError("Global Variable Declaration");
+         return false;
+      }
+      currPos++;
+   }
+
+   while (currPos < size && tokens[currPos].ttype == TokenType::StructDef) {
+      currPos = asmStructDef(tokens, currPos, size);
+      if (currPos == -1) {
+         printSectionError("Struct Declaration");
+         return false;
+      }
+      currPos++;
+   }
+
+   while (currPos < size && tokens[currPos].ttype == TokenType::ProcDef) {
+      currPos = asmProcedure(tokens, currPos, size);
+      if (currPos == -1) {
+         printSectionError("Procedure Declaration");
+         return false;
+      }
+      currPos++;
+   }
+
+   if (currPos >= size) return false;
+
+   currPos = asmMain(tokens, currPos, size);
+   if (currPos == -1) return false;
+
+   currPos++;
+   if (currPos != size) {
+      cerr << "Error: invalid content found after main routine.\n";
+      cerr << (size - currPos) << " additional tokens found\n";
+      return false;
+   }
+
+   // the constants the code refers to
+   if (!realConstants.empty()) {
+      cout << "\n\t.section .rodata\n\t.balign 8\n";
+      for (auto it = realConstants.begin(); it != realConstants.end(); it++) {
+         cout << it->second << ":\n\t.quad " << it->first << "\n";
+      }
+   }
+   if (!textConstants.empty()) {
+      cout << "\n\t.data\n";
+      for (auto it = textConstants.begin(); it != textConstants.end(); it++) {
+         cout << "\t.balign 8\n" << it->second << ":\n";
+         cout << "\t.quad " << LiteralReferences << ", " << it->first.length();
+         cout << ", " << it->first.length() << "\n";
+         if (it->first.length() == 0) continue;
+         cout << "\t.ascii \"";
+         for (unsigned char c : it->first) {
+            if (c == '"' || c == '\\') {
+               cout << '\\' << c;
+            } else if (c < ' ' || c > '~') {
+               cout << '\\' << (char)('0' + (c >> 6)) << (char)('0' + ((c >> 3) & 7)) << (char)('0' + (c & 7));
+            } else {
+               cout << c;
+            }
+         }
+         cout << "\"\n";
+      }
+   }
+
+   cout << "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+   return true;
+}
+
+
+// --- writing assembly ---------------------------------------------------
+
+static void emit(const string &instruction)
+{
+   cout << "\t" << instruction << "\n";
+}
+
+
+static void emitLabel(const string &label)
+{
+   cout << label << ":\n";
+}
+
+
+static string newLabel()
+{
+   return ".L" + to_string(labelCount++);
+}
+
+
+// returns the value of an integer literal, which C++ reads as octal
+//    when it starts with a zero
+long integerLiteral(const string &content)
+{
+   int base = (content.length() > 1 && content[0] == '0') ? 8 : 10;
+   return (long)strtoul(content.c_str(), nullptr, base);
+}
+
+
+// returns the characters of a text literal, with the escapes
+//    C++ would read in it replaced
+string literalCharacters(const string &content)
+{
+   string characters = "";
+   string quoted = content.substr(1, content.length() - 2);
+
+   for (size_t i = 0; i < quoted.length(); i++) {
+      if (quoted[i] != '\\' || i + 1 == quoted.length()) {
+         characters += quoted[i];
+         continue;
+      }
+
+      char escape = quoted[++i];
+      const string simple = "n\nt\tr\ra\ab\bf\fv\v";
+      size_t found = simple.find(escape);
+      if (found != string::npos && found % 2 == 0) {
+         characters += simple[found + 1];
+      } else if (escape >= '0' && escape <= '7') {
+         int value = 0;
+         for (int digits = 0; digits < 3 && i < quoted.length() && quoted[i] >= '0' && quoted[i] <= '7'; digits++) {
+            value = value * 8 + (quoted[i++] - '0');
+         }
+         i--;
+         characters += (char)value;
+      } else if (escape == 'x') {
+         int value = 0;
+         while (i + 1 < quoted.length() && isxdigit((unsigned char)quoted[i + 1])) {
+            char digit = (char)tolower(quoted[++i]);
+            value = value * 16 + (isdigit((unsigned char)digit) ? digit - '0' : digit - 'a' + 10);
+         }
+         characters += (char)value;
+      } else {
+         characters += escape;
+      }
+   }
+   return characters;
+}
+
+
+// returns the label of the constant holding a real value
+static string realConstant(double value)
+{
+   unsigned long bits = 0;
+   memcpy(&bits, &value, sizeof(bits));
+   auto found = realConstants.find(bits);
+   if (found != realConstants.end()) return found->second;
+   string label = newLabel();
+   realConstants[bits] = label;
+   return label;
+}
+
+
+// returns the label of the text constant holding the characters
+static string textConstant(const string &characters)
+{
+   auto found = textConstants.find(characters);
+   if (found != textConstants.end()) return found->second;
+   string label = newLabel();
+   textConstants[characters] = label;
+   return label;
+}
+
+
+// returns the operand as written in an instruction
+static string render(const asmOperand &operand)
+{
+   if (operand.reg != "") return operand.reg;
+
+   string displacement = operand.displacement ? to_string(operand.displacement) : "";
+   if (operand.label != "") {
+      string at = operand.label + (operand.displacement ? "+" + displacement : "");
+      return at + (operand.index != "" ? "(," + operand.index + ",8)" : "(%rip)");
+   }
+   return displacement + "(" + operand.base + (operand.index != "" ? "," + operand.index + ",8" : "") + ")";
+}
+
+
+// returns the operand for a frame offset
+static string frameOperand(long offset)
+{
+   return to_string(offset) + "(%rbp)";
+}
+
+
+// put an integer in a register, using the shortest instruction that holds it
+static void loadInteger(long value, const string &reg)
+{
+   if (value >= 0 && value <= 0x7fffffff) {
+      emit("mov $" + to_string(value) + ", " + reg);
+   } else {
+      emit("movabs $" + to_string(value) + ", " + reg);
+   }
+}
+
+
+// call a function of the runtime, keeping the stack aligned as it expects
+static void callRuntime(const string &function)
+{
+   if (stackDepth % 16 != 0) {
+      emit("sub $8, %rsp");
+      emit("call " + function);
+      emit("add $8, %rsp");
+   } else {
+      emit("call " + function);
+   }
+}
+
+
+// save the value just worked out on the stack, and get it back
+static void pushValue(TokenType type)
+{
+   if (type == TokenType::RealType) emit("movq %xmm0, %rax");
+   emit("push %rax");
+   stackDepth += 8;
+}
+
+
+static void popValue(TokenType type, const string &reg)
+{
+   emit("pop " + reg);
+   stackDepth -= 8;
+   if (type == TokenType::RealType && reg == "%rax") emit("movq %rax, %xmm0");
+}
+
+
+// take another reference to the text in %rax, which may be empty
+static void retainText()
+{
+   emit("test %rax, %rax");
+   emit("jz 1f");
+   emit("incq (%rax)");
+   cout << "1:\n";
+}
+
+
+// returns a frame slot of the given size in bytes
+static long frameSlot(long bytes)
+{
+   frameBytes += (bytes + 7) / 8 * 8;
+   return -(savedRegisters * 8 + frameBytes);
+}
+
+
+// set a run of the frame to zero, as text and structs start out empty
+static void clearFrame(long offset, long bytes)
+{
+   long words = bytes / 8;
+   if (words <= 8) {
+      for (long i = 0; i < words; i++) emit("movq $0, " + frameOperand(offset + 8 * i));
+      return;
+   }
+   emit("lea " + frameOperand(offset) + ", %rdi");
+   emit("mov $" + to_string(words) + ", %ecx");
+   emit("xor %eax, %eax");
+   emit("rep stosq");
+}
+
+
+// --- variables and their types -------------------------------------------
+
+// returns the variable of the given name in the innermost scope that has one,
+//    or nullptr if none does
+static asmVariable *findVariable(const string &name)
+{
+   for (size_t scope = asmScopes.size(); scope-- > 0; ) {
+      for (size_t i = asmScopes[scope].size(); i-- > 0; ) {
+         if (asmScopes[scope][i].name == name) return &asmScopes[scope][i];
+      }
+   }
+   return nullptr;
+}
+
+
+// record a variable in the innermost scope, where accessType can find it too
+static void declareAsmVariable(const asmVariable &variable)
+{
+   asmScopes.back().push_back(variable);
+   declareVariable(variable.name, variable.type);
+}
+
+
+// returns the number of bytes a value of the type takes
+static long typeBytes(const typeInfo &type)
+{
+   long bytes = 8;
+   if (type.ttype == TokenType::StructType) bytes = structLayouts[type.structName].bytes;
+   return type.isArray ? bytes * integerLiteral(type.arraySize) : bytes;
+}
+
+
+// returns the element of the struct type with the given name, or nullptr if none
+static const asmElement *findElement(const string &structName, const string &elementName)
+{
+   auto layout = structLayouts.find(structName);
+   if (layout == structLayouts.end()) return nullptr;
+   for (const asmElement &element : layout->second.elements) {
+      if (element.name == elementName) return &element;
+   }
+   return nullptr;
+}
+
+
+// returns the type of the value of the expression at currPos:
+//    IntType, RealType, TextType or BoolType, StructType for structs,
+//    VoidType for calls that return nothing, or Invalid if unknown
+TokenType valueType(token tokens[], int currPos, int size)
+{
+   if (currPos >= size) return TokenType::Invalid;
+
+   switch (tokens[currPos].ttype) {
+      case IntLit:
+      case ArraySize:
+         return TokenType::IntType;
+      case RealLit:
+         return TokenType::RealType;
+      case TextLit:
+         return TokenType::TextType;
+      case BoolLit:
+         return TokenType::BoolType;
+      case Identifier:
+      case ArrayAccess:
+      case StructElemAccess:
+      case StructIndirElemAccess: {
+         typeInfo type;
+         return accessType(tokens, currPos, size, type) ? type.ttype : TokenType::Invalid;
+      }
+      case Call: {
+         const procedureInfo *proc = (currPos + 1 < size) ? findProcedure(tokens[currPos + 1].content) : nullptr;
+         return proc ? proc->returnType : TokenType::Invalid;
+      }
+      case Left:
+         break;
+      default:
+         return TokenType::Invalid;
+   }
+
+   if (currPos + 2 >= size) return TokenType::Invalid;
+   TokenType op = tokens[currPos + 1].ttype;
+
+   if (isIncrementOperator(op)) return valueType(tokens, currPos + 2, size);
+   if (isCondOperator(op)) return TokenType::BoolType;
+   if (op == TokenType::Negate) {
+      return valueType(tokens, currPos + 2, size) == TokenType::RealType ? TokenType::RealType : TokenType::IntType;
+   }
+   if (op == TokenType::Rem) return TokenType::IntType;
+
+   // arithmetic on reals gives a real, as C++ converts the other side,
+   //    and adding text joins it
+   int leftEnd = skipExpression(tokens, currPos + 2, size);
+   if (leftEnd == -1) return TokenType::Invalid;
+   TokenType left = valueType(tokens, currPos + 2, size);
+   TokenType right = valueType(tokens, leftEnd + 1, size);
+   if (left == TokenType::TextType || right == TokenType::TextType) return TokenType::TextType;
+   if (left == TokenType::RealType || right == TokenType::RealType) return TokenType::RealType;
+   return TokenType::IntType;
+}
+
+
+// returns the operand of a variable itself, loading the pointer to it into
+//    %rdx if it is kept through one
+static asmOperand variableOperand(const asmVariable &variable)
+{
+   asmOperand operand = {"", "", "", 0, ""};
+
+   if (variable.storage == InRegister) {
+      operand.reg = variable.location;
+   } else if (variable.storage == InData) {
+      operand.label = variable.location;
+   } else if (variable.storage == InFrame) {
+      operand.base = "%rbp";
+      operand.displacement = variable.offset;
+   } else {
+      emit("mov " + frameOperand(variable.offset) + ", %rdx");
+      operand.base = "%rdx";
+   }
+   return operand;
+}
+
+
+// move the operand on to the array element indexed by the token at indexPos,
+//    loading the index into %rcx unless it is a literal or in a register
+static bool indexOperand(token tokens[], int indexPos, asmOperand &operand)
+{
+   if (tokens[indexPos].ttype == TokenType::IntLit) {
+      operand.displacement += 8 * integerLiteral(tokens[indexPos].content);
+      return true;
+   }
+
+   const asmVariable *index = nullptr;
+   if (tokens[indexPos].ttype == TokenType::Identifier) index = findVariable(tokens[indexPos].content);
+   if (!index || index->type.isArray) {
+      printError(tokens[indexPos], indexPos, "Valid array index");
+      return false;
+   }
+
+   if (index->storage == InRegister) {
+      operand.index = index->location;
+   } else {
+      emit("mov " + render(variableOperand(*index)) + ", %rcx");
+      operand.index = "%rcx";
+   }
+   return true;
+}
+
+
+// find the operand of the identifier, array access or struct access at currPos,
+//    and its type, using only %rdx and %rcx to get there
+// returns the position of the last token of the access, or -1 if malformed
+static int accessOperand(token tokens[], int currPos, int size, asmOperand &operand, typeInfo &type)
+{
+   if (currPos >= size) return -1;
+
+   if (tokens[currPos].ttype == TokenType::Identifier) {
+      const asmVariable *variable = findVariable(tokens[currPos].content);
+      if (!variable) {
+         printError(tokens[currPos], currPos, "declared variable");
+         return -1;
+      }
+      type = variable->type;
+      operand = variableOperand(*variable);
+      return currPos;
+   }
+
+   if (tokens[currPos].ttype == TokenType::ArrayAccess) {
+      int arrayEnd = accessOperand(tokens, currPos + 1, size, operand, type);
+      if (arrayEnd == -1 || arrayEnd + 1 >= size) return -1;
+      if (!type.isArray) {
+         printError(tokens[currPos + 1], currPos + 1, "Array");
+         return -1;
+      }
+      if (!indexOperand(tokens, arrayEnd + 1, operand)) return -1;
+      type.isArray = false;
+      type.arraySize = "";
+      return arrayEnd + 1;
+   }
+
+   if (tokens[currPos].ttype == TokenType::StructElemAccess
+      || tokens[currPos].ttype == TokenType::StructIndirElemAccess) {
+      int structEnd = accessOperand(tokens, currPos + 1, size, operand, type);
+      if (structEnd == -1 || structEnd + 1 >= size) return -1;
+      const asmElement *element = nullptr;
+      if (!type.isArray && type.ttype == TokenType::StructType) {
+         element = findElement(type.structName, tokens[structEnd + 1].content);
+      }
+      if (!element) {
+         printError(tokens[structEnd + 1], structEnd + 1, "Struct element identifier");
+         return -1;
+      }
+      operand.displacement += element->offset;
+      type = element->type;
+      return structEnd + 1;
+   }
+
+   printError(tokens[currPos], currPos, "Identifier or struct field");
+   return -1;
+}
+
+
+// find the operand giving the number of elements of the array at currPos
+static bool countOperand(token tokens[], int currPos, int size, string &count)
+{
+   typeInfo type;
+   if (!accessType(tokens, currPos, size, type) || !type.isArray) {
+      printError(tokens[currPos], currPos, "Array");
+      return false;
+   }
+
+   // the size is known from the declaration, or kept along with the array
+   const asmVariable *variable = nullptr;
+   if (tokens[currPos].ttype == TokenType::Identifier) variable = findVariable(tokens[currPos].content);
+   if (variable && variable->count < 0) {
+      count = frameOperand(variable->countOffset);
+   } else {
+      count = "$" + to_string(variable ? variable->count : integerLiteral(type.arraySize));
+   }
+   return true;
+}
+
+
+// returns true if the access at currPos reaches its value without any code:
+//    a variable, or an element of an array or struct of the frame or the
+//    program's data, indexed by a literal or a variable kept in a register
+static bool isDirectAccess(token tokens[], int currPos, int size)
+{
+   if (currPos + 1 >= size) return false;
+
+   switch (tokens[currPos].ttype) {
+      case Identifier: {
+         const asmVariable *variable = findVariable(tokens[currPos].content);
+         return variable && variable->storage != ThroughPointer;
+      }
+      case ArrayAccess: {
+         int arrayEnd = skipExpression(tokens, currPos + 1, size);
+         if (arrayEnd == -1 || arrayEnd + 1 >= size || !isDirectAccess(tokens, currPos + 1, size)) return false;
+         const token &index = tokens[arrayEnd + 1];
+         if (index.ttype == TokenType::IntLit) return true;
+         const asmVariable *variable = (index.ttype == TokenType::Identifier) ? findVariable(index.content) : nullptr;
+         return variable && variable->storage == InRegister;
+      }
+      case StructElemAccess:
+      case StructIndirElemAccess:
+         return isDirectAccess(tokens, currPos + 1, size);
+      default:
+         return false;
+   }
+}
+
+
+// returns true if the expression at currPos can be used as an operand of
+//    integer (or, with isReal, real) arithmetic as it stands, storing the
+//    operand: a literal, or a scalar reached without any code
+static bool simpleOperand(token tokens[], int currPos, int size, bool isReal, string &operand)
+{
+   if (currPos >= size) return false;
+   const token &tok = tokens[currPos];
+
+   if (tok.ttype == TokenType::IntLit) {
+      long value = integerLiteral(tok.content);
+      if (isReal) {
+         operand = realConstant((double)value) + "(%rip)";
+         return true;
+      }
+      if (value > 0x7fffffff) return false;
+      operand = "$" + to_string(value);
+      return true;
+   } else if (tok.ttype == TokenType::BoolLit && !isReal) {
+      operand = (tok.content == "true") ? "$1" : "$0";
+      return true;
+   } else if (tok.ttype == TokenType::RealLit && isReal) {
+      operand = realConstant(strtod(tok.content.c_str(), nullptr)) + "(%rip)";
+      return true;
+   } else if (!isDirectAccess(tokens, currPos, size)) {
+      return false;
+   }
+
+   asmOperand access;
+   typeInfo type;
+   if (accessOperand(tokens, currPos, size, access, type) == -1 || type.isArray) return false;
+   if (isReal != (type.ttype == TokenType::RealType)) return false;
+   if (!isReal && type.ttype != TokenType::IntType && type.ttype != TokenType::BoolType) return false;
+
+   operand = render(access);
+   return true;
+}
+
+
+// leave the left side of an operation, converted to the type, in %rax,
+//    or %xmm0 for a real, storing the operand holding its right side:
+//    the right side itself if simple enough, or else %rcx or %xmm1; the
+//    right side is worked out first when only the left is simple
+// returns the position of the last token of the right side, or -1 if malformed
+static int asmOperands(token tokens[], int leftPos, int size, TokenType type, string &operand)
+{
+   bool isReal = (type == TokenType::RealType);
+   string scratch = isReal ? "%xmm1" : "%rcx";
+   int rightPos = skipExpression(tokens, leftPos, size) + 1;
+   if (rightPos == 0 || rightPos >= size) return -1;
+   int rightEnd = skipExpression(tokens, rightPos, size);
+   if (rightEnd == -1) return -1;
+
+   string left = "";
+   if (!simpleOperand(tokens, rightPos, size, isReal, operand) && simpleOperand(tokens, leftPos, size, isReal, left)) {
+      if (asmConverted(tokens, rightPos, size, type) == -1) return -1;
+      emit(isReal ? "movapd %xmm0, %xmm1" : "mov %rax, %rcx");
+      emit((isReal ? "movsd " : "mov ") + left + (isReal ? ", %xmm0" : ", %rax"));
+      operand = scratch;
+      return rightEnd;
+   }
+
+   if (asmConverted(tokens, leftPos, size, type) == -1) return -1;
+   if (operand == "") {
+      pushValue(type);
+      if (asmConverted(tokens, rightPos, size, type) == -1) return -1;
+      emit(isReal ? "movapd %xmm0, %xmm1" : "mov %rax, %rcx");
+      popValue(type, "%rax");
+      operand = scratch;
+   }
+   return rightEnd;
+}
+
+
+// --- releasing ---------------------------------------------------------------
+
+// returns true if the variable holds text or storage to give back when it goes out of scope
+static bool needsRelease(const asmVariable &variable)
+{
+   if (variable.storage == InData) return false;
+   if (variable.type.isArray) {
+      return variable.ownsStorage
+         || (variable.storage == InFrame && variable.type.ttype == TokenType::TextType);
+   }
+   if (variable.type.ttype == TokenType::StructType) {
+      return variable.storage == InFrame && !structLayouts[variable.type.structName].texts.empty();
+   }
+   return variable.type.ttype == TokenType::TextType;
+}
+
+
+// give back the text and storage held by the variable
+static void releaseVariable(const asmVariable &variable)
+{
+   if (!needsRelease(variable)) return;
+   const typeInfo &type = variable.type;
+
+   if (type.isArray) {
+      string count = (variable.count < 0) ? frameOperand(variable.countOffset) : "$" + to_string(variable.count);
+      string elements = variable.ownsStorage ? "mov " : "lea ";
+      if (type.ttype == TokenType::TextType) {
+         emit(elements + frameOperand(variable.offset) + ", %rdi");
+         emit("mov " + count + ", %rsi");
+         callRuntime("vurb_textReleaseAll");
+      }
+      if (variable.ownsStorage) {
+         emit("mov " + frameOperand(variable.offset) + ", %rdi");
+         emit("mov " + count + ", %rsi");
+         emit("shl $3, %rsi");
+         callRuntime("vurb_arrayGive");
+      }
+   } else if (type.ttype == TokenType::StructType) {
+      emit("lea " + frameOperand(variable.offset) + ", %rdi");
+      emit("lea vurb_texts_" + type.structName + "(%rip), %rsi");
+      callRuntime("vurb_structRelease");
+   } else {
+      emit("mov " + frameOperand(variable.offset) + ", %rdi");
+      callRuntime("vurb_textRelease");
+   }
+}
+
+
+// release the variables of the scopes from the innermost out to the given one
+static void releaseScopes(size_t outermost)
+{
+   for (size_t scope = asmScopes.size(); scope-- > outermost; ) {
+      for (size_t i = asmScopes[scope].size(); i-- > 0; ) {
+         releaseVariable(asmScopes[scope][i]);
+      }
+   }
+}
+
+
+// returns true if any variable of the scopes out to the given one needs releasing
+static bool scopesNeedRelease(size_t outermost)
+{
+   for (size_t scope = outermost; scope < asmScopes.size(); scope++) {
+      for (const asmVariable &variable : asmScopes[scope]) {
+         if (needsRelease(variable)) return true;
+      }
+   }
+   return false;
+}
+
+
+// --- declarations ------------------------------------------------------------
+
+// lay out a global variable in the program's zeroed data
+static int asmGlobal(token tokens[], int currPos, int size)
+{
+   string name = "";
+   typeInfo type;
+   int declEnd = readDeclaration(tokens, currPos + 1, size, name, type);
+   if (declEnd == -1 || (type.isArray && tokens[currPos + 4].ttype != TokenType::IntLit)) {
+      printError(tokens[currPos + 1], currPos + 1, "Global variable declaration");
+      return -1;
+   }
+
+   cout << "\n\t.bss\n\t.balign 8\n" << name << ":\n\t.zero " << typeBytes(type) << "\n";
+
+   asmVariable variable = {name, type, InData, name, 0, -1, 0, false};
+   if (type.isArray) variable.count = integerLiteral(type.arraySize);
+   declareAsmVariable(variable);
+   return declEnd;
+}
+
+
+// lay out a struct type, with the table of its text words for the runtime
+static int asmStructDef(token tokens[], int currPos, int size)
+{
+   if (currPos + 2 >= size || tokens[currPos + 1].ttype != TokenType::Identifier
+      || tokens[currPos + 2].ttype != TokenType::Begin) {
+      printError(tokens[currPos + 1], currPos + 1, tokenTypeToString(TokenType::Identifier));
+      return -1;
+   }
+
+   string structName = tokens[currPos + 1].content;
+   asmStruct layout;
+   layout.bytes = 0;
+   currPos += 3;
+
+   while (currPos < size && tokens[currPos].ttype == TokenType::Element) {
+      asmElement element;
+      int declEnd = readDeclaration(tokens, currPos + 1, size, element.name, element.type);
+      if (declEnd == -1) {
+         printError(tokens[currPos + 1], currPos + 1, "Valid struct element");
+         return -1;
+      }
+      declareElement(structName, element.name, element.type);
+
+      element.offset = layout.bytes;
+      long words = element.offset / 8;
+      if (element.type.ttype == TokenType::TextType) {
+         long count = element.type.isArray ? integerLiteral(element.type.arraySize) : 1;
+         for (long i = 0; i < count; i++) layout.texts.push_back(words + i);
+      } else if (element.type.ttype == TokenType::StructType && !element.type.isArray) {
+         for (long text : structLayouts[element.type.structName].texts) layout.texts.push_back(words + text);
+      }
+      layout.bytes += typeBytes(element.type);
+      layout.elements.push_back(element);
+      currPos = declEnd + 1;
+   }
+
+   if (currPos >= size || tokens[currPos].ttype != TokenType::End) {
+      printError(tokens[currPos], currPos, tokenTypeToString(TokenType::End));
+      return -1;
+   }
+
+   structLayouts[structName] = layout;
+
+   if (!layout.texts.empty()) {
+      cout << "\n\t.section .rodata\n\t.balign 8\nvurb_texts_" << structName << ":\n";
+      cout << "\t.quad " << layout.texts.size();
+      for (long text : layout.texts) cout << ", " << text;
+      cout << "\n";
+   }
+   return currPos;
+}
+
+
+// choose the integer and boolean scalars of the procedure to keep in the
+//    registers saved across calls, taking those used most often in its body,
+//    with each loop counted as running eight times
+static void planRegisters(token tokens[], int size, const procedureInfo *proc, int bodyStart, int bodyEnd)
+{
+   chosenRegisters.clear();
+
+   // the declarations visible, by name, with minus one more than the
+   //    parameter number standing for parameters
+   vector<vector<pair<string, int>>> visible(1);
+   unordered_map<int, long> uses;
+   vector<int> order;
+
+   for (size_t i = 0; proc && i < proc->params.size(); i++) {
+      const paramInfo &param = proc->params[i];
+      int key = -(int)i - 1;
+      visible[0].push_back({param.name, key});
+      if (!param.isArray && param.structType.empty()
+         && (param.ptype == TokenType::IntType || param.ptype == TokenType::BoolType)) {
+         uses[key] = 0;
+         order.push_back(key);
+      }
+   }
+
+   vector<int> loopBodies;
+   int depth = 0;
+   int conditionEnd = -1;
+   bool bodyNext = false;
+
+   for (int pos = bodyStart; pos <= bodyEnd && pos < size; pos++) {
+      TokenType type = tokens[pos].ttype;
+
+      if (type == TokenType::Begin) {
+         depth++;
+         visible.push_back({});
+         if (bodyNext) loopBodies.push_back(depth);
+         bodyNext = false;
+      } else if (type == TokenType::End) {
+         visible.pop_back();
+         if (!loopBodies.empty() && loopBodies.back() == depth) loopBodies.pop_back();
+         depth--;
+      } else if (type == TokenType::If) {
+         bodyNext = true;
+         conditionEnd = skipExpression(tokens, pos + 1, size);
+      } else if (type == TokenType::VarDef) {
+         string name = "";
+         typeInfo declType;
+         if (readDeclaration(tokens, pos + 1, size, name, declType) == -1) continue;
+         visible.back().push_back({name, pos});
+         if (!declType.isArray && (declType.ttype == TokenType::IntType || declType.ttype == TokenType::BoolType)) {
+            uses[pos] = 0;
+            order.push_back(pos);
+         }
+      } else if (type == TokenType::Identifier) {
+         // the condition of a loop runs once more than its body
+         int loops = (int)loopBodies.size() + (pos <= conditionEnd ? 1 : 0);
+         for (size_t scope = visible.size(); scope-- > 0; ) {
+            auto found = std::find_if(visible[scope].rbegin(), visible[scope].rend(),
+               [&](const pair<string, int> &decl) { return decl.first == tokens[pos].content; });
+            if (found == visible[scope].rend()) continue;
+            if (uses.count(found->second)) uses[found->second] += 1l << std::min(3 * loops, 60);
+            break;
+         }
+      }
+   }
+
+   std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return uses[a] > uses[b]; });
+   for (size_t i = 0; i < order.size() && (int)i < CalleeSavedCount; i++) {
+      if (uses[order[i]] == 0) break;
+      chosenRegisters[order[i]] = calleeSaved[i];
+   }
+}
+
+
+// start a procedure: save the registers its scalars are kept in, make room
+//    for its frame and find its parameters, which the caller pushed in order
+static void startProcedure(token tokens[], int size, const string &label,
+   const procedureInfo *proc, int bodyStart, int bodyEnd)
+{
+   planRegisters(tokens, size, proc, bodyStart, bodyEnd);
+
+   savedRegisters = (int)chosenRegisters.size();
+   frameBytes = 0;
+   stackDepth = 0;
+   returnSlot = 0;
+   scratchSlot = 0;
+   returnType = proc ? proc->returnType : TokenType::IntType;
+   returnLabel = newLabel();
+   tailLabel = "";
+
+   cout << "\n\t.text\n\t.p2align 4\n\t.globl " << label << "\n\t.type " << label << ", @function\n";
+   emitLabel(label);
+   emit("push %rbp");
+   emit("mov %rsp, %rbp");
+   for (int i = 0; i < savedRegisters; i++) emit(string("push ") + calleeSaved[i]);
+   emit("sub $" + returnLabel + "_frame, %rsp");
+
+   enterScope();
+   asmScopes.push_back(vector<asmVariable>());
+
+   long slots = 0;
+   for (size_t i = 0; proc && i < proc->params.size(); i++) {
+      slots += proc->params[i].isArray ? 2 : 1;
+   }
+
+   long slot = 0;
+   for (size_t i = 0; proc && i < proc->params.size(); i++) {
+      const paramInfo &param = proc->params[i];
+      asmVariable variable = {param.name, typeInfo(), InFrame, "", 16 + 8 * (slots - 1 - slot), -1, 0, false};
+      variable.type.ttype = param.structType.empty() ? param.ptype : TokenType::StructType;
+      variable.type.structName = param.structType;
+      variable.type.isArray = param.isArray;
+      variable.type.arraySize = param.isArray ? arraySizeName(param.name) : "";
+
+      // arrays come with their number of elements, and are passed, like structs,
+      //    as a pointer
+      auto chosen = chosenRegisters.find(-(int)i - 1);
+      if (param.isArray) {
+         variable.storage = ThroughPointer;
+         variable.countOffset = variable.offset - 8;
+         slot++;
+      } else if (!param.structType.empty()) {
+         variable.storage = ThroughPointer;
+      } else if (chosen != chosenRegisters.end()) {
+         variable.storage = InRegister;
+         variable.location = chosen->second;
+         emit("mov " + frameOperand(variable.offset) + ", " + variable.location);
+      }
+      slot++;
+      declareAsmVariable(variable);
+   }
+}
+
+
+// finish a procedure, returning nothing, or zero, if it runs off its end
+static void finishProcedure(const string &label)
+{
+   releaseScopes(1);
+   if (returnType != TokenType::VoidType) emit("xor %eax, %eax");
+
+   emitLabel(returnLabel);
+   if (savedRegisters > 0) {
+      emit("lea " + to_string(-8 * savedRegisters) + "(%rbp), %rsp");
+      for (int i = savedRegisters; i-- > 0; ) emit(string("pop ") + calleeSaved[i]);
+      emit("pop %rbp");
+   } else {
+      emit("leave");
+   }
+   emit("ret");
+
+   // the frame keeps the stack aligned to 16 bytes for calls
+   long frame = frameBytes + ((savedRegisters * 8 + frameBytes) % 16);
+   cout << "\t.set " << returnLabel << "_frame, " << frame << "\n";
+   cout << "\t.size " << label << ", .-" << label << "\n";
+
+   asmScopes.pop_back();
+   exitScope();
+}
+
+
+// translate a procedure definition
+static int asmProcedure(token tokens[], int currPos, int size)
+{
+   if (currPos + 1 >= size) return -1;
+
+   const procedureInfo *proc = findProcedure(tokens[currPos + 1].content);
+   if (!proc) {
+      printError(tokens[currPos + 1], currPos + 1, "Procedure definition");
+      return -1;
+   }
+
+   markProcedure(tokens[currPos], proc->name);
+   startProcedure(tokens, size, proc->name, proc, proc->bodyStart, proc->bodyEnd);
+
+   // self tail calls jump back to the start of the body
+   if (hasSelfTailCall(tokens, size, proc->name)) {
+      tailLabel = newLabel();
+      emitLabel(tailLabel);
+   }
+
+   if (asmBody(tokens, proc->bodyStart, size) == -1) return -1;
+   finishProcedure(proc->name);
+   return proc->bodyEnd;
+}
+
+
+// translate the main routine, as the procedure the runtime starts the program with
+static int asmMain(token tokens[], int currPos, int size)
+{
+   if (tokens[currPos].ttype != TokenType::Main) {
+      printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Main));
+      return -1;
+   }
+
+   int bodyEnd = findBlockEnd(tokens, currPos + 1, size);
+   if (bodyEnd == -1) {
+      printError(tokens[currPos + 1], currPos + 1, tokenTypeToString(TokenType::Begin));
+      return -1;
+   }
+
+   markProcedure(tokens[currPos], "main");
+   startProcedure(tokens, size, "vurb_main", nullptr, currPos + 1, bodyEnd);
+   currPos = asmBody(tokens, currPos + 1, size);
+   if (currPos == -1) return -1;
+   finishProcedure("vurb_main");
+   return currPos;
+}
+
+
+// --- statements --------------------------------------------------------------
+
+// translate a body of code, releasing the variables declared in it at its end
+static int asmBody(token tokens[], int currPos, int size)
+{
+   if (currPos >= size || tokens[currPos].ttype != TokenType::Begin) {
+      printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Begin));
+      return -1;
+   }
+
+   enterScope();
+   asmScopes.push_back(vector<asmVariable>());
+
+   currPos++;
+   while (currPos < size && tokens[currPos].ttype != TokenType::End) {
+      markSourceLine(tokens[currPos]);
+      currPos = asmStatement(tokens, currPos, size);
+      if (currPos == -1) return -1;
+      currPos++;
+   }
+
+   if (currPos >= size) return -1;
+
+   markSourceLine(tokens[currPos]);
+   releaseScopes(asmScopes.size() - 1);
+   asmScopes.pop_back();
+   exitScope();
+   return currPos;
+}
+
+
+// translate a local variable definition: scalars start at zero and text empty,
+//    and arrays too large for the frame, or sized by an expression, get
+//    storage of their own
+static int asmLocal(token tokens[], int currPos, int size)
+{
+   int declPos = currPos + 1;
+   string name = "";
+   typeInfo type;
+   int declEnd = readDeclaration(tokens, declPos, size, name, type);
+   if (declEnd == -1 || (!isVariableType(type.ttype) && type.ttype != TokenType::StructType)) {
+      printError(tokens[declPos], declPos, "Variable declaration");
+      return -1;
+   }
+
+   asmVariable variable = {name, type, InFrame, "", 0, -1, 0, false};
+   auto chosen = chosenRegisters.find(currPos);
+
+   if (type.isArray) {
+      // the size is worked out before the array is in scope
+      if (isRuntimeSizedArray(tokens, declPos, size)) {
+         if (asmConverted(tokens, declPos + 3, size, TokenType::IntType) == -1) return -1;
+         emit("xor %ecx, %ecx");
+         emit("test %rax, %rax");
+         emit("cmovl %rcx, %rax");
+         variable.countOffset = frameSlot(8);
+         emit("mov %rax, " + frameOperand(variable.countOffset));
+         emit("lea 0(,%rax,8), %rdi");
+      } else {
+         variable.count = integerLiteral(type.arraySize);
+         if (variable.count * 8 <= FrameArrayBytes) {
+            variable.offset = frameSlot(variable.count * 8);
+            if (type.ttype == TokenType::TextType) clearFrame(variable.offset, variable.count * 8);
+            declareAsmVariable(variable);
+            return declEnd;
+         }
+         loadInteger(variable.count * 8, "%rdi");
+      }
+      callRuntime("vurb_arrayTake");
+      variable.storage = ThroughPointer;
+      variable.ownsStorage = true;
+      variable.offset = frameSlot(8);
+      emit("mov %rax, " + frameOperand(variable.offset));
+   } else if (type.ttype == TokenType::StructType) {
+      variable.offset = frameSlot(typeBytes(type));
+      clearFrame(variable.offset, typeBytes(type));
+   } else if (chosen != chosenRegisters.end()) {
+      variable.storage = InRegister;
+      variable.location = chosen->second;
+      emit("xor " + variable.location + ", " + variable.location);
+   } else {
+      variable.offset = frameSlot(8);
+      emit("movq $0, " + frameOperand(variable.offset));
+   }
+
+   declareAsmVariable(variable);
+   return declEnd;
+}
+
+
+// store the value just worked out at the operand, releasing the text it replaces
+static void storeValue(const asmOperand &operand, TokenType type)
+{
+   if (type == TokenType::TextType) {
+      emit("mov " + render(operand) + ", %rdi");
+      emit("mov %rax, " + render(operand));
+      callRuntime("vurb_textRelease");
+   } else if (type == TokenType::RealType) {
+      emit("movsd %xmm0, " + render(operand));
+   } else {
+      emit("mov %rax, " + render(operand));
+   }
+}
+
+
+// copy the struct whose address is in %rsi to the one whose address is in %rdi
+static void copyStruct(const string &structName)
+{
+   const asmStruct &layout = structLayouts[structName];
+   if (layout.texts.empty()) {
+      emit("mov $" + to_string(layout.bytes / 8) + ", %ecx");
+      emit("rep movsq");
+      return;
+   }
+   emit("mov $" + to_string(layout.bytes / 8) + ", %edx");
+   emit("lea vurb_texts_" + structName + "(%rip), %rcx");
+   callRuntime("vurb_structCopy");
+}
+
+
+// work out the value at valuePos for a store of the given type: the address
+//    of the struct to copy in %rsi, or the value converted to the type
+// returns the position of the last token of the value, or -1 if malformed
+static int asmStoredValue(token tokens[], int valuePos, int size, const typeInfo &type)
+{
+   if (type.isArray) {
+      printError(tokens[valuePos], valuePos, "Single value");
+      return -1;
+   }
+   if (type.ttype != TokenType::StructType) return asmConverted(tokens, valuePos, size, type.ttype);
+
+   asmOperand source;
+   typeInfo sourceType;
+   int valueEnd = accessOperand(tokens, valuePos, size, source, sourceType);
+   if (valueEnd == -1) return -1;
+   if (sourceType.isArray || sourceType.structName != type.structName) {
+      printError(tokens[valuePos], valuePos, "Struct of type " + type.structName);
+      return -1;
+   }
+   emit("lea " + render(source) + ", %rsi");
+   return valueEnd;
+}
+
+
+// returns true if the value at valuePos is a literal that can be stored
+//    as it stands in a variable of the type, storing it as an operand
+static bool constantValue(token tokens[], int valuePos, int size, const typeInfo &type, string &constant)
+{
+   if (type.isArray || valuePos >= size) return false;
+   TokenType literal = tokens[valuePos].ttype;
+   bool fits = (type.ttype == TokenType::BoolType && literal == TokenType::BoolLit)
+      || (type.ttype == TokenType::IntType && (literal == TokenType::IntLit || literal == TokenType::BoolLit));
+   return fits && simpleOperand(tokens, valuePos, size, false, constant);
+}
+
+
+// store the value worked out by asmStoredValue, or the constant if there
+//    is one, at the operand
+static void storeAt(const asmOperand &operand, const typeInfo &type, const string &constant)
+{
+   if (constant != "") {
+      emit((operand.reg != "" ? "mov " : "movq ") + constant + ", " + render(operand));
+   } else if (type.ttype == TokenType::StructType) {
+      emit("lea " + render(operand) + ", %rdi");
+      copyStruct(type.structName);
+   } else {
+      storeValue(operand, type.ttype);
+   }
+}
+
+
+// translate a set statement giving an integer variable kept in a register or
+//    the frame its own value plus or minus a simple operand, as one instruction
+// returns the position of the last token of the value, or 0 if the statement
+//    is not of this form
+static int asmAccumulate(token tokens[], int targetPos, int valuePos, int size)
+{
+   if (valuePos + 4 >= size || tokens[valuePos].ttype != TokenType::Left) return 0;
+   TokenType op = tokens[valuePos + 1].ttype;
+   if (op != TokenType::Add && op != TokenType::Sub) return 0;
+
+   const asmVariable *variable = nullptr;
+   if (tokens[targetPos].ttype == TokenType::Identifier) variable = findVariable(tokens[targetPos].content);
+   if (!variable || variable->type.isArray || variable->type.ttype != TokenType::IntType
+      || variable->storage == ThroughPointer) return 0;
+
+   // the variable may be either side of an addition, and the left of a subtraction
+   int leftPos = valuePos + 2;
+   int rightPos = skipExpression(tokens, leftPos, size) + 1;
+   int valueEnd = skipExpression(tokens, valuePos, size);
+   if (rightPos == 0 || valueEnd == -1) return 0;
+   int otherPos = -1;
+   if (tokens[leftPos].ttype == TokenType::Identifier && tokens[leftPos].content == variable->name) {
+      otherPos = rightPos;
+   } else if (op == TokenType::Add && rightPos + 1 == valueEnd
+      && tokens[rightPos].ttype == TokenType::Identifier && tokens[rightPos].content == variable->name) {
+      otherPos = leftPos;
+   } else {
+      return 0;
+   }
+
+   // anything else is worked out first, unless it could call a procedure
+   //    that changes the variable
+   string operand = "";
+   string place = render(variableOperand(*variable));
+   bool isSimple = simpleOperand(tokens, otherPos, size, false, operand);
+   if (isSimple && place[0] != '%' && operand[0] != '%' && operand[0] != '$') return 0;
+   if (!isSimple) {
+      if (variable->storage == InData || valueType(tokens, otherPos, size) != TokenType::IntType) return 0;
+      if (asmConverted(tokens, otherPos, size, TokenType::IntType) == -1) return -1;
+      operand = "%rax";
+   }
+
+   emit((op == TokenType::Add ? "addq " : "subq ") + operand + ", " + place);
+   return valueEnd;
+}
+
+
+// translate a set statement, appending text in place where it can be
+static int asmSet(token tokens[], int currPos, int size)
+{
+   int targetPos = currPos + 1;
+   typeInfo type;
+   if (!accessType(tokens, targetPos, size, type)) {
+      printError(tokens[targetPos], targetPos, "Identifier or struct field");
+      return -1;
+   }
+
+   int valuePos = skipExpression(tokens, targetPos, size) + 1;
+   if (valuePos == 0 || valuePos >= size) return -1;
+
+   vector<int> appended;
+   if (findAppendedValues(tokens, currPos, size, appended)) {
+      for (int piece : appended) {
+         bool owned = false;
+         if (asmValue(tokens, piece, size, owned) == -1) return -1;
+         emit("mov %rax, %rsi");
+         asmOperand target;
+         accessOperand(tokens, targetPos, size, target, type);
+         emit("lea " + render(target) + ", %rdi");
+         emit(owned ? "mov $1, %edx" : "xor %edx, %edx");
+         callRuntime("vurb_textAppend");
+      }
+      return skipExpression(tokens, valuePos, size);
+   }
+
+   // an integer added to or taken from itself changes where it is kept
+   int valueEnd = asmAccumulate(tokens, targetPos, valuePos, size);
+   if (valueEnd != 0) return valueEnd;
+
+   string constant = "";
+   bool isConstant = constantValue(tokens, valuePos, size, type, constant);
+   valueEnd = isConstant ? valuePos : asmStoredValue(tokens, valuePos, size, type);
+   if (valueEnd == -1) return -1;
+
+   asmOperand target;
+   if (accessOperand(tokens, targetPos, size, target, type) == -1) return -1;
+   storeAt(target, type, constant);
+   return valueEnd;
+}
+
+
+// translate an array set statement
+static int asmArraySet(token tokens[], int currPos, int size)
+{
+   int arrayPos = currPos + 1;
+   int indexPos = skipExpression(tokens, arrayPos, size) + 1;
+   if (indexPos == 0 || indexPos + 1 >= size) return -1;
+
+   typeInfo type;
+   if (!accessType(tokens, arrayPos, size, type) || !type.isArray) {
+      printError(tokens[arrayPos], arrayPos, "Array");
+      return -1;
+   }
+   type.isArray = false;
+
+   string constant = "";
+   bool isConstant = constantValue(tokens, indexPos + 1, size, type, constant);
+   int valueEnd = isConstant ? indexPos + 1 : asmStoredValue(tokens, indexPos + 1, size, type);
+   if (valueEnd == -1) return -1;
+
+   asmOperand target;
+   typeInfo arrayType;
+   if (accessOperand(tokens, arrayPos, size, target, arrayType) == -1) return -1;
+   if (!indexOperand(tokens, indexPos, target)) return -1;
+   storeAt(target, type, constant);
+   return valueEnd;
+}
+
+
+// translate a struct set statement
+static int asmStructSet(token tokens[], int currPos, int size)
+{
+   int structPos = currPos + 1;
+   if (structPos + 2 >= size || tokens[structPos].ttype != TokenType::Identifier) {
+      printError(tokens[structPos], structPos, "Struct identifier");
+      return -1;
+   }
+
+   typeInfo structType;
+   const asmElement *element = nullptr;
+   if (accessType(tokens, structPos, size, structType) && !structType.isArray) {
+      element = findElement(structType.structName, tokens[structPos + 1].content);
+   }
+   if (!element) {
+      printError(tokens[structPos + 1], structPos + 1, "Struct element identifier");
+      return -1;
+   }
+   typeInfo type = element->type;
+   long offset = element->offset;
+
+   string constant = "";
+   bool isConstant = constantValue(tokens, structPos + 2, size, type, constant);
+   int valueEnd = isConstant ? structPos + 2 : asmStoredValue(tokens, structPos + 2, size, type);
+   if (valueEnd == -1) return -1;
+
+   asmOperand target;
+   if (accessOperand(tokens, structPos, size, target, structType) == -1) return -1;
+   target.displacement += offset;
+   storeAt(target, type, constant);
+   return valueEnd;
+}
+
+
+// returns the characters a single token write puts out, if it is a literal
+static bool literalOutput(const token &tok, string &characters)
+{
+   if (tok.ttype == TokenType::TextLit) {
+      characters = literalCharacters(tok.content);
+   } else if (tok.ttype == TokenType::IntLit) {
+      characters = to_string(integerLiteral(tok.content));
+   } else if (tok.ttype == TokenType::BoolLit) {
+      characters = (tok.content == "true") ? "1" : "0";
+   } else {
+      return false;
+   }
+   return true;
+}
+
+
+// translate an output statement, joining a run of literal writes into one
+static int asmWrite(token tokens[], int currPos, int size)
+{
+   int valuePos = currPos + 1;
+   if (valuePos >= size) return -1;
+
+   string characters = "";
+   if (literalOutput(tokens[valuePos], characters)) {
+      string more = "";
+      while (valuePos + 2 < size && tokens[valuePos + 1].ttype == TokenType::Write
+         && literalOutput(tokens[valuePos + 2], more)) {
+         characters += "\n" + more;
+         valuePos += 2;
+      }
+      emit("lea " + textConstant(characters) + "(%rip), %rdi");
+      emit("xor %esi, %esi");
+      callRuntime("vurb_writeText");
+      return valuePos;
+   }
+
+   TokenType type = valueType(tokens, valuePos, size);
+   bool owned = false;
+   int valueEnd = asmValue(tokens, valuePos, size, owned);
+   if (valueEnd == -1) return -1;
+
+   if (type == TokenType::TextType) {
+      emit("mov %rax, %rdi");
+      emit(owned ? "mov $1, %esi" : "xor %esi, %esi");
+      callRuntime("vurb_writeText");
+   } else if (type == TokenType::RealType) {
+      callRuntime("vurb_writeReal");
+   } else if (type == TokenType::BoolType) {
+      emit("mov %rax, %rdi");
+      callRuntime("vurb_writeBool");
+   } else if (type == TokenType::IntType) {
+      emit("mov %rax, %rdi");
+      callRuntime("vurb_writeInteger");
+   } else {
+      printError(tokens[valuePos], valuePos, "Value to write");
+      return -1;
+   }
+   return valueEnd;
+}
+
+
+// translate an input statement, reading scalars kept in registers through the frame
+static int asmRead(token tokens[], int currPos, int size)
+{
+   int namePos = currPos + 1;
+   const asmVariable *variable = nullptr;
+   if (namePos < size && tokens[namePos].ttype == TokenType::Identifier) variable = findVariable(tokens[namePos].content);
+   if (!variable || variable->type.isArray || !isVariableType(variable->type.ttype)) {
+      printError(tokens[namePos], namePos, "Variable name");
+      return -1;
+   }
+
+   string function = "vurb_readInteger";
+   if (variable->type.ttype == TokenType::RealType) function = "vurb_readReal";
+   if (variable->type.ttype == TokenType::TextType) function = "vurb_readText";
+   if (variable->type.ttype == TokenType::BoolType) function = "vurb_readBool";
+
+   if (variable->storage == InRegister) {
+      string reg = variable->location;
+      if (scratchSlot == 0) scratchSlot = frameSlot(8);
+      emit("mov " + reg + ", " + frameOperand(scratchSlot));
+      emit("lea " + frameOperand(scratchSlot) + ", %rdi");
+      callRuntime(function);
+      emit("mov " + frameOperand(scratchSlot) + ", " + reg);
+      return namePos;
+   }
+
+   emit("lea " + render(variableOperand(*variable)) + ", %rdi");
+   callRuntime(function);
+   return namePos;
+}
+
+
+// translate an increment or decrement, leaving the value it gives in %rax,
+//    or %xmm0 for a real, if wanted
+static int asmIncrement(token tokens[], int currPos, int size, bool wantValue)
+{
+   int namePos = currPos + 2;
+   if (namePos + 1 >= size || tokens[namePos + 1].ttype != TokenType::Right) return -1;
+
+   TokenType op = tokens[currPos + 1].ttype;
+   const asmVariable *variable = nullptr;
+   if (tokens[namePos].ttype == TokenType::Identifier) variable = findVariable(tokens[namePos].content);
+   if (!variable || variable->type.isArray || variable->storage == ThroughPointer) {
+      printError(tokens[namePos], namePos, tokenTypeToString(TokenType::Identifier));
+      return -1;
+   }
+
+   bool isUp = (op == TokenType::AddAdd || op == TokenType::AddAddPre);
+   bool isPre = isPreIncrementOperator(op);
+   string operand = render(variableOperand(*variable));
+
+   if (variable->type.ttype == TokenType::RealType) {
+      emit("movsd " + operand + ", %xmm0");
+      emit("movapd %xmm0, %xmm1");
+      emit(string(isUp ? "addsd " : "subsd ") + realConstant(1.0) + "(%rip), %xmm1");
+      emit("movsd %xmm1, " + operand);
+      if (isPre) emit("movapd %xmm1, %xmm0");
+      return namePos + 1;
+   }
+
+   string step = string(isUp ? "inc" : "dec") + (variable->storage == InRegister ? " " : "q ");
+   if (wantValue && !isPre) emit("mov " + operand + ", %rax");
+   emit(step + operand);
+   if (wantValue && isPre) emit("mov " + operand + ", %rax");
+   return namePos + 1;
+}
+
+
+// translate a self tail call as stores to the parameters and a jump back
+//    to the start of the procedure
+static int asmTailJump(token tokens[], int currPos, int size)
+{
+   const procedureInfo *proc = enclosingProcedure(currPos);
+   if (!proc) return -1;
+
+   // every argument is worked out before any parameter changes
+   vector<size_t> changed;
+   int argPos = currPos + 3;
+   for (size_t i = 0; i < proc->params.size(); i++) {
+      const paramInfo &param = proc->params[i];
+      int argEnd = skipExpression(tokens, argPos, size);
+      if (argEnd == -1) return -1;
+
+      if (argEnd != argPos || tokens[argPos].content != param.name) {
+         changed.push_back(i);
+         if (param.isArray) {
+            asmOperand elements;
+            typeInfo type;
+            string count = "";
+            if (accessOperand(tokens, argPos, size, elements, type) == -1) return -1;
+            emit("lea " + render(elements) + ", %rax");
+            pushValue(TokenType::IntType);
+            if (!countOperand(tokens, argPos, size, count)) return -1;
+            emit("mov " + count + ", %rax");
+            pushValue(TokenType::IntType);
+         } else {
+            if (asmConverted(tokens, argPos, size, param.ptype) == -1) return -1;
+            pushValue(param.ptype);
+         }
+      }
+      argPos = argEnd + 1;
+   }
+
+   // the locals go out of scope, but the parameters stay
+   releaseScopes(2);
+
+   for (size_t i = changed.size(); i-- > 0; ) {
+      const asmVariable &param = asmScopes[1][changed[i]];
+      if (param.type.isArray) {
+         popValue(TokenType::IntType, "%rax");
+         emit("mov %rax, " + frameOperand(param.countOffset));
+         popValue(TokenType::IntType, "%rax");
+         emit("mov %rax, " + frameOperand(param.offset));
+      } else if (param.storage == InRegister) {
+         popValue(TokenType::IntType, param.location);
+      } else {
+         popValue(TokenType::IntType, "%rax");
+         storeValue(variableOperand(param), param.type.ttype == TokenType::TextType ? TokenType::TextType : TokenType::IntType);
+      }
+   }
+
+   emit("jmp " + tailLabel);
+   return argPos;
+}
+
+
+// translate a return statement, releasing every variable in scope on the way out
+static int asmReturn(token tokens[], int currPos, int size)
+{
+   if (tailLabel != "" && isSelfTailCall(tokens, currPos, size)) {
+      return asmTailJump(tokens, currPos + 1, size);
+   }
+
+   int valueEnd = asmConverted(tokens, currPos + 1, size, returnType);
+   if (valueEnd == -1) return -1;
+
+   if (scopesNeedRelease(1)) {
+      if (returnSlot == 0) returnSlot = frameSlot(8);
+      bool isReal = (returnType == TokenType::RealType);
+      emit((isReal ? "movsd %xmm0, " : "mov %rax, ") + frameOperand(returnSlot));
+      releaseScopes(1);
+      emit((isReal ? "movsd " : "mov ") + frameOperand(returnSlot) + (isReal ? ", %xmm0" : ", %rax"));
+   }
+   emit("jmp " + returnLabel);
+   return valueEnd;
+}
+
+
+// translate an if loop: its body repeats while the condition holds, tested
+//    at the bottom, and the else body runs once after it
+static int asmIfLoop(token tokens[], int currPos, int size)
+{
+   int conditionPos = currPos + 1;
+   int conditionEnd = skipExpression(tokens, conditionPos, size);
+   if (conditionEnd == -1 || conditionEnd + 1 >= size) return -1;
+
+   string top = newLabel();
+   string test = newLabel();
+
+   emit("jmp " + test);
+   emit(".p2align 4,,10");
+   emitLabel(top);
+   currPos = asmBody(tokens, conditionEnd + 1, size);
+   if (currPos == -1) return -1;
+
+   emitLabel(test);
+   if (asmBranch(tokens, conditionPos, size, top, true) == -1) return -1;
+
+   if (currPos + 1 < size && tokens[currPos + 1].ttype == TokenType::Else) {
+      currPos = asmBody(tokens, currPos + 2, size);
+   }
+   return currPos;
+}
+
+
+// translate a statement of a body
+static int asmStatement(token tokens[], int currPos, int size)
+{
+   switch (tokens[currPos].ttype) {
+      case Call: {
+         TokenType type = valueType(tokens, currPos, size);
+         currPos = asmCall(tokens, currPos, size);
+         if (currPos != -1 && type == TokenType::TextType) {
+            emit("mov %rax, %rdi");
+            callRuntime("vurb_textRelease");
+         }
+         return currPos;
+      }
+      case Set:
+         return asmSet(tokens, currPos, size);
+      case Write:
+         return asmWrite(tokens, currPos, size);
+      case Read:
+         return asmRead(tokens, currPos, size);
+      case VarDef:
+         return asmLocal(tokens, currPos, size);
+      case If:
+         return asmIfLoop(tokens, currPos, size);
+      case Left:
+         if (currPos + 1 < size && isIncrementOperator(tokens[currPos + 1].ttype)) {
+            return asmIncrement(tokens, currPos, size, false);
+         }
+         break;
+      case Return:
+         return asmReturn(tokens, currPos, size);
+      case ArraySet:
+         return asmArraySet(tokens, currPos, size);
+      case StructElemSet:
+      case StructIndirElemSet:
+         return asmStructSet(tokens, currPos, size);
+      default:
+         break;
+   }
+
+   printError(tokens[currPos], currPos, "valid expression");
+   return -1;
+}
+
+
+// --- expressions -------------------------------------------------------------
+
+// convert the value just worked out from one type to another, as C++ would
+static void convertValue(TokenType from, TokenType to)
+{
+   bool isInteger = (from == TokenType::IntType || from == TokenType::BoolType);
+
+   if (to == TokenType::RealType && isInteger) {
+      emit("cvtsi2sdq %rax, %xmm0");
+   } else if (to == TokenType::IntType && from == TokenType::RealType) {
+      emit("cvttsd2si %xmm0, %rax");
+   } else if (to == TokenType::BoolType && from == TokenType::RealType) {
+      emit("xorpd %xmm1, %xmm1");
+      emit("ucomisd %xmm1, %xmm0");
+      emit("setne %al");
+      emit("setp %cl");
+      emit("or %cl, %al");
+      emit("movzbl %al, %eax");
+   } else if (to == TokenType::BoolType && from == TokenType::IntType) {
+      emit("test %rax, %rax");
+      emit("setne %al");
+      emit("movzbl %al, %eax");
+   }
+}
+
+
+// leave the value of the expression at currPos, converted to the type, in
+//    %rax, or %xmm0 for a real, with text holding a reference of its own
+// returns the position of the last token of the expression, or -1 if malformed
+static int asmConverted(token tokens[], int currPos, int size, TokenType type)
+{
+   TokenType from = valueType(tokens, currPos, size);
+   bool owned = false;
+   int end = asmValue(tokens, currPos, size, owned);
+   if (end == -1) return -1;
+
+   if (type == TokenType::TextType && !owned) retainText();
+   convertValue(from, type);
+   return end;
+}
+
+
+// jump to the label if the real comparison just made gives when, where
+//    %xmm0 was compared with the right side, or that with %xmm0 for lt and le
+static void realJump(TokenType op, const string &label, bool when)
+{
+   if (op == TokenType::EQOp || op == TokenType::NEOp) {
+      // an unordered comparison only makes ne true
+      if (when == (op == TokenType::EQOp)) {
+         string skip = newLabel();
+         emit("jp " + skip);
+         emit("je " + label);
+         emitLabel(skip);
+      } else {
+         emit("jp " + label);
+         emit("jne " + label);
+      }
+      return;
+   }
+
+   bool isStrict = (op == TokenType::LTOp || op == TokenType::GTOp);
+   if (isStrict) {
+      emit((when ? "ja " : "jbe ") + label);
+   } else {
+      emit((when ? "jae " : "jb ") + label);
+   }
+}
+
+
+// jump to the label if the integer comparison just made gives when
+static void integerJump(TokenType op, const string &label, bool when)
+{
+   string condition = "";
+   switch (op) {
+      case LTOp: condition = when ? "l" : "ge"; break;
+      case LEOp: condition = when ? "le" : "g"; break;
+      case GTOp: condition = when ? "g" : "le"; break;
+      case GEOp: condition = when ? "ge" : "l"; break;
+      case EQOp: condition = when ? "e" : "ne"; break;
+      default: condition = when ? "ne" : "e"; break;
+   }
+   emit("j" + condition + " " + label);
+}
+
+
+// translate the comparison at currPos as a jump to the label if it gives when
+// returns the position of the last token of its right side, or -1 if malformed
+static int asmComparison(token tokens[], int currPos, int size, const string &label, bool when)
+{
+   TokenType op = tokens[currPos + 1].ttype;
+   int leftPos = currPos + 2;
+   int rightPos = skipExpression(tokens, leftPos, size) + 1;
+   if (rightPos == 0 || rightPos >= size) return -1;
+   int rightEnd = skipExpression(tokens, rightPos, size);
+   if (rightEnd == -1) return -1;
+
+   TokenType left = valueType(tokens, leftPos, size);
+   TokenType right = valueType(tokens, rightPos, size);
+   string operand = "";
+
+   // text is compared by the runtime, which gives its order as a sign
+   if (left == TokenType::TextType && right == TokenType::TextType) {
+      bool leftOwned = false;
+      bool rightOwned = false;
+      if (asmValue(tokens, leftPos, size, leftOwned) == -1) return -1;
+      pushValue(TokenType::TextType);
+      if (asmValue(tokens, rightPos, size, rightOwned) == -1) return -1;
+      emit("mov %rax, %rsi");
+      popValue(TokenType::TextType, "%rdi");
+      emit("mov $" + to_string((leftOwned ? 1 : 0) | (rightOwned ? 2 : 0)) + ", %edx");
+      callRuntime("vurb_textCompare");
+      emit("test %rax, %rax");
+      integerJump(op, label, when);
+      return rightEnd;
+   }
+
+   if (left == TokenType::RealType || right == TokenType::RealType) {
+      if (asmOperands(tokens, leftPos, size, TokenType::RealType, operand) == -1) return -1;
+      if (op == TokenType::LTOp || op == TokenType::LEOp) {
+         if (operand != "%xmm1") emit("movsd " + operand + ", %xmm1");
+         emit("ucomisd %xmm0, %xmm1");
+      } else {
+         emit("ucomisd " + operand + ", %xmm0");
+      }
+      realJump(op, label, when);
+      return rightEnd;
+   }
+
+   // integers held in registers or memory are compared where they are
+   string leftOperand = "";
+   if (simpleOperand(tokens, leftPos, size, false, leftOperand) && leftOperand[0] != '$'
+      && simpleOperand(tokens, rightPos, size, false, operand)
+      && (leftOperand[0] == '%' || operand[0] == '$' || operand[0] == '%')) {
+      emit("cmpq " + operand + ", " + leftOperand);
+      integerJump(op, label, when);
+      return rightEnd;
+   }
+
+   operand = "";
+   if (asmOperands(tokens, leftPos, size, TokenType::IntType, operand) == -1) return -1;
+   emit("cmp " + operand + ", %rax");
+   integerJump(op, label, when);
+   return rightEnd;
+}
+
+
+// translate the conditional expression at currPos as a jump to the label
+//    if it gives when, falling through otherwise; and and or only work out
+//    their right side if the left does not decide
+// returns the position of its right bracket, or -1 if malformed
+static int asmBranch(token tokens[], int currPos, int size, const string &label, bool when)
+{
+   if (currPos + 2 >= size || tokens[currPos].ttype != TokenType::Left) {
+      printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Left));
+      return -1;
+   }
+
+   const token &inner = tokens[currPos + 1];
+   int end = currPos + 1;
+
+   if (inner.ttype == TokenType::BoolLit) {
+      if ((inner.content == "true") == when) emit("jmp " + label);
+   } else if (inner.ttype == TokenType::Identifier) {
+      const asmVariable *variable = findVariable(inner.content);
+      if (!variable || variable->type.isArray) {
+         printError(inner, currPos + 1, "Boolean variable");
+         return -1;
+      }
+      string operand = render(variableOperand(*variable));
+      if (variable->type.ttype == TokenType::RealType) {
+         emit("xorpd %xmm0, %xmm0");
+         emit("ucomisd " + operand + ", %xmm0");
+         realJump(TokenType::NEOp, label, when);
+      } else {
+         emit(variable->storage == InRegister ? "test " + operand + ", " + operand : "cmpq $0, " + operand);
+         emit((when ? "jne " : "je ") + label);
+      }
+   } else if (inner.ttype == TokenType::NotOp) {
+      end = asmBranch(tokens, currPos + 2, size, label, !when);
+   } else if (inner.ttype == TokenType::AndOp || inner.ttype == TokenType::OrOp) {
+      // the left side decides an and when false, and an or when true
+      bool decides = (inner.ttype == TokenType::OrOp);
+      int leftEnd;
+      if (when == decides) {
+         leftEnd = asmBranch(tokens, currPos + 2, size, label, when);
+         end = (leftEnd == -1) ? -1 : asmBranch(tokens, leftEnd + 1, size, label, when);
+      } else {
+         string skip = newLabel();
+         leftEnd = asmBranch(tokens, currPos + 2, size, skip, decides);
+         end = (leftEnd == -1) ? -1 : asmBranch(tokens, leftEnd + 1, size, label, when);
+         emitLabel(skip);
+      }
+   } else if (isCondOperator(inner.ttype)) {
+      end = asmComparison(tokens, currPos, size, label, when);
+   } else {
+      printError(inner, currPos + 1, "Conditional operator");
+      return -1;
+   }
+
+   if (end == -1) return -1;
+   if (end + 1 >= size || tokens[end + 1].ttype != TokenType::Right) {
+      printError(tokens[end + 1], end + 1, tokenTypeToString(TokenType::Right));
+      return -1;
+   }
+   return end + 1;
+}
+
+
+// translate a procedure call, pushing its arguments in order: arrays as a
+//    pointer and their number of elements, structs as a pointer, and text with
+//    a reference the procedure releases; its result is left in %rax or %xmm0
+static int asmCall(token tokens[], int currPos, int size)
+{
+   if (currPos + 2 >= size || tokens[currPos + 2].ttype != TokenType::Left) return -1;
+
+   const procedureInfo *proc = findProcedure(tokens[currPos + 1].content);
+   if (!proc) {
+      printError(tokens[currPos + 1], currPos + 1, "Procedure name");
+      return -1;
+   }
+
+   long slots = 0;
+   for (const paramInfo &param : proc->params) slots += param.isArray ? 2 : 1;
+
+   // the stack is aligned for the call once the arguments are pushed
+   long padding = (stackDepth + 8 * slots) % 16;
+   if (padding != 0) {
+      emit("sub $8, %rsp");
+      stackDepth += 8;
+   }
+
+   int argPos = currPos + 3;
+   for (const paramInfo &param : proc->params) {
+      if (argPos >= size || tokens[argPos].ttype == TokenType::Right) {
+         printError(tokens[argPos], argPos, "Argument for " + param.name);
+         return -1;
+      }
+
+      int argEnd;
+      if (param.isArray || !param.structType.empty()) {
+         asmOperand operand;
+         typeInfo type;
+         argEnd = accessOperand(tokens, argPos, size, operand, type);
+         if (argEnd == -1) return -1;
+         if (type.isArray != param.isArray) {
+            printError(tokens[argPos], argPos, param.isArray ? "Array" : "Struct");
+            return -1;
+         }
+         emit("lea " + render(operand) + ", %rax");
+         pushValue(TokenType::IntType);
+
+         if (param.isArray) {
+            string count = "";
+            if (!countOperand(tokens, argPos, size, count)) return -1;
+            emit("mov " + count + ", %rax");
+            pushValue(TokenType::IntType);
+         }
+      } else {
+         argEnd = asmConverted(tokens, argPos, size, param.ptype);
+         if (argEnd == -1) return -1;
+         pushValue(param.ptype);
+      }
+      argPos = argEnd + 1;
+   }
+
+   if (argPos >= size || tokens[argPos].ttype != TokenType::Right) {
+      printError(tokens[argPos], argPos, tokenTypeToString(TokenType::Right));
+      return -1;
+   }
+
+   emit("call " + proc->name);
+
+   long pushed = 8 * slots + (padding != 0 ? 8 : 0);
+   if (pushed != 0) {
+      emit("add $" + to_string(pushed) + ", %rsp");
+      stackDepth -= pushed;
+   }
+   return argPos;
+}
+
+
+// translate arithmetic on the two sides of the operation at currPos
+static int asmArithmetic(token tokens[], int currPos, int size, bool &owned)
+{
+   TokenType op = tokens[currPos + 1].ttype;
+   TokenType result = valueType(tokens, currPos, size);
+   int leftPos = currPos + 2;
+   int rightPos = skipExpression(tokens, leftPos, size) + 1;
+   if (rightPos == 0 || rightPos >= size) return -1;
+   int rightEnd = skipExpression(tokens, rightPos, size);
+   if (rightEnd == -1) return -1;
+   string operand = "";
+
+   // text is joined by the runtime, in place if the left side is its own
+   if (result == TokenType::TextType) {
+      if (op != TokenType::Add) {
+         printError(tokens[currPos + 1], currPos + 1, "Text operator");
+         return -1;
+      }
+      bool leftOwned = false;
+      bool rightOwned = false;
+      if (asmValue(tokens, leftPos, size, leftOwned) == -1) return -1;
+      pushValue(TokenType::TextType);
+      if (asmValue(tokens, rightPos, size, rightOwned) == -1) return -1;
+      emit("mov %rax, %rsi");
+      popValue(TokenType::TextType, "%rdi");
+      emit("mov $" + to_string((leftOwned ? 1 : 0) | (rightOwned ? 2 : 0)) + ", %edx");
+      callRuntime("vurb_textConcat");
+      owned = true;
+      return rightEnd;
+   }
+
+   if (result == TokenType::RealType) {
+      const string instruction = (op == TokenType::Add) ? "addsd " : (op == TokenType::Sub) ? "subsd "
+         : (op == TokenType::Mul) ? "mulsd " : "divsd ";
+      if (asmOperands(tokens, leftPos, size, TokenType::RealType, operand) == -1) return -1;
+      emit(instruction + operand + ", %xmm0");
+      return rightEnd;
+   }
+
+   if (asmOperands(tokens, leftPos, size, TokenType::IntType, operand) == -1) return -1;
+
+   if (op == TokenType::Div || op == TokenType::Rem) {
+      // the divisor cannot be a constant
+      if (operand[0] == '$') {
+         emit("mov " + operand + ", %rcx");
+         operand = "%rcx";
+      }
+      emit("cqo");
+      emit("idivq " + operand);
+      if (op == TokenType::Rem) emit("mov %rdx, %rax");
+   } else {
+      const string instruction = (op == TokenType::Add) ? "add " : (op == TokenType::Sub) ? "sub " : "imul ";
+      emit(instruction + operand + ", %rax");
+   }
+   return rightEnd;
+}
+
+
+// translate a bracketed operation: an increment, a condition worked out as
+//    a boolean, a negation or arithmetic
+static int asmOperation(token tokens[], int currPos, int size, bool &owned)
+{
+   if (currPos + 2 >= size) return -1;
+   TokenType op = tokens[currPos + 1].ttype;
+
+   if (isIncrementOperator(op)) return asmIncrement(tokens, currPos, size, true);
+
+   if (isCondOperator(op)) {
+      string isFalse = newLabel();
+      string done = newLabel();
+      int end = asmBranch(tokens, currPos, size, isFalse, false);
+      if (end == -1) return -1;
+      emit("mov $1, %eax");
+      emit("jmp " + done);
+      emitLabel(isFalse);
+      emit("xor %eax, %eax");
+      emitLabel(done);
+      return end;
+   }
+
+   int end;
+   if (op == TokenType::Negate) {
+      if (valueType(tokens, currPos + 2, size) == TokenType::RealType) {
+         end = asmConverted(tokens, currPos + 2, size, TokenType::RealType);
+         emit("movsd " + realConstant(-0.0) + "(%rip), %xmm1");
+         emit("xorpd %xmm1, %xmm0");
+      } else {
+         end = asmConverted(tokens, currPos + 2, size, TokenType::IntType);
+         emit("neg %rax");
+      }
+   } else if (isBinaryOperator(op)) {
+      end = asmArithmetic(tokens, currPos, size, owned);
+   } else {
+      printError(tokens[currPos + 1], currPos + 1, "Expression operator");
+      return -1;
+   }
+
+   if (end == -1) return -1;
+   if (end + 1 >= size || tokens[end + 1].ttype != TokenType::Right) {
+      printError(tokens[end + 1], end + 1, tokenTypeToString(TokenType::Right));
+      return -1;
+   }
+   return end + 1;
+}
+
+
+// leave the value of the expression at currPos in %rax, or %xmm0 for a real,
+//    and the address of a struct or array; owned is set if text left in %rax
+//    holds a reference of its own, rather than one of a variable or literal
+// returns the position of the last token of the expression, or -1 if malformed
+static int asmValue(token tokens[], int currPos, int size, bool &owned)
+{
+   owned = false;
+   if (currPos >= size) return -1;
+   const token &tok = tokens[currPos];
+
+   switch (tok.ttype) {
+      case IntLit:
+         loadInteger(integerLiteral(tok.content), "%rax");
+         return currPos;
+      case BoolLit:
+         emit(tok.content == "true" ? "mov $1, %eax" : "xor %eax, %eax");
+         return currPos;
+      case RealLit:
+         emit("movsd " + realConstant(strtod(tok.content.c_str(), nullptr)) + "(%rip), %xmm0");
+         return currPos;
+      case TextLit:
+         emit("lea " + textConstant(literalCharacters(tok.content)) + "(%rip), %rax");
+         return currPos;
+      case ArraySize: {
+         string count = "";
+         if (!countOperand(tokens, currPos + 1, size, count)) return -1;
+         emit("mov " + count + ", %rax");
+         return skipExpression(tokens, currPos + 1, size);
+      }
+      case Identifier:
+      case ArrayAccess:
+      case StructElemAccess:
+      case StructIndirElemAccess: {
+         asmOperand operand;
+         typeInfo type;
+         int end = accessOperand(tokens, currPos, size, operand, type);
+         if (end == -1) return -1;
+         if (type.isArray || type.ttype == TokenType::StructType) {
+            emit("lea " + render(operand) + ", %rax");
+         } else if (type.ttype == TokenType::RealType) {
+            emit("movsd " + render(operand) + ", %xmm0");
+         } else {
+            emit("mov " + render(operand) + ", %rax");
+         }
+         return end;
+      }
+      case Call:
+         owned = (valueType(tokens, currPos, size) == TokenType::TextType);
+         return asmCall(tokens, currPos, size);
+      case Left:
+         return asmOperation(tokens, currPos, size, owned);
+      default:
+         break;
+   }
+
+   printError(tok, currPos, "Variable name, literal value, or expression");
+   return -1;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "tokenizing.h"
+
+
+// translate the token sequence to x86-64 assembly for the GNU assembler,
+//    to be linked by ld with the runtime in asmruntime.o,
+// writing the results to standard output,
+// with any error messages directed to standard error
+// returns false if the program is malformed
+bool assemble(token tokens[], int size);
+
+
+// returns the value of an integer literal, which C++ reads as octal
+//    when it starts with a zero
+long integerLiteral(const string &content);
+
+
+// returns the characters of a text literal, with the escapes
+//    C++ would read in it replaced
+string literalCharacters(const string &content);
+
+
+// returns the type of the value of the expression at currPos:
+//    IntType, RealType, TextType or BoolType, StructType for structs,
+//    VoidType for calls that return nothing, or Invalid if unknown
+TokenType valueType(token tokens[], int currPos, int size);
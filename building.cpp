@@ -0,0 +1,294 @@
+#include "building.h"
+#include "caching.h"
+#include "options.h"
+#include "parsing.h"
+#include "sourcemap.h"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using std::vector;
+
+extern char **environ;
+
+// the compiler flags of each build profile
+struct buildProfile {
+   string name;
+   vector<string> flags;
+};
+
+const vector<buildProfile> BuildProfiles = {
+   {"debug", {"-O0", "-g"}},
+   {"release", {"-O2", "-march=native"}},
+   {"lto", {"-O2", "-march=native", "-flto"}}
+};
+
+
+// passes everything written to standard output down a pipe to the compiler,
+//    in blocks, and to the kept copy of the C++ if one was asked for; once
+//    the compiler stops reading, the rest is dropped
+class pipeBuffer : public streambuf {
+public:
+   int pipe = -1;
+   ofstream *copy = nullptr;
+   bool isBroken = false;
+
+   pipeBuffer() {
+      setp(block, block + sizeof(block));
+   }
+
+protected:
+   int overflow(int c) override {
+      if (!writeBlock()) return EOF;
+      if (c != EOF) sputc(c);
+      return 0;
+   }
+
+   int sync() override {
+      return writeBlock() ? 0 : -1;
+   }
+
+private:
+   char block[64 * 1024];
+
+   bool writeBlock() {
+      const char *next = pbase();
+      long count = pptr() - pbase();
+      if (copy) copy->write(next, count);
+      while (count > 0 && !isBroken) {
+         long written = write(pipe, next, count);
+         if (written < 0 && errno == EINTR) continue;
+         if (written <= 0) isBroken = true;
+         next += written;
+         count -= written;
+      }
+      setp(block, block + sizeof(block));
+      return !isBroken;
+   }
+};
+
+
+// returns the milliseconds since the given time
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// returns the exit status of the process, waiting for it to end, with a
+//    process ended by a signal given 128 and the signal's number as a shell does
+static int waitFor(pid_t process)
+{
+   int status = 0;
+   while (waitpid(process, &status, 0) == -1) {
+      if (errno != EINTR) return -1;
+   }
+   return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+
+// returns the file the executable is written to: the one asked for, or as
+//    convertScript.sh names it, in executables/
+static string executableFile()
+{
+   if (options.outputFile != "") return options.outputFile;
+
+   string name = options.buildFile.substr(options.buildFile.find_last_of('/') + 1);
+   if (name.size() > 5 && name.compare(name.size() - 5, 5, ".vurb") == 0) name.resize(name.size() - 5);
+   mkdir("executables", 0755);
+   return "executables/" + name + "x";
+}
+
+
+// returns the arguments the compiler is run with, to read C++ from standard
+//    input and write the executable, with those the options call for
+static vector<string> compilerArguments(const string &executable)
+{
+   vector<string> arguments = {options.compiler};
+   for (const buildProfile &profile : BuildProfiles) {
+      if (profile.name == options.buildProfile) {
+         arguments.insert(arguments.end(), profile.flags.begin(), profile.flags.end());
+      }
+   }
+
+   // as convertScript.sh does: parallel loops need OpenMP, and the lean
+   //    runtime needs nothing from the C++ library
+   if (options.parallel) arguments.push_back("-fopenmp");
+   if (options.leanRuntime) {
+      arguments.push_back("-fno-exceptions");
+      arguments.push_back("-Wl,--as-needed");
+   }
+
+   vector<string> input = {"-x", "c++", "-", "-o", executable};
+   arguments.insert(arguments.end(), input.begin(), input.end());
+   return arguments;
+}
+
+
+// start the program, with the arguments given, sharing the translator's
+//    standard input, output and error, and the actions given for its files
+// returns the process, or -1 if it cannot be started
+static pid_t start(const vector<string> &arguments, const posix_spawn_file_actions_t *actions)
+{
+   vector<char *> argv;
+   for (const string &argument : arguments) argv.push_back(const_cast<char *>(argument.c_str()));
+   argv.push_back(nullptr);
+
+   pid_t process = -1;
+   if (posix_spawnp(&process, argv[0], actions, nullptr, argv.data(), environ) != 0) return -1;
+   return process;
+}
+
+
+// returns true if name is a build profile: debug, release or lto
+bool isBuildProfile(const string &name)
+{
+   for (const buildProfile &profile : BuildProfiles) {
+      if (profile.name == name) return true;
+   }
+   return false;
+}
+
+
+// translate the token sequence to C++ and compile it into the executable,
+//    with the compiler started first and the C++ streamed to it through a
+//    pipe as it is written, storing the milliseconds each stage takes
+// returns false, after printing an error, if it cannot be built
+static bool compileProgram(token tokens[], int size, const string &executable,
+   const vector<string> &arguments, double &translating, double &compiling)
+{
+   ofstream copy;
+   if (options.keepCpp != "") {
+      copy.open(options.keepCpp);
+      if (!copy) {
+         cerr << "Error: unable to write " << options.keepCpp << endl;
+         return false;
+      }
+   }
+
+   auto started = std::chrono::steady_clock::now();
+   int ends[2];
+   if (pipe2(ends, O_CLOEXEC) != 0) {
+      cerr << "Error: unable to make a pipe to the compiler" << endl;
+      return false;
+   }
+   posix_spawn_file_actions_t actions;
+   posix_spawn_file_actions_init(&actions);
+   posix_spawn_file_actions_adddup2(&actions, ends[0], 0);
+   pid_t compiler = start(arguments, &actions);
+   posix_spawn_file_actions_destroy(&actions);
+   close(ends[0]);
+   if (compiler == -1) {
+      close(ends[1]);
+      cerr << "Error: unable to run " << options.compiler << endl;
+      return false;
+   }
+
+   // a compiler that stops reading early reports why itself
+   void (*brokenPipe)(int) = signal(SIGPIPE, SIG_IGN);
+   pipeBuffer toCompiler;
+   toCompiler.pipe = ends[1];
+   toCompiler.copy = options.keepCpp != "" ? &copy : nullptr;
+   streambuf *output = cout.rdbuf(&toCompiler);
+
+   startSourceMap();
+   bool isTranslated = parse(tokens, size);
+   bool isMapped = finishSourceMap();
+   cout.flush();
+   cout.rdbuf(output);
+   translating = millisecondsSince(started);
+
+   // a program that cannot be translated is not compiled at all
+   if (!isTranslated || !isMapped) {
+      kill(compiler, SIGTERM);
+      close(ends[1]);
+      waitFor(compiler);
+      signal(SIGPIPE, brokenPipe);
+      if (!isMapped) cerr << "Error: unable to write source map " << options.sourceMap << endl;
+      return false;
+   }
+   close(ends[1]);
+   signal(SIGPIPE, brokenPipe);
+
+   auto translated = std::chrono::steady_clock::now();
+   int compiled = waitFor(compiler);
+   compiling = millisecondsSince(translated);
+
+   if (copy.is_open()) copy.close();
+   if (compiled != 0 || (options.keepCpp != "" && !copy)) {
+      if (compiled == 0) cerr << "Error: unable to write " << options.keepCpp << endl;
+      cerr << "Error: " << options.compiler << " could not build " << executable << endl;
+      return false;
+   }
+   return true;
+}
+
+
+// translate the token sequence to C++ and compile it with the build profile
+//    chosen, streaming the C++ to the compiler through a pipe as it is
+//    written, or copy the executable from the cache if it was built before;
+//    then run the executable if asked, reporting the time each stage takes
+//    to standard error
+// returns the program's exit status if it was run, otherwise 0, or -1 if it
+//    cannot be built
+int buildProgram(token tokens[], int size)
+{
+   auto started = std::chrono::steady_clock::now();
+   string executable = executableFile();
+   vector<string> arguments = compilerArguments(executable);
+
+   // the cache is passed by when the C++ itself, or its source map, is wanted
+   string key = "";
+   bool isCached = false;
+   if (!options.noCache && options.keepCpp == "" && options.sourceMap == "") {
+      key = cacheKey(vector<string>(arguments.begin(), arguments.end() - 2));
+      isCached = (key != "") && fetchCached(key, executable);
+   }
+   double looking = millisecondsSince(started);
+
+   double translating = 0;
+   double compiling = 0;
+   double storing = 0;
+   if (!isCached) {
+      if (!compileProgram(tokens, size, executable, arguments, translating, compiling)) return -1;
+      auto compiled = std::chrono::steady_clock::now();
+      if (key != "" && !storeCached(key, executable)) {
+         cerr << "Warning: unable to store " << executable << " in the cache" << endl;
+      }
+      storing = millisecondsSince(compiled);
+   }
+
+   int status = 0;
+   double running = 0;
+   if (options.thenRun) {
+      auto run = std::chrono::steady_clock::now();
+      pid_t program = start({executable.find('/') == string::npos ? "./" + executable : executable}, nullptr);
+      if (program == -1) {
+         cerr << "Error: unable to run " << executable << endl;
+         return -1;
+      }
+      status = waitFor(program);
+      running = millisecondsSince(run);
+   }
+
+   string flags = "";
+   for (size_t i = 1; i < arguments.size() && arguments[i] != "-x"; i++) flags += " " + arguments[i];
+   cerr << std::fixed << std::setprecision(1);
+   if (isCached) {
+      cerr << "cache     " << std::setw(10) << looking << " ms   hit " << key << endl;
+   } else {
+      cerr << "translate " << std::setw(10) << translating << " ms" << endl;
+      cerr << "compile   " << std::setw(10) << compiling << " ms   " << options.compiler << flags << endl;
+      if (key != "") cerr << "cache     " << std::setw(10) << looking + storing << " ms   miss, stored " << key << endl;
+   }
+   if (options.thenRun) cerr << "run       " << std::setw(10) << running << " ms   exit status " << status << endl;
+   cerr << "total     " << std::setw(10) << millisecondsSince(started) << " ms" << endl;
+   return status;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "tokenizing.h"
+
+
+// returns true if name is a build profile: debug, release or lto
+bool isBuildProfile(const string &name);
+
+
+// translate the token sequence to C++ and compile it with the build profile
+//    chosen, streaming the C++ to the compiler through a pipe as it is
+//    written, then run the executable if asked, reporting the time each
+//    stage takes to standard error
+// returns the program's exit status if it was run, otherwise 0, or -1 if it
+//    cannot be built
+int buildProgram(token tokens[], int size);
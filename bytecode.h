@@ -0,0 +1,123 @@
+#pragma once
+
+// the bytecode written by --bytecode and run by --exec, for the machine it
+//    was made on: a header, the text literals and struct tables the code
+//    refers to, and the code itself, laid out just as the interpreter uses
+//    them, so an image is mapped from its file and run with nothing to read
+//
+// the code is a run of 32 bit words, each instruction an opcode followed by
+//    a fixed number of operands: slots of the frame of the running procedure,
+//    counted in 8 byte words from its start, words of the program's global
+//    storage, immediate values, byte offsets of data in the image, and for
+//    jumps and calls the word of the code to go to
+//
+// a procedure's parameters take the first slots of its frame, followed by its
+//    locals and the temporaries of its expressions; a call makes the slots
+//    holding its arguments the start of the new frame, and the value
+//    returned is left in the first of them
+
+
+// the instructions, with the number of operands each takes and which of them
+//    is a jump target, or -1; the operands are named in the comments as
+//    d for the slot set, a, b and i for slots read, p for a slot holding a
+//    pointer to 8 byte words, g for a global word, k for an immediate value
+//    and t for a target
+#define VURB_OPCODES(op) \
+   /* d = a; d = k; d = the 64 bit k1 k2; d = the text at image offset k;  \
+      k slots from d set to zero */ \
+   op(Move, 2, -1) op(SetInteger, 2, -1) op(SetWide, 3, -1) op(SetText, 2, -1) \
+   op(Clear, 2, -1) \
+   /* d = g, g = a; d = g[i], g[i] = a; d = (b + i), (b + i) = a; \
+      d = p[k], p[k] = a; d = p[i + k], p[i + k] = a */ \
+   op(LoadGlobal, 2, -1) op(StoreGlobal, 2, -1) \
+   op(LoadGlobalIndexed, 3, -1) op(StoreGlobalIndexed, 3, -1) \
+   op(LoadFrameIndexed, 3, -1) op(StoreFrameIndexed, 3, -1) \
+   op(Load, 3, -1) op(Store, 3, -1) op(LoadIndexed, 4, -1) op(StoreIndexed, 4, -1) \
+   /* d = the address of slot a, of g, of p[k], of p[i] */ \
+   op(FrameAddress, 2, -1) op(GlobalAddress, 2, -1) op(PointerAddress, 3, -1) \
+   op(IndexAddress, 3, -1) \
+   /* integer arithmetic, d = a op b, d = a + k, d = -a, d++ and d-- */ \
+   op(Add, 3, -1) op(Subtract, 3, -1) op(Multiply, 3, -1) op(Divide, 3, -1) \
+   op(Remainder, 3, -1) op(AddInteger, 3, -1) op(Negate, 2, -1) \
+   op(Increment, 1, -1) op(Decrement, 1, -1) \
+   /* real arithmetic */ \
+   op(RealAdd, 3, -1) op(RealSubtract, 3, -1) op(RealMultiply, 3, -1) \
+   op(RealDivide, 3, -1) op(RealNegate, 2, -1) op(RealIncrement, 1, -1) \
+   op(RealDecrement, 1, -1) \
+   /* d = a converted as C++ converts it */ \
+   op(IntegerToReal, 2, -1) op(RealToInteger, 2, -1) op(RealToBool, 2, -1) \
+   op(IntegerToBool, 2, -1) \
+   /* jumps: always, on a nonzero or zero integer, on a comparison of two \
+      integers, of an integer with k, and of two reals, for which the \
+      Unless forms jump when the comparison is false or unordered */ \
+   op(Jump, 1, 0) op(JumpIfTrue, 2, 1) op(JumpIfFalse, 2, 1) \
+   op(JumpIfLess, 3, 2) op(JumpIfLessEqual, 3, 2) op(JumpIfEqual, 3, 2) \
+   op(JumpIfNotEqual, 3, 2) \
+   op(JumpIfLessInteger, 3, 2) op(JumpIfLessEqualInteger, 3, 2) \
+   op(JumpIfGreaterInteger, 3, 2) op(JumpIfGreaterEqualInteger, 3, 2) \
+   op(JumpIfEqualInteger, 3, 2) op(JumpIfNotEqualInteger, 3, 2) \
+   op(JumpIfRealLess, 3, 2) op(JumpIfRealLessEqual, 3, 2) op(JumpIfRealEqual, 3, 2) \
+   op(JumpIfRealNotEqual, 3, 2) op(JumpUnlessRealLess, 3, 2) \
+   op(JumpUnlessRealLessEqual, 3, 2) \
+   /* text, through the runtime, where k is the owned argument it takes: \
+      d = the order of a and b, d = a followed by b, a appended to the text \
+      at p, another reference to a, a released, a stored in slot d, \
+      releasing the text it held, and the texts of the array at p, of the \
+      length in a, released */ \
+   op(TextCompare, 4, -1) op(TextConcat, 4, -1) op(TextAppend, 3, -1) \
+   op(TextRetain, 1, -1) op(TextRelease, 1, -1) op(TextStore, 2, -1) \
+   op(TextReleaseAll, 2, -1) \
+   /* storage for a elements taken and given back; k words copied from p to \
+      d, or a struct copied and released with its table at image offset k */ \
+   op(ArrayTake, 2, -1) op(ArrayGive, 2, -1) op(CopyWords, 3, -1) \
+   op(StructCopy, 3, -1) op(StructRelease, 2, -1) \
+   /* output of a value, and of the text literal at image offset k, and \
+      input to the value at p */ \
+   op(WriteInteger, 1, -1) op(WriteReal, 1, -1) op(WriteBool, 1, -1) \
+   op(WriteText, 2, -1) op(WriteLiteral, 1, -1) \
+   op(ReadInteger, 1, -1) op(ReadReal, 1, -1) op(ReadBool, 1, -1) op(ReadText, 1, -1) \
+   /* a call of the procedure at t, with a frame of k slots starting at \
+      slot b, and returns with the value in a or with nothing */ \
+   op(Call, 3, 0) op(Return, 1, -1) op(ReturnNothing, 0, -1) \
+   /* superinstructions for the most common pairs: d = a + (b + i), \
+      d = a + g[i], d = a + p[i], and an increment of a followed by a jump \
+      if it is then less than b or k, which otherwise skips the same test \
+      that always follows it */ \
+   op(AddFrameIndexed, 4, -1) op(AddGlobalIndexed, 4, -1) op(AddIndexed, 4, -1) \
+   op(IncrementJumpIfLess, 3, 2) op(IncrementJumpIfLessInteger, 3, 2)
+
+#define VURB_OPCODE_NAME(name, operands, target) name,
+
+// scoped, as some names are the same as those of tokens
+enum class vmOpcode { VURB_OPCODES(VURB_OPCODE_NAME) OpcodeCount };
+
+#undef VURB_OPCODE_NAME
+
+#define VURB_OPERAND_COUNT(name, operands, target) operands,
+#define VURB_TARGET_OPERAND(name, operands, target) target,
+
+// the number of operands of each instruction, and which is its target, or -1
+const int OperandCounts[] = { VURB_OPCODES(VURB_OPERAND_COUNT) };
+const int TargetOperands[] = { VURB_OPCODES(VURB_TARGET_OPERAND) };
+
+#undef VURB_OPERAND_COUNT
+#undef VURB_TARGET_OPERAND
+
+
+// the start of every image, giving the magic bytes and format version, the
+//    size of the whole image, the byte offset and number of words of its
+//    code, the number of global words the program uses, and the word of the
+//    main routine and the slots of its frame
+struct vmHeader {
+   char magic[8];
+   long imageBytes;
+   long codeOffset;
+   long codeWords;
+   long globalWords;
+   long mainEntry;
+   long mainFrame;
+};
+
+// the magic bytes, ending in the format version, changed whenever the
+//    instructions or the layout of the image do
+const char BytecodeMagic[8] = {'V', 'U', 'R', 'B', 'C', 0, 0, 1};
@@ -0,0 +1,386 @@
+#include "caching.h"
+#include "options.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::ifstream;
+using std::ofstream;
+using std::ostringstream;
+using std::to_string;
+
+// the version of the layout of the cache, part of every key
+const string CacheFormat = "vurb cache 1";
+
+// the partly written copies left by a build that stopped, given back once
+//    they are this many seconds old
+const long AbandonedSeconds = 3600;
+
+
+// a 128 bit hash built up from runs of bytes, in two 64 bit lanes that mix
+//    every 8 byte word differently; enough to tell builds apart, though not
+//    to stand against anyone forging a collision
+class keyHash {
+public:
+   void add(const char *bytes, size_t count) {
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8) {
+         uint64_t word;
+         memcpy(&word, bytes + i, 8);
+         mix(word);
+      }
+      uint64_t tail = 0;
+      memcpy(&tail, bytes + i, count - i);
+      mix(tail);
+      mix(count);
+   }
+
+   void add(const string &text) {
+      add(text.data(), text.size());
+   }
+
+   string hex() {
+      ostringstream digits;
+      digits << std::hex << std::setfill('0') << std::setw(16) << finish(first)
+             << std::setw(16) << finish(second);
+      return digits.str();
+   }
+
+private:
+   uint64_t first = 0x9e3779b97f4a7c15ull;
+   uint64_t second = 0xc2b2ae3d27d4eb4full;
+
+   void mix(uint64_t word) {
+      first = (first ^ word) * 0xff51afd7ed558ccdull;
+      first ^= first >> 32;
+      second = (second + word) * 0x87c37b91114253d5ull;
+      second = (second << 31) | (second >> 33);
+   }
+
+   static uint64_t finish(uint64_t lane) {
+      lane ^= lane >> 33;
+      lane *= 0xc4ceb9fe1a85ec53ull;
+      lane ^= lane >> 33;
+      return lane;
+   }
+};
+
+
+// the counts kept in the cache's stats file
+struct cacheStats {
+   long hits;
+   long misses;
+   long evictions;
+};
+
+// an entry of the cache, with the time it was last used
+struct cacheEntry {
+   string name;
+   long bytes;
+   struct timespec used;
+};
+
+
+// returns the contents of the named file, storing whether it could be read
+static string fileContents(const string &name, bool &isRead)
+{
+   string contents = "";
+   int file = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+   isRead = (file != -1);
+   if (!isRead) return contents;
+
+   char block[64 * 1024];
+   long count;
+   while ((count = read(file, block, sizeof(block))) != 0) {
+      if (count < 0 && errno == EINTR) continue;
+      if (count < 0) {
+         isRead = false;
+         break;
+      }
+      contents.append(block, count);
+   }
+   close(file);
+   return contents;
+}
+
+
+// returns the directory of the cache: the one asked for, or vurb in the
+//    user's cache directory
+static string cacheDirectory()
+{
+   if (options.cacheDir != "") return options.cacheDir;
+   const char *cacheHome = getenv("XDG_CACHE_HOME");
+   if (cacheHome && cacheHome[0] == '/') return string(cacheHome) + "/vurb";
+   const char *home = getenv("HOME");
+   if (home && home[0] != '\0') return string(home) + "/.cache/vurb";
+   return ".vurb-cache";
+}
+
+
+// make the directory, and those it is within, if they are not there already
+// returns false if it cannot be made
+static bool makeDirectory(const string &name)
+{
+   for (size_t slash = name.find('/', 1); slash != string::npos; slash = name.find('/', slash + 1)) {
+      mkdir(name.substr(0, slash).c_str(), 0755);
+   }
+   return mkdir(name.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+
+// returns the file the compiler runs from, found as the shell finds it,
+//    or the name as it is if it is not found
+static string compilerFile(const string &compiler)
+{
+   if (compiler.find('/') != string::npos) return compiler;
+   const char *path = getenv("PATH");
+   std::istringstream directories(path ? path : "");
+   string directory;
+   while (std::getline(directories, directory, ':')) {
+      string candidate = (directory == "" ? "." : directory) + "/" + compiler;
+      if (access(candidate.c_str(), X_OK) == 0) return candidate;
+   }
+   return compiler;
+}
+
+
+// returns the settings that change the C++ the translator writes, with the
+//    contents of the layout profile read; any option added that changes the
+//    C++ belongs here too
+static string translationOptions(bool &isRead)
+{
+   isRead = true;
+   string layout = "";
+   if (options.layoutProfile != "") layout = fileContents(options.layoutProfile, isRead);
+
+   ostringstream settings;
+   settings << options.packStructs << ' ' << options.parallel << ' ' << options.parallelMin << ' '
+            << options.iostream << ' ' << options.leanRuntime << ' ' << options.hugePages << ' '
+            << options.checked << ' ' << options.narrowArrays << ' ' << options.textArena << ' '
+            << options.profile << ' ' << options.sourceFile.size() << ' ' << options.sourceFile
+            << ' ' << layout.size() << ' ' << layout;
+   return settings.str();
+}
+
+
+// returns the path, size, time of change and inode of the named file, which
+//    tell the translator and compiler apart from the ones they are replaced
+//    by far sooner than reading them would, or "" if there is no such file
+static string fileIdentity(const string &name)
+{
+   struct stat status;
+   if (stat(name.c_str(), &status) != 0) return "";
+   return name + ' ' + to_string(status.st_size) + ' ' + to_string(status.st_mtim.tv_sec)
+      + ' ' + to_string(status.st_mtim.tv_nsec) + ' ' + to_string(status.st_ino);
+}
+
+
+// returns the key --build stores the executable under: a hash of the source
+//    file, the translator itself, the compiler and the arguments it is given,
+//    and the options that change the C++, or "" if one of them cannot be read
+string cacheKey(const vector<string> &compilerArguments)
+{
+   keyHash key;
+   bool isRead = false;
+   key.add(CacheFormat);
+
+   key.add(fileContents(options.buildFile, isRead));
+   if (!isRead) return "";
+   key.add(translationOptions(isRead));
+   if (!isRead) return "";
+
+   string translator = fileIdentity("/proc/self/exe");
+   string compiler = fileIdentity(compilerFile(compilerArguments[0]));
+   if (translator == "" || compiler == "") return "";
+   key.add(translator);
+   key.add(compiler);
+   for (const string &argument : compilerArguments) key.add(argument);
+   return key.hex();
+}
+
+
+// returns true if the name is that of an entry: the 32 hex digits of a key
+static bool isEntryName(const string &name)
+{
+   return name.size() == 32 && name.find_first_not_of("0123456789abcdef") == string::npos;
+}
+
+
+// copy the file from one name to another, writing it beside the target under
+//    a name of its own and then renaming it, so the target is either as it
+//    was or wholly there, however many builds write it at once
+// returns false if the copy cannot be made
+static bool copyFile(const string &from, const string &to)
+{
+   int source = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+   if (source == -1) return false;
+
+   string partial = to + ".partial." + to_string(getpid());
+   int target = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+   if (target == -1) {
+      close(source);
+      return false;
+   }
+
+   char block[64 * 1024];
+   bool isCopied = true;
+   long count;
+   while (isCopied && (count = read(source, block, sizeof(block))) != 0) {
+      if (count < 0) {
+         isCopied = (errno == EINTR);
+         continue;
+      }
+      for (long written = 0; isCopied && written < count; ) {
+         long more = write(target, block + written, count - written);
+         if (more < 0 && errno == EINTR) continue;
+         isCopied = (more > 0);
+         written += more;
+      }
+   }
+   close(source);
+
+   isCopied = (close(target) == 0) && isCopied && rename(partial.c_str(), to.c_str()) == 0;
+   if (!isCopied) unlink(partial.c_str());
+   return isCopied;
+}
+
+
+// change the counts of the cache's stats file by the given amounts, holding
+//    the cache's lock, and then give back entries to bring the cache within
+//    its limit, if asked; the lock keeps builds running at once from losing
+//    each other's counts or evicting the same entries
+// returns false if the cache cannot be written
+static bool updateCache(const string &directory, cacheStats change, bool isEvicting)
+{
+   int lock = open((directory + "/lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (lock == -1) return false;
+   while (flock(lock, LOCK_EX) != 0) {
+      if (errno != EINTR) {
+         close(lock);
+         return false;
+      }
+   }
+
+   if (isEvicting) {
+      vector<cacheEntry> entries;
+      long total = 0;
+      DIR *listing = opendir(directory.c_str());
+      for (struct dirent *item = listing ? readdir(listing) : nullptr; item; item = readdir(listing)) {
+         string name = item->d_name;
+         struct stat status;
+         if (stat((directory + "/" + name).c_str(), &status) != 0) continue;
+
+         if (isEntryName(name)) {
+            entries.push_back({name, (long)status.st_size, status.st_mtim});
+            total += status.st_size;
+         } else if (name.find(".partial.") != string::npos
+            && time(nullptr) - status.st_mtim.tv_sec > AbandonedSeconds) {
+            unlink((directory + "/" + name).c_str());
+         }
+      }
+      if (listing) closedir(listing);
+
+      std::sort(entries.begin(), entries.end(), [](const cacheEntry &a, const cacheEntry &b) {
+         return a.used.tv_sec != b.used.tv_sec ? a.used.tv_sec < b.used.tv_sec : a.used.tv_nsec < b.used.tv_nsec;
+      });
+      long limit = options.cacheLimit * 1024 * 1024;
+      for (size_t i = 0; i < entries.size() && total > limit; i++) {
+         if (unlink((directory + "/" + entries[i].name).c_str()) == 0) {
+            total -= entries[i].bytes;
+            change.evictions++;
+         }
+      }
+   }
+
+   cacheStats stats = {0, 0, 0};
+   ifstream(directory + "/stats") >> stats.hits >> stats.misses >> stats.evictions;
+   stats.hits += change.hits;
+   stats.misses += change.misses;
+   stats.evictions += change.evictions;
+   ofstream(directory + "/stats") << stats.hits << ' ' << stats.misses << ' ' << stats.evictions << '\n';
+
+   close(lock);
+   return true;
+}
+
+
+// copy the executable stored under the key to the file, marking it as just
+//    used, and count a hit, or count a miss if there is none
+// returns true on a hit
+bool fetchCached(const string &key, const string &executable)
+{
+   string directory = cacheDirectory();
+   if (!makeDirectory(directory)) return false;
+
+   string entry = directory + "/" + key;
+   bool isHit = copyFile(entry, executable);
+   if (isHit) utimensat(AT_FDCWD, entry.c_str(), nullptr, 0);
+
+   updateCache(directory, {isHit ? 1 : 0, isHit ? 0 : 1, 0}, false);
+   return isHit;
+}
+
+
+// store a copy of the executable under the key, then give back the least
+//    recently used entries until the cache is within its limit
+// returns false if the cache cannot be written
+bool storeCached(const string &key, const string &executable)
+{
+   string directory = cacheDirectory();
+   if (!makeDirectory(directory) || !copyFile(executable, directory + "/" + key)) return false;
+   return updateCache(directory, {0, 0, 0}, true);
+}
+
+
+// print the counts of hits, misses and evictions, and the entries kept
+// returns false if the cache cannot be read
+bool printCacheStats()
+{
+   string directory = cacheDirectory();
+   DIR *listing = opendir(directory.c_str());
+   if (!listing) {
+      cerr << "Error: unable to read the cache " << directory << endl;
+      return false;
+   }
+
+   long entries = 0;
+   long total = 0;
+   for (struct dirent *item = readdir(listing); item; item = readdir(listing)) {
+      struct stat status;
+      if (isEntryName(item->d_name) && stat((directory + "/" + item->d_name).c_str(), &status) == 0) {
+         entries++;
+         total += status.st_size;
+      }
+   }
+   closedir(listing);
+
+   cacheStats stats = {0, 0, 0};
+   ifstream(directory + "/stats") >> stats.hits >> stats.misses >> stats.evictions;
+   long lookups = stats.hits + stats.misses;
+
+   cout << std::fixed << std::setprecision(1);
+   cout << "cache      " << directory << endl;
+   cout << "hits       " << stats.hits;
+   if (lookups > 0) cout << " (" << 100.0 * stats.hits / lookups << "%)";
+   cout << endl;
+   cout << "misses     " << stats.misses << endl;
+   cout << "evictions  " << stats.evictions << endl;
+   cout << "entries    " << entries << ", " << total / (1024.0 * 1024.0) << " MiB of "
+        << options.cacheLimit << " MiB" << endl;
+   return true;
+}
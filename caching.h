@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+
+// returns the key --build stores the executable under: a hash of the source
+//    file, the translator itself, the compiler and the arguments it is given,
+//    and the options that change the C++, or "" if one of them cannot be read
+string cacheKey(const vector<string> &compilerArguments);
+
+
+// copy the executable stored under the key to the file, marking it as just
+//    used, and count a hit, or count a miss if there is none
+// returns true on a hit
+bool fetchCached(const string &key, const string &executable);
+
+
+// store a copy of the executable under the key, then give back the least
+//    recently used entries until the cache is within its limit
+// returns false if the cache cannot be written
+bool storeCached(const string &key, const string &executable);
+
+
+// print the counts of hits, misses and evictions, and the entries kept
+// returns false if the cache cannot be read
+bool printCacheStats();
@@ -0,0 +1,1862 @@
+#include "compiling.h"
+#include "analyzing.h"
+#include "asmruntime.h"
+#include "assembling.h"
+#include "bytecode.h"
+#include "optimizing.h"
+#include "parsing.h"
+#include "symbols.h"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
+using std::map;
+using std::to_string;
+using std::vector;
+
+// where a variable is kept: in slots of the frame, in the program's global
+//    words, or in storage found through a pointer in a slot, as struct and
+//    array parameters and arrays too large for the frame are
+enum vmStorage { InSlots, InGlobals, ThroughSlot };
+
+// a variable's type and where it is kept: its first slot or global word, or
+//    the slot of the pointer to it; arrays also record their number of
+//    elements, or -1 if that is kept in countSlot, and whether their storage
+//    is given back with the scope
+struct vmVariable {
+   string name;
+   typeInfo type;
+   vmStorage storage;
+   int slot;
+   long count;
+   int countSlot;
+   bool ownsStorage;
+};
+
+// an element of a struct, offset words from its start
+struct vmElement {
+   string name;
+   typeInfo type;
+   long offset;
+};
+
+// the layout of a struct type, as the assembly lays it out: every value takes
+//    a word, with arrays and structs within it laid out in place; texts lists
+//    the words holding text, and table is the image offset of the list the
+//    runtime copies and releases by, or -1 if there is no text
+struct vmStruct {
+   vector<vmElement> elements;
+   long words;
+   vector<long> texts;
+   int table;
+};
+
+// a word holding a value: a slot, a global word, or a word through the
+//    pointer in a slot, offset words on, and further on by the value of the
+//    index slot, if it is not -1
+struct vmPlace {
+   vmStorage storage;
+   int slot;
+   long offset;
+   int index;
+};
+
+// an instruction before it is laid out, its jump target given as a label
+struct vmInstruction {
+   vmOpcode op;
+   int operands[4];
+};
+
+// arrays larger than this are kept apart from the frame, as the C++ does
+const long FrameArrayWords = 64 * 1024 / 8;
+
+static unordered_map<string, vmStruct> vmStructs;
+
+// the variables in scope, innermost last: the first scope holds the globals,
+//    the second the parameters of the procedure being compiled
+static vector<vector<vmVariable>> vmScopes;
+
+static long globalWords = 0;
+
+// the code, the instruction each label marks, and the calls made, whose
+//    frame sizes are filled in once every procedure is compiled
+static vector<vmInstruction> code;
+static vector<int> labelPositions;
+static vector<pair<size_t, string>> calls;
+static unordered_map<string, int> procedureLabels;
+static unordered_map<string, int> procedureFrames;
+
+// the text literals and struct tables, which the image holds ahead of the code
+static string data = "";
+static map<string, int> textLiterals;
+
+// the procedure being compiled: the next free slot, the most slots it has
+//    used, its return type and the label self tail calls jump to, or -1
+static int slotTop = 0;
+static int frameSlots = 0;
+static TokenType returnType = TokenType::VoidType;
+static int tailLabel = -1;
+
+static int vmGlobal(token tokens[], int currPos, int size);
+static int vmStructDef(token tokens[], int currPos, int size);
+static int vmProcedure(token tokens[], int currPos, int size);
+static int vmMain(token tokens[], int currPos, int size);
+static int vmBody(token tokens[], int currPos, int size);
+static int vmStatement(token tokens[], int currPos, int size);
+static int vmValue(token tokens[], int currPos, int size, int target, int &slot, bool &owned);
+static int vmConverted(token tokens[], int currPos, int size, TokenType type, int target, int &slot);
+static int vmBranch(token tokens[], int currPos, int size, int label, bool when);
+static int vmCall(token tokens[], int currPos, int size, int &slot);
+static string layOut(int mainLabel);
+
+
+// translate the token sequence to the bytecode described in bytecode.h,
+//    storing the image that --exec runs in image,
+// with any error messages directed to standard error
+// returns false if the program is malformed
+bool compileBytecode(token tokens[], int size, string &image)
+{
+   collectProcedures(tokens, size);
+   vmScopes.assign(1, vector<vmVariable>());
+
+   int currPos = 0;
+   while (currPos < size && tokens[currPos].ttype == TokenType::GlobalDef) {
+      currPos = vmGlobal(tokens, currPos, size);
+      if (currPos == -1) {
+         printSectionError("Global Variable Declaration");
+         return false;
+      }
+      currPos++;
+   }
+
+   while (currPos < size && tokens[currPos].ttype == TokenType::StructDef) {
+      currPos = vmStructDef(tokens, currPos, size);
+      if (currPos == -1) {
+         printSectionError("Struct Declaration");
+         return false;
+      }
+      currPos++;
+   }
+
+   while (currPos < size && tokens[currPos].ttype == TokenType::ProcDef) {
+      currPos = vmProcedure(tokens, currPos, size);
+      if (currPos == -1) {
+         printSectionError("Procedure Declaration");
+         return false;
+      }
+      currPos++;
+   }
+
+   if (currPos >= size) return false;
+
+   int mainLabel = (int)labelPositions.size();
+   currPos = vmMain(tokens, currPos, size);
+   if (currPos == -1) return false;
+
+   currPos++;
+   if (currPos != size) {
+      cerr << "Error: invalid content found after main routine.\n";
+      cerr << (size - currPos) << " additional tokens found\n";
+      return false;
+   }
+
+   image = layOut(mainLabel);
+   return true;
+}
+
+
+// --- writing code --------------------------------------------------------
+
+static void emit(vmOpcode op, int a = 0, int b = 0, int c = 0, int d = 0)
+{
+   code.push_back({op, {a, b, c, d}});
+}
+
+
+static int newLabel()
+{
+   labelPositions.push_back(-1);
+   return (int)labelPositions.size() - 1;
+}
+
+
+static void placeLabel(int label)
+{
+   labelPositions[label] = (int)code.size();
+}
+
+
+// returns the label of the start of the named procedure
+static int procedureLabel(const string &name)
+{
+   auto found = procedureLabels.find(name);
+   if (found != procedureLabels.end()) return found->second;
+   int label = newLabel();
+   procedureLabels[name] = label;
+   return label;
+}
+
+
+// returns the first of count new slots of the frame
+static int newSlots(int count)
+{
+   int first = slotTop;
+   slotTop += count;
+   frameSlots = std::max(frameSlots, slotTop);
+   return first;
+}
+
+
+// returns the slot a value is to be left in: the target, or if that is -1,
+//    a new temporary slot
+static int destination(int target)
+{
+   return (target >= 0) ? target : newSlots(1);
+}
+
+
+// move the value in slot to the target, if there is one, leaving slot naming
+//    where the value is
+static void moveTo(int target, int &slot)
+{
+   if (target >= 0 && slot != target) {
+      emit(vmOpcode::Move, target, slot);
+      slot = target;
+   }
+}
+
+
+static bool fitsImmediate(long value)
+{
+   return value >= -0x80000000l && value <= 0x7fffffff;
+}
+
+
+// set the slot to an integer, or the bits of a real
+static void setWord(int slot, long value)
+{
+   if (fitsImmediate(value)) {
+      emit(vmOpcode::SetInteger, slot, (int)value);
+   } else {
+      emit(vmOpcode::SetWide, slot, (int)(value & 0xffffffff), (int)(value >> 32));
+   }
+}
+
+
+static void setReal(int slot, double value)
+{
+   long bits = 0;
+   memcpy(&bits, &value, sizeof(bits));
+   emit(vmOpcode::SetWide, slot, (int)(bits & 0xffffffff), (int)(bits >> 32));
+}
+
+
+// append 8 byte words to the image's data
+static void appendWord(long word)
+{
+   data.append((const char *)&word, sizeof(word));
+}
+
+
+// returns the image offset of the text literal holding the characters, laid
+//    out as the runtime lays out text
+static int textLiteral(const string &characters)
+{
+   auto found = textLiterals.find(characters);
+   if (found != textLiterals.end()) return found->second;
+
+   int offset = (int)(sizeof(vmHeader) + data.size());
+   appendWord(LiteralReferences);
+   appendWord((long)characters.length());
+   appendWord((long)characters.length());
+   data += characters;
+   data.append((8 - data.size() % 8) % 8, '\0');
+   textLiterals[characters] = offset;
+   return offset;
+}
+
+
+// --- variables and their types -------------------------------------------
+
+// returns the variable of the given name in the innermost scope that has one,
+//    or nullptr if none does
+static vmVariable *findVariable(const string &name)
+{
+   for (size_t scope = vmScopes.size(); scope-- > 0; ) {
+      for (size_t i = vmScopes[scope].size(); i-- > 0; ) {
+         if (vmScopes[scope][i].name == name) return &vmScopes[scope][i];
+      }
+   }
+   return nullptr;
+}
+
+
+// record a variable in the innermost scope, where accessType can find it too
+static void declareVmVariable(const vmVariable &variable)
+{
+   vmScopes.back().push_back(variable);
+   declareVariable(variable.name, variable.type);
+}
+
+
+// returns the number of words a value of the type takes
+static long typeWords(const typeInfo &type)
+{
+   long words = 1;
+   if (type.ttype == TokenType::StructType) words = vmStructs[type.structName].words;
+   return type.isArray ? words * integerLiteral(type.arraySize) : words;
+}
+
+
+// returns the element of the struct type with the given name, or nullptr if none
+static const vmElement *findElement(const string &structName, const string &elementName)
+{
+   auto layout = vmStructs.find(structName);
+   if (layout == vmStructs.end()) return nullptr;
+   for (const vmElement &element : layout->second.elements) {
+      if (element.name == elementName) return &element;
+   }
+   return nullptr;
+}
+
+
+// returns the place of a variable itself
+static vmPlace variablePlace(const vmVariable &variable)
+{
+   return {variable.storage, variable.slot, 0, -1};
+}
+
+
+// returns the slot holding the value at the place as it stands, or -1 if it
+//    has to be loaded
+static int placeSlot(const vmPlace &place)
+{
+   if (place.storage != InSlots || place.index >= 0) return -1;
+   return place.slot + (int)place.offset;
+}
+
+
+// load the value at the place into slot d
+static void loadPlace(const vmPlace &place, int d)
+{
+   int at = place.slot + (int)place.offset;
+   if (place.storage == InSlots) {
+      if (place.index >= 0) {
+         emit(vmOpcode::LoadFrameIndexed, d, at, place.index);
+      } else if (at != d) {
+         emit(vmOpcode::Move, d, at);
+      }
+   } else if (place.storage == InGlobals) {
+      if (place.index >= 0) {
+         emit(vmOpcode::LoadGlobalIndexed, d, at, place.index);
+      } else {
+         emit(vmOpcode::LoadGlobal, d, at);
+      }
+   } else if (place.index >= 0) {
+      emit(vmOpcode::LoadIndexed, d, place.slot, place.index, (int)place.offset);
+   } else {
+      emit(vmOpcode::Load, d, place.slot, (int)place.offset);
+   }
+}
+
+
+// store the value in slot a at the place
+static void storePlace(const vmPlace &place, int a)
+{
+   int at = place.slot + (int)place.offset;
+   if (place.storage == InSlots) {
+      if (place.index >= 0) {
+         emit(vmOpcode::StoreFrameIndexed, at, place.index, a);
+      } else if (at != a) {
+         emit(vmOpcode::Move, at, a);
+      }
+   } else if (place.storage == InGlobals) {
+      if (place.index >= 0) {
+         emit(vmOpcode::StoreGlobalIndexed, at, place.index, a);
+      } else {
+         emit(vmOpcode::StoreGlobal, at, a);
+      }
+   } else if (place.index >= 0) {
+      emit(vmOpcode::StoreIndexed, place.slot, place.index, (int)place.offset, a);
+   } else {
+      emit(vmOpcode::Store, place.slot, (int)place.offset, a);
+   }
+}
+
+
+// returns the slot holding the address of the place, put in the target
+//    if there is one
+static int addressOf(const vmPlace &place, int target)
+{
+   int at = place.slot + (int)place.offset;
+   if (place.storage == ThroughSlot && place.offset == 0 && place.index < 0) {
+      int slot = place.slot;
+      moveTo(target, slot);
+      return slot;
+   }
+
+   int d = destination(target);
+   if (place.storage == InSlots) {
+      emit(vmOpcode::FrameAddress, d, at);
+   } else if (place.storage == InGlobals) {
+      emit(vmOpcode::GlobalAddress, d, at);
+   } else {
+      emit(vmOpcode::PointerAddress, d, place.slot, (int)place.offset);
+   }
+   if (place.index >= 0) emit(vmOpcode::IndexAddress, d, d, place.index);
+   return d;
+}
+
+
+// move the place on to the array element indexed by the token at indexPos,
+//    loading the index into a slot unless it is a literal or kept in one
+static bool indexPlace(token tokens[], int indexPos, vmPlace &place)
+{
+   if (place.index >= 0) {
+      place = {ThroughSlot, addressOf(place, -1), 0, -1};
+   }
+
+   if (tokens[indexPos].ttype == TokenType::IntLit) {
+      place.offset += integerLiteral(tokens[indexPos].content);
+      return true;
+   }
+
+   const vmVariable *index = nullptr;
+   if (tokens[indexPos].ttype == TokenType::Identifier) index = findVariable(tokens[indexPos].content);
+   if (!index || index->type.isArray) {
+      printError(tokens[indexPos], indexPos, "Valid array index");
+      return false;
+   }
+
+   place.index = placeSlot(variablePlace(*index));
+   if (place.index < 0) {
+      place.index = newSlots(1);
+      loadPlace(variablePlace(*index), place.index);
+   }
+   return true;
+}
+
+
+// find the place of the identifier, array access or struct access at currPos,
+//    and its type
+// returns the position of the last token of the access, or -1 if malformed
+static int accessPlace(token tokens[], int currPos, int size, vmPlace &place, typeInfo &type)
+{
+   if (currPos >= size) return -1;
+
+   if (tokens[currPos].ttype == TokenType::Identifier) {
+      const vmVariable *variable = findVariable(tokens[currPos].content);
+      if (!variable) {
+         printError(tokens[currPos], currPos, "declared variable");
+         return -1;
+      }
+      type = variable->type;
+      place = variablePlace(*variable);
+      return currPos;
+   }
+
+   if (tokens[currPos].ttype == TokenType::ArrayAccess) {
+      int arrayEnd = accessPlace(tokens, currPos + 1, size, place, type);
+      if (arrayEnd == -1 || arrayEnd + 1 >= size) return -1;
+      if (!type.isArray) {
+         printError(tokens[currPos + 1], currPos + 1, "Array");
+         return -1;
+      }
+      if (!indexPlace(tokens, arrayEnd + 1, place)) return -1;
+      type.isArray = false;
+      type.arraySize = "";
+      return arrayEnd + 1;
+   }
+
+   if (tokens[currPos].ttype == TokenType::StructElemAccess
+      || tokens[currPos].ttype == TokenType::StructIndirElemAccess) {
+      int structEnd = accessPlace(tokens, currPos + 1, size, place, type);
+      if (structEnd == -1 || structEnd + 1 >= size) return -1;
+      const vmElement *element = nullptr;
+      if (!type.isArray && type.ttype == TokenType::StructType) {
+         element = findElement(type.structName, tokens[structEnd + 1].content);
+      }
+      if (!element) {
+         printError(tokens[structEnd + 1], structEnd + 1, "Struct element identifier");
+         return -1;
+      }
+      place.offset += element->offset;
+      type = element->type;
+      return structEnd + 1;
+   }
+
+   printError(tokens[currPos], currPos, "Identifier or struct field");
+   return -1;
+}
+
+
+// returns the slot holding the number of elements of the array at currPos,
+//    put in the target if there is one, or -1 if it is not an array
+static int countValue(token tokens[], int currPos, int size, int target)
+{
+   typeInfo type;
+   if (!accessType(tokens, currPos, size, type) || !type.isArray) {
+      printError(tokens[currPos], currPos, "Array");
+      return -1;
+   }
+
+   // the size is known from the declaration, or kept along with the array
+   const vmVariable *variable = nullptr;
+   if (tokens[currPos].ttype == TokenType::Identifier) variable = findVariable(tokens[currPos].content);
+   if (variable && variable->count < 0) {
+      int slot = variable->countSlot;
+      moveTo(target, slot);
+      return slot;
+   }
+   int d = destination(target);
+   setWord(d, variable ? variable->count : integerLiteral(type.arraySize));
+   return d;
+}
+
+
+// --- releasing ---------------------------------------------------------------
+
+// returns true if the variable holds text or storage to give back when it goes out of scope
+static bool needsRelease(const vmVariable &variable)
+{
+   if (variable.storage == InGlobals) return false;
+   if (variable.type.isArray) {
+      return variable.ownsStorage
+         || (variable.storage == InSlots && variable.type.ttype == TokenType::TextType);
+   }
+   if (variable.type.ttype == TokenType::StructType) {
+      return variable.storage == InSlots && !vmStructs[variable.type.structName].texts.empty();
+   }
+   return variable.type.ttype == TokenType::TextType;
+}
+
+
+// give back the text and storage held by the variable
+static void releaseVariable(const vmVariable &variable)
+{
+   if (!needsRelease(variable)) return;
+   const typeInfo &type = variable.type;
+   int mark = slotTop;
+
+   if (type.isArray) {
+      int count = variable.countSlot;
+      if (variable.count >= 0) {
+         count = newSlots(1);
+         setWord(count, variable.count);
+      }
+      if (type.ttype == TokenType::TextType) {
+         emit(vmOpcode::TextReleaseAll, addressOf(variablePlace(variable), -1), count);
+      }
+      if (variable.ownsStorage) emit(vmOpcode::ArrayGive, variable.slot, count);
+   } else if (type.ttype == TokenType::StructType) {
+      emit(vmOpcode::StructRelease, addressOf(variablePlace(variable), -1), vmStructs[type.structName].table);
+   } else {
+      emit(vmOpcode::TextRelease, variable.slot);
+   }
+   slotTop = mark;
+}
+
+
+// release the variables of the scopes from the innermost out to the given one
+static void releaseScopes(size_t outermost)
+{
+   for (size_t scope = vmScopes.size(); scope-- > outermost; ) {
+      for (size_t i = vmScopes[scope].size(); i-- > 0; ) {
+         releaseVariable(vmScopes[scope][i]);
+      }
+   }
+}
+
+
+// --- declarations ------------------------------------------------------------
+
+// lay out a global variable in the program's global words, which start zeroed
+static int vmGlobal(token tokens[], int currPos, int size)
+{
+   string name = "";
+   typeInfo type;
+   int declEnd = readDeclaration(tokens, currPos + 1, size, name, type);
+   if (declEnd == -1 || (type.isArray && tokens[currPos + 4].ttype != TokenType::IntLit)) {
+      printError(tokens[currPos + 1], currPos + 1, "Global variable declaration");
+      return -1;
+   }
+
+   vmVariable variable = {name, type, InGlobals, (int)globalWords, -1, 0, false};
+   if (type.isArray) variable.count = integerLiteral(type.arraySize);
+   globalWords += typeWords(type);
+   declareVmVariable(variable);
+   return declEnd;
+}
+
+
+// lay out a struct type, with the table of its text words for the runtime:
+//    the number of words, then the number of texts and which words they are
+static int vmStructDef(token tokens[], int currPos, int size)
+{
+   if (currPos + 2 >= size || tokens[currPos + 1].ttype != TokenType::Identifier
+      || tokens[currPos + 2].ttype != TokenType::Begin) {
+      printError(tokens[currPos + 1], currPos + 1, tokenTypeToString(TokenType::Identifier));
+      return -1;
+   }
+
+   string structName = tokens[currPos + 1].content;
+   vmStruct layout;
+   layout.words = 0;
+   layout.table = -1;
+   currPos += 3;
+
+   while (currPos < size && tokens[currPos].ttype == TokenType::Element) {
+      vmElement element;
+      int declEnd = readDeclaration(tokens, currPos + 1, size, element.name, element.type);
+      if (declEnd == -1) {
+         printError(tokens[currPos + 1], currPos + 1, "Valid struct element");
+         return -1;
+      }
+      declareElement(structName, element.name, element.type);
+
+      element.offset = layout.words;
+      if (element.type.ttype == TokenType::TextType) {
+         long count = element.type.isArray ? integerLiteral(element.type.arraySize) : 1;
+         for (long i = 0; i < count; i++) layout.texts.push_back(element.offset + i);
+      } else if (element.type.ttype == TokenType::StructType && !element.type.isArray) {
+         for (long text : vmStructs[element.type.structName].texts) layout.texts.push_back(element.offset + text);
+      }
+      layout.words += typeWords(element.type);
+      layout.elements.push_back(element);
+      currPos = declEnd + 1;
+   }
+
+   if (currPos >= size || tokens[currPos].ttype != TokenType::End) {
+      printError(tokens[currPos], currPos, tokenTypeToString(TokenType::End));
+      return -1;
+   }
+
+   if (!layout.texts.empty()) {
+      layout.table = (int)(sizeof(vmHeader) + data.size());
+      appendWord(layout.words);
+      appendWord((long)layout.texts.size());
+      for (long text : layout.texts) appendWord(text);
+   }
+   vmStructs[structName] = layout;
+   return currPos;
+}
+
+
+// start a procedure at its label: its parameters take the first slots of
+//    its frame, in order, with arrays passed as a pointer and their number
+//    of elements, and structs as a pointer
+static void startProcedure(const string &name, const procedureInfo *proc)
+{
+   slotTop = 0;
+   frameSlots = 0;
+   returnType = proc ? proc->returnType : TokenType::IntType;
+   tailLabel = -1;
+   placeLabel(procedureLabel(name));
+
+   enterScope();
+   vmScopes.push_back(vector<vmVariable>());
+
+   for (size_t i = 0; proc && i < proc->params.size(); i++) {
+      const paramInfo &param = proc->params[i];
+      vmVariable variable = {param.name, typeInfo(), InSlots, newSlots(1), -1, 0, false};
+      variable.type.ttype = param.structType.empty() ? param.ptype : TokenType::StructType;
+      variable.type.structName = param.structType;
+      variable.type.isArray = param.isArray;
+      variable.type.arraySize = param.isArray ? arraySizeName(param.name) : "";
+
+      if (param.isArray) {
+         variable.storage = ThroughSlot;
+         variable.countSlot = newSlots(1);
+      } else if (!param.structType.empty()) {
+         variable.storage = ThroughSlot;
+      }
+      declareVmVariable(variable);
+   }
+}
+
+
+// finish a procedure, returning nothing, or zero, if it runs off its end
+static void finishProcedure(const string &name)
+{
+   releaseScopes(1);
+   if (returnType != TokenType::VoidType) {
+      int zero = newSlots(1);
+      emit(vmOpcode::SetInteger, zero, 0);
+      emit(vmOpcode::Return, zero);
+   } else {
+      emit(vmOpcode::ReturnNothing);
+   }
+   procedureFrames[name] = frameSlots;
+
+   vmScopes.pop_back();
+   exitScope();
+}
+
+
+// compile a procedure definition
+static int vmProcedure(token tokens[], int currPos, int size)
+{
+   if (currPos + 1 >= size) return -1;
+
+   const procedureInfo *proc = findProcedure(tokens[currPos + 1].content);
+   if (!proc) {
+      printError(tokens[currPos + 1], currPos + 1, "Procedure definition");
+      return -1;
+   }
+
+   startProcedure(proc->name, proc);
+
+   // self tail calls jump back to the start of the body
+   if (hasSelfTailCall(tokens, size, proc->name)) {
+      tailLabel = newLabel();
+      placeLabel(tailLabel);
+   }
+
+   if (vmBody(tokens, proc->bodyStart, size) == -1) return -1;
+   finishProcedure(proc->name);
+   return proc->bodyEnd;
+}
+
+
+// compile the main routine, as the procedure the interpreter starts with;
+//    no procedure can be called main, which the C++ already uses
+static int vmMain(token tokens[], int currPos, int size)
+{
+   if (tokens[currPos].ttype != TokenType::Main) {
+      printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Main));
+      return -1;
+   }
+
+   startProcedure("main", nullptr);
+   currPos = vmBody(tokens, currPos + 1, size);
+   if (currPos == -1) return -1;
+   finishProcedure("main");
+   return currPos;
+}
+
+
+// --- statements --------------------------------------------------------------
+
+// compile a body of code, releasing the variables declared in it at its end,
+//    whose slots later code can use again
+static int vmBody(token tokens[], int currPos, int size)
+{
+   if (currPos >= size || tokens[currPos].ttype != TokenType::Begin) {
+      printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Begin));
+      return -1;
+   }
+
+   enterScope();
+   vmScopes.push_back(vector<vmVariable>());
+   int bodySlots = slotTop;
+
+   currPos++;
+   while (currPos < size && tokens[currPos].ttype != TokenType::End) {
+      // the temporaries of a statement are free once it is done
+      int mark = slotTop;
+      bool isDeclaration = (tokens[currPos].ttype == TokenType::VarDef);
+      currPos = vmStatement(tokens, currPos, size);
+      if (currPos == -1) return -1;
+      if (!isDeclaration) slotTop = mark;
+      currPos++;
+   }
+
+   if (currPos >= size) return -1;
+
+   releaseScopes(vmScopes.size() - 1);
+   vmScopes.pop_back();
+   exitScope();
+   slotTop = bodySlots;
+   return currPos;
+}
+
+
+// compile a local variable definition: scalars start at zero and text empty,
+//    and arrays too large for the frame, or sized by an expression, get
+//    storage of their own
+static int vmLocal(token tokens[], int currPos, int size)
+{
+   int declPos = currPos + 1;
+   string name = "";
+   typeInfo type;
+   int declEnd = readDeclaration(tokens, declPos, size, name, type);
+   if (declEnd == -1 || (!isVariableType(type.ttype) && type.ttype != TokenType::StructType)) {
+      printError(tokens[declPos], declPos, "Variable declaration");
+      return -1;
+   }
+
+   vmVariable variable = {name, type, InSlots, 0, -1, 0, false};
+
+   if (type.isArray) {
+      if (isRuntimeSizedArray(tokens, declPos, size)) {
+         // the size is worked out before the array is in scope
+         variable.countSlot = newSlots(1);
+         int mark = slotTop;
+         if (vmConverted(tokens, declPos + 3, size, TokenType::IntType, variable.countSlot, variable.countSlot) == -1) {
+            return -1;
+         }
+         slotTop = mark;
+         int isCounted = newLabel();
+         emit(vmOpcode::JumpIfGreaterEqualInteger, variable.countSlot, 0, isCounted);
+         emit(vmOpcode::SetInteger, variable.countSlot, 0);
+         placeLabel(isCounted);
+      } else {
+         variable.count = integerLiteral(type.arraySize);
+         if (variable.count <= FrameArrayWords) {
+            variable.slot = newSlots((int)variable.count);
+            if (type.ttype == TokenType::TextType) emit(vmOpcode::Clear, variable.slot, (int)variable.count);
+            declareVmVariable(variable);
+            return declEnd;
+         }
+         variable.countSlot = newSlots(1);
+         setWord(variable.countSlot, variable.count);
+      }
+      variable.storage = ThroughSlot;
+      variable.ownsStorage = true;
+      variable.slot = newSlots(1);
+      emit(vmOpcode::ArrayTake, variable.slot, variable.countSlot);
+
+      // a count known from the declaration need not be kept
+      if (variable.count >= 0) slotTop = variable.slot + 1;
+   } else if (type.ttype == TokenType::StructType) {
+      variable.slot = newSlots((int)typeWords(type));
+      emit(vmOpcode::Clear, variable.slot, (int)typeWords(type));
+   } else {
+      variable.slot = newSlots(1);
+      emit(vmOpcode::SetInteger, variable.slot, 0);
+   }
+
+   declareVmVariable(variable);
+   return declEnd;
+}
+
+
+// copy the struct at the address in slot s to the one at the address in slot d
+static void copyStruct(const string &structName, int d, int s)
+{
+   const vmStruct &layout = vmStructs[structName];
+   if (layout.table < 0) {
+      emit(vmOpcode::CopyWords, d, s, (int)layout.words);
+   } else {
+      emit(vmOpcode::StructCopy, d, s, layout.table);
+   }
+}
+
+
+// work out the value at valuePos for a store of the given type: the address
+//    of the struct to copy, or the value converted to the type, with text
+//    holding a reference of its own, put in the target if there is one
+// returns the position of the last token of the value, or -1 if malformed
+static int vmStoredValue(token tokens[], int valuePos, int size, const typeInfo &type, int target, int &slot)
+{
+   if (type.isArray) {
+      printError(tokens[valuePos], valuePos, "Single value");
+      return -1;
+   }
+   if (type.ttype != TokenType::StructType) return vmConverted(tokens, valuePos, size, type.ttype, target, slot);
+
+   vmPlace source;
+   typeInfo sourceType;
+   int valueEnd = accessPlace(tokens, valuePos, size, source, sourceType);
+   if (valueEnd == -1) return -1;
+   if (sourceType.isArray || sourceType.structName != type.structName) {
+      printError(tokens[valuePos], valuePos, "Struct of type " + type.structName);
+      return -1;
+   }
+   slot = addressOf(source, target);
+   return valueEnd;
+}
+
+
+// store the value worked out by vmStoredValue in slot at the place, releasing
+//    the text it replaces
+static void storeAt(const vmPlace &place, const typeInfo &type, int slot)
+{
+   if (type.ttype == TokenType::StructType) {
+      copyStruct(type.structName, addressOf(place, -1), slot);
+   } else if (type.ttype != TokenType::TextType) {
+      storePlace(place, slot);
+   } else if (placeSlot(place) >= 0) {
+      emit(vmOpcode::TextStore, placeSlot(place), slot);
+   } else {
+      int replaced = newSlots(1);
+      loadPlace(place, replaced);
+      storePlace(place, slot);
+      emit(vmOpcode::TextRelease, replaced);
+   }
+}
+
+
+// compile a set statement, appending text in place where it can be, and
+//    working out scalars kept in slots straight into them
+static int vmSet(token tokens[], int currPos, int size)
+{
+   int targetPos = currPos + 1;
+   typeInfo type;
+   if (!accessType(tokens, targetPos, size, type)) {
+      printError(tokens[targetPos], targetPos, "Identifier or struct field");
+      return -1;
+   }
+
+   int valuePos = skipExpression(tokens, targetPos, size) + 1;
+   if (valuePos == 0 || valuePos >= size) return -1;
+
+   vector<int> appended;
+   if (findAppendedValues(tokens, currPos, size, appended)) {
+      for (int piece : appended) {
+         int mark = slotTop;
+         int slot = 0;
+         bool owned = false;
+         if (vmValue(tokens, piece, size, -1, slot, owned) == -1) return -1;
+         vmPlace target;
+         accessPlace(tokens, targetPos, size, target, type);
+         emit(vmOpcode::TextAppend, addressOf(target, -1), slot, owned ? 1 : 0);
+         slotTop = mark;
+      }
+      return skipExpression(tokens, valuePos, size);
+   }
+
+   const vmVariable *variable = nullptr;
+   if (tokens[targetPos].ttype == TokenType::Identifier) variable = findVariable(tokens[targetPos].content);
+   if (variable && variable->storage == InSlots && !type.isArray
+      && type.ttype != TokenType::StructType && type.ttype != TokenType::TextType) {
+      int slot = 0;
+      return vmConverted(tokens, valuePos, size, type.ttype, variable->slot, slot);
+   }
+
+   int slot = 0;
+   int valueEnd = vmStoredValue(tokens, valuePos, size, type, -1, slot);
+   if (valueEnd == -1) return -1;
+
+   vmPlace target;
+   if (accessPlace(tokens, targetPos, size, target, type) == -1) return -1;
+   storeAt(target, type, slot);
+   return valueEnd;
+}
+
+
+// compile an array set statement
+static int vmArraySet(token tokens[], int currPos, int size)
+{
+   int arrayPos = currPos + 1;
+   int indexPos = skipExpression(tokens, arrayPos, size) + 1;
+   if (indexPos == 0 || indexPos + 1 >= size) return -1;
+
+   typeInfo type;
+   if (!accessType(tokens, arrayPos, size, type) || !type.isArray) {
+      printError(tokens[arrayPos], arrayPos, "Array");
+      return -1;
+   }
+   type.isArray = false;
+
+   int slot = 0;
+   int valueEnd = vmStoredValue(tokens, indexPos + 1, size, type, -1, slot);
+   if (valueEnd == -1) return -1;
+
+   vmPlace target;
+   typeInfo arrayType;
+   if (accessPlace(tokens, arrayPos, size, target, arrayType) == -1) return -1;
+   if (!indexPlace(tokens, indexPos, target)) return -1;
+   storeAt(target, type, slot);
+   return valueEnd;
+}
+
+
+// compile a struct set statement
+static int vmStructSet(token tokens[], int currPos, int size)
+{
+   int structPos = currPos + 1;
+   if (structPos + 2 >= size || tokens[structPos].ttype != TokenType::Identifier) {
+      printError(tokens[structPos], structPos, "Struct identifier");
+      return -1;
+   }
+
+   typeInfo structType;
+   const vmElement *element = nullptr;
+   if (accessType(tokens, structPos, size, structType) && !structType.isArray) {
+      element = findElement(structType.structName, tokens[structPos + 1].content);
+   }
+   if (!element) {
+      printError(tokens[structPos + 1], structPos + 1, "Struct element identifier");
+      return -1;
+   }
+   typeInfo type = element->type;
+   long offset = element->offset;
+
+   int slot = 0;
+   int valueEnd = vmStoredValue(tokens, structPos + 2, size, type, -1, slot);
+   if (valueEnd == -1) return -1;
+
+   vmPlace target;
+   if (accessPlace(tokens, structPos, size, target, structType) == -1) return -1;
+   target.offset += offset;
+   storeAt(target, type, slot);
+   return valueEnd;
+}
+
+
+// returns the characters a single token write puts out, if it is a literal
+static bool literalOutput(const token &tok, string &characters)
+{
+   if (tok.ttype == TokenType::TextLit) {
+      characters = literalCharacters(tok.content);
+   } else if (tok.ttype == TokenType::IntLit) {
+      characters = to_string(integerLiteral(tok.content));
+   } else if (tok.ttype == TokenType::BoolLit) {
+      characters = (tok.content == "true") ? "1" : "0";
+   } else {
+      return false;
+   }
+   return true;
+}
+
+
+// compile an output statement, joining a run of literal writes into one
+static int vmWrite(token tokens[], int currPos, int size)
+{
+   int valuePos = currPos + 1;
+   if (valuePos >= size) return -1;
+
+   string characters = "";
+   if (literalOutput(tokens[valuePos], characters)) {
+      string more = "";
+      while (valuePos + 2 < size && tokens[valuePos + 1].ttype == TokenType::Write
+         && literalOutput(tokens[valuePos + 2], more)) {
+         characters += "\n" + more;
+         valuePos += 2;
+      }
+      emit(vmOpcode::WriteLiteral, textLiteral(characters));
+      return valuePos;
+   }
+
+   TokenType type = valueType(tokens, valuePos, size);
+   int slot = 0;
+   bool owned = false;
+   int valueEnd = vmValue(tokens, valuePos, size, -1, slot, owned);
+   if (valueEnd == -1) return -1;
+
+   if (type == TokenType::TextType) {
+      emit(vmOpcode::WriteText, slot, owned ? 1 : 0);
+   } else if (type == TokenType::RealType) {
+      emit(vmOpcode::WriteReal, slot);
+   } else if (type == TokenType::BoolType) {
+      emit(vmOpcode::WriteBool, slot);
+   } else if (type == TokenType::IntType) {
+      emit(vmOpcode::WriteInteger, slot);
+   } else {
+      printError(tokens[valuePos], valuePos, "Value to write");
+      return -1;
+   }
+   return valueEnd;
+}
+
+
+// compile an input statement
+static int vmRead(token tokens[], int currPos, int size)
+{
+   int namePos = currPos + 1;
+   const vmVariable *variable = nullptr;
+   if (namePos < size && tokens[namePos].ttype == TokenType::Identifier) variable = findVariable(tokens[namePos].content);
+   if (!variable || variable->type.isArray || !isVariableType(variable->type.ttype)) {
+      printError(tokens[namePos], namePos, "Variable name");
+      return -1;
+   }
+
+   vmOpcode op = vmOpcode::ReadInteger;
+   if (variable->type.ttype == TokenType::RealType) op = vmOpcode::ReadReal;
+   if (variable->type.ttype == TokenType::TextType) op = vmOpcode::ReadText;
+   if (variable->type.ttype == TokenType::BoolType) op = vmOpcode::ReadBool;
+
+   emit(op, addressOf(variablePlace(*variable), -1));
+   return namePos;
+}
+
+
+// compile an increment or decrement, leaving the value it gives in a slot,
+//    put in the target if there is one, if wanted
+static int vmIncrement(token tokens[], int currPos, int size, bool wantValue, int target, int &slot)
+{
+   int namePos = currPos + 2;
+   if (namePos + 1 >= size || tokens[namePos + 1].ttype != TokenType::Right) return -1;
+
+   TokenType op = tokens[currPos + 1].ttype;
+   const vmVariable *variable = nullptr;
+   if (tokens[namePos].ttype == TokenType::Identifier) variable = findVariable(tokens[namePos].content);
+   if (!variable || variable->type.isArray || variable->storage == ThroughSlot) {
+      printError(tokens[namePos], namePos, tokenTypeToString(TokenType::Identifier));
+      return -1;
+   }
+
+   bool isUp = (op == TokenType::AddAdd || op == TokenType::AddAddPre);
+   bool isPre = isPreIncrementOperator(op);
+   bool isReal = (variable->type.ttype == TokenType::RealType);
+   vmOpcode step = isReal ? (isUp ? vmOpcode::RealIncrement : vmOpcode::RealDecrement)
+      : (isUp ? vmOpcode::Increment : vmOpcode::Decrement);
+
+   // a global is changed in a slot of its own
+   vmPlace place = variablePlace(*variable);
+   int changed = placeSlot(place);
+   if (changed < 0) {
+      changed = newSlots(1);
+      loadPlace(place, changed);
+   }
+
+   if (wantValue && !isPre) {
+      slot = destination(target);
+      emit(vmOpcode::Move, slot, changed);
+   }
+   emit(step, changed);
+   if (changed != placeSlot(place)) storePlace(place, changed);
+   if (wantValue && isPre) {
+      slot = destination(target);
+      emit(vmOpcode::Move, slot, changed);
+   }
+   return namePos + 1;
+}
+
+
+// compile a self tail call as stores to the parameters and a jump back
+//    to the start of the procedure
+static int vmTailJump(token tokens[], int currPos, int size)
+{
+   const procedureInfo *proc = enclosingProcedure(currPos);
+   if (!proc) return -1;
+
+   // every argument is worked out before any parameter changes
+   vector<pair<size_t, int>> changed;
+   int argPos = currPos + 3;
+   for (size_t i = 0; i < proc->params.size(); i++) {
+      const paramInfo &param = proc->params[i];
+      int argEnd = skipExpression(tokens, argPos, size);
+      if (argEnd == -1) return -1;
+
+      if (argEnd != argPos || tokens[argPos].content != param.name) {
+         int slot = newSlots(param.isArray ? 2 : 1);
+         changed.push_back({i, slot});
+         if (param.isArray) {
+            vmPlace elements;
+            typeInfo type;
+            if (accessPlace(tokens, argPos, size, elements, type) == -1) return -1;
+            addressOf(elements, slot);
+            if (countValue(tokens, argPos, size, slot + 1) == -1) return -1;
+         } else {
+            int valueSlot = 0;
+            if (vmConverted(tokens, argPos, size, param.ptype, slot, valueSlot) == -1) return -1;
+         }
+      }
+      argPos = argEnd + 1;
+   }
+
+   // the locals go out of scope, but the parameters stay
+   releaseScopes(2);
+
+   for (const pair<size_t, int> &argument : changed) {
+      const vmVariable &param = vmScopes[1][argument.first];
+      if (param.type.isArray) {
+         emit(vmOpcode::Move, param.slot, argument.second);
+         emit(vmOpcode::Move, param.countSlot, argument.second + 1);
+      } else if (param.type.ttype == TokenType::TextType) {
+         emit(vmOpcode::TextStore, param.slot, argument.second);
+      } else {
+         emit(vmOpcode::Move, param.slot, argument.second);
+      }
+   }
+
+   emit(vmOpcode::Jump, tailLabel);
+   return argPos;
+}
+
+
+// compile a return statement, releasing every variable in scope on the way out
+static int vmReturn(token tokens[], int currPos, int size)
+{
+   if (tailLabel >= 0 && isSelfTailCall(tokens, currPos, size)) {
+      return vmTailJump(tokens, currPos + 1, size);
+   }
+
+   int value = newSlots(1);
+   int slot = 0;
+   int valueEnd = vmConverted(tokens, currPos + 1, size, returnType, value, slot);
+   if (valueEnd == -1) return -1;
+
+   releaseScopes(1);
+   emit(vmOpcode::Return, value);
+   return valueEnd;
+}
+
+
+// compile an if loop: its body repeats while the condition holds, tested
+//    at the bottom, and the else body runs once after it
+static int vmIfLoop(token tokens[], int currPos, int size)
+{
+   int conditionPos = currPos + 1;
+   int conditionEnd = skipExpression(tokens, conditionPos, size);
+   if (conditionEnd == -1 || conditionEnd + 1 >= size) return -1;
+
+   int top = newLabel();
+   int test = newLabel();
+
+   emit(vmOpcode::Jump, test);
+   placeLabel(top);
+   currPos = vmBody(tokens, conditionEnd + 1, size);
+   if (currPos == -1) return -1;
+
+   placeLabel(test);
+   int mark = slotTop;
+   if (vmBranch(tokens, conditionPos, size, top, true) == -1) return -1;
+   slotTop = mark;
+
+   if (currPos + 1 < size && tokens[currPos + 1].ttype == TokenType::Else) {
+      currPos = vmBody(tokens, currPos + 2, size);
+   }
+   return currPos;
+}
+
+
+// compile a statement of a body
+static int vmStatement(token tokens[], int currPos, int size)
+{
+   int slot = 0;
+
+   switch (tokens[currPos].ttype) {
+      case Call: {
+         TokenType type = valueType(tokens, currPos, size);
+         currPos = vmCall(tokens, currPos, size, slot);
+         if (currPos != -1 && type == TokenType::TextType) emit(vmOpcode::TextRelease, slot);
+         return currPos;
+      }
+      case Set:
+         return vmSet(tokens, currPos, size);
+      case Write:
+         return vmWrite(tokens, currPos, size);
+      case Read:
+         return vmRead(tokens, currPos, size);
+      case VarDef:
+         return vmLocal(tokens, currPos, size);
+      case If:
+         return vmIfLoop(tokens, currPos, size);
+      case Left:
+         if (currPos + 1 < size && isIncrementOperator(tokens[currPos + 1].ttype)) {
+            return vmIncrement(tokens, currPos, size, false, -1, slot);
+         }
+         break;
+      case Return:
+         return vmReturn(tokens, currPos, size);
+      case ArraySet:
+         return vmArraySet(tokens, currPos, size);
+      case StructElemSet:
+      case StructIndirElemSet:
+         return vmStructSet(tokens, currPos, size);
+      default:
+         break;
+   }
+
+   printError(tokens[currPos], currPos, "valid expression");
+   return -1;
+}
+
+
+// --- expressions -------------------------------------------------------------
+
+// returns the instruction converting a value from one type to another as
+//    C++ would, or OpcodeCount if the value needs no change
+static vmOpcode conversion(TokenType from, TokenType to)
+{
+   bool isInteger = (from == TokenType::IntType || from == TokenType::BoolType);
+
+   if (to == TokenType::RealType && isInteger) return vmOpcode::IntegerToReal;
+   if (to == TokenType::IntType && from == TokenType::RealType) return vmOpcode::RealToInteger;
+   if (to == TokenType::BoolType && from == TokenType::RealType) return vmOpcode::RealToBool;
+   if (to == TokenType::BoolType && from == TokenType::IntType) return vmOpcode::IntegerToBool;
+   return vmOpcode::OpcodeCount;
+}
+
+
+// leave the value of the expression at currPos, converted to the type, in a
+//    slot, put in the target if there is one, with text holding a reference
+//    of its own
+// returns the position of the last token of the expression, or -1 if malformed
+static int vmConverted(token tokens[], int currPos, int size, TokenType type, int target, int &slot)
+{
+   vmOpcode convert = conversion(valueType(tokens, currPos, size), type);
+   bool owned = false;
+   int end = vmValue(tokens, currPos, size, convert == vmOpcode::OpcodeCount ? target : -1, slot, owned);
+   if (end == -1) return -1;
+
+   if (type == TokenType::TextType && !owned) emit(vmOpcode::TextRetain, slot);
+   if (convert != vmOpcode::OpcodeCount) {
+      int d = destination(target);
+      emit(convert, d, slot);
+      slot = d;
+   }
+   return end;
+}
+
+
+// returns true if the value at currPos is an integer or boolean literal that
+//    fits an instruction as an immediate, storing its value
+static bool immediateValue(token tokens[], int currPos, int size, long &value)
+{
+   if (currPos >= size) return false;
+   if (tokens[currPos].ttype == TokenType::BoolLit) {
+      value = (tokens[currPos].content == "true") ? 1 : 0;
+      return true;
+   }
+   if (tokens[currPos].ttype != TokenType::IntLit) return false;
+   value = integerLiteral(tokens[currPos].content);
+   return fitsImmediate(value) && fitsImmediate(-value);
+}
+
+
+// jump to the label if the comparison of the integers in slots a and b gives when
+static void integerJump(TokenType op, int a, int b, int label, bool when)
+{
+   switch (op) {
+      case LTOp:
+         if (when) emit(vmOpcode::JumpIfLess, a, b, label);
+         else emit(vmOpcode::JumpIfLessEqual, b, a, label);
+         break;
+      case LEOp:
+         if (when) emit(vmOpcode::JumpIfLessEqual, a, b, label);
+         else emit(vmOpcode::JumpIfLess, b, a, label);
+         break;
+      case GTOp:
+         if (when) emit(vmOpcode::JumpIfLess, b, a, label);
+         else emit(vmOpcode::JumpIfLessEqual, a, b, label);
+         break;
+      case GEOp:
+         if (when) emit(vmOpcode::JumpIfLessEqual, b, a, label);
+         else emit(vmOpcode::JumpIfLess, a, b, label);
+         break;
+      case EQOp:
+         emit(when ? vmOpcode::JumpIfEqual : vmOpcode::JumpIfNotEqual, a, b, label);
+         break;
+      default:
+         emit(when ? vmOpcode::JumpIfNotEqual : vmOpcode::JumpIfEqual, a, b, label);
+         break;
+   }
+}
+
+
+// jump to the label if the comparison of the integer in slot a with the
+//    immediate value gives when
+static void immediateJump(TokenType op, int a, long value, int label, bool when)
+{
+   vmOpcode jump;
+   switch (op) {
+      case LTOp: jump = when ? vmOpcode::JumpIfLessInteger : vmOpcode::JumpIfGreaterEqualInteger; break;
+      case LEOp: jump = when ? vmOpcode::JumpIfLessEqualInteger : vmOpcode::JumpIfGreaterInteger; break;
+      case GTOp: jump = when ? vmOpcode::JumpIfGreaterInteger : vmOpcode::JumpIfLessEqualInteger; break;
+      case GEOp: jump = when ? vmOpcode::JumpIfGreaterEqualInteger : vmOpcode::JumpIfLessInteger; break;
+      case EQOp: jump = when ? vmOpcode::JumpIfEqualInteger : vmOpcode::JumpIfNotEqualInteger; break;
+      default: jump = when ? vmOpcode::JumpIfNotEqualInteger : vmOpcode::JumpIfEqualInteger; break;
+   }
+   emit(jump, a, (int)value, label);
+}
+
+
+// jump to the label if the comparison of the reals in slots a and b gives
+//    when, where an unordered comparison only makes ne true
+static void realJump(TokenType op, int a, int b, int label, bool when)
+{
+   switch (op) {
+      case LTOp:
+         emit(when ? vmOpcode::JumpIfRealLess : vmOpcode::JumpUnlessRealLess, a, b, label);
+         break;
+      case LEOp:
+         emit(when ? vmOpcode::JumpIfRealLessEqual : vmOpcode::JumpUnlessRealLessEqual, a, b, label);
+         break;
+      case GTOp:
+         emit(when ? vmOpcode::JumpIfRealLess : vmOpcode::JumpUnlessRealLess, b, a, label);
+         break;
+      case GEOp:
+         emit(when ? vmOpcode::JumpIfRealLessEqual : vmOpcode::JumpUnlessRealLessEqual, b, a, label);
+         break;
+      case EQOp:
+         emit(when ? vmOpcode::JumpIfRealEqual : vmOpcode::JumpIfRealNotEqual, a, b, label);
+         break;
+      default:
+         emit(when ? vmOpcode::JumpIfRealNotEqual : vmOpcode::JumpIfRealEqual, a, b, label);
+         break;
+   }
+}
+
+
+// returns the comparison that gives the same result with its sides swapped
+static TokenType mirrored(TokenType op)
+{
+   switch (op) {
+      case LTOp: return TokenType::GTOp;
+      case LEOp: return TokenType::GEOp;
+      case GTOp: return TokenType::LTOp;
+      case GEOp: return TokenType::LEOp;
+      default: return op;
+   }
+}
+
+
+// compile the comparison at currPos as a jump to the label if it gives when,
+//    comparing with an integer literal as an immediate
+// returns the position of the last token of its right side, or -1 if malformed
+static int vmComparison(token tokens[], int currPos, int size, int label, bool when)
+{
+   TokenType op = tokens[currPos + 1].ttype;
+   int leftPos = currPos + 2;
+   int rightPos = skipExpression(tokens, leftPos, size) + 1;
+   if (rightPos == 0 || rightPos >= size) return -1;
+   int rightEnd = skipExpression(tokens, rightPos, size);
+   if (rightEnd == -1) return -1;
+
+   TokenType left = valueType(tokens, leftPos, size);
+   TokenType right = valueType(tokens, rightPos, size);
+   int leftSlot = 0;
+   int rightSlot = 0;
+
+   // text is compared by the runtime, which gives its order as a sign
+   if (left == TokenType::TextType && right == TokenType::TextType) {
+      bool leftOwned = false;
+      bool rightOwned = false;
+      if (vmValue(tokens, leftPos, size, -1, leftSlot, leftOwned) == -1) return -1;
+      if (vmValue(tokens, rightPos, size, -1, rightSlot, rightOwned) == -1) return -1;
+      int order = newSlots(1);
+      emit(vmOpcode::TextCompare, order, leftSlot, rightSlot, (leftOwned ? 1 : 0) | (rightOwned ? 2 : 0));
+      immediateJump(op, order, 0, label, when);
+      return rightEnd;
+   }
+
+   if (left == TokenType::RealType || right == TokenType::RealType) {
+      if (vmConverted(tokens, leftPos, size, TokenType::RealType, -1, leftSlot) == -1) return -1;
+      if (vmConverted(tokens, rightPos, size, TokenType::RealType, -1, rightSlot) == -1) return -1;
+      realJump(op, leftSlot, rightSlot, label, when);
+      return rightEnd;
+   }
+
+   long value = 0;
+   if (immediateValue(tokens, rightPos, size, value)) {
+      if (vmConverted(tokens, leftPos, size, TokenType::IntType, -1, leftSlot) == -1) return -1;
+      immediateJump(op, leftSlot, value, label, when);
+   } else if (immediateValue(tokens, leftPos, size, value)) {
+      if (vmConverted(tokens, rightPos, size, TokenType::IntType, -1, rightSlot) == -1) return -1;
+      immediateJump(mirrored(op), rightSlot, value, label, when);
+   } else {
+      if (vmConverted(tokens, leftPos, size, TokenType::IntType, -1, leftSlot) == -1) return -1;
+      if (vmConverted(tokens, rightPos, size, TokenType::IntType, -1, rightSlot) == -1) return -1;
+      integerJump(op, leftSlot, rightSlot, label, when);
+   }
+   return rightEnd;
+}
+
+
+// compile the conditional expression at currPos as a jump to the label if it
+//    gives when, falling through otherwise; and and or only work out their
+//    right side if the left does not decide
+// returns the position of its right bracket, or -1 if malformed
+static int vmBranch(token tokens[], int currPos, int size, int label, bool when)
+{
+   if (currPos + 2 >= size || tokens[currPos].ttype != TokenType::Left) {
+      printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Left));
+      return -1;
+   }
+
+   const token &inner = tokens[currPos + 1];
+   int end = currPos + 1;
+
+   if (inner.ttype == TokenType::BoolLit) {
+      if ((inner.content == "true") == when) emit(vmOpcode::Jump, label);
+   } else if (inner.ttype == TokenType::Identifier) {
+      const vmVariable *variable = findVariable(inner.content);
+      if (!variable || variable->type.isArray) {
+         printError(inner, currPos + 1, "Boolean variable");
+         return -1;
+      }
+      int slot = placeSlot(variablePlace(*variable));
+      if (slot < 0) {
+         slot = newSlots(1);
+         loadPlace(variablePlace(*variable), slot);
+      }
+      if (variable->type.ttype == TokenType::RealType) {
+         int zero = newSlots(1);
+         setReal(zero, 0.0);
+         realJump(TokenType::NEOp, slot, zero, label, when);
+      } else {
+         emit(when ? vmOpcode::JumpIfTrue : vmOpcode::JumpIfFalse, slot, label);
+      }
+   } else if (inner.ttype == TokenType::NotOp) {
+      end = vmBranch(tokens, currPos + 2, size, label, !when);
+   } else if (inner.ttype == TokenType::AndOp || inner.ttype == TokenType::OrOp) {
+      // the left side decides an and when false, and an or when true
+      bool decides = (inner.ttype == TokenType::OrOp);
+      int leftEnd;
+      if (when == decides) {
+         leftEnd = vmBranch(tokens, currPos + 2, size, label, when);
+         end = (leftEnd == -1) ? -1 : vmBranch(tokens, leftEnd + 1, size, label, when);
+      } else {
+         int skip = newLabel();
+         leftEnd = vmBranch(tokens, currPos + 2, size, skip, decides);
+         end = (leftEnd == -1) ? -1 : vmBranch(tokens, leftEnd + 1, size, label, when);
+         placeLabel(skip);
+      }
+   } else if (isCondOperator(inner.ttype)) {
+      end = vmComparison(tokens, currPos, size, label, when);
+   } else {
+      printError(inner, currPos + 1, "Conditional operator");
+      return -1;
+   }
+
+   if (end == -1) return -1;
+   if (end + 1 >= size || tokens[end + 1].ttype != TokenType::Right) {
+      printError(tokens[end + 1], end + 1, tokenTypeToString(TokenType::Right));
+      return -1;
+   }
+   return end + 1;
+}
+
+
+// compile a procedure call, working out its arguments in order into the slots
+//    that start its frame: arrays as a pointer and their number of elements,
+//    structs as a pointer, and text with a reference the procedure releases;
+//    its result is left in the first of them, stored as slot
+static int vmCall(token tokens[], int currPos, int size, int &slot)
+{
+   if (currPos + 2 >= size || tokens[currPos + 2].ttype != TokenType::Left) return -1;
+
+   const procedureInfo *proc = findProcedure(tokens[currPos + 1].content);
+   if (!proc) {
+      printError(tokens[currPos + 1], currPos + 1, "Procedure name");
+      return -1;
+   }
+
+   int slots = 0;
+   for (const paramInfo &param : proc->params) slots += param.isArray ? 2 : 1;
+   int base = newSlots(std::max(slots, 1));
+   int argument = base;
+
+   int argPos = currPos + 3;
+   for (const paramInfo &param : proc->params) {
+      if (argPos >= size || tokens[argPos].ttype == TokenType::Right) {
+         printError(tokens[argPos], argPos, "Argument for " + param.name);
+         return -1;
+      }
+
+      int mark = slotTop;
+      int argEnd;
+      if (param.isArray || !param.structType.empty()) {
+         vmPlace place;
+         typeInfo type;
+         argEnd = accessPlace(tokens, argPos, size, place, type);
+         if (argEnd == -1) return -1;
+         if (type.isArray != param.isArray) {
+            printError(tokens[argPos], argPos, param.isArray ? "Array" : "Struct");
+            return -1;
+         }
+         addressOf(place, argument++);
+         if (param.isArray && countValue(tokens, argPos, size, argument++) == -1) return -1;
+      } else {
+         int valueSlot = 0;
+         argEnd = vmConverted(tokens, argPos, size, param.ptype, argument++, valueSlot);
+         if (argEnd == -1) return -1;
+      }
+      slotTop = mark;
+      argPos = argEnd + 1;
+   }
+
+   if (argPos >= size || tokens[argPos].ttype != TokenType::Right) {
+      printError(tokens[argPos], argPos, tokenTypeToString(TokenType::Right));
+      return -1;
+   }
+
+   calls.push_back({code.size(), proc->name});
+   emit(vmOpcode::Call, procedureLabel(proc->name), base, 0);
+   slotTop = base + 1;
+   slot = base;
+   return argPos;
+}
+
+
+// returns true if the access at currPos is an integer array element that a
+//    superinstruction can add straight from where it is, storing its place
+static bool indexedAddend(token tokens[], int currPos, int size, vmPlace &place)
+{
+   if (currPos >= size || tokens[currPos].ttype != TokenType::ArrayAccess
+      || valueType(tokens, currPos, size) != TokenType::IntType) {
+      return false;
+   }
+   typeInfo type;
+   if (accessPlace(tokens, currPos, size, place, type) == -1) return false;
+   if (place.index < 0 || (place.storage == ThroughSlot && place.offset != 0)) {
+      int slot = newSlots(1);
+      loadPlace(place, slot);
+      place = {InSlots, slot, 0, -1};
+      return false;
+   }
+   return true;
+}
+
+
+// compile arithmetic on the two sides of the operation at currPos, adding
+//    an integer literal as an immediate, and an array element with the
+//    superinstruction that loads it
+static int vmArithmetic(token tokens[], int currPos, int size, int target, int &slot, bool &owned)
+{
+   TokenType op = tokens[currPos + 1].ttype;
+   TokenType result = valueType(tokens, currPos, size);
+   int leftPos = currPos + 2;
+   int rightPos = skipExpression(tokens, leftPos, size) + 1;
+   if (rightPos == 0 || rightPos >= size) return -1;
+   int rightEnd = skipExpression(tokens, rightPos, size);
+   if (rightEnd == -1) return -1;
+   int leftSlot = 0;
+   int rightSlot = 0;
+
+   // text is joined by the runtime, in place if the left side is its own
+   if (result == TokenType::TextType) {
+      if (op != TokenType::Add) {
+         printError(tokens[currPos + 1], currPos + 1, "Text operator");
+         return -1;
+      }
+      bool leftOwned = false;
+      bool rightOwned = false;
+      if (vmValue(tokens, leftPos, size, -1, leftSlot, leftOwned) == -1) return -1;
+      if (vmValue(tokens, rightPos, size, -1, rightSlot, rightOwned) == -1) return -1;
+      slot = destination(target);
+      emit(vmOpcode::TextConcat, slot, leftSlot, rightSlot, (leftOwned ? 1 : 0) | (rightOwned ? 2 : 0));
+      owned = true;
+      return rightEnd;
+   }
+
+   if (result == TokenType::RealType) {
+      vmOpcode instruction = (op == TokenType::Add) ? vmOpcode::RealAdd : (op == TokenType::Sub) ? vmOpcode::RealSubtract
+         : (op == TokenType::Mul) ? vmOpcode::RealMultiply : vmOpcode::RealDivide;
+      if (vmConverted(tokens, leftPos, size, TokenType::RealType, -1, leftSlot) == -1) return -1;
+      if (vmConverted(tokens, rightPos, size, TokenType::RealType, -1, rightSlot) == -1) return -1;
+      slot = destination(target);
+      emit(instruction, slot, leftSlot, rightSlot);
+      return rightEnd;
+   }
+
+   long value = 0;
+   if (op == TokenType::Add || op == TokenType::Sub) {
+      // a literal is added as an immediate, on either side of an addition
+      int otherPos = -1;
+      if (immediateValue(tokens, rightPos, size, value)) {
+         otherPos = leftPos;
+         if (op == TokenType::Sub) value = -value;
+      } else if (op == TokenType::Add && immediateValue(tokens, leftPos, size, value)) {
+         otherPos = rightPos;
+      }
+      if (otherPos != -1) {
+         if (vmConverted(tokens, otherPos, size, TokenType::IntType, -1, leftSlot) == -1) return -1;
+         slot = destination(target);
+         emit(vmOpcode::AddInteger, slot, leftSlot, (int)value);
+         return rightEnd;
+      }
+   }
+
+   if (op == TokenType::Add) {
+      if (vmConverted(tokens, leftPos, size, TokenType::IntType, -1, leftSlot) == -1) return -1;
+      vmPlace place;
+      if (indexedAddend(tokens, rightPos, size, place)) {
+         slot = destination(target);
+         int at = place.slot + (int)place.offset;
+         if (place.storage == InSlots) {
+            emit(vmOpcode::AddFrameIndexed, slot, leftSlot, at, place.index);
+         } else if (place.storage == InGlobals) {
+            emit(vmOpcode::AddGlobalIndexed, slot, leftSlot, at, place.index);
+         } else {
+            emit(vmOpcode::AddIndexed, slot, leftSlot, place.slot, place.index);
+         }
+         return rightEnd;
+      }
+      if (place.index < 0 && tokens[rightPos].ttype == TokenType::ArrayAccess && place.storage == InSlots) {
+         rightSlot = place.slot;
+      } else if (vmConverted(tokens, rightPos, size, TokenType::IntType, -1, rightSlot) == -1) {
+         return -1;
+      }
+      slot = destination(target);
+      emit(vmOpcode::Add, slot, leftSlot, rightSlot);
+      return rightEnd;
+   }
+
+   if (vmConverted(tokens, leftPos, size, TokenType::IntType, -1, leftSlot) == -1) return -1;
+   if (vmConverted(tokens, rightPos, size, TokenType::IntType, -1, rightSlot) == -1) return -1;
+   vmOpcode instruction = (op == TokenType::Sub) ? vmOpcode::Subtract : (op == TokenType::Mul) ? vmOpcode::Multiply
+      : (op == TokenType::Div) ? vmOpcode::Divide : vmOpcode::Remainder;
+   slot = destination(target);
+   emit(instruction, slot, leftSlot, rightSlot);
+   return rightEnd;
+}
+
+
+// compile a bracketed operation: an increment, a condition worked out as
+//    a boolean, a negation or arithmetic
+static int vmOperation(token tokens[], int currPos, int size, int target, int &slot, bool &owned)
+{
+   if (currPos + 2 >= size) return -1;
+   TokenType op = tokens[currPos + 1].ttype;
+
+   if (isIncrementOperator(op)) return vmIncrement(tokens, currPos, size, true, target, slot);
+
+   if (isCondOperator(op)) {
+      int isFalse = newLabel();
+      int done = newLabel();
+      slot = destination(target);
+      int end = vmBranch(tokens, currPos, size, isFalse, false);
+      if (end == -1) return -1;
+      emit(vmOpcode::SetInteger, slot, 1);
+      emit(vmOpcode::Jump, done);
+      placeLabel(isFalse);
+      emit(vmOpcode::SetInteger, slot, 0);
+      placeLabel(done);
+      return end;
+   }
+
+   int end;
+   if (op == TokenType::Negate) {
+      bool isReal = (valueType(tokens, currPos + 2, size) == TokenType::RealType);
+      int valueSlot = 0;
+      end = vmConverted(tokens, currPos + 2, size, isReal ? TokenType::RealType : TokenType::IntType, -1, valueSlot);
+      slot = destination(target);
+      emit(isReal ? vmOpcode::RealNegate : vmOpcode::Negate, slot, valueSlot);
+   } else if (isBinaryOperator(op)) {
+      end = vmArithmetic(tokens, currPos, size, target, slot, owned);
+   } else {
+      printError(tokens[currPos + 1], currPos + 1, "Expression operator");
+      return -1;
+   }
+
+   if (end == -1) return -1;
+   if (end + 1 >= size || tokens[end + 1].ttype != TokenType::Right) {
+      printError(tokens[end + 1], end + 1, tokenTypeToString(TokenType::Right));
+      return -1;
+   }
+   return end + 1;
+}
+
+
+// leave the value of the expression at currPos in a slot, put in the target
+//    if there is one, and the address of a struct or array; a variable kept
+//    in a slot is used where it is when there is no target; owned is set if
+//    text left holds a reference of its own, rather than one of a variable
+//    or literal
+// returns the position of the last token of the expression, or -1 if malformed
+static int vmValue(token tokens[], int currPos, int size, int target, int &slot, bool &owned)
+{
+   owned = false;
+   if (currPos >= size) return -1;
+   const token &tok = tokens[currPos];
+
+   switch (tok.ttype) {
+      case IntLit:
+         slot = destination(target);
+         setWord(slot, integerLiteral(tok.content));
+         return currPos;
+      case BoolLit:
+         slot = destination(target);
+         emit(vmOpcode::SetInteger, slot, tok.content == "true" ? 1 : 0);
+         return currPos;
+      case RealLit:
+         slot = destination(target);
+         setReal(slot, strtod(tok.content.c_str(), nullptr));
+         return currPos;
+      case TextLit:
+         slot = destination(target);
+         emit(vmOpcode::SetText, slot, textLiteral(literalCharacters(tok.content)));
+         return currPos;
+      case ArraySize:
+         slot = countValue(tokens, currPos + 1, size, target);
+         if (slot == -1) return -1;
+         return skipExpression(tokens, currPos + 1, size);
+      case Identifier:
+      case ArrayAccess:
+      case StructElemAccess:
+      case StructIndirElemAccess: {
+         vmPlace place;
+         typeInfo type;
+         int end = accessPlace(tokens, currPos, size, place, type);
+         if (end == -1) return -1;
+         if (type.isArray || type.ttype == TokenType::StructType) {
+            slot = addressOf(place, target);
+         } else if (placeSlot(place) >= 0) {
+            slot = placeSlot(place);
+            moveTo(target, slot);
+         } else {
+            slot = destination(target);
+            loadPlace(place, slot);
+         }
+         return end;
+      }
+      case Call: {
+         owned = (valueType(tokens, currPos, size) == TokenType::TextType);
+         int end = vmCall(tokens, currPos, size, slot);
+         moveTo(target, slot);
+         return end;
+      }
+      case Left:
+         return vmOperation(tokens, currPos, size, target, slot, owned);
+      default:
+         break;
+   }
+
+   printError(tok, currPos, "Variable name, literal value, or expression");
+   return -1;
+}
+
+
+// --- laying out the image ---------------------------------------------------
+
+// turn an increment followed by a test of the variable against a limit, as
+//    counted loops end, into a superinstruction that does both; the test is
+//    kept after it, as the loop's first pass jumps to it
+static void combineInstructions()
+{
+   for (size_t i = 0; i + 1 < code.size(); i++) {
+      const vmInstruction &step = code[i];
+      const vmInstruction &test = code[i + 1];
+      if (step.op != vmOpcode::Increment || test.operands[0] != step.operands[0]) continue;
+
+      if (test.op == vmOpcode::JumpIfLessInteger) {
+         code[i] = {vmOpcode::IncrementJumpIfLessInteger, {test.operands[0], test.operands[1], test.operands[2], 0}};
+      } else if (test.op == vmOpcode::JumpIfLess && test.operands[1] != step.operands[0]) {
+         code[i] = {vmOpcode::IncrementJumpIfLess, {test.operands[0], test.operands[1], test.operands[2], 0}};
+      }
+   }
+}
+
+
+// returns the image: its header, the data, and the code with its labels
+//    turned into words of the code and its calls given the frame sizes of
+//    the procedures they call
+static string layOut(int mainLabel)
+{
+   combineInstructions();
+
+   for (const pair<size_t, string> &call : calls) code[call.first].operands[2] = procedureFrames[call.second];
+
+   vector<int> words(code.size() + 1, 0);
+   for (size_t i = 0; i < code.size(); i++) words[i + 1] = words[i] + 1 + OperandCounts[(int)code[i].op];
+
+   vector<int> program;
+   program.reserve(words.back());
+   for (const vmInstruction &instruction : code) {
+      program.push_back((int)instruction.op);
+      for (int i = 0; i < OperandCounts[(int)instruction.op]; i++) {
+         int operand = instruction.operands[i];
+         if (i == TargetOperands[(int)instruction.op]) operand = words[labelPositions[operand]];
+         program.push_back(operand);
+      }
+   }
+
+   vmHeader header;
+   memcpy(header.magic, BytecodeMagic, sizeof(header.magic));
+   header.codeOffset = (long)(sizeof(vmHeader) + data.size());
+   header.codeWords = (long)program.size();
+   header.imageBytes = header.codeOffset + header.codeWords * (long)sizeof(int);
+   header.globalWords = globalWords;
+   header.mainEntry = words[labelPositions[mainLabel]];
+   header.mainFrame = procedureFrames["main"];
+
+   string image((const char *)&header, sizeof(header));
+   image += data;
+   image.append((const char *)program.data(), program.size() * sizeof(int));
+   return image;
+}
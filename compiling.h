@@ -0,0 +1,10 @@
+#pragma once
+
+#include "tokenizing.h"
+
+
+// translate the token sequence to the bytecode described in bytecode.h,
+//    storing the image that --exec runs in image,
+// with any error messages directed to standard error
+// returns false if the program is malformed
+bool compileBytecode(token tokens[], int size, string &image);
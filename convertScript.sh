@@ -1,8 +1,8 @@
 #!/bin/bash
 
-# Confirm that exactly one argument was passed
-if [ "$#" -ne 1 ]; then
-    echo "Usage: $0 <path-to-file-with-or-without-extension>"
+# Confirm that a file was passed, followed by any translator options
+if [ "$#" -lt 1 ]; then
+    echo "Usage: $0 <path-to-file-with-or-without-extension> [translator options]"
     exit 1
 fi
 
@@ -12,6 +12,7 @@ CURRENT_DIR="$(pwd)"
 # Extract the file's base name without the extension/filepath
 INPUT_PATH="$1"
 BASENAME="$(basename "$INPUT_PATH" .vurb)"
+shift
 
 # Set up output directories
 CPP_DIR="${CURRENT_DIR}/cppFiles"
@@ -25,11 +26,59 @@ mkdir -p "$EXE_DIR"
 CPP_FILE="${CPP_DIR}/${BASENAME}.cpp"
 EXE_FILE="${EXE_DIR}/${BASENAME}x"
 
+# Loops translated to run in parallel need OpenMP, and programs using the
+# lean runtime need nothing from the C++ library, so can be linked without it
+CXX_FLAGS=""
+for OPTION in "$@"; do
+    if [ "$OPTION" = "--parallel" ] || [ "$OPTION" = "--parallel-min" ]; then
+        CXX_FLAGS="${CXX_FLAGS} -fopenmp"
+    elif [ "$OPTION" = "--lean-runtime" ] || [ "$OPTION" = "--text-arena" ]; then
+        CXX_FLAGS="${CXX_FLAGS} -fno-exceptions -Wl,--as-needed"
+    fi
+done
+
+# Programs translated to assembly are assembled and linked with their own
+# runtime, without the C++ compiler
+for OPTION in "$@"; do
+    if [ "$OPTION" = "--asm" ]; then
+        ASM_FILE="${CPP_DIR}/${BASENAME}.s"
+        ./VaaToCpp "$@" < "${INPUT_PATH}" > "${ASM_FILE}" \
+            && as "${ASM_FILE}" -o "${CPP_DIR}/${BASENAME}.o" \
+            && ld "${CPP_DIR}/${BASENAME}.o" "${CURRENT_DIR}/asmruntime.o" -o "${EXE_FILE}"
+        if [ $? -eq 0 ]; then
+            echo "Assembly was successful!"
+            echo "Assembly file: ${ASM_FILE}"
+            echo "Executable: ${EXE_FILE}"
+        else
+            echo "Assembly failed."
+            exit 1
+        fi
+        exit 0
+    fi
+done
+
+# Programs compiled to bytecode need nothing built; the bytecode is run
+# with ./VaaToCpp --exec
+for OPTION in "$@"; do
+    if [ "$OPTION" = "--bytecode" ]; then
+        BYTECODE_FILE="${EXE_DIR}/${BASENAME}.vurbc"
+        if ./VaaToCpp "$@" < "${INPUT_PATH}" > "${BYTECODE_FILE}"; then
+            echo "Compilation to bytecode was successful!"
+            echo "Bytecode: ${BYTECODE_FILE}"
+            echo "Run it with: ./VaaToCpp --exec ${BYTECODE_FILE}"
+        else
+            echo "Compilation to bytecode failed."
+            exit 1
+        fi
+        exit 0
+    fi
+done
+
 # Convert VurbAddAdd to C++
-./VaaToCpp < "${INPUT_PATH}" > "${CPP_FILE}"
+./VaaToCpp "$@" < "${INPUT_PATH}" > "${CPP_FILE}"
 
 # Compile the C++ file
-g++ "${CPP_FILE}" -o "${EXE_FILE}"
+g++ ${CXX_FLAGS} "${CPP_FILE}" -o "${EXE_FILE}"
 
 # Check if compilation was successful
 if [ $? -eq 0 ]; then
@@ -0,0 +1,382 @@
+
+	.section .rodata
+	.balign 8
+vurb_texts_Creature:
+	.quad 1, 0
+
+	.text
+	.p2align 4
+	.globl initCreature
+	.type initCreature, @function
+initCreature:
+	push %rbp
+	mov %rsp, %rbp
+	sub $.L0_frame, %rsp
+	lea .L1(%rip), %rax
+	test %rax, %rax
+	jz 1f
+	incq (%rax)
+1:
+	mov 16(%rbp), %rdx
+	mov (%rdx), %rdi
+	mov %rax, (%rdx)
+	call vurb_textRelease
+	mov $100, %rax
+	mov 16(%rbp), %rdx
+	mov %rax, 8(%rdx)
+	mov $50, %rax
+	mov 16(%rbp), %rdx
+	mov %rax, 16(%rdx)
+.L0:
+	leave
+	ret
+	.set .L0_frame, 0
+	.size initCreature, .-initCreature
+
+	.text
+	.p2align 4
+	.globl damageCreature
+	.type damageCreature, @function
+damageCreature:
+	push %rbp
+	mov %rsp, %rbp
+	push %rbx
+	sub $.L2_frame, %rsp
+	xor %rbx, %rbx
+	mov 24(%rbp), %rdx
+	mov 16(%rdx), %rax
+	mov %rax, %rbx
+	mov 16(%rbp), %rdx
+	mov 8(%rdx), %rax
+	sub %rbx, %rax
+	mov 16(%rbp), %rdx
+	mov %rax, 8(%rdx)
+.L2:
+	lea -8(%rbp), %rsp
+	pop %rbx
+	pop %rbp
+	ret
+	.set .L2_frame, 8
+	.size damageCreature, .-damageCreature
+
+	.text
+	.p2align 4
+	.globl healCreature
+	.type healCreature, @function
+healCreature:
+	push %rbp
+	mov %rsp, %rbp
+	push %rbx
+	sub $.L3_frame, %rsp
+	xor %rbx, %rbx
+	mov 16(%rbp), %rdx
+	mov 16(%rdx), %rax
+	mov $2, %rcx
+	cqo
+	idivq %rcx
+	mov %rax, %rbx
+	mov 16(%rbp), %rdx
+	mov 8(%rdx), %rax
+	add %rbx, %rax
+	mov 16(%rbp), %rdx
+	mov %rax, 8(%rdx)
+.L3:
+	lea -8(%rbp), %rsp
+	pop %rbx
+	pop %rbp
+	ret
+	.set .L3_frame, 8
+	.size healCreature, .-healCreature
+
+	.text
+	.p2align 4
+	.globl printCreature
+	.type printCreature, @function
+printCreature:
+	push %rbp
+	mov %rsp, %rbp
+	sub $.L4_frame, %rsp
+	lea .L5(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	mov 16(%rbp), %rdx
+	mov (%rdx), %rax
+	mov %rax, %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	lea .L6(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	mov 16(%rbp), %rdx
+	mov 8(%rdx), %rax
+	mov %rax, %rdi
+	call vurb_writeInteger
+	lea .L7(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	mov 16(%rbp), %rdx
+	mov 16(%rdx), %rax
+	mov %rax, %rdi
+	call vurb_writeInteger
+.L4:
+	leave
+	ret
+	.set .L4_frame, 0
+	.size printCreature, .-printCreature
+
+	.text
+	.p2align 4
+	.globl powerUpCreature
+	.type powerUpCreature, @function
+powerUpCreature:
+	push %rbp
+	mov %rsp, %rbp
+	push %rbx
+	sub $.L8_frame, %rsp
+	xor %rbx, %rbx
+	mov $20, %rbx
+	mov 16(%rbp), %rdx
+	mov 16(%rdx), %rax
+	add %rbx, %rax
+	mov 16(%rbp), %rdx
+	mov %rax, 16(%rdx)
+.L8:
+	lea -8(%rbp), %rsp
+	pop %rbx
+	pop %rbp
+	ret
+	.set .L8_frame, 8
+	.size powerUpCreature, .-powerUpCreature
+
+	.text
+	.p2align 4
+	.globl vurb_main
+	.type vurb_main, @function
+vurb_main:
+	push %rbp
+	mov %rsp, %rbp
+	sub $.L9_frame, %rsp
+	movq $0, -24(%rbp)
+	movq $0, -16(%rbp)
+	movq $0, -8(%rbp)
+	movq $0, -48(%rbp)
+	movq $0, -40(%rbp)
+	movq $0, -32(%rbp)
+	sub $8, %rsp
+	lea -24(%rbp), %rax
+	push %rax
+	call initCreature
+	add $16, %rsp
+	sub $8, %rsp
+	lea -48(%rbp), %rax
+	push %rax
+	call initCreature
+	add $16, %rsp
+	lea .L10(%rip), %rax
+	test %rax, %rax
+	jz 1f
+	incq (%rax)
+1:
+	mov -24(%rbp), %rdi
+	mov %rax, -24(%rbp)
+	call vurb_textRelease
+	lea .L11(%rip), %rax
+	test %rax, %rax
+	jz 1f
+	incq (%rax)
+1:
+	mov -48(%rbp), %rdi
+	mov %rax, -48(%rbp)
+	call vurb_textRelease
+	lea .L12(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	sub $8, %rsp
+	lea -24(%rbp), %rax
+	push %rax
+	call printCreature
+	add $16, %rsp
+	lea .L13(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	sub $8, %rsp
+	lea -48(%rbp), %rax
+	push %rax
+	call printCreature
+	add $16, %rsp
+	lea .L14(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	mov -24(%rbp), %rax
+	push %rax
+	lea .L15(%rip), %rax
+	mov %rax, %rsi
+	pop %rdi
+	mov $0, %edx
+	call vurb_textConcat
+	push %rax
+	mov -48(%rbp), %rax
+	mov %rax, %rsi
+	pop %rdi
+	mov $1, %edx
+	call vurb_textConcat
+	mov %rax, %rdi
+	mov $1, %esi
+	call vurb_writeText
+	lea -48(%rbp), %rax
+	push %rax
+	lea -24(%rbp), %rax
+	push %rax
+	call damageCreature
+	add $16, %rsp
+	lea .L16(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	sub $8, %rsp
+	lea -24(%rbp), %rax
+	push %rax
+	call printCreature
+	add $16, %rsp
+	lea .L14(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	mov -24(%rbp), %rax
+	push %rax
+	lea .L17(%rip), %rax
+	mov %rax, %rsi
+	pop %rdi
+	mov $0, %edx
+	call vurb_textConcat
+	mov %rax, %rdi
+	mov $1, %esi
+	call vurb_writeText
+	sub $8, %rsp
+	lea -24(%rbp), %rax
+	push %rax
+	call healCreature
+	add $16, %rsp
+	mov -24(%rbp), %rax
+	push %rax
+	lea .L18(%rip), %rax
+	mov %rax, %rsi
+	pop %rdi
+	mov $0, %edx
+	call vurb_textConcat
+	mov %rax, %rdi
+	mov $1, %esi
+	call vurb_writeText
+	sub $8, %rsp
+	lea -24(%rbp), %rax
+	push %rax
+	call powerUpCreature
+	add $16, %rsp
+	lea .L16(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	sub $8, %rsp
+	lea -24(%rbp), %rax
+	push %rax
+	call printCreature
+	add $16, %rsp
+	lea .L14(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	mov -48(%rbp), %rax
+	push %rax
+	lea .L19(%rip), %rax
+	mov %rax, %rsi
+	pop %rdi
+	mov $0, %edx
+	call vurb_textConcat
+	mov %rax, %rdi
+	mov $1, %esi
+	call vurb_writeText
+	lea -24(%rbp), %rax
+	push %rax
+	lea -48(%rbp), %rax
+	push %rax
+	call damageCreature
+	add $16, %rsp
+	lea .L20(%rip), %rdi
+	xor %esi, %esi
+	call vurb_writeText
+	sub $8, %rsp
+	lea -48(%rbp), %rax
+	push %rax
+	call printCreature
+	add $16, %rsp
+	lea -48(%rbp), %rdi
+	lea vurb_texts_Creature(%rip), %rsi
+	call vurb_structRelease
+	lea -24(%rbp), %rdi
+	lea vurb_texts_Creature(%rip), %rsi
+	call vurb_structRelease
+	xor %eax, %eax
+.L9:
+	leave
+	ret
+	.set .L9_frame, 48
+	.size vurb_main, .-vurb_main
+
+	.data
+	.balign 8
+.L14:
+	.quad 4611686018427387904, 0, 0
+	.balign 8
+.L13:
+	.quad 4611686018427387904, 12, 12
+	.ascii "\012Enemy Info:"
+	.balign 8
+.L20:
+	.quad 4611686018427387904, 20, 20
+	.ascii "\012Updated Enemy Info:"
+	.balign 8
+.L16:
+	.quad 4611686018427387904, 21, 21
+	.ascii "\012Updated Player Info:"
+	.balign 8
+.L17:
+	.quad 4611686018427387904, 7, 7
+	.ascii " heals!"
+	.balign 8
+.L15:
+	.quad 4611686018427387904, 16, 16
+	.ascii " is attacked by "
+	.balign 8
+.L19:
+	.quad 4611686018427387904, 27, 27
+	.ascii " is blasted by the grenade!"
+	.balign 8
+.L18:
+	.quad 4611686018427387904, 29, 29
+	.ascii " pulls out holy hand grenade!"
+	.balign 8
+.L7:
+	.quad 4611686018427387904, 8, 8
+	.ascii "Energy: "
+	.balign 8
+.L6:
+	.quad 4611686018427387904, 4, 4
+	.ascii "HP: "
+	.balign 8
+.L11:
+	.quad 4611686018427387904, 13, 13
+	.ascii "Killer Rabbit"
+	.balign 8
+.L5:
+	.quad 4611686018427387904, 6, 6
+	.ascii "Name: "
+	.balign 8
+.L12:
+	.quad 4611686018427387904, 12, 12
+	.ascii "Player Info:"
+	.balign 8
+.L10:
+	.quad 4611686018427387904, 17, 17
+	.ascii "Tim the Enchanter"
+	.balign 8
+.L1:
+	.quad 4611686018427387904, 7, 7
+	.ascii "Unnamed"
+
+	.section .note.GNU-stack,"",@progbits
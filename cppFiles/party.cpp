@@ -0,0 +1,192 @@
+#include <iostream>
+#include <string>
+#include <utility>
+using namespace std;
+#include <cfloat>
+#include <charconv>
+#include <climits>
+#include <cstdlib>
+
+inline char *vurb_formatInteger(char *digits, long value) {
+   return to_chars(digits, digits + 24, value).ptr;
+}
+
+inline char *vurb_formatReal(char *digits, double value) {
+   return to_chars(digits, digits + 32, value, chars_format::general, 6).ptr;
+}
+
+// skip a plus sign that cin would accept but from_chars does not
+inline const char *vurb_skipPlus(const char *first, const char *last) {
+   if (last - first > 1 && *first == '+' && *(first + 1) != '-') return first + 1;
+   return first;
+}
+
+inline bool vurb_parseInteger(const char *&next, const char *last, long &value) {
+   const char *first = vurb_skipPlus(next, last);
+   from_chars_result result = from_chars(first, last, value);
+   if (result.ec == errc::invalid_argument) {
+      value = 0;
+      return false;
+   }
+   next = result.ptr;
+   if (result.ec == errc::result_out_of_range) {
+      value = (*first == '-') ? LONG_MIN : LONG_MAX;
+      return false;
+   }
+   return true;
+}
+
+inline bool vurb_parseReal(const char *&next, const char *last, double &value) {
+   const char *first = vurb_skipPlus(next, last);
+   // cin only reads reals written out in digits, not inf or nan,
+   //    and gives up on an exponent without digits
+   const char *digits = (first < last && *first == '-') ? first + 1 : first;
+   from_chars_result result = from_chars(first, last, value);
+   if (digits == last || !((*digits >= '0' && *digits <= '9') || *digits == '.')
+      || (result.ptr < last && (*result.ptr == 'e' || *result.ptr == 'E'))
+      || result.ec == errc::invalid_argument) {
+      value = 0;
+      return false;
+   }
+   next = result.ptr;
+   if (result.ec == errc::result_out_of_range) {
+      // too small reals become zero, too large ones fail at the largest real
+      value = strtod(string(first, result.ptr).c_str(), nullptr);
+      if (value > DBL_MAX || value < -DBL_MAX) {
+         value = (value > 0) ? DBL_MAX : -DBL_MAX;
+         return false;
+      }
+   }
+   return true;
+}
+#include <cstring>
+#include <unistd.h>
+
+struct vurb_Output {
+   char buffer[1 << 16];
+   size_t used = 0;
+
+   ~vurb_Output() { flush(); }
+
+   void send(const char *text, size_t length) {
+      while (length > 0) {
+         ssize_t count = ::write(1, text, length);
+         if (count <= 0) return;
+         text += count;
+         length -= count;
+      }
+   }
+
+   void flush() {
+      send(buffer, used);
+      used = 0;
+   }
+
+   void put(const char *text, size_t length) {
+      if (length > sizeof(buffer) - used) {
+         flush();
+         if (length > sizeof(buffer)) {
+            send(text, length);
+            return;
+         }
+      }
+      memcpy(buffer + used, text, length);
+      used += length;
+   }
+
+   vurb_Output &operator<<(char c) {
+      if (used == sizeof(buffer)) flush();
+      buffer[used++] = c;
+      return *this;
+   }
+
+   vurb_Output &operator<<(const char *text) {
+      put(text, strlen(text));
+      return *this;
+   }
+
+   vurb_Output &operator<<(const string &text) {
+      put(text.data(), text.size());
+      return *this;
+   }
+
+   vurb_Output &operator<<(bool value) { return *this << (value ? '1' : '0'); }
+
+   vurb_Output &operator<<(int value) { return *this << (long)value; }
+
+   vurb_Output &operator<<(long value) {
+      char digits[24];
+      put(digits, vurb_formatInteger(digits, value) - digits);
+      return *this;
+   }
+
+   vurb_Output &operator<<(double value) {
+      char digits[32];
+      put(digits, vurb_formatReal(digits, value) - digits);
+      return *this;
+   }
+} vurb_out;
+
+struct Character
+{
+   string name;
+   string charClass;
+   long level;
+   long health;
+   string inventory[3];
+};
+
+struct Party
+{
+   Character member1;
+   Character member2;
+   Character member3;
+};
+
+
+void initCharacter(Character &c, string itemOne, string itemTwo, string itemThree)
+{
+   c.level = 1;
+   c.health = 100;
+   c.inventory[0] = itemOne;
+   c.inventory[1] = itemTwo;
+   c.inventory[2] = itemThree;
+}
+
+void printCharacter(Character &c)
+{
+   vurb_out << "Name: \n" << c.name
+      << "\nClass: \n" << c.charClass
+      << "\nLevel: \n" << c.level
+      << "\nHealth: \n" << c.health
+      << "\nItem 1: \n" << c.inventory[0]
+      << "\nItem 2: \n" << c.inventory[1]
+      << "\nItem 3: \n" << c.inventory[2] << '\n';
+}
+
+void printParty(Party &p)
+{
+   printCharacter(p.member1);
+   vurb_out << "" << '\n';
+   printCharacter(p.member2);
+   vurb_out << "" << '\n';
+   printCharacter(p.member3);
+   vurb_out << "" << '\n';
+}
+
+
+int main()
+{
+   Party myParty;
+   myParty.member1.name = "Garen";
+   myParty.member1.charClass = "Warrior";
+   initCharacter(myParty.member1, "Sword", "Shield", "Helmet");
+   myParty.member2.name = "Lux";
+   myParty.member2.charClass = "Mage";
+   initCharacter(myParty.member2, "Staff", "Spellbook", "Robe");
+   myParty.member3.name = "Katarina";
+   myParty.member3.charClass = "Rogue";
+   initCharacter(myParty.member3, "Dagger", "Lockpick", "Cloak");
+   vurb_out << "Party Status:\n" << '\n';
+   printParty(myParty);
+}
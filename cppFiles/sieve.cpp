@@ -0,0 +1,178 @@
+#include <iostream>
+#include <string>
+#include <utility>
+using namespace std;
+#include <cfloat>
+#include <charconv>
+#include <climits>
+#include <cstdlib>
+
+inline char *vurb_formatInteger(char *digits, long value) {
+   return to_chars(digits, digits + 24, value).ptr;
+}
+
+inline char *vurb_formatReal(char *digits, double value) {
+   return to_chars(digits, digits + 32, value, chars_format::general, 6).ptr;
+}
+
+// skip a plus sign that cin would accept but from_chars does not
+inline const char *vurb_skipPlus(const char *first, const char *last) {
+   if (last - first > 1 && *first == '+' && *(first + 1) != '-') return first + 1;
+   return first;
+}
+
+inline bool vurb_parseInteger(const char *&next, const char *last, long &value) {
+   const char *first = vurb_skipPlus(next, last);
+   from_chars_result result = from_chars(first, last, value);
+   if (result.ec == errc::invalid_argument) {
+      value = 0;
+      return false;
+   }
+   next = result.ptr;
+   if (result.ec == errc::result_out_of_range) {
+      value = (*first == '-') ? LONG_MIN : LONG_MAX;
+      return false;
+   }
+   return true;
+}
+
+inline bool vurb_parseReal(const char *&next, const char *last, double &value) {
+   const char *first = vurb_skipPlus(next, last);
+   // cin only reads reals written out in digits, not inf or nan,
+   //    and gives up on an exponent without digits
+   const char *digits = (first < last && *first == '-') ? first + 1 : first;
+   from_chars_result result = from_chars(first, last, value);
+   if (digits == last || !((*digits >= '0' && *digits <= '9') || *digits == '.')
+      || (result.ptr < last && (*result.ptr == 'e' || *result.ptr == 'E'))
+      || result.ec == errc::invalid_argument) {
+      value = 0;
+      return false;
+   }
+   next = result.ptr;
+   if (result.ec == errc::result_out_of_range) {
+      // too small reals become zero, too large ones fail at the largest real
+      value = strtod(string(first, result.ptr).c_str(), nullptr);
+      if (value > DBL_MAX || value < -DBL_MAX) {
+         value = (value > 0) ? DBL_MAX : -DBL_MAX;
+         return false;
+      }
+   }
+   return true;
+}
+#include <cstring>
+#include <unistd.h>
+
+struct vurb_Output {
+   char buffer[1 << 16];
+   size_t used = 0;
+
+   ~vurb_Output() { flush(); }
+
+   void send(const char *text, size_t length) {
+      while (length > 0) {
+         ssize_t count = ::write(1, text, length);
+         if (count <= 0) return;
+         text += count;
+         length -= count;
+      }
+   }
+
+   void flush() {
+      send(buffer, used);
+      used = 0;
+   }
+
+   void put(const char *text, size_t length) {
+      if (length > sizeof(buffer) - used) {
+         flush();
+         if (length > sizeof(buffer)) {
+            send(text, length);
+            return;
+         }
+      }
+      memcpy(buffer + used, text, length);
+      used += length;
+   }
+
+   vurb_Output &operator<<(char c) {
+      if (used == sizeof(buffer)) flush();
+      buffer[used++] = c;
+      return *this;
+   }
+
+   vurb_Output &operator<<(const char *text) {
+      put(text, strlen(text));
+      return *this;
+   }
+
+   vurb_Output &operator<<(const string &text) {
+      put(text.data(), text.size());
+      return *this;
+   }
+
+   vurb_Output &operator<<(bool value) { return *this << (value ? '1' : '0'); }
+
+   vurb_Output &operator<<(int value) { return *this << (long)value; }
+
+   vurb_Output &operator<<(long value) {
+      char digits[24];
+      put(digits, vurb_formatInteger(digits, value) - digits);
+      return *this;
+   }
+
+   vurb_Output &operator<<(double value) {
+      char digits[32];
+      put(digits, vurb_formatReal(digits, value) - digits);
+      return *this;
+   }
+} vurb_out;
+
+long composite[20000000];
+long small[4096];
+
+int main()
+{
+   long i;
+   long j;
+   long r;
+   long s;
+   long count;
+   i = 2;
+   count = 0;
+   while((i < 20000000))
+   {
+      j = (i * i);
+      while((j < 20000000))
+      {
+         composite[j] = 1;
+         j = (j + i);
+      }
+      i++;
+   }
+   i = 2;
+   while((i < 20000000))
+   {
+      count = (count + (1 - composite[i]));
+      i++;
+   }
+   vurb_out << count << '\n';
+   i = 0;
+   while((i < 4096))
+   {
+      small[i] = (i % 100);
+      i++;
+   }
+   r = 0;
+   s = 0;
+   while((r < 200000))
+   {
+      i = 0;
+      while((i < 4096))
+      {
+         s = (s + small[i]);
+         i++;
+      }
+      r++;
+   }
+   vurb_out << s << '\n';
+}
@@ -0,0 +1,577 @@
+#include "evaluating.h"
+#include "analyzing.h"
+#include "parsing.h"
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+
+// a local variable or parameter of a procedure being evaluated
+struct localVar {
+   TokenType declType;
+   bool initialized;
+   constValue value;
+};
+
+// the local scopes of one procedure activation, innermost last
+typedef vector<unordered_map<string, localVar>> evalFrame;
+
+// how execution left a body
+enum EvalStatus { EvalNormal, EvalReturned };
+
+
+static int stepsLeft = 0;
+static int callDepth = 0;
+
+// results of calls already evaluated, keyed by the position of the call token
+static unordered_map<int, pair<bool, string>> evaluatedCalls;
+
+
+static int evalExpression(token tokens[], int currPos, int size, evalFrame &frame, constValue &result);
+static int evalCondExpression(token tokens[], int currPos, int size, evalFrame &frame, constValue &result);
+static int evalCall(token tokens[], int currPos, int size, evalFrame &frame, constValue &result, bool &hasValue);
+static int evalBody(token tokens[], int currPos, int size, evalFrame &frame, EvalStatus &status, constValue &retVal);
+
+
+// attempt to evaluate the procedure call starting at currPos at translation time,
+//    storing the C++ literal for its result in literal (empty for void procedures)
+// returns false if the call reads or writes anything outside its own locals,
+//    or does not finish within the step budget
+bool evaluateCall(token tokens[], int currPos, int size, string &literal)
+{
+   auto it = evaluatedCalls.find(currPos);
+   if (it != evaluatedCalls.end()) {
+      literal = it->second.second;
+      return it->second.first;
+   }
+
+   evalFrame frame(1);
+   constValue result;
+   bool hasValue = false;
+
+   stepsLeft = EvalStepBudget;
+   callDepth = 0;
+
+   bool success = (evalCall(tokens, currPos, size, frame, result, hasValue) != -1);
+   literal = "";
+
+   if (success && hasValue) {
+      success = valueToLiteral(result, literal);
+   }
+
+   evaluatedCalls[currPos] = make_pair(success, literal);
+   return success;
+}
+
+
+// convert an evaluated value into the equivalent C++ literal
+// returns false if the value has no exact literal form
+bool valueToLiteral(const constValue &value, string &literal)
+{
+   switch (value.vtype) {
+      case IntType:
+         // LONG_MIN cannot be written as a single literal
+         if (value.intVal == LONG_MIN) return false;
+         literal = to_string(value.intVal);
+         break;
+      case RealType: {
+         if (!std::isfinite(value.realVal)) return false;
+         ostringstream out;
+         out << setprecision(17) << value.realVal;
+         literal = out.str();
+         if (literal.find_first_of(".e") == string::npos) {
+            literal += ".0";
+         }
+         break;
+      }
+      case BoolType:
+         literal = value.boolVal ? "true" : "false";
+         return true;
+      case TextType:
+         literal = tokenToCPPString(TokenType::TextType) + "(\"" + value.textVal + "\")";
+         return true;
+      default:
+         return false;
+   }
+
+   if (literal[0] == '-') {
+      literal = "(" + literal + ")";
+   }
+   return true;
+}
+
+
+// find a variable visible in the innermost frame, or nullptr if there is none
+static localVar *findLocal(evalFrame &frame, string name)
+{
+   for (size_t i = frame.size(); i > 0; i--) {
+      auto it = frame[i - 1].find(name);
+      if (it != frame[i - 1].end()) return &it->second;
+   }
+   return nullptr;
+}
+
+
+// store a value in a variable, converting integers to reals where allowed
+static bool assignValue(localVar &var, constValue value)
+{
+   if (var.declType == TokenType::RealType && value.vtype == TokenType::IntType) {
+      value.vtype = TokenType::RealType;
+      value.realVal = value.intVal;
+   }
+
+   if (var.declType != value.vtype) return false;
+
+   var.value = value;
+   var.initialized = true;
+   return true;
+}
+
+
+// read a literal token into a value
+static bool literalValue(token tok, constValue &result)
+{
+   errno = 0;
+   result.vtype = TokenType::Invalid;
+
+   switch (tok.ttype) {
+      case IntLit:
+         result.vtype = TokenType::IntType;
+         result.intVal = strtol(tok.content.c_str(), nullptr, 10);
+         return errno == 0;
+      case RealLit:
+         result.vtype = TokenType::RealType;
+         result.realVal = strtod(tok.content.c_str(), nullptr);
+         return errno == 0;
+      case BoolLit:
+         result.vtype = TokenType::BoolType;
+         result.boolVal = (tok.content == "true");
+         return true;
+      case TextLit:
+         // escape sequences are interpreted by the C++ compiler, not here
+         if (tok.content.find('\\') != string::npos) return false;
+         result.vtype = TokenType::TextType;
+         result.textVal = tok.content.substr(1, tok.content.length() - 2);
+         return true;
+      default:
+         return false;
+   }
+}
+
+
+// returns true if the value is an integer or a real
+static bool isNumeric(const constValue &value)
+{
+   return (value.vtype == TokenType::IntType || value.vtype == TokenType::RealType);
+}
+
+
+// returns the value of a number as a real
+static double asReal(const constValue &value)
+{
+   return (value.vtype == TokenType::IntType) ? value.intVal : value.realVal;
+}
+
+
+// apply an arithmetic or comparison operator to two values
+static bool applyBinary(TokenType op, const constValue &lhs, const constValue &rhs, constValue &result)
+{
+   if (isCondOperator(op)) {
+      int order;
+
+      if (isNumeric(lhs) && isNumeric(rhs)) {
+         if (lhs.vtype == TokenType::IntType && rhs.vtype == TokenType::IntType) {
+            order = (lhs.intVal < rhs.intVal) ? -1 : (lhs.intVal > rhs.intVal);
+         } else {
+            double a = asReal(lhs);
+            double b = asReal(rhs);
+            // comparisons involving NaN are always false, except ne
+            if (a != a || b != b) {
+               result.vtype = TokenType::BoolType;
+               result.boolVal = (op == TokenType::NEOp);
+               return true;
+            }
+            order = (a < b) ? -1 : (a > b);
+         }
+      } else if (lhs.vtype == TokenType::TextType && rhs.vtype == TokenType::TextType) {
+         int cmp = lhs.textVal.compare(rhs.textVal);
+         order = (cmp < 0) ? -1 : (cmp > 0);
+      } else if (lhs.vtype == TokenType::BoolType && rhs.vtype == TokenType::BoolType) {
+         order = (int)lhs.boolVal - (int)rhs.boolVal;
+      } else {
+         return false;
+      }
+
+      result.vtype = TokenType::BoolType;
+      switch (op) {
+         case EQOp: result.boolVal = (order == 0); break;
+         case NEOp: result.boolVal = (order != 0); break;
+         case LTOp: result.boolVal = (order < 0); break;
+         case LEOp: result.boolVal = (order <= 0); break;
+         case GTOp: result.boolVal = (order > 0); break;
+         case GEOp: result.boolVal = (order >= 0); break;
+         default: return false;
+      }
+      return true;
+   }
+
+   if (lhs.vtype == TokenType::TextType && rhs.vtype == TokenType::TextType) {
+      if (op != TokenType::Add) return false;
+      result.vtype = TokenType::TextType;
+      result.textVal = lhs.textVal + rhs.textVal;
+      return true;
+   }
+
+   if (!isNumeric(lhs) || !isNumeric(rhs)) return false;
+
+   if (lhs.vtype == TokenType::IntType && rhs.vtype == TokenType::IntType) {
+      long a = lhs.intVal;
+      long b = rhs.intVal;
+      result.vtype = TokenType::IntType;
+
+      // overflow and division by zero are left for the program to encounter
+      switch (op) {
+         case Add: return !__builtin_add_overflow(a, b, &result.intVal);
+         case Sub: return !__builtin_sub_overflow(a, b, &result.intVal);
+         case Mul: return !__builtin_mul_overflow(a, b, &result.intVal);
+         case Div:
+            if (b == 0 || (a == LONG_MIN && b == -1)) return false;
+            result.intVal = a / b;
+            return true;
+         case Rem:
+            if (b == 0 || (a == LONG_MIN && b == -1)) return false;
+            result.intVal = a % b;
+            return true;
+         default:
+            return false;
+      }
+   }
+
+   double a = asReal(lhs);
+   double b = asReal(rhs);
+   result.vtype = TokenType::RealType;
+
+   switch (op) {
+      case Add: result.realVal = a + b; return true;
+      case Sub: result.realVal = a - b; return true;
+      case Mul: result.realVal = a * b; return true;
+      case Div: result.realVal = a / b; return true;
+      default: return false;
+   }
+}
+
+
+// evaluate an increment expression, starting at its Left token
+static int evalIncrement(token tokens[], int currPos, int size, evalFrame &frame, constValue &result)
+{
+   if (currPos + 3 >= size) return -1;
+
+   TokenType op = tokens[currPos + 1].ttype;
+   if (!isIncrementOperator(op)
+      || tokens[currPos + 2].ttype != TokenType::Identifier
+      || tokens[currPos + 3].ttype != TokenType::Right) return -1;
+
+   localVar *var = findLocal(frame, tokens[currPos + 2].content);
+   if (!var || !var->initialized) return -1;
+
+   constValue &value = var->value;
+   bool increase = (op == TokenType::AddAdd || op == TokenType::AddAddPre);
+
+   if (isPostIncrementOperator(op)) {
+      result = value;
+   }
+
+   if (value.vtype == TokenType::IntType) {
+      if (__builtin_add_overflow(value.intVal, increase ? 1 : -1, &value.intVal)) return -1;
+   } else if (value.vtype == TokenType::RealType) {
+      value.realVal += increase ? 1 : -1;
+   } else {
+      return -1;
+   }
+
+   if (isPreIncrementOperator(op)) {
+      result = value;
+   }
+
+   return currPos + 3;
+}
+
+
+// evaluate an operator and its operands, starting at the operator token,
+// returning the position of the last operand
+static int evalOperation(token tokens[], int currPos, int size, evalFrame &frame, constValue &result)
+{
+   TokenType op = tokens[currPos].ttype;
+   bool isCondExpOp = isCondExpOperator(op);
+   constValue lhs;
+   constValue rhs;
+
+   if (isBinaryOperator(op)) {
+      currPos = isCondExpOp
+         ? evalCondExpression(tokens, currPos + 1, size, frame, lhs)
+         : evalExpression(tokens, currPos + 1, size, frame, lhs);
+      if (currPos == -1) return -1;
+
+      if (op == TokenType::AndOp || op == TokenType::OrOp) {
+         if (lhs.vtype != TokenType::BoolType) return -1;
+
+         // the right operand is only evaluated if it decides the result
+         if (lhs.boolVal == (op == TokenType::OrOp)) {
+            result = lhs;
+            return skipExpression(tokens, currPos + 1, size);
+         }
+
+         currPos = evalCondExpression(tokens, currPos + 1, size, frame, rhs);
+         if (currPos == -1 || rhs.vtype != TokenType::BoolType) return -1;
+         result = rhs;
+         return currPos;
+      }
+
+      currPos = isCondExpOp
+         ? evalCondExpression(tokens, currPos + 1, size, frame, rhs)
+         : evalExpression(tokens, currPos + 1, size, frame, rhs);
+      if (currPos == -1) return -1;
+
+      return applyBinary(op, lhs, rhs, result) ? currPos : -1;
+   }
+
+   if (isUnaryOperator(op)) {
+      currPos = isCondExpOp
+         ? evalCondExpression(tokens, currPos + 1, size, frame, lhs)
+         : evalExpression(tokens, currPos + 1, size, frame, lhs);
+      if (currPos == -1) return -1;
+
+      result = lhs;
+      if (op == TokenType::NotOp && lhs.vtype == TokenType::BoolType) {
+         result.boolVal = !lhs.boolVal;
+      } else if (op == TokenType::Negate && lhs.vtype == TokenType::IntType) {
+         if (lhs.intVal == LONG_MIN) return -1;
+         result.intVal = -lhs.intVal;
+      } else if (op == TokenType::Negate && lhs.vtype == TokenType::RealType) {
+         result.realVal = -lhs.realVal;
+      } else {
+         return -1;
+      }
+      return currPos;
+   }
+
+   return -1;
+}
+
+
+// evaluate an expression
+static int evalExpression(token tokens[], int currPos, int size, evalFrame &frame, constValue &result)
+{
+   if (currPos >= size) return -1;
+
+   if (tokens[currPos].ttype == TokenType::Identifier) {
+      // globals, arrays and structs are not known at translation time
+      localVar *var = findLocal(frame, tokens[currPos].content);
+      if (!var || !var->initialized) return -1;
+      result = var->value;
+      return currPos;
+   } else if (isLiteralValue(tokens[currPos].ttype)) {
+      return literalValue(tokens[currPos], result) ? currPos : -1;
+   } else if (tokens[currPos].ttype == TokenType::Call) {
+      bool hasValue = false;
+      currPos = evalCall(tokens, currPos, size, frame, result, hasValue);
+      return hasValue ? currPos : -1;
+   } else if (tokens[currPos].ttype == TokenType::Left) {
+      if (currPos + 1 >= size) return -1;
+      if (isIncrementOperator(tokens[currPos + 1].ttype)) {
+         return evalIncrement(tokens, currPos, size, frame, result);
+      }
+
+      currPos = evalOperation(tokens, currPos + 1, size, frame, result);
+      if (currPos == -1 || currPos + 1 >= size) return -1;
+      if (tokens[currPos + 1].ttype != TokenType::Right) return -1;
+      return currPos + 1;
+   }
+
+   return -1;
+}
+
+
+// evaluate a conditional expression
+static int evalCondExpression(token tokens[], int currPos, int size, evalFrame &frame, constValue &result)
+{
+   if (currPos + 1 >= size || tokens[currPos].ttype != TokenType::Left) return -1;
+
+   currPos++;
+
+   if (tokens[currPos].ttype == TokenType::BoolLit
+      || tokens[currPos].ttype == TokenType::Identifier) {
+      currPos = evalExpression(tokens, currPos, size, frame, result);
+   } else if (isCondOperator(tokens[currPos].ttype)) {
+      currPos = evalOperation(tokens, currPos, size, frame, result);
+   } else {
+      return -1;
+   }
+
+   if (currPos == -1 || currPos + 1 >= size) return -1;
+   if (tokens[currPos + 1].ttype != TokenType::Right) return -1;
+   if (result.vtype != TokenType::BoolType) return -1;
+
+   return currPos + 1;
+}
+
+
+// evaluate an if loop and its optional else body
+static int evalIfLoop(token tokens[], int currPos, int size, evalFrame &frame, EvalStatus &status, constValue &retVal)
+{
+   int condPos = currPos + 1;
+   int bodyEnd;
+
+   while (true) {
+      if (--stepsLeft < 0) return -1;
+
+      constValue cond;
+      int condEnd = evalCondExpression(tokens, condPos, size, frame, cond);
+      if (condEnd == -1) return -1;
+
+      if (!cond.boolVal) {
+         bodyEnd = findBlockEnd(tokens, condEnd + 1, size);
+         break;
+      }
+
+      bodyEnd = evalBody(tokens, condEnd + 1, size, frame, status, retVal);
+      if (bodyEnd == -1) return -1;
+      if (status == EvalReturned) return bodyEnd;
+   }
+
+   if (bodyEnd == -1 || bodyEnd + 1 >= size) return -1;
+   if (tokens[bodyEnd + 1].ttype != TokenType::Else) return bodyEnd;
+
+   return evalBody(tokens, bodyEnd + 2, size, frame, status, retVal);
+}
+
+
+// evaluate a body of code
+static int evalBody(token tokens[], int currPos, int size, evalFrame &frame, EvalStatus &status, constValue &retVal)
+{
+   if (currPos >= size || tokens[currPos].ttype != TokenType::Begin) return -1;
+
+   status = EvalNormal;
+   frame.push_back(unordered_map<string, localVar>());
+   currPos++;
+
+   while (currPos < size && tokens[currPos].ttype != TokenType::End) {
+      if (--stepsLeft < 0) return -1;
+
+      constValue value;
+      bool hasValue;
+      localVar *var;
+
+      switch (tokens[currPos].ttype) {
+         case VarDef:
+            if (currPos + 2 >= size
+               || tokens[currPos + 1].ttype != TokenType::Identifier
+               || !isVariableType(tokens[currPos + 2].ttype)) return -1;
+
+            frame.back()[tokens[currPos + 1].content] = localVar{tokens[currPos + 2].ttype, false, constValue()};
+            currPos += 2;
+            break;
+         case Set:
+            if (currPos + 1 >= size || tokens[currPos + 1].ttype != TokenType::Identifier) return -1;
+
+            var = findLocal(frame, tokens[currPos + 1].content);
+            if (!var) return -1;
+
+            currPos = evalExpression(tokens, currPos + 2, size, frame, value);
+            if (currPos == -1 || !assignValue(*var, value)) return -1;
+            break;
+         case Left:
+            currPos = evalIncrement(tokens, currPos, size, frame, value);
+            break;
+         case Call:
+            currPos = evalCall(tokens, currPos, size, frame, value, hasValue);
+            break;
+         case If:
+            currPos = evalIfLoop(tokens, currPos, size, frame, status, retVal);
+            if (currPos != -1 && status == EvalReturned) {
+               frame.pop_back();
+               return currPos;
+            }
+            break;
+         case Return:
+            currPos = evalExpression(tokens, currPos + 1, size, frame, retVal);
+            if (currPos == -1) return -1;
+            status = EvalReturned;
+            frame.pop_back();
+            return currPos;
+         default:
+            // output, input, arrays and structs all need the running program
+            return -1;
+      }
+
+      if (currPos == -1) return -1;
+      currPos++;
+   }
+
+   if (currPos >= size) return -1;
+
+   frame.pop_back();
+   return currPos;
+}
+
+
+// evaluate a procedure call, returning the position of its Right token
+static int evalCall(token tokens[], int currPos, int size, evalFrame &frame, constValue &result, bool &hasValue)
+{
+   hasValue = false;
+
+   if (currPos + 2 >= size
+      || tokens[currPos + 1].ttype != TokenType::Identifier
+      || tokens[currPos + 2].ttype != TokenType::Left) return -1;
+
+   const procedureInfo *proc = findProcedure(tokens[currPos + 1].content);
+   if (!proc) return -1;
+
+   vector<constValue> args;
+   currPos += 3;
+
+   while (currPos < size && tokens[currPos].ttype != TokenType::Right) {
+      constValue arg;
+      currPos = evalExpression(tokens, currPos, size, frame, arg);
+      if (currPos == -1) return -1;
+      args.push_back(arg);
+      currPos++;
+   }
+
+   if (currPos >= size || args.size() != proc->params.size()) return -1;
+   if (++callDepth > EvalDepthLimit) return -1;
+
+   evalFrame callee(1);
+
+   for (size_t i = 0; i < args.size(); i++) {
+      const paramInfo &param = proc->params[i];
+      if (param.isArray || !param.structType.empty()) return -1;
+
+      localVar var = {param.ptype, false, constValue()};
+      if (!assignValue(var, args[i])) return -1;
+      callee.back()[param.name] = var;
+   }
+
+   EvalStatus status;
+   constValue retVal;
+
+   if (evalBody(tokens, proc->bodyStart, size, callee, status, retVal) == -1) return -1;
+   callDepth--;
+
+   if (proc->returnType == TokenType::VoidType) {
+      return (status == EvalNormal) ? currPos : -1;
+   }
+
+   // falling off the end of a procedure with a return type has no defined result
+   if (status != EvalReturned) return -1;
+
+   localVar ret = {proc->returnType, false, constValue()};
+   if (!assignValue(ret, retVal)) return -1;
+
+   result = ret.value;
+   hasValue = true;
+   return currPos;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "tokenizing.h"
+#include <string>
+
+using std::string;
+
+// upper limit on the number of statements executed while evaluating one call
+const int EvalStepBudget = 100000;
+
+// upper limit on the depth of nested calls while evaluating one call
+const int EvalDepthLimit = 200;
+
+
+// a value computed while evaluating a procedure at translation time,
+//    vtype is one of IntType, RealType, TextType or BoolType
+struct constValue {
+   TokenType vtype;
+   long intVal;
+   double realVal;
+   bool boolVal;
+   string textVal;
+};
+
+
+// attempt to evaluate the procedure call starting at currPos at translation time,
+//    storing the C++ literal for its result in literal (empty for void procedures)
+// returns false if the call reads or writes anything outside its own locals,
+//    or does not finish within the step budget
+bool evaluateCall(token tokens[], int currPos, int size, string &literal);
+
+
+// convert an evaluated value into the equivalent C++ literal
+// returns false if the value has no exact literal form
+bool valueToLiteral(const constValue &value, string &literal);
@@ -0,0 +1,379 @@
+#include "interpreting.h"
+#include "asmruntime.h"
+#include "bytecode.h"
+#include <cstdint>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::vector;
+
+// a word of a frame or of the globals, holding any value
+union vmWord {
+   long integer;
+   double real;
+   void *pointer;
+};
+
+// where a call returns to: the instruction after it and the caller's frame
+struct vmFrame {
+   const int *pc;
+   vmWord *fp;
+};
+
+// the words of the stack of frames and the depth of calls a program can use,
+//    only taken from the system as they are touched
+const long StackWords = 16l << 20;
+const long CallDepth = 1l << 20;
+
+// the image being run, and the storage it runs in
+static char *runningImage = nullptr;
+static vmWord *slots = nullptr;
+static vmFrame *frames = nullptr;
+static vmWord *globals = nullptr;
+
+
+// returns true if the image offset is a text literal, or a struct table,
+//    lying wholly within the image's data
+static bool isData(const char *image, long offset, bool isText)
+{
+   long dataEnd = ((const vmHeader *)image)->codeOffset;
+   if (offset < (long)sizeof(vmHeader) || offset % 8 != 0 || offset + 16 > dataEnd) return false;
+
+   const long *words = (const long *)(image + offset);
+   if (isText) return words[1] >= 0 && offset + 24 + words[1] <= dataEnd;
+   return words[1] >= 0 && words[1] <= (dataEnd - offset - 16) / 8;
+}
+
+
+// returns true if the image is laid out as compileBytecode lays it out: every
+//    instruction known, with its operands within the code, every jump to the
+//    start of an instruction and every literal and table within the data;
+//    slots and global words are not checked, so an image is trusted as far
+//    as the program it was made from would be
+static bool isValidImage(const char *image, long bytes)
+{
+   const vmHeader *header = (const vmHeader *)image;
+   if (bytes < (long)sizeof(vmHeader) || (uintptr_t)image % 8 != 0) return false;
+   if (header->imageBytes != bytes || header->codeOffset < (long)sizeof(vmHeader)
+      || header->codeOffset % 8 != 0 || header->codeWords <= 0
+      || header->codeOffset + header->codeWords * (long)sizeof(int) != bytes
+      || header->globalWords < 0 || header->mainFrame < 0 || header->mainFrame > StackWords) {
+      return false;
+   }
+
+   const int *code = (const int *)(image + header->codeOffset);
+   long words = header->codeWords;
+   vector<bool> starts(words, false);
+   int op = 0;
+   for (long at = 0; at < words; at += 1 + OperandCounts[op]) {
+      op = code[at];
+      if (op < 0 || op >= (int)vmOpcode::OpcodeCount || at + 1 + OperandCounts[op] > words) return false;
+      starts[at] = true;
+
+      const int *operands = code + at + 1;
+      if ((op == (int)vmOpcode::SetText && !isData(image, operands[1], true))
+         || (op == (int)vmOpcode::WriteLiteral && !isData(image, operands[0], true))
+         || (op == (int)vmOpcode::StructCopy && !isData(image, operands[2], false))
+         || (op == (int)vmOpcode::StructRelease && !isData(image, operands[1], false))) {
+         return false;
+      }
+   }
+
+   // the code cannot run off its end
+   if (op != (int)vmOpcode::Jump && op != (int)vmOpcode::Return && op != (int)vmOpcode::ReturnNothing) return false;
+
+   for (long at = 0; at < words; at += 1 + OperandCounts[code[at]]) {
+      int target = TargetOperands[code[at]];
+      if (target >= 0) {
+         long word = code[at + 1 + target];
+         if (word < 0 || word >= words || !starts[word]) return false;
+      }
+
+      // the superinstructions that skip the test after them need it there
+      if ((code[at] == (int)vmOpcode::IncrementJumpIfLess || code[at] == (int)vmOpcode::IncrementJumpIfLessInteger)
+         && (at + 8 >= words || !starts[at + 4] || !starts[at + 8])) {
+         return false;
+      }
+   }
+   return header->mainEntry >= 0 && header->mainEntry < words && starts[header->mainEntry];
+}
+
+
+// the instructions are dispatched by jumping straight from each to the next,
+//    through the GNU extension that takes the addresses of labels
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+// run the image from its main routine
+// returns the value the main routine returns, or 1 if it runs out of stack
+static long runCode()
+{
+#define VURB_LABEL(name, operands, target) &&Do##name,
+   static void *const labels[] = { VURB_OPCODES(VURB_LABEL) };
+#undef VURB_LABEL
+
+   char *image = runningImage;
+   const vmHeader *header = (const vmHeader *)image;
+   const int *code = (const int *)(image + header->codeOffset);
+   const int *pc = code + header->mainEntry;
+   vmWord *fp = slots;
+   vmWord *g = globals;
+   vmFrame *rp = frames;
+
+// the operand n of the instruction as a slot, a global word, an immediate,
+//    a pointer in a slot, and a word of data in the image
+#define S(n) fp[pc[n]]
+#define G(n) g[pc[n]]
+#define K(n) pc[n]
+#define P(n) ((vmWord *)fp[pc[n]].pointer)
+#define D(n) (image + pc[n])
+#define TEXT(n) ((vurb_Text *)fp[pc[n]].pointer)
+// go on to the next instruction, past the operands of this one, or to a target
+#define NEXT(operands) pc += (operands) + 1; goto *labels[*pc]
+#define JUMP(n) pc = code + pc[n]; goto *labels[*pc]
+// signed integer arithmetic wraps, as it does in the machine code
+#define WRAP(expression) (long)((unsigned long)(expression))
+
+   goto *labels[*pc];
+
+DoMove: S(1) = S(2); NEXT(2);
+DoSetInteger: S(1).integer = K(2); NEXT(2);
+DoSetWide: S(1).integer = (long)(((unsigned long)(unsigned)K(3) << 32) | (unsigned)K(2)); NEXT(3);
+DoSetText: S(1).pointer = D(2); NEXT(2);
+DoClear: memset(&S(1), 0, K(2) * sizeof(vmWord)); NEXT(2);
+
+DoLoadGlobal: S(1) = G(2); NEXT(2);
+DoStoreGlobal: G(1) = S(2); NEXT(2);
+DoLoadGlobalIndexed: S(1) = g[K(2) + S(3).integer]; NEXT(3);
+DoStoreGlobalIndexed: g[K(1) + S(2).integer] = S(3); NEXT(3);
+DoLoadFrameIndexed: S(1) = fp[K(2) + S(3).integer]; NEXT(3);
+DoStoreFrameIndexed: fp[K(1) + S(2).integer] = S(3); NEXT(3);
+DoLoad: S(1) = P(2)[K(3)]; NEXT(3);
+DoStore: P(1)[K(2)] = S(3); NEXT(3);
+DoLoadIndexed: S(1) = P(2)[S(3).integer + K(4)]; NEXT(4);
+DoStoreIndexed: P(1)[S(2).integer + K(3)] = S(4); NEXT(4);
+
+DoFrameAddress: S(1).pointer = &S(2); NEXT(2);
+DoGlobalAddress: S(1).pointer = &G(2); NEXT(2);
+DoPointerAddress: S(1).pointer = P(2) + K(3); NEXT(3);
+DoIndexAddress: S(1).pointer = P(2) + S(3).integer; NEXT(3);
+
+DoAdd: S(1).integer = WRAP(S(2).integer + (unsigned long)S(3).integer); NEXT(3);
+DoSubtract: S(1).integer = WRAP(S(2).integer - (unsigned long)S(3).integer); NEXT(3);
+DoMultiply: S(1).integer = WRAP(S(2).integer * (unsigned long)S(3).integer); NEXT(3);
+DoDivide: S(1).integer = S(2).integer / S(3).integer; NEXT(3);
+DoRemainder: S(1).integer = S(2).integer % S(3).integer; NEXT(3);
+DoAddInteger: S(1).integer = WRAP(S(2).integer + (unsigned long)(long)K(3)); NEXT(3);
+DoNegate: S(1).integer = WRAP(0ul - S(2).integer); NEXT(2);
+DoIncrement: S(1).integer = WRAP(S(1).integer + 1ul); NEXT(1);
+DoDecrement: S(1).integer = WRAP(S(1).integer - 1ul); NEXT(1);
+
+DoRealAdd: S(1).real = S(2).real + S(3).real; NEXT(3);
+DoRealSubtract: S(1).real = S(2).real - S(3).real; NEXT(3);
+DoRealMultiply: S(1).real = S(2).real * S(3).real; NEXT(3);
+DoRealDivide: S(1).real = S(2).real / S(3).real; NEXT(3);
+DoRealNegate: S(1).real = -S(2).real; NEXT(2);
+DoRealIncrement: S(1).real += 1; NEXT(1);
+DoRealDecrement: S(1).real -= 1; NEXT(1);
+
+DoIntegerToReal: S(1).real = (double)S(2).integer; NEXT(2);
+DoRealToInteger: S(1).integer = (long)S(2).real; NEXT(2);
+DoRealToBool: S(1).integer = (S(2).real != 0); NEXT(2);
+DoIntegerToBool: S(1).integer = (S(2).integer != 0); NEXT(2);
+
+DoJump: JUMP(1);
+DoJumpIfTrue: if (S(1).integer) { JUMP(2); } NEXT(2);
+DoJumpIfFalse: if (!S(1).integer) { JUMP(2); } NEXT(2);
+DoJumpIfLess: if (S(1).integer < S(2).integer) { JUMP(3); } NEXT(3);
+DoJumpIfLessEqual: if (S(1).integer <= S(2).integer) { JUMP(3); } NEXT(3);
+DoJumpIfEqual: if (S(1).integer == S(2).integer) { JUMP(3); } NEXT(3);
+DoJumpIfNotEqual: if (S(1).integer != S(2).integer) { JUMP(3); } NEXT(3);
+DoJumpIfLessInteger: if (S(1).integer < K(2)) { JUMP(3); } NEXT(3);
+DoJumpIfLessEqualInteger: if (S(1).integer <= K(2)) { JUMP(3); } NEXT(3);
+DoJumpIfGreaterInteger: if (S(1).integer > K(2)) { JUMP(3); } NEXT(3);
+DoJumpIfGreaterEqualInteger: if (S(1).integer >= K(2)) { JUMP(3); } NEXT(3);
+DoJumpIfEqualInteger: if (S(1).integer == K(2)) { JUMP(3); } NEXT(3);
+DoJumpIfNotEqualInteger: if (S(1).integer != K(2)) { JUMP(3); } NEXT(3);
+DoJumpIfRealLess: if (S(1).real < S(2).real) { JUMP(3); } NEXT(3);
+DoJumpIfRealLessEqual: if (S(1).real <= S(2).real) { JUMP(3); } NEXT(3);
+DoJumpIfRealEqual: if (S(1).real == S(2).real) { JUMP(3); } NEXT(3);
+DoJumpIfRealNotEqual: if (S(1).real != S(2).real) { JUMP(3); } NEXT(3);
+DoJumpUnlessRealLess: if (!(S(1).real < S(2).real)) { JUMP(3); } NEXT(3);
+DoJumpUnlessRealLessEqual: if (!(S(1).real <= S(2).real)) { JUMP(3); } NEXT(3);
+
+DoTextCompare: S(1).integer = vurb_textCompare(TEXT(2), TEXT(3), K(4)); NEXT(4);
+DoTextConcat: S(1).pointer = vurb_textConcat(TEXT(2), TEXT(3), K(4)); NEXT(4);
+DoTextAppend: vurb_textAppend((vurb_Text **)P(1), TEXT(2), K(3)); NEXT(3);
+DoTextRetain: if (S(1).pointer) ((long *)S(1).pointer)[0]++; NEXT(1);
+DoTextRelease: vurb_textRelease(TEXT(1)); NEXT(1);
+DoTextStore: {
+   vurb_Text *replaced = TEXT(1);
+   S(1) = S(2);
+   vurb_textRelease(replaced);
+   NEXT(2);
+}
+DoTextReleaseAll: vurb_textReleaseAll((vurb_Text **)P(1), S(2).integer); NEXT(2);
+
+DoArrayTake: S(1).pointer = vurb_arrayTake(S(2).integer * (long)sizeof(vmWord)); NEXT(2);
+DoArrayGive: vurb_arrayGive(P(1), S(2).integer * (long)sizeof(vmWord)); NEXT(2);
+DoCopyWords: memmove(P(1), P(2), K(3) * sizeof(vmWord)); NEXT(3);
+DoStructCopy: {
+   const long *table = (const long *)D(3);
+   vurb_structCopy((long *)P(1), (const long *)P(2), table[0], table + 1);
+   NEXT(3);
+}
+DoStructRelease: vurb_structRelease((long *)P(1), (const long *)D(2) + 1); NEXT(2);
+
+DoWriteInteger: vurb_writeInteger(S(1).integer); NEXT(1);
+DoWriteReal: vurb_writeReal(S(1).real); NEXT(1);
+DoWriteBool: vurb_writeBool(S(1).integer); NEXT(1);
+DoWriteText: vurb_writeText(TEXT(1), K(2)); NEXT(2);
+DoWriteLiteral: vurb_writeText((vurb_Text *)D(1), 0); NEXT(1);
+DoReadInteger: vurb_readInteger((long *)P(1)); NEXT(1);
+DoReadReal: vurb_readReal((double *)P(1)); NEXT(1);
+DoReadBool: vurb_readBool((long *)P(1)); NEXT(1);
+DoReadText: vurb_readText((vurb_Text **)P(1)); NEXT(1);
+
+DoCall: {
+   vmWord *frame = fp + K(2);
+   if (frame + K(3) > slots + StackWords || rp == frames + CallDepth) goto OutOfStack;
+   rp->pc = pc + 4;
+   rp->fp = fp;
+   rp++;
+   fp = frame;
+   JUMP(1);
+}
+DoReturn:
+   fp[0] = S(1);
+   if (rp == frames) return fp[0].integer;
+   rp--;
+   pc = rp->pc;
+   fp = rp->fp;
+   goto *labels[*pc];
+DoReturnNothing:
+   if (rp == frames) return 0;
+   rp--;
+   pc = rp->pc;
+   fp = rp->fp;
+   goto *labels[*pc];
+
+DoAddFrameIndexed: S(1).integer = WRAP(S(2).integer + (unsigned long)fp[K(3) + S(4).integer].integer); NEXT(4);
+DoAddGlobalIndexed: S(1).integer = WRAP(S(2).integer + (unsigned long)g[K(3) + S(4).integer].integer); NEXT(4);
+DoAddIndexed: S(1).integer = WRAP(S(2).integer + (unsigned long)P(3)[S(4).integer].integer); NEXT(4);
+DoIncrementJumpIfLess:
+   S(1).integer = WRAP(S(1).integer + 1ul);
+   if (S(1).integer < S(2).integer) { JUMP(3); }
+   NEXT(3 + 4);
+DoIncrementJumpIfLessInteger:
+   S(1).integer = WRAP(S(1).integer + 1ul);
+   if (S(1).integer < K(2)) { JUMP(3); }
+   NEXT(3 + 4);
+
+OutOfStack:
+   cerr << "Error: the program ran out of stack\n";
+   return 1;
+
+#undef S
+#undef G
+#undef K
+#undef P
+#undef D
+#undef TEXT
+#undef NEXT
+#undef JUMP
+#undef WRAP
+}
+
+#pragma GCC diagnostic pop
+
+
+// returns storage of the given number of bytes, zeroed, only taken from the
+//    system as it is touched, or nullptr if there is none
+static void *mapStorage(long bytes)
+{
+   void *storage = mmap(nullptr, bytes > 0 ? bytes : 1, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   return (storage == MAP_FAILED) ? nullptr : storage;
+}
+
+
+// run the image of the given size, after checking it
+// returns the program's exit status, or -1 if it is not valid bytecode
+static int runImage(char *image, long bytes)
+{
+   if (bytes < (long)sizeof(vmHeader) || memcmp(image, BytecodeMagic, sizeof(BytecodeMagic)) != 0) {
+      cerr << "Error: the bytecode is not of the format this translator runs\n";
+      return -1;
+   }
+   if (!isValidImage(image, bytes)) {
+      cerr << "Error: the bytecode is malformed\n";
+      return -1;
+   }
+
+   long globalBytes = ((const vmHeader *)image)->globalWords * (long)sizeof(vmWord);
+   slots = (vmWord *)mapStorage(StackWords * sizeof(vmWord));
+   frames = (vmFrame *)mapStorage(CallDepth * sizeof(vmFrame));
+   globals = (vmWord *)mapStorage(globalBytes);
+
+   int status = -1;
+   if (slots && frames && globals) {
+      runningImage = image;
+      status = (int)vurb_run(runCode);
+   } else {
+      cerr << "Error: unable to take storage for the program\n";
+   }
+
+   if (slots) munmap(slots, StackWords * sizeof(vmWord));
+   if (frames) munmap(frames, CallDepth * sizeof(vmFrame));
+   if (globals) munmap(globals, globalBytes > 0 ? globalBytes : 1);
+   return status;
+}
+
+
+// run the bytecode image made by compileBytecode within the translator,
+//    with the program reading standard input and writing standard output;
+//    the image is changed as it runs, as its text literals are counted
+// returns the program's exit status, or -1 if the image is not valid bytecode
+int runBytecode(string &image)
+{
+   return runImage(&image[0], (long)image.size());
+}
+
+
+// run the bytecode image in the named file, mapped into memory as it is
+// returns the program's exit status, or -1 if it is not valid bytecode
+int runBytecodeFile(const string &name)
+{
+   int file = open(name.c_str(), O_RDONLY);
+   struct stat status;
+   if (file == -1 || fstat(file, &status) != 0 || status.st_size == 0) {
+      if (file != -1) close(file);
+      cerr << "Error: unable to read " << name << endl;
+      return -1;
+   }
+
+   // the mapping is private, so the counts of its text literals can change
+   void *image = mmap(nullptr, status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+   close(file);
+   if (image == MAP_FAILED) {
+      cerr << "Error: unable to map " << name << endl;
+      return -1;
+   }
+
+   int exitStatus = runImage((char *)image, status.st_size);
+   munmap(image, status.st_size);
+   return exitStatus;
+}
+
+
+// returns true if the named file starts as a bytecode image does
+bool isBytecodeFile(const string &name)
+{
+   ifstream file(name, std::ios::binary);
+   char magic[5] = {0};
+   file.read(magic, sizeof(magic));
+   return file && memcmp(magic, BytecodeMagic, sizeof(magic)) == 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "tokenizing.h"
+
+
+// run the bytecode image made by compileBytecode within the translator,
+//    with the program reading standard input and writing standard output;
+//    the image is changed as it runs, as its text literals are counted
+// returns the program's exit status, or -1 if the image is not valid bytecode
+int runBytecode(string &image);
+
+// run the bytecode image in the named file, mapped into memory as it is
+// returns the program's exit status, or -1 if it is not valid bytecode
+int runBytecodeFile(const string &name);
+
+// returns true if the named file starts as a bytecode image does
+bool isBytecodeFile(const string &name);
@@ -0,0 +1,779 @@
+#include "jitting.h"
+#include "asmruntime.h"
+#include "assembling.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using std::cout;
+using std::istringstream;
+using std::ostringstream;
+using std::streambuf;
+using std::to_string;
+using std::vector;
+
+// the addresses of the runtime's functions, by the names the assembly calls them
+static const unordered_map<string, long> runtimeFunctions = {
+   {"vurb_arrayTake", reinterpret_cast<long>(&vurb_arrayTake)},
+   {"vurb_arrayGive", reinterpret_cast<long>(&vurb_arrayGive)},
+   {"vurb_textRelease", reinterpret_cast<long>(&vurb_textRelease)},
+   {"vurb_textConcat", reinterpret_cast<long>(&vurb_textConcat)},
+   {"vurb_textAppend", reinterpret_cast<long>(&vurb_textAppend)},
+   {"vurb_textCompare", reinterpret_cast<long>(&vurb_textCompare)},
+   {"vurb_textReleaseAll", reinterpret_cast<long>(&vurb_textReleaseAll)},
+   {"vurb_structCopy", reinterpret_cast<long>(&vurb_structCopy)},
+   {"vurb_structRelease", reinterpret_cast<long>(&vurb_structRelease)},
+   {"vurb_writeInteger", reinterpret_cast<long>(&vurb_writeInteger)},
+   {"vurb_writeReal", reinterpret_cast<long>(&vurb_writeReal)},
+   {"vurb_writeBool", reinterpret_cast<long>(&vurb_writeBool)},
+   {"vurb_writeText", reinterpret_cast<long>(&vurb_writeText)},
+   {"vurb_readInteger", reinterpret_cast<long>(&vurb_readInteger)},
+   {"vurb_readBool", reinterpret_cast<long>(&vurb_readBool)},
+   {"vurb_readReal", reinterpret_cast<long>(&vurb_readReal)},
+   {"vurb_readText", reinterpret_cast<long>(&vurb_readText)},
+};
+
+// the parts of the program as it is laid out in memory: code, constants,
+//    data and zeroed data, in that order
+enum jitSection { TextSection, RodataSection, DataSection, BssSection, IgnoredSection };
+
+// a label, at an offset into its section, or a value set by .set
+struct jitSymbol {
+   jitSection section;
+   long offset;
+   bool isAbsolute;
+};
+
+// four bytes of code to fill in once everything is laid out: the address of
+//    the symbol plus addend, or for relative fixups its distance from end,
+//    the offset of the end of the instruction
+struct jitFixup {
+   long at;
+   string symbol;
+   long addend;
+   bool isRelative;
+   long end;
+};
+
+// an operand: a register (or vector register) of the given bits, an immediate
+//    value or symbol, or memory at a symbol or displacement from a base
+//    register, plus an index register times the scale, or from the next
+//    instruction for %rip
+struct jitOperand {
+   enum { Register, Vector, Immediate, Memory } kind;
+   int reg;
+   int bits;
+   long value;
+   string symbol;
+   int base;
+   int index;
+   int scale;
+   bool isRipRelative;
+};
+
+static vector<unsigned char> sectionBytes[IgnoredSection + 1];
+static long bssBytes = 0;
+static jitSection section = TextSection;
+
+static unordered_map<string, jitSymbol> symbols;
+static vector<jitFixup> fixups;
+
+// the fixups of the instruction being encoded, which end with it
+static size_t instructionFixups = 0;
+
+// how many times each numbered local label (as in "1:") has been defined so far
+static unordered_map<string, int> localLabels;
+
+// the bytes of a stub jumping to a function of the runtime, through its address
+static const int StubBytes = 14;
+
+static const long PageBytes = 4096;
+
+static const char *registerNames64[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+   "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+static const char *registerNames32[] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+   "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+static const char *registerNames8[] = {"al", "cl", "dl", "bl"};
+
+// the condition codes of jumps, sets and conditional moves
+static const unordered_map<string, int> conditionCodes = {
+   {"o", 0}, {"no", 1}, {"b", 2}, {"c", 2}, {"nae", 2}, {"ae", 3}, {"nb", 3}, {"nc", 3},
+   {"e", 4}, {"z", 4}, {"ne", 5}, {"nz", 5}, {"be", 6}, {"na", 6}, {"a", 7}, {"nbe", 7},
+   {"s", 8}, {"ns", 9}, {"p", 10}, {"pe", 10}, {"np", 11}, {"po", 11},
+   {"l", 12}, {"nge", 12}, {"ge", 13}, {"nl", 13}, {"le", 14}, {"ng", 14}, {"g", 15}, {"nle", 15},
+};
+
+// the arithmetic instructions sharing one pattern of encodings: the ModRM
+//    digit of their immediate forms, and their first opcode
+static const unordered_map<string, pair<int, int>> arithmeticOps = {
+   {"add", {0, 0x00}}, {"or", {1, 0x08}}, {"and", {4, 0x20}},
+   {"sub", {5, 0x28}}, {"xor", {6, 0x30}}, {"cmp", {7, 0x38}},
+};
+
+// the scalar double instructions, by their prefix and opcode after 0F,
+//    which take their destination as the register of the ModRM byte
+static const unordered_map<string, pair<int, int>> vectorOps = {
+   {"addsd", {0xf2, 0x58}}, {"mulsd", {0xf2, 0x59}}, {"subsd", {0xf2, 0x5c}}, {"divsd", {0xf2, 0x5e}},
+   {"xorpd", {0x66, 0x57}}, {"ucomisd", {0x66, 0x2e}}, {"movapd", {0x66, 0x28}},
+};
+
+
+// --- reading the assembly -------------------------------------------------
+
+static void printJitError(const string &message, const string &line)
+{
+   cerr << "Error: " << message << ": " << line << "\n";
+}
+
+
+// returns the text with spaces and tabs taken off both ends
+static string trimmed(const string &text)
+{
+   size_t first = text.find_first_not_of(" \t");
+   if (first == string::npos) return "";
+   size_t last = text.find_last_not_of(" \t");
+   return text.substr(first, last - first + 1);
+}
+
+
+// returns the operands of an instruction, split at the commas outside brackets
+static vector<string> splitOperands(const string &text)
+{
+   vector<string> parts;
+   string part = "";
+   int depth = 0;
+   for (char c : text) {
+      if (c == '(') depth++;
+      if (c == ')') depth--;
+      if (c == ',' && depth == 0) {
+         parts.push_back(trimmed(part));
+         part = "";
+      } else {
+         part += c;
+      }
+   }
+   if (trimmed(part) != "") parts.push_back(trimmed(part));
+   return parts;
+}
+
+
+// returns the name a label is kept under, telling numbered local labels
+//    apart by how many of the same number came before, with "1f" naming the
+//    next "1:" and "1b" the last
+static string labelName(const string &label, bool isDefinition)
+{
+   if (label.empty() || !isdigit((unsigned char)label[0])) return label;
+
+   string number = label;
+   int count = localLabels[label];
+   if (isDefinition) {
+      count = ++localLabels[label];
+   } else if (label.back() == 'f' || label.back() == 'b') {
+      number = label.substr(0, label.length() - 1);
+      count = localLabels[number] + (label.back() == 'f' ? 1 : 0);
+   }
+   return number + "@" + to_string(count);
+}
+
+
+// returns the number of the named register, and its size in bits,
+//    or false if it is not one
+static bool findRegister(const string &name, int &reg, int &bits, bool &isVector)
+{
+   isVector = false;
+   for (int i = 0; i < 16; i++) {
+      if (name == registerNames64[i]) {
+         reg = i;
+         bits = 64;
+         return true;
+      } else if (name == registerNames32[i]) {
+         reg = i;
+         bits = 32;
+         return true;
+      } else if (i < 4 && name == registerNames8[i]) {
+         reg = i;
+         bits = 8;
+         return true;
+      }
+   }
+   if (name.compare(0, 3, "xmm") == 0 && name.length() > 3) {
+      reg = atoi(name.c_str() + 3);
+      bits = 128;
+      isVector = true;
+      return reg >= 0 && reg < 16;
+   }
+   return false;
+}
+
+
+// read a number or a symbol, with any added or subtracted number
+static void readValue(const string &text, long &value, string &symbol)
+{
+   value = 0;
+   symbol = "";
+   if (text.empty()) return;
+
+   size_t split = string::npos;
+   if (!isdigit((unsigned char)text[0]) && text[0] != '-') {
+      split = text.find_first_of("+-", 1);
+      symbol = labelName(text.substr(0, split), false);
+      if (split == string::npos) return;
+   }
+   string number = (split == string::npos) ? text : text.substr(split);
+   if (number[0] == '+') number = number.substr(1);
+   value = (number[0] == '-') ? strtol(number.c_str(), nullptr, 0) : (long)strtoul(number.c_str(), nullptr, 0);
+}
+
+
+// read an operand of an instruction
+// returns false if it is not one the encoder knows
+static bool readOperand(const string &text, jitOperand &operand)
+{
+   operand = {jitOperand::Immediate, 0, 0, 0, "", -1, -1, 1, false};
+   if (text.empty()) return false;
+
+   bool isVector = false;
+   if (text[0] == '%') {
+      if (!findRegister(text.substr(1), operand.reg, operand.bits, isVector)) return false;
+      operand.kind = isVector ? jitOperand::Vector : jitOperand::Register;
+      return true;
+   }
+   if (text[0] == '$') {
+      readValue(text.substr(1), operand.value, operand.symbol);
+      return true;
+   }
+
+   operand.kind = jitOperand::Memory;
+   size_t open = text.find('(');
+   readValue(text.substr(0, open), operand.value, operand.symbol);
+   if (open == string::npos) return true;
+
+   size_t close = text.find(')', open);
+   if (close == string::npos) return false;
+   vector<string> parts;
+   string inside = text.substr(open + 1, close - open - 1);
+   size_t start = 0;
+   for (;;) {
+      size_t comma = inside.find(',', start);
+      parts.push_back(trimmed(inside.substr(start, comma == string::npos ? string::npos : comma - start)));
+      if (comma == string::npos) break;
+      start = comma + 1;
+   }
+
+   int bits = 0;
+   if (parts[0] == "%rip") {
+      operand.isRipRelative = true;
+   } else if (parts[0] != "" && (parts[0][0] != '%' || !findRegister(parts[0].substr(1), operand.base, bits, isVector))) {
+      return false;
+   }
+   if (parts.size() > 1 && (parts[1].empty() || !findRegister(parts[1].substr(1), operand.index, bits, isVector))) {
+      return false;
+   }
+   if (parts.size() > 2) operand.scale = atoi(parts[2].c_str());
+   return true;
+}
+
+
+// --- encoding -----------------------------------------------------------------
+
+static void emitByte(int byte)
+{
+   sectionBytes[section].push_back((unsigned char)byte);
+}
+
+
+static void emitBytes(long value, int count)
+{
+   for (int i = 0; i < count; i++) emitByte((int)((value >> (8 * i)) & 0xff));
+}
+
+
+// leave four bytes for the address of the symbol, or its distance from the end
+//    of the instruction, filled in once the program is laid out
+static void emitFixup(const string &symbol, long addend, bool isRelative)
+{
+   fixups.push_back({(long)sectionBytes[section].size(), symbol, addend, isRelative, 0});
+   emitBytes(0, 4);
+}
+
+
+// emit a four byte immediate value, or the value of its symbol
+static void emitImmediate32(const jitOperand &operand)
+{
+   if (operand.symbol != "") {
+      emitFixup(operand.symbol, operand.value, false);
+   } else {
+      emitBytes(operand.value, 4);
+   }
+}
+
+
+// mark the end of the instruction, from which its relative fixups are measured
+static void finishInstruction()
+{
+   for (size_t i = instructionFixups; i < fixups.size(); i++) {
+      fixups[i].end = (long)sectionBytes[section].size();
+   }
+   instructionFixups = fixups.size();
+}
+
+
+static bool fitsByte(long value)
+{
+   return value >= -128 && value <= 127;
+}
+
+
+// emit an instruction with a ModRM byte: its mandatory prefix if any, the REX
+//    prefix if it is wide or uses the upper registers, the opcode, and the
+//    ModRM byte with reg and the register or memory operand rm
+static bool emitModRM(int prefix, bool isWide, const vector<int> &opcode, int reg, const jitOperand &rm)
+{
+   int rex = (isWide ? 8 : 0) | ((reg & 8) ? 4 : 0);
+   if (rm.kind == jitOperand::Register || rm.kind == jitOperand::Vector) {
+      rex |= (rm.reg & 8) ? 1 : 0;
+   } else if (rm.kind == jitOperand::Memory) {
+      rex |= (rm.index >= 0 && (rm.index & 8)) ? 2 : 0;
+      rex |= (rm.base >= 0 && (rm.base & 8)) ? 1 : 0;
+   } else {
+      return false;
+   }
+
+   if (prefix) emitByte(prefix);
+   if (rex) emitByte(0x40 | rex);
+   for (int byte : opcode) emitByte(byte);
+
+   reg &= 7;
+   if (rm.kind != jitOperand::Memory) {
+      emitByte(0xc0 | (reg << 3) | (rm.reg & 7));
+      return true;
+   }
+
+   int scale = (rm.scale == 8) ? 3 : (rm.scale == 4) ? 2 : (rm.scale == 2) ? 1 : 0;
+   if (rm.isRipRelative) {
+      emitByte((reg << 3) | 5);
+      emitFixup(rm.symbol, rm.value, true);
+      return true;
+   }
+   if (rm.base < 0) {
+      // an absolute address, which the program's low mapping keeps in 32 bits
+      emitByte((reg << 3) | 4);
+      emitByte((scale << 6) | ((rm.index >= 0 ? rm.index & 7 : 4) << 3) | 5);
+      emitImmediate32(rm);
+      return true;
+   }
+   if (rm.symbol != "") return false;
+
+   int mod = (rm.value == 0 && (rm.base & 7) != 5) ? 0 : fitsByte(rm.value) ? 1 : 2;
+   if (rm.index >= 0 || (rm.base & 7) == 4) {
+      emitByte((mod << 6) | (reg << 3) | 4);
+      emitByte((scale << 6) | ((rm.index >= 0 ? rm.index & 7 : 4) << 3) | (rm.base & 7));
+   } else {
+      emitByte((mod << 6) | (reg << 3) | (rm.base & 7));
+   }
+   if (mod == 1) emitBytes(rm.value, 1);
+   if (mod == 2) emitBytes(rm.value, 4);
+   return true;
+}
+
+
+// emit a jump or call to the label, measured from the end of the instruction
+static void emitBranch(const vector<int> &opcode, const string &label)
+{
+   for (int byte : opcode) emitByte(byte);
+   emitFixup(labelName(label, false), 0, true);
+}
+
+
+// emit an instruction whose opcode names its register, as push and pop do
+static void emitRegisterOpcode(bool isWide, int opcode, int reg)
+{
+   int rex = (isWide ? 8 : 0) | ((reg & 8) ? 1 : 0);
+   if (rex) emitByte(0x40 | rex);
+   emitByte(opcode + (reg & 7));
+}
+
+
+// returns the size in bits of the operation, from its general registers, or
+//    else from the size letter ending its mnemonic, or 0 if neither says
+static int operationBits(const string &mnemonic, const vector<jitOperand> &operands)
+{
+   for (const jitOperand &operand : operands) {
+      if (operand.kind == jitOperand::Register) return operand.bits;
+   }
+   char suffix = mnemonic.back();
+   return (suffix == 'q') ? 64 : (suffix == 'l') ? 32 : (suffix == 'b') ? 8 : 0;
+}
+
+
+// encode an instruction with its operands in AT&T order, source first
+// returns false if the encoder does not know it
+static bool encodeInstruction(string mnemonic, const string &operandText)
+{
+   if (mnemonic == "rep") {
+      if (operandText == "stosq") emitBytes(0xab48f3, 3);
+      else if (operandText == "movsq") emitBytes(0xa548f3, 3);
+      else return false;
+      return true;
+   }
+   if (mnemonic == "ret") return emitByte(0xc3), true;
+   if (mnemonic == "leave") return emitByte(0xc9), true;
+   if (mnemonic == "cqo") return emitBytes(0x9948, 2), true;
+   if (mnemonic == "nop") return emitByte(0x90), true;
+   if (mnemonic == "hlt") return emitByte(0xf4), true;
+
+   if (mnemonic == "jmp") return emitBranch({0xe9}, operandText), true;
+   if (mnemonic == "call") return emitBranch({0xe8}, operandText), true;
+   if (mnemonic[0] == 'j' && conditionCodes.count(mnemonic.substr(1))) {
+      emitBranch({0x0f, 0x80 + conditionCodes.at(mnemonic.substr(1))}, operandText);
+      return true;
+   }
+
+   vector<jitOperand> operands;
+   for (const string &text : splitOperands(operandText)) {
+      jitOperand operand;
+      if (!readOperand(text, operand)) return false;
+      operands.push_back(operand);
+   }
+   int bits = operationBits(mnemonic, operands);
+   bool isWide = (bits == 64);
+
+   // the size letter is left off once it has given the size
+   static const vector<string> sized = {"add", "or", "and", "sub", "xor", "cmp", "mov", "test",
+      "inc", "dec", "neg", "idiv", "shl", "imul", "lea", "push", "pop"};
+   string base = mnemonic;
+   if (base != "movq" && (base.back() == 'q' || base.back() == 'l')) {
+      string shorter = base.substr(0, base.length() - 1);
+      if (find(sized.begin(), sized.end(), shorter) != sized.end()) base = shorter;
+   }
+
+   if (operands.size() == 1) {
+      const jitOperand &target = operands[0];
+      if (base == "push" && target.kind == jitOperand::Register) return emitRegisterOpcode(false, 0x50, target.reg), true;
+      if (base == "pop" && target.kind == jitOperand::Register) return emitRegisterOpcode(false, 0x58, target.reg), true;
+      if (bits == 0) return false;
+
+      if (base == "inc") return emitModRM(0, isWide, {0xff}, 0, target);
+      if (base == "dec") return emitModRM(0, isWide, {0xff}, 1, target);
+      if (base == "neg") return emitModRM(0, isWide, {0xf7}, 3, target);
+      if (base == "idiv") return emitModRM(0, isWide, {0xf7}, 7, target);
+      if (base.compare(0, 3, "set") == 0 && conditionCodes.count(base.substr(3))) {
+         return emitModRM(0, false, {0x0f, 0x90 + conditionCodes.at(base.substr(3))}, 0, target);
+      }
+      return false;
+   }
+   if (operands.size() != 2) return false;
+
+   const jitOperand &source = operands[0];
+   const jitOperand &target = operands[1];
+   bool isVector = (source.kind == jitOperand::Vector || target.kind == jitOperand::Vector);
+
+   if (vectorOps.count(base)) {
+      if (target.kind != jitOperand::Vector) return false;
+      return emitModRM(vectorOps.at(base).first, false, {0x0f, vectorOps.at(base).second}, target.reg, source);
+   }
+   if (base == "movsd") {
+      if (target.kind == jitOperand::Vector) return emitModRM(0xf2, false, {0x0f, 0x10}, target.reg, source);
+      return source.kind == jitOperand::Vector && emitModRM(0xf2, false, {0x0f, 0x11}, source.reg, target);
+   }
+   if (base == "movq" && isVector) {
+      if (target.kind == jitOperand::Vector) return emitModRM(0x66, true, {0x0f, 0x6e}, target.reg, source);
+      return emitModRM(0x66, true, {0x0f, 0x7e}, source.reg, target);
+   }
+   if (base == "cvtsi2sdq" || base == "cvtsi2sd") {
+      return target.kind == jitOperand::Vector && emitModRM(0xf2, true, {0x0f, 0x2a}, target.reg, source);
+   }
+   if (base == "cvttsd2si" || base == "cvttsd2siq") {
+      return target.kind == jitOperand::Register && emitModRM(0xf2, true, {0x0f, 0x2c}, target.reg, source);
+   }
+   if (base == "movzbl") {
+      return target.kind == jitOperand::Register && emitModRM(0, false, {0x0f, 0xb6}, target.reg, source);
+   }
+   if (base == "lea") {
+      return target.kind == jitOperand::Register && emitModRM(0, isWide, {0x8d}, target.reg, source);
+   }
+   if (base.compare(0, 4, "cmov") == 0 && conditionCodes.count(base.substr(4))) {
+      return target.kind == jitOperand::Register
+         && emitModRM(0, isWide, {0x0f, 0x40 + conditionCodes.at(base.substr(4))}, target.reg, source);
+   }
+   if (base == "movabs") {
+      if (target.kind != jitOperand::Register || source.kind != jitOperand::Immediate) return false;
+      emitRegisterOpcode(true, 0xb8, target.reg);
+      emitBytes(source.value, 8);
+      return true;
+   }
+   if (bits == 0) return false;
+
+   if (base == "mov" || base == "movq") {
+      if (source.kind == jitOperand::Immediate && target.kind == jitOperand::Register && !isWide) {
+         emitRegisterOpcode(false, 0xb8, target.reg);
+         emitImmediate32(source);
+         return true;
+      }
+      if (source.kind == jitOperand::Immediate) {
+         if (!emitModRM(0, isWide, {0xc7}, 0, target)) return false;
+         emitImmediate32(source);
+         return true;
+      }
+      if (source.kind == jitOperand::Register) return emitModRM(0, isWide, {bits == 8 ? 0x88 : 0x89}, source.reg, target);
+      return target.kind == jitOperand::Register && emitModRM(0, isWide, {bits == 8 ? 0x8a : 0x8b}, target.reg, source);
+   }
+   if (arithmeticOps.count(base)) {
+      int digit = arithmeticOps.at(base).first;
+      int opcode = arithmeticOps.at(base).second;
+      if (source.kind == jitOperand::Immediate) {
+         bool isShort = (bits == 8 || (source.symbol == "" && fitsByte(source.value)));
+         if (!emitModRM(0, isWide, {bits == 8 ? 0x80 : isShort ? 0x83 : 0x81}, digit, target)) return false;
+         if (isShort) {
+            emitBytes(source.value, 1);
+         } else {
+            emitImmediate32(source);
+         }
+         return true;
+      }
+      if (source.kind == jitOperand::Register) return emitModRM(0, isWide, {opcode + (bits == 8 ? 0 : 1)}, source.reg, target);
+      return target.kind == jitOperand::Register && emitModRM(0, isWide, {opcode + (bits == 8 ? 2 : 3)}, target.reg, source);
+   }
+   if (base == "test") {
+      if (source.kind == jitOperand::Immediate) {
+         if (!emitModRM(0, isWide, {0xf7}, 0, target)) return false;
+         emitImmediate32(source);
+         return true;
+      }
+      return source.kind == jitOperand::Register && emitModRM(0, isWide, {bits == 8 ? 0x84 : 0x85}, source.reg, target);
+   }
+   if (base == "imul") {
+      if (target.kind != jitOperand::Register) return false;
+      if (source.kind == jitOperand::Immediate) {
+         if (!emitModRM(0, isWide, {0x69}, target.reg, target)) return false;
+         emitImmediate32(source);
+         return true;
+      }
+      return emitModRM(0, isWide, {0x0f, 0xaf}, target.reg, source);
+   }
+   if (base == "shl" && source.kind == jitOperand::Immediate) {
+      if (!emitModRM(0, isWide, {0xc1}, 4, target)) return false;
+      emitBytes(source.value, 1);
+      return true;
+   }
+   return false;
+}
+
+
+// pad the section to a multiple of the alignment, unless that would take
+//    more than most bytes; code is padded with no-ops
+static void alignSection(long alignment, long most)
+{
+   long size = (section == BssSection) ? bssBytes : (long)sectionBytes[section].size();
+   long padding = (alignment - size % alignment) % alignment;
+   if (padding > most) return;
+   if (section == BssSection) {
+      bssBytes += padding;
+   } else {
+      for (long i = 0; i < padding; i++) emitByte(section == TextSection ? 0x90 : 0);
+   }
+}
+
+
+// carry out an assembler directive
+// returns false if the directive is not one the encoder knows
+static bool readDirective(const string &directive, const string &rest)
+{
+   vector<string> arguments = splitOperands(rest);
+
+   if (directive == ".text") {
+      section = TextSection;
+   } else if (directive == ".data") {
+      section = DataSection;
+   } else if (directive == ".bss") {
+      section = BssSection;
+   } else if (directive == ".section") {
+      section = (arguments.size() > 0 && arguments[0] == ".rodata") ? RodataSection : IgnoredSection;
+   } else if (directive == ".balign" && arguments.size() == 1) {
+      alignSection(atol(arguments[0].c_str()), PageBytes);
+   } else if (directive == ".p2align" && arguments.size() >= 1) {
+      long most = (arguments.size() == 3) ? atol(arguments[2].c_str()) : PageBytes;
+      alignSection(1l << atol(arguments[0].c_str()), most);
+   } else if (directive == ".set" && arguments.size() == 2) {
+      symbols[arguments[0]] = {TextSection, strtol(arguments[1].c_str(), nullptr, 0), true};
+   } else if (directive == ".zero" && arguments.size() == 1) {
+      if (section == BssSection) {
+         bssBytes += atol(arguments[0].c_str());
+      } else {
+         for (long i = 0; i < atol(arguments[0].c_str()); i++) emitByte(0);
+      }
+   } else if (directive == ".quad") {
+      for (const string &argument : arguments) {
+         long value = 0;
+         string symbol = "";
+         readValue(argument, value, symbol);
+         if (symbol != "") return false;
+         emitBytes(value, 8);
+      }
+   } else if (directive == ".ascii") {
+      string quoted = trimmed(rest);
+      for (size_t i = 1; i + 1 < quoted.length(); i++) {
+         if (quoted[i] != '\\') {
+            emitByte(quoted[i]);
+         } else if (isdigit((unsigned char)quoted[i + 1])) {
+            int value = 0;
+            for (int digits = 0; digits < 3 && isdigit((unsigned char)quoted[i + 1]); digits++) {
+               value = value * 8 + (quoted[++i] - '0');
+            }
+            emitByte(value);
+         } else {
+            emitByte(quoted[++i]);
+         }
+      }
+   } else if (directive != ".globl" && directive != ".type" && directive != ".size"
+      && directive != ".file" && directive != ".loc") {
+      return false;
+   }
+   return true;
+}
+
+
+// encode the assembly written by assemble
+// returns false, after reporting the line, if any of it cannot be encoded
+static bool encodeAssembly(const string &assembly)
+{
+   istringstream lines(assembly);
+   string line;
+
+   while (getline(lines, line)) {
+      line = trimmed(line);
+      if (line.empty()) continue;
+
+      if (line.back() == ':') {
+         string name = labelName(line.substr(0, line.length() - 1), true);
+         long offset = (section == BssSection) ? bssBytes : (long)sectionBytes[section].size();
+         symbols[name] = {section, offset, false};
+         continue;
+      }
+
+      size_t space = line.find_first_of(" \t");
+      string first = line.substr(0, space);
+      string rest = (space == string::npos) ? "" : trimmed(line.substr(space));
+
+      if (first[0] == '.') {
+         if (!readDirective(first, rest)) {
+            printJitError("unable to run directive", line);
+            return false;
+         }
+         continue;
+      }
+
+      if (section != TextSection || !encodeInstruction(first, rest)) {
+         printJitError("unable to run instruction", line);
+         return false;
+      }
+      finishInstruction();
+   }
+   return true;
+}
+
+
+// --- loading and running --------------------------------------------------------
+
+// returns the size rounded up to a multiple of the alignment
+static long roundUp(long size, long alignment)
+{
+   return (size + alignment - 1) / alignment * alignment;
+}
+
+
+// lay the encoded program out in memory below 2 GiB, where absolute addresses
+//    fit the 32 bits the assembly gives them, fill in the addresses of its
+//    labels and the runtime, and make its code executable in place of writable
+// returns the address of the main routine, or 0 if the program cannot be loaded
+static long loadProgram(void *&memory, long &memoryBytes)
+{
+   // calls out to the runtime go through stubs holding its full addresses
+   unordered_map<string, long> stubs;
+   section = TextSection;
+   for (const jitFixup &fixup : fixups) {
+      if (!fixup.isRelative || symbols.count(fixup.symbol) || stubs.count(fixup.symbol)) continue;
+      auto function = runtimeFunctions.find(fixup.symbol);
+      if (function == runtimeFunctions.end()) {
+         cerr << "Error: undefined symbol " << fixup.symbol << "\n";
+         return 0;
+      }
+      stubs[fixup.symbol] = (long)sectionBytes[TextSection].size();
+      emitBytes(0x25ff, 2);
+      emitBytes(0, 4);
+      emitBytes(function->second, 8);
+   }
+
+   long starts[4];
+   starts[TextSection] = 0;
+   starts[RodataSection] = roundUp((long)sectionBytes[TextSection].size(), PageBytes);
+   starts[DataSection] = roundUp(starts[RodataSection] + (long)sectionBytes[RodataSection].size(), 16);
+   starts[BssSection] = roundUp(starts[DataSection] + (long)sectionBytes[DataSection].size(), 16);
+   memoryBytes = roundUp(starts[BssSection] + bssBytes, PageBytes);
+
+   memory = mmap(nullptr, memoryBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+   if (memory == MAP_FAILED) {
+      cerr << "Error: unable to map " << memoryBytes << " bytes for the program\n";
+      return 0;
+   }
+   unsigned char *base = (unsigned char *)memory;
+   for (int part = TextSection; part <= DataSection; part++) {
+      if (!sectionBytes[part].empty()) memcpy(base + starts[part], sectionBytes[part].data(), sectionBytes[part].size());
+   }
+
+   for (const jitFixup &fixup : fixups) {
+      long address = 0;
+      auto symbol = symbols.find(fixup.symbol);
+      if (symbol != symbols.end()) {
+         address = symbol->second.offset + (symbol->second.isAbsolute ? 0 : (long)base + starts[symbol->second.section]);
+      } else if (fixup.isRelative) {
+         address = (long)base + stubs[fixup.symbol];
+      } else {
+         cerr << "Error: undefined symbol " << fixup.symbol << "\n";
+         return 0;
+      }
+
+      long value = address + fixup.addend - (fixup.isRelative ? (long)base + fixup.end : 0);
+      if (value != (int)value) {
+         cerr << "Error: address of " << fixup.symbol << " out of range\n";
+         return 0;
+      }
+      int field = (int)value;
+      memcpy(base + fixup.at, &field, 4);
+   }
+
+   if (mprotect(memory, starts[RodataSection], PROT_READ | PROT_EXEC) != 0) {
+      cerr << "Error: unable to make the program executable\n";
+      return 0;
+   }
+
+   auto entry = symbols.find("vurb_main");
+   return (entry == symbols.end()) ? 0 : (long)base + entry->second.offset;
+}
+
+
+// translate the token sequence to x86-64 machine code in memory, through the
+//    assembly written by assemble, and run it within the translator,
+//    with the program reading standard input and writing standard output
+// returns the program's exit status, or -1 if it cannot be translated
+int runProgram(token tokens[], int size)
+{
+   // the assembly is kept rather than written out
+   ostringstream assembly;
+   streambuf *output = cout.rdbuf(assembly.rdbuf());
+   bool isTranslated = assemble(tokens, size);
+   cout.rdbuf(output);
+
+   if (!isTranslated || !encodeAssembly(assembly.str())) return -1;
+
+   void *memory = nullptr;
+   long memoryBytes = 0;
+   long entry = loadProgram(memory, memoryBytes);
+   if (entry == 0) return -1;
+
+   long status = vurb_run(reinterpret_cast<long (*)()>(entry));
+   munmap(memory, memoryBytes);
+   return (int)status;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "tokenizing.h"
+
+
+// translate the token sequence to x86-64 machine code in memory, through the
+//    assembly written by assemble, and run it within the translator,
+//    with the program reading standard input and writing standard output
+// returns the program's exit status, or -1 if it cannot be translated
+int runProgram(token tokens[], int size);
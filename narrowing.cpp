@@ -0,0 +1,536 @@
+#include "narrowing.h"
+#include "analyzing.h"
+#include "parsing.h"
+#include "symbols.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+
+// the values an integer may hold, from lo to hi; a range with lo above hi
+//    holds no values, and a bound of LONG_MIN or LONG_MAX stands for no bound
+struct valueRange {
+   long lo;
+   long hi;
+};
+
+const valueRange NoValues = {LONG_MAX, LONG_MIN};
+const valueRange AnyValue = {LONG_MIN, LONG_MAX};
+
+// a range that keeps growing after this many widenings has its growing bound dropped
+const int MaxRangeChanges = 8;
+
+// the largest integer a float holds exactly, along with every integer below it
+const long FloatExactInteger = 1L << 24;
+
+
+// a value stored into an integer variable or array element, by a set statement,
+//    an arrayset statement or the argument of a call
+struct rangeFlow {
+   string target;
+   bool isElement;
+   int valuePos;
+};
+
+// a step of an integer variable up or down by one, bounded by the limit of the
+//    counted loop it steps if it is that loop's only write to the variable
+struct rangeStep {
+   string target;
+   bool isUp;
+   int limitPos;
+   bool isInclusive;
+};
+
+
+// the ranges of the integer variables, keyed by scope and name
+static unordered_map<string, valueRange> variableRanges;
+
+// the ranges of the elements of the integer arrays, keyed by name
+static unordered_map<string, valueRange> elementRanges;
+
+// whether every value stored in each real array is exactly a float, keyed by name
+static unordered_map<string, bool> floatExactArrays;
+
+// the number of times each range has grown, keyed by variable key or array name
+static unordered_map<string, int> rangeChanges;
+
+// the names declared by each body, keyed by procedure name or main
+static unordered_map<string, unordered_map<string, bool>> localNames;
+
+// the number of global and local declarations of each array name, and the
+//    literal size of each, or -1 if it is sized as the program runs
+static unordered_map<string, int> arrayDeclarations;
+static unordered_map<string, long> arraySizes;
+
+// the arrays which may be reached other than by their own name
+static unordered_map<string, bool> fixedArrays;
+
+// the C++ element type chosen for each narrowed array
+static unordered_map<string, string> narrowTypes;
+
+
+// returns the key of the integer variable named at currPos: the body declaring
+//    it, or nothing for a global, followed by its name
+static string variableKey(int currPos, string name)
+{
+   const procedureInfo *proc = enclosingProcedure(currPos);
+   string scope = proc ? proc->name : "main";
+   if (localNames[scope].count(name)) return scope + " " + name;
+   return " " + name;
+}
+
+
+static bool isEmpty(valueRange range)
+{
+   return range.lo > range.hi;
+}
+
+
+static valueRange joinRanges(valueRange first, valueRange second)
+{
+   return {std::min(first.lo, second.lo), std::max(first.hi, second.hi)};
+}
+
+
+// the largest magnitude of a value in the range, or LONG_MAX if unbounded
+static long magnitude(valueRange range)
+{
+   if (range.lo == LONG_MIN || range.hi == LONG_MAX) return LONG_MAX;
+   return std::max(std::abs(range.lo), std::abs(range.hi));
+}
+
+
+static valueRange negateRange(valueRange range)
+{
+   if (isEmpty(range)) return NoValues;
+   return {range.hi == LONG_MAX ? LONG_MIN : -range.hi, range.lo == LONG_MIN ? LONG_MAX : -range.lo};
+}
+
+
+static valueRange addRanges(valueRange first, valueRange second)
+{
+   if (isEmpty(first) || isEmpty(second)) return NoValues;
+
+   valueRange sum;
+   if (first.lo == LONG_MIN || second.lo == LONG_MIN
+      || __builtin_add_overflow(first.lo, second.lo, &sum.lo)) sum.lo = LONG_MIN;
+   if (first.hi == LONG_MAX || second.hi == LONG_MAX
+      || __builtin_add_overflow(first.hi, second.hi, &sum.hi)) sum.hi = LONG_MAX;
+   return sum;
+}
+
+
+static valueRange multiplyRanges(valueRange first, valueRange second)
+{
+   if (isEmpty(first) || isEmpty(second)) return NoValues;
+
+   long corners[] = {first.lo, first.hi};
+   long others[] = {second.lo, second.hi};
+   valueRange product = NoValues;
+
+   for (int i = 0; i < 2; i++) {
+      for (int j = 0; j < 2; j++) {
+         long value;
+         if (corners[i] == LONG_MIN || corners[i] == LONG_MAX || others[j] == LONG_MIN
+            || others[j] == LONG_MAX || __builtin_mul_overflow(corners[i], others[j], &value)) return AnyValue;
+         product = joinRanges(product, {value, value});
+      }
+   }
+   return product;
+}
+
+
+// a quotient is never further from zero than its dividend
+static valueRange divideRanges(valueRange dividend, valueRange divisor)
+{
+   if (isEmpty(dividend) || isEmpty(divisor)) return NoValues;
+
+   long most = magnitude(dividend);
+   if (most == LONG_MAX) return AnyValue;
+   if (dividend.lo >= 0 && divisor.lo >= 0) return {0, dividend.hi};
+   return {-most, most};
+}
+
+
+// a remainder takes the sign of its dividend, and is nearer zero than both
+//    the dividend and the divisor
+static valueRange remainderRanges(valueRange dividend, valueRange divisor)
+{
+   if (isEmpty(dividend) || isEmpty(divisor)) return NoValues;
+
+   long most = magnitude(divisor);
+   if (most != LONG_MAX && most > 0) most--;
+   most = std::min(most, magnitude(dividend));
+
+   return {dividend.lo >= 0 ? 0 : -most, dividend.hi <= 0 ? 0 : most};
+}
+
+
+// find the range of the integer expression at currPos, from the ranges so far
+static valueRange expressionRange(token tokens[], int currPos, int size)
+{
+   if (currPos < 0 || currPos >= size) return AnyValue;
+
+   const token &tok = tokens[currPos];
+
+   if (tok.ttype == TokenType::IntLit) {
+      errno = 0;
+      long value = std::strtol(tok.content.c_str(), nullptr, 10);
+      if (errno == ERANGE) return AnyValue;
+      return {value, value};
+   }
+
+   if (tok.ttype == TokenType::Identifier) {
+      auto it = variableRanges.find(variableKey(currPos, tok.content));
+      return (it != variableRanges.end()) ? it->second : AnyValue;
+   }
+
+   if (tok.ttype == TokenType::ArrayAccess) {
+      if (currPos + 1 >= size || tokens[currPos + 1].ttype != TokenType::Identifier) return AnyValue;
+      string name = tokens[currPos + 1].content;
+      auto it = elementRanges.find(name);
+      if (it == elementRanges.end() || fixedArrays.count(name)) return AnyValue;
+      return it->second;
+   }
+
+   if (tok.ttype == TokenType::ArraySize) {
+      if (currPos + 1 < size && tokens[currPos + 1].ttype == TokenType::Identifier
+         && !fixedArrays.count(tokens[currPos + 1].content)) {
+         auto it = arraySizes.find(tokens[currPos + 1].content);
+         if (it != arraySizes.end() && it->second >= 0) return {it->second, it->second};
+      }
+      return {0, LONG_MAX};
+   }
+
+   if (tok.ttype != TokenType::Left || currPos + 2 >= size) return AnyValue;
+
+   TokenType op = tokens[currPos + 1].ttype;
+   if (op == TokenType::Negate) {
+      return negateRange(expressionRange(tokens, currPos + 2, size));
+   }
+
+   if (op != TokenType::Add && op != TokenType::Sub && op != TokenType::Mul
+      && op != TokenType::Div && op != TokenType::Rem) return AnyValue;
+
+   int secondPos = skipExpression(tokens, currPos + 2, size) + 1;
+   if (secondPos == 0) return AnyValue;
+
+   valueRange first = expressionRange(tokens, currPos + 2, size);
+   valueRange second = expressionRange(tokens, secondPos, size);
+
+   switch (op) {
+      case Add: return addRanges(first, second);
+      case Sub: return addRanges(first, negateRange(second));
+      case Mul: return multiplyRanges(first, second);
+      case Div: return divideRanges(first, second);
+      default: return remainderRanges(first, second);
+   }
+}
+
+
+// returns true if the real expression at currPos always gives a value that
+//    a float holds exactly
+static bool isFloatExact(token tokens[], int currPos, int size)
+{
+   const token &tok = tokens[currPos];
+
+   if (tok.ttype == TokenType::RealLit) {
+      double value = std::strtod(tok.content.c_str(), nullptr);
+      return (double)(float)value == value;
+   }
+
+   if (tok.ttype == TokenType::IntLit) {
+      errno = 0;
+      long value = std::strtol(tok.content.c_str(), nullptr, 10);
+      return (errno != ERANGE && value >= -FloatExactInteger && value <= FloatExactInteger);
+   }
+
+   if (tok.ttype == TokenType::ArrayAccess && currPos + 1 < size
+      && tokens[currPos + 1].ttype == TokenType::Identifier) {
+      string name = tokens[currPos + 1].content;
+      auto it = floatExactArrays.find(name);
+      return (it != floatExactArrays.end() && it->second && !fixedArrays.count(name));
+   }
+
+   return false;
+}
+
+
+// grow a range to take in more values, dropping any bound that keeps moving
+// returns true if the range changed
+static bool widenRange(unordered_map<string, valueRange> &ranges, string key, valueRange values)
+{
+   auto it = ranges.find(key);
+   if (it == ranges.end() || isEmpty(values)) return false;
+
+   valueRange old = it->second;
+   valueRange grown = joinRanges(old, values);
+   if (grown.lo == old.lo && grown.hi == old.hi) return false;
+
+   if (++rangeChanges[key] > MaxRangeChanges) {
+      if (grown.lo < old.lo) grown.lo = LONG_MIN;
+      if (grown.hi > old.hi) grown.hi = LONG_MAX;
+   }
+   it->second = grown;
+   return true;
+}
+
+
+// find the counted loop whose statements step the variable at currPos up or
+//    down, writing it nowhere else, so its limit bounds the variable
+// returns the position of the loop's If token, or -1 if there is none
+static int findSteppedLoop(token tokens[], int currPos, int size, bool isUp)
+{
+   string name = tokens[currPos].content;
+
+   for (int loopPos = currPos - 1; loopPos >= 0; loopPos--) {
+      if (tokens[loopPos].ttype != TokenType::If || loopPos + 4 >= size
+         || tokens[loopPos + 1].ttype != TokenType::Left
+         || tokens[loopPos + 3].ttype != TokenType::Identifier || tokens[loopPos + 3].content != name) continue;
+
+      TokenType op = tokens[loopPos + 2].ttype;
+      bool bounds = isUp ? (op == TokenType::LTOp || op == TokenType::LEOp)
+         : (op == TokenType::GTOp || op == TokenType::GEOp);
+
+      int condEnd = findBracketEnd(tokens, loopPos + 1, size);
+      if (condEnd == -1 || condEnd + 1 >= size) continue;
+      int loopEnd = findBlockEnd(tokens, condEnd + 1, size);
+      if (loopEnd == -1 || loopEnd < currPos) continue;
+
+      // the innermost loop on the variable decides, bounding it or not
+      if (!bounds || skipExpression(tokens, loopPos + 4, size) + 1 != condEnd) return -1;
+
+      // the step must be one of the loop's own statements, run once a pass
+      bool isStatement = false;
+      for (int pos = condEnd + 2; pos < loopEnd; ) {
+         int stmtEnd = skipStatement(tokens, pos, size);
+         if (stmtEnd == -1) return -1;
+         if (pos == currPos - 2 && tokens[pos].ttype == TokenType::Left) isStatement = true;
+         pos = stmtEnd + 1;
+      }
+      if (!isStatement) return -1;
+
+      for (int pos = condEnd + 2; pos < loopEnd; pos++) {
+         if (pos == currPos || tokens[pos].ttype != TokenType::Identifier || tokens[pos].content != name) continue;
+         TokenType prev = tokens[pos - 1].ttype;
+         if (prev == TokenType::Set || prev == TokenType::Read || prev == TokenType::VarDef
+            || isIncrementOperator(prev)) return -1;
+      }
+      return loopPos;
+   }
+   return -1;
+}
+
+
+// work out the range of values every integer variable and array element of the
+//    program can hold, and choose the narrowest C++ element type for each array
+//    whose stored values all fit it
+void planNarrowArrays(token tokens[], int size)
+{
+   vector<rangeFlow> flows;
+   vector<rangeStep> steps;
+   unordered_map<string, TokenType> arrayTypes;
+   unordered_map<string, bool> globals;
+
+   // the declarations of every body and of the program as a whole
+   for (int pos = 0; pos + 1 < size; pos++) {
+      string name;
+      typeInfo type;
+      TokenType tok = tokens[pos].ttype;
+
+      if (tok == TokenType::Element && tokens[pos + 1].ttype == TokenType::Array && pos + 2 < size) {
+         fixedArrays[tokens[pos + 2].content] = true;
+         continue;
+      }
+
+      if (tok == TokenType::ProcDef) {
+         const procedureInfo *proc = findProcedure(tokens[pos + 1].content);
+         for (size_t i = 0; proc && i < proc->params.size(); i++) {
+            const paramInfo &param = proc->params[i];
+            localNames[proc->name][param.name] = true;
+            if (param.isArray) {
+               fixedArrays[param.name] = true;
+            } else if (param.structType.empty() && param.ptype == TokenType::IntType) {
+               variableRanges[proc->name + " " + param.name] = NoValues;
+            }
+         }
+         continue;
+      }
+
+      if ((tok != TokenType::GlobalDef && tok != TokenType::VarDef)
+         || readDeclaration(tokens, pos + 1, size, name, type) == -1) continue;
+
+      const procedureInfo *proc = enclosingProcedure(pos);
+      string scope = proc ? proc->name : "main";
+
+      if (tok == TokenType::GlobalDef) {
+         globals[name] = true;
+      } else {
+         localNames[scope][name] = true;
+      }
+
+      if (type.isArray) {
+         arrayDeclarations[name]++;
+         arrayTypes[name] = type.ttype;
+         arraySizes[name] = (tokens[pos + 4].ttype == TokenType::IntLit) ? std::atol(type.arraySize.c_str()) : -1;
+      } else if (type.ttype == TokenType::IntType) {
+         // globals start out zero, locals as whatever is first stored in them
+         string key = (tok == TokenType::GlobalDef) ? " " + name : scope + " " + name;
+         valueRange start = (tok == TokenType::GlobalDef) ? valueRange{0, 0} : NoValues;
+         variableRanges[key] = variableRanges.count(key) ? joinRanges(variableRanges[key], start) : start;
+      }
+   }
+
+   // a local hiding a global may be taken for it, so neither is bounded
+   for (auto scope = localNames.begin(); scope != localNames.end(); scope++) {
+      for (auto it = scope->second.begin(); it != scope->second.end(); it++) {
+         if (!globals.count(it->first)) continue;
+         if (variableRanges.count(" " + it->first)) variableRanges[" " + it->first] = AnyValue;
+         if (variableRanges.count(scope->first + " " + it->first)) {
+            variableRanges[scope->first + " " + it->first] = AnyValue;
+         }
+         fixedArrays[it->first] = true;
+      }
+   }
+
+   for (auto it = arrayDeclarations.begin(); it != arrayDeclarations.end(); it++) {
+      if (it->second != 1) fixedArrays[it->first] = true;
+      if (arrayTypes[it->first] == TokenType::IntType) elementRanges[it->first] = {0, 0};
+      if (arrayTypes[it->first] == TokenType::RealType) floatExactArrays[it->first] = true;
+   }
+
+   // every place a value is stored
+   for (int pos = 0; pos + 2 < size; pos++) {
+      TokenType tok = tokens[pos].ttype;
+
+      if (tok == TokenType::Set && tokens[pos + 1].ttype == TokenType::Identifier) {
+         flows.push_back({variableKey(pos + 1, tokens[pos + 1].content), false, pos + 2});
+      } else if (tok == TokenType::ArraySet && tokens[pos + 1].ttype == TokenType::Identifier
+         && pos + 3 < size) {
+         flows.push_back({tokens[pos + 1].content, true, pos + 3});
+      } else if (tok == TokenType::Read && tokens[pos + 1].ttype == TokenType::Identifier) {
+         string key = variableKey(pos + 1, tokens[pos + 1].content);
+         if (variableRanges.count(key)) variableRanges[key] = AnyValue;
+      } else if (tok == TokenType::Call && tokens[pos + 1].ttype == TokenType::Identifier) {
+         // arrays passed to a procedure are reached by another name there
+         const procedureInfo *proc = findProcedure(tokens[pos + 1].content);
+         size_t argNum = 0;
+         for (int arg = pos + 3; arg != 0 && arg < size && tokens[arg].ttype != TokenType::Right; argNum++) {
+            if (tokens[arg].ttype == TokenType::Identifier && arrayDeclarations.count(tokens[arg].content)) {
+               fixedArrays[tokens[arg].content] = true;
+            }
+            if (proc && argNum < proc->params.size()) {
+               flows.push_back({proc->name + " " + proc->params[argNum].name, false, arg});
+            }
+            arg = skipExpression(tokens, arg, size) + 1;
+         }
+      } else if (isIncrementOperator(tok) && tokens[pos + 1].ttype == TokenType::Identifier) {
+         bool isUp = (tok == TokenType::AddAdd || tok == TokenType::AddAddPre);
+         string key = variableKey(pos + 1, tokens[pos + 1].content);
+         int loopPos = (key[0] == ' ') ? -1 : findSteppedLoop(tokens, pos + 1, size, isUp);
+         steps.push_back({key, isUp, loopPos == -1 ? -1 : loopPos + 4,
+            loopPos != -1 && (tokens[loopPos + 2].ttype == TokenType::LEOp
+               || tokens[loopPos + 2].ttype == TokenType::GEOp)});
+      }
+   }
+
+   // grow the ranges until every stored value lies within them
+   bool changed = true;
+   while (changed) {
+      changed = false;
+
+      for (size_t i = 0; i < flows.size(); i++) {
+         const rangeFlow &flow = flows[i];
+         if (flow.isElement && floatExactArrays.count(flow.target) && floatExactArrays[flow.target]
+            && !isFloatExact(tokens, flow.valuePos, size)) {
+            floatExactArrays[flow.target] = false;
+            changed = true;
+         }
+
+         valueRange values = expressionRange(tokens, flow.valuePos, size);
+         if (widenRange(flow.isElement ? elementRanges : variableRanges, flow.target, values)) changed = true;
+      }
+
+      for (size_t i = 0; i < steps.size(); i++) {
+         const rangeStep &step = steps[i];
+         auto it = variableRanges.find(step.target);
+         if (it == variableRanges.end() || isEmpty(it->second)) continue;
+
+         valueRange current = it->second;
+         valueRange stepped;
+         if (step.isUp) {
+            long bound = LONG_MAX;
+            if (step.limitPos != -1) {
+               bound = expressionRange(tokens, step.limitPos, size).hi;
+               if (step.isInclusive && bound != LONG_MAX) bound++;
+            }
+            stepped = {current.lo, std::max(bound, current.lo)};
+         } else {
+            long bound = LONG_MIN;
+            if (step.limitPos != -1) {
+               bound = expressionRange(tokens, step.limitPos, size).lo;
+               if (step.isInclusive && bound != LONG_MIN) bound--;
+            }
+            stepped = {std::min(bound, current.hi), current.hi};
+         }
+         if (widenRange(variableRanges, step.target, stepped)) changed = true;
+      }
+   }
+
+   // the narrowest type holding every value each array can hold
+   vector<string> names;
+   for (auto it = arrayTypes.begin(); it != arrayTypes.end(); it++) {
+      if (!fixedArrays.count(it->first)) names.push_back(it->first);
+   }
+   std::sort(names.begin(), names.end());
+
+   for (size_t i = 0; i < names.size(); i++) {
+      string name = names[i];
+
+      if (arrayTypes[name] == TokenType::RealType && floatExactArrays[name]) {
+         narrowTypes[name] = "float";
+         cerr << "Note: array " << name << " only holds values exact as floats, stored as float" << endl;
+         continue;
+      }
+      if (arrayTypes[name] != TokenType::IntType) continue;
+
+      valueRange range = elementRanges[name];
+      string narrowType = "";
+      if (range.lo >= 0 && range.hi <= UCHAR_MAX) {
+         narrowType = "unsigned char";
+      } else if (range.lo >= SCHAR_MIN && range.hi <= SCHAR_MAX) {
+         narrowType = "signed char";
+      } else if (range.lo >= 0 && range.hi <= USHRT_MAX) {
+         narrowType = "unsigned short";
+      } else if (range.lo >= SHRT_MIN && range.hi <= SHRT_MAX) {
+         narrowType = "short";
+      } else if (range.lo >= 0 && range.hi <= (long)UINT_MAX) {
+         narrowType = "unsigned int";
+      } else if (range.lo >= INT_MIN && range.hi <= INT_MAX) {
+         narrowType = "int";
+      }
+      if (narrowType.empty()) continue;
+
+      narrowTypes[name] = narrowType;
+      cerr << "Note: array " << name << " holds values from " << range.lo << " to " << range.hi;
+      cerr << ", stored as " << narrowType << endl;
+   }
+}
+
+
+// returns the C++ type the elements of the named array are stored as,
+//    which is the usual type for elementType unless the array is narrowed
+string arrayElementType(string name, TokenType elementType)
+{
+   auto it = narrowTypes.find(name);
+   return (it != narrowTypes.end()) ? it->second : tokenToCPPString(elementType);
+}
+
+
+// returns true if the named array is stored in a narrower type than its
+//    element type, so its elements must be widened again when read
+bool isNarrowedArray(string name)
+{
+   return narrowTypes.count(name) != 0;
+}
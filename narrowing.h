@@ -0,0 +1,22 @@
+#pragma once
+
+#include "tokenizing.h"
+#include <string>
+
+using std::string;
+
+
+// work out the range of values every integer variable and array element of the
+//    program can hold, and choose the narrowest C++ element type for each array
+//    whose stored values all fit it
+void planNarrowArrays(token tokens[], int size);
+
+
+// returns the C++ type the elements of the named array are stored as,
+//    which is the usual type for elementType unless the array is narrowed
+string arrayElementType(string name, TokenType elementType);
+
+
+// returns true if the named array is stored in a narrower type than its
+//    element type, so its elements must be widened again when read
+bool isNarrowedArray(string name);
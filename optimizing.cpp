@@ -0,0 +1,1081 @@
+#include "optimizing.h"
+#include "analyzing.h"
+#include "options.h"
+#include "parsing.h"
+#include "symbols.h"
+#include <algorithm>
+#include <fstream>
+
+
+// an array or struct element load that repeats within straight-line statements
+struct cachedLoad {
+   string name;
+   TokenType ttype;
+   int length;
+   int firstStmt;
+   vector<int> uses;
+};
+
+
+// number of cached loads planned so far, used to give each local a unique name
+static int cachedLoadCount = 0;
+
+// the cached loads to declare before each statement, keyed by statement position
+static unordered_map<int, vector<cachedLoad>> loadsByStatement;
+
+// the local holding each cached use, keyed by the position of the use,
+//    filled in once the local has been declared
+static unordered_map<int, string> cachedLoadNames;
+
+// the array accesses whose indexes are checked ahead of their loop, by position
+static unordered_map<int, bool> rangeCheckedAccesses;
+
+
+// the estimated size and alignment of a struct in bytes, both in declaration
+//    order and after layout
+struct structFootprint {
+   size_t before;
+   size_t after;
+   size_t align;
+};
+
+// the profiled number of accesses to each element, keyed by struct then element
+static unordered_map<string, unordered_map<string, long>> elementAccesses;
+
+// the footprint of each struct laid out so far
+static unordered_map<string, structFootprint> structFootprints;
+
+// the elements moved into the cold part of each struct
+static unordered_map<string, unordered_map<string, bool>> coldElements;
+
+// a cold element is used less than this fraction of the struct's hottest element,
+//    and takes at least as many bytes as a text value
+const long ColdAccessDivisor = 100;
+const size_t ColdElementBytes = 32;
+
+// local arrays larger than this are kept on the heap rather than the stack
+const size_t StackArrayBytes = 64 * 1024;
+
+// arrays at least this large can be backed by huge pages
+const size_t HugePageBytes = 2 * 1024 * 1024;
+
+
+// returns true if the token is the start of an array or struct element access
+static bool isAccessToken(TokenType token)
+{
+   return (token == TokenType::ArrayAccess
+      || token == TokenType::StructElemAccess
+      || token == TokenType::StructIndirElemAccess);
+}
+
+
+// keep the load for later use if it was used more than once, then forget it
+static void finishLoad(vector<cachedLoad> &active, size_t index)
+{
+   cachedLoad load = active[index];
+   active.erase(active.begin() + index);
+
+   if (load.uses.size() < 2) return;
+
+   loadsByStatement[load.firstStmt].push_back(load);
+}
+
+
+// finish every load that refers to the named variable
+static void invalidateName(token tokens[], vector<cachedLoad> &active, string name)
+{
+   for (size_t i = active.size(); i > 0; i--) {
+      int start = active[i - 1].uses[0];
+      for (int pos = start; pos < start + active[i - 1].length; pos++) {
+         if (tokens[pos].ttype == TokenType::Identifier && tokens[pos].content == name) {
+            finishLoad(active, i - 1);
+            break;
+         }
+      }
+   }
+}
+
+
+// finish every load that reads through an array access or a struct access
+static void invalidateAccesses(token tokens[], vector<cachedLoad> &active, bool arrays, bool structs)
+{
+   for (size_t i = active.size(); i > 0; i--) {
+      int start = active[i - 1].uses[0];
+      for (int pos = start; pos < start + active[i - 1].length; pos++) {
+         TokenType tok = tokens[pos].ttype;
+         if ((arrays && tok == TokenType::ArrayAccess)
+            || (structs && (tok == TokenType::StructElemAccess
+               || tok == TokenType::StructIndirElemAccess))) {
+            finishLoad(active, i - 1);
+            break;
+         }
+      }
+   }
+}
+
+
+// returns true if the tokens of two loads are identical
+static bool sameLoad(token tokens[], int first, int second, int length)
+{
+   for (int i = 0; i < length; i++) {
+      if (tokens[first + i].ttype != tokens[second + i].ttype
+         || tokens[first + i].content != tokens[second + i].content) return false;
+   }
+   return true;
+}
+
+
+// record each primitive array or struct element load read within the given tokens,
+//    leaving out those in the second operand of and and or, which may not be
+//    evaluated, so must not be loaded ahead of the statement
+static void collectLoads(token tokens[], int start, int end, int size, int stmtPos, vector<cachedLoad> &active)
+{
+   int pos = start;
+
+   while (pos <= end) {
+      typeInfo type;
+
+      if (tokens[pos].ttype == TokenType::AndOp || tokens[pos].ttype == TokenType::OrOp) {
+         int firstEnd = skipExpression(tokens, pos + 1, size);
+         if (firstEnd == -1) return;
+         int secondEnd = skipExpression(tokens, firstEnd + 1, size);
+         if (secondEnd == -1) return;
+
+         collectLoads(tokens, pos + 1, firstEnd, size, stmtPos, active);
+         pos = secondEnd + 1;
+         continue;
+      }
+
+      if (!isAccessToken(tokens[pos].ttype)
+         || !accessType(tokens, pos, size, type) || !isPrimitiveValue(type)) {
+         pos++;
+         continue;
+      }
+
+      int loadEnd = skipExpression(tokens, pos, size);
+      if (loadEnd == -1) return;
+
+      int length = loadEnd - pos + 1;
+      bool found = false;
+
+      for (size_t i = 0; i < active.size() && !found; i++) {
+         if (active[i].length == length && sameLoad(tokens, active[i].uses[0], pos, length)) {
+            active[i].uses.push_back(pos);
+            found = true;
+         }
+      }
+
+      if (!found) {
+         cachedLoad load;
+         load.ttype = type.ttype;
+         load.length = length;
+         load.firstStmt = stmtPos;
+         load.uses.push_back(pos);
+         active.push_back(load);
+      }
+
+      pos = loadEnd + 1;
+   }
+}
+
+
+// find the array and struct element loads that repeat within the straight-line
+//    statements of the body starting at currPos, and plan locals to cache them
+void planCachedLoads(token tokens[], int currPos, int size)
+{
+   vector<cachedLoad> active;
+
+   // locals declared in the body are needed to know the types of the loads
+   enterScope();
+   currPos++;
+
+   while (currPos < size && tokens[currPos].ttype != TokenType::End) {
+      int stmtEnd = skipStatement(tokens, currPos, size);
+      if (stmtEnd == -1) break;
+
+      TokenType stmt = tokens[currPos].ttype;
+      int readStart = currPos + 1;
+      bool hasEffects = false;
+
+      if (stmt == TokenType::VarDef) {
+         string name;
+         typeInfo type;
+         if (readDeclaration(tokens, currPos + 1, size, name, type) != -1) {
+            declareVariable(name, type);
+            invalidateName(tokens, active, name);
+         }
+      } else if (stmt == TokenType::If) {
+         // the loop bodies may write anything
+         while (!active.empty()) finishLoad(active, 0);
+      } else {
+         if (stmt == TokenType::Set) {
+            readStart = skipExpression(tokens, currPos + 1, size) + 1;
+         } else if (stmt == TokenType::ArraySet) {
+            readStart = skipExpression(tokens, currPos + 1, size) + 2;
+         } else if (stmt == TokenType::StructElemSet || stmt == TokenType::StructIndirElemSet) {
+            readStart = currPos + 3;
+         } else if (stmt == TokenType::Call || stmt == TokenType::Left) {
+            readStart = currPos;
+         }
+
+         // increments and calls within the statement may happen before or after its loads
+         for (int pos = currPos; pos <= stmtEnd; pos++) {
+            if (isIncrementOperator(tokens[pos].ttype) || tokens[pos].ttype == TokenType::Call) {
+               hasEffects = true;
+            }
+         }
+
+         if (!hasEffects && stmt != TokenType::Read) {
+            collectLoads(tokens, readStart, stmtEnd, size, currPos, active);
+         }
+
+         for (int pos = currPos; pos <= stmtEnd; pos++) {
+            if (isIncrementOperator(tokens[pos].ttype)) {
+               invalidateName(tokens, active, tokens[pos + 1].content);
+            } else if (tokens[pos].ttype == TokenType::Call
+               && procedureMayWrite(tokens, size, tokens[pos + 1].content)) {
+               while (!active.empty()) finishLoad(active, 0);
+            }
+         }
+
+         // then the variable, array element or struct element being written
+         if (stmt == TokenType::Read) {
+            invalidateName(tokens, active, tokens[currPos + 1].content);
+         } else if (stmt == TokenType::ArraySet) {
+            invalidateAccesses(tokens, active, true, false);
+         } else if (stmt == TokenType::StructElemSet || stmt == TokenType::StructIndirElemSet) {
+            invalidateAccesses(tokens, active, false, true);
+         } else if (stmt == TokenType::Set) {
+            typeInfo target;
+            if (tokens[currPos + 1].ttype != TokenType::Identifier) {
+               invalidateAccesses(tokens, active, false, true);
+            } else if (!accessType(tokens, currPos + 1, size, target) || !isPrimitiveValue(target)) {
+               // whole structs may be referenced under other names
+               invalidateAccesses(tokens, active, false, true);
+            }
+            invalidateName(tokens, active, tokens[currPos + 1].content);
+         }
+      }
+
+      currPos = stmtEnd + 1;
+      if (stmt == TokenType::Return) break;
+   }
+
+   while (!active.empty()) finishLoad(active, 0);
+   exitScope();
+}
+
+
+// print the declarations of the cached loads first used by the statement at currPos
+void printCachedLoads(token tokens[], int currPos, int size, int indent)
+{
+   auto it = loadsByStatement.find(currPos);
+   if (it == loadsByStatement.end()) return;
+
+   for (size_t i = 0; i < it->second.size(); i++) {
+      cachedLoad &load = it->second[i];
+      string value = "";
+
+      if (parseExpression(tokens, load.uses[0], size, value) == -1) continue;
+
+      load.name = "vurb_load" + to_string(cachedLoadCount++);
+
+      printIndent(indent);
+      cout << "const " << tokenToCPPString(load.ttype) << " " << load.name;
+      cout << " = " << value << ";\n";
+
+      for (size_t use = 0; use < load.uses.size(); use++) {
+         cachedLoadNames[load.uses[use]] = load.name;
+      }
+   }
+}
+
+
+// returns true if the load expression at currPos is read from a cached local,
+//    storing the name of that local in name
+bool findCachedLoad(int currPos, string &name)
+{
+   auto it = cachedLoadNames.find(currPos);
+   if (it == cachedLoadNames.end()) return false;
+
+   name = it->second;
+   return true;
+}
+
+
+// find the primitive globals that the if loop at currPos both reads and writes,
+//    if the loop makes no calls and cannot return, so they can be kept in locals
+vector<string> findPromotableGlobals(token tokens[], int currPos, int size)
+{
+   vector<string> globals;
+
+   int condEnd = findBracketEnd(tokens, currPos + 1, size);
+   if (condEnd == -1) return globals;
+   int loopEnd = findBlockEnd(tokens, condEnd + 1, size);
+   if (loopEnd == -1) return globals;
+
+   // the order each global is first seen in, and whether it is read or written
+   vector<string> seen;
+   unordered_map<string, bool> isRead;
+   unordered_map<string, bool> isWritten;
+   unordered_map<string, bool> isDeclared;
+
+   for (int pos = currPos + 1; pos < loopEnd; pos++) {
+      TokenType prev = tokens[pos - 1].ttype;
+
+      if (tokens[pos].ttype == TokenType::Call || tokens[pos].ttype == TokenType::Return) {
+         return globals;
+      }
+
+      if (tokens[pos].ttype != TokenType::Identifier) continue;
+
+      string name = tokens[pos].content;
+      const typeInfo *type = lookupVariable(name);
+
+      if (prev == TokenType::VarDef || prev == TokenType::Array || prev == TokenType::StructType) {
+         isDeclared[name] = true;
+         continue;
+      }
+
+      if (!type || !isPrimitiveValue(*type) || !isGlobalVariable(name)
+         || variableName(name) != name) continue;
+
+      if (!isRead.count(name) && !isWritten.count(name)) {
+         seen.push_back(name);
+      }
+
+      if (prev == TokenType::Set || prev == TokenType::Read) {
+         isWritten[name] = true;
+      } else if (isIncrementOperator(prev)) {
+         isRead[name] = true;
+         isWritten[name] = true;
+      } else {
+         isRead[name] = true;
+      }
+   }
+
+   for (size_t i = 0; i < seen.size(); i++) {
+      if (isRead[seen[i]] && isWritten[seen[i]] && !isDeclared.count(seen[i])) {
+         globals.push_back(seen[i]);
+      }
+   }
+   return globals;
+}
+
+
+// returns true if the expression at currPos is a text or struct variable
+//    whose value is not needed afterwards, so it can be moved rather than copied
+bool isMovableValue(token tokens[], int currPos, int size)
+{
+   if (currPos >= size || tokens[currPos].ttype != TokenType::Identifier) return false;
+
+   const typeInfo *type = lookupVariable(tokens[currPos].content);
+   if (!type || type->isArray
+      || (type->ttype != TokenType::TextType && type->ttype != TokenType::StructType)) return false;
+
+   return isLastUse(tokens, currPos, size);
+}
+
+
+// returns true if the set statement at currPos only appends values to the end
+//    of a text variable, storing the positions of those values in order
+bool findAppendedValues(token tokens[], int currPos, int size, vector<int> &values)
+{
+   if (currPos + 2 >= size || tokens[currPos + 1].ttype != TokenType::Identifier) return false;
+
+   string name = tokens[currPos + 1].content;
+   const typeInfo *type = lookupVariable(name);
+   if (!type || type->isArray || type->ttype != TokenType::TextType) return false;
+
+   int valueEnd = skipExpression(tokens, currPos + 2, size);
+   if (valueEnd == -1) return false;
+
+   // follow the left operands of nested additions down to the variable itself
+   vector<int> found;
+   int pos = currPos + 2;
+
+   while (pos + 2 < size && tokens[pos].ttype == TokenType::Left
+      && tokens[pos + 1].ttype == TokenType::Add) {
+      int leftEnd = skipExpression(tokens, pos + 2, size);
+      if (leftEnd == -1) return false;
+
+      found.insert(found.begin(), leftEnd + 1);
+      pos += 2;
+   }
+
+   if (found.empty() || tokens[pos].ttype != TokenType::Identifier
+      || tokens[pos].content != name) return false;
+
+   // appending in place must not change what the appended values see
+   for (int other = currPos + 2; other <= valueEnd; other++) {
+      if (other != pos && tokens[other].ttype == TokenType::Identifier
+         && tokens[other].content == name) return false;
+      if (tokens[other].ttype == TokenType::Call && isGlobalVariable(name)) return false;
+   }
+
+   values = found;
+   return true;
+}
+
+
+// match the head of a counted if loop: if left lt|le counter limit right,
+//    where the counter is an integer variable and the limit is an integer
+//    variable, an integer literal or the size of an array, storing the name
+//    of the counter and the limit as written in C++
+// returns the position of the right bracket, or -1 if the loop is not counted
+static int matchCountedLoop(token tokens[], int currPos, int size, string &counter, string &limit)
+{
+   if (currPos + 5 >= size || tokens[currPos + 1].ttype != TokenType::Left
+      || (tokens[currPos + 2].ttype != TokenType::LTOp && tokens[currPos + 2].ttype != TokenType::LEOp)
+      || tokens[currPos + 3].ttype != TokenType::Identifier) return -1;
+
+   counter = tokens[currPos + 3].content;
+   const typeInfo *counterType = lookupVariable(counter);
+   if (!counterType || counterType->isArray || counterType->ttype != TokenType::IntType) return -1;
+
+   int limitPos = currPos + 4;
+   int limitEnd = skipExpression(tokens, limitPos, size);
+   if (limitEnd == -1 || limitEnd + 1 >= size || tokens[limitEnd + 1].ttype != TokenType::Right) return -1;
+
+   if (tokens[limitPos].ttype == TokenType::IntLit) {
+      limit = tokens[limitPos].content;
+   } else if (tokens[limitPos].ttype == TokenType::Identifier) {
+      limit = tokens[limitPos].content;
+      const typeInfo *limitType = lookupVariable(limit);
+      if (!limitType || limitType->isArray || limitType->ttype != TokenType::IntType) return -1;
+   } else if (tokens[limitPos].ttype == TokenType::ArraySize) {
+      // arrays never change size, so this limit cannot be written within the loop
+      typeInfo arrayType;
+      if (!accessType(tokens, limitPos + 1, size, arrayType) || !arrayType.isArray) return -1;
+      limit = arrayType.arraySize;
+   } else {
+      return -1;
+   }
+
+   return limitEnd + 1;
+}
+
+
+// print reservations for the text variables that the counted if loop at currPos
+//    appends literals to on every pass, so they do not keep growing their storage
+void printStringReserves(token tokens[], int currPos, int size, int indent)
+{
+   string counter;
+   string limit;
+   int condEnd = matchCountedLoop(tokens, currPos, size, counter, limit);
+   if (condEnd == -1) return;
+
+   int loopEnd = findBlockEnd(tokens, condEnd + 1, size);
+   if (loopEnd == -1) return;
+
+   // the loop must run its full count, stepping the counter up exactly once per pass
+   int steps = 0;
+   unordered_map<string, bool> declared;
+
+   for (int pos = condEnd + 2; pos < loopEnd; pos++) {
+      TokenType tok = tokens[pos].ttype;
+      if (tok == TokenType::Call || tok == TokenType::Return) return;
+
+      if (tokens[pos].ttype != TokenType::Identifier) continue;
+
+      TokenType prev = tokens[pos - 1].ttype;
+      string name = tokens[pos].content;
+
+      if (prev == TokenType::VarDef || prev == TokenType::Array || prev == TokenType::StructType) {
+         declared[name] = true;
+      }
+
+      if (name != counter && name != limit) continue;
+
+      if (prev == TokenType::Set || prev == TokenType::Read || prev == TokenType::VarDef
+         || prev == TokenType::Array || prev == TokenType::StructType) return;
+
+      if (isIncrementOperator(prev)) {
+         if (name != counter || (prev != TokenType::AddAdd && prev != TokenType::AddAddPre)) return;
+         steps++;
+      }
+   }
+
+   if (steps != 1) return;
+
+   // the literal characters appended on each pass by the loop's own statements
+   vector<string> names;
+   unordered_map<string, size_t> perPass;
+   bool steppedOnce = false;
+
+   for (int pos = condEnd + 2; pos < loopEnd; ) {
+      int stmtEnd = skipStatement(tokens, pos, size);
+      if (stmtEnd == -1) return;
+
+      if (tokens[pos].ttype == TokenType::Left && tokens[pos + 2].content == counter) {
+         steppedOnce = true;
+      }
+
+      vector<int> values;
+      if (tokens[pos].ttype == TokenType::Set && !declared.count(tokens[pos + 1].content)
+         && findAppendedValues(tokens, pos, size, values)) {
+         string name = tokens[pos + 1].content;
+
+         for (size_t i = 0; i < values.size(); i++) {
+            string text = tokens[values[i]].content;
+            if (tokens[values[i]].ttype != TokenType::TextLit
+               || text.find('\\') != string::npos) continue;
+
+            if (!perPass.count(name)) names.push_back(name);
+            perPass[name] += text.length() - 2;
+         }
+      }
+
+      pos = stmtEnd + 1;
+   }
+
+   // the step may be hidden in a nested loop, which could run it any number of times
+   if (!steppedOnce) return;
+
+   string passes = "(" + variableName(limit) + " - " + variableName(counter)
+      + (tokens[currPos + 2].ttype == TokenType::LEOp ? " + 1)" : ")");
+   string cond = variableName(counter) + " " + tokenToCPPString(tokens[currPos + 2].ttype)
+      + " " + variableName(limit);
+
+   for (size_t i = 0; i < names.size(); i++) {
+      if (perPass[names[i]] == 0) continue;
+
+      string text = variableName(names[i]);
+      printIndent(indent);
+      cout << "if (" << cond << ") " << text << ".reserve(" << text << ".size() + ";
+      cout << passes << " * " << perPass[names[i]] << ");\n";
+   }
+}
+
+
+// print checks, ahead of the counted if loop at currPos, that every index its
+//    counter takes lies within the arrays the loop accesses by the counter on
+//    every pass, so those accesses need no checks of their own
+void printRangeChecks(token tokens[], int currPos, int size, int indent)
+{
+   string counter;
+   string limit;
+   int condEnd = matchCountedLoop(tokens, currPos, size, counter, limit);
+   if (condEnd == -1 || isGlobalVariable(counter)) return;
+
+   int loopEnd = findBlockEnd(tokens, condEnd + 1, size);
+   if (loopEnd == -1) return;
+
+   // the loop must run its full count, stepping the counter up exactly once per pass
+   bool limitIsName = (tokens[currPos + 4].ttype == TokenType::Identifier);
+   bool makesCalls = false;
+   int stepPos = -1;
+   unordered_map<string, bool> declared;
+
+   for (int pos = condEnd + 2; pos < loopEnd; pos++) {
+      TokenType tok = tokens[pos].ttype;
+      if (tok == TokenType::Return) return;
+      if (tok == TokenType::Call) makesCalls = true;
+
+      if (tok != TokenType::Identifier) continue;
+
+      TokenType prev = tokens[pos - 1].ttype;
+      string name = tokens[pos].content;
+
+      if (prev == TokenType::VarDef || prev == TokenType::Array || prev == TokenType::StructType) {
+         declared[name] = true;
+      }
+
+      if (name != counter && !(limitIsName && name == limit)) continue;
+
+      if (prev == TokenType::Set || prev == TokenType::Read || prev == TokenType::VarDef
+         || prev == TokenType::Array || prev == TokenType::StructType) return;
+
+      if (isIncrementOperator(prev)) {
+         if (name != counter || (prev != TokenType::AddAdd && prev != TokenType::AddAddPre)
+            || stepPos != -1) return;
+         stepPos = pos;
+      }
+   }
+
+   if (stepPos == -1 || (limitIsName && makesCalls && isGlobalVariable(limit))) return;
+
+   // the step must be the last statement, so every statement before it sees
+   //    the counter within the range the loop condition allows
+   vector<int> statements;
+   for (int pos = condEnd + 2; pos < loopEnd; ) {
+      int stmtEnd = skipStatement(tokens, pos, size);
+      if (stmtEnd == -1) return;
+      statements.push_back(pos);
+      pos = stmtEnd + 1;
+   }
+
+   if (statements.empty() || tokens[statements.back()].ttype != TokenType::Left
+      || stepPos < statements.back()) return;
+
+   // the accesses made unconditionally on every pass, leaving out those within
+   //    nested loops and the operands of and and or, which may not be evaluated
+   vector<string> arraySizes;
+   for (size_t i = 0; i + 1 < statements.size(); i++) {
+      int stmtPos = statements[i];
+      int stmtEnd = skipStatement(tokens, stmtPos, size);
+      if (tokens[stmtPos].ttype == TokenType::If) continue;
+
+      bool isConditional = false;
+      for (int pos = stmtPos; pos <= stmtEnd; pos++) {
+         if (tokens[pos].ttype == TokenType::AndOp || tokens[pos].ttype == TokenType::OrOp) {
+            isConditional = true;
+         }
+      }
+      if (isConditional) continue;
+
+      for (int pos = stmtPos; pos + 2 <= stmtEnd; pos++) {
+         if (tokens[pos].ttype != TokenType::ArrayAccess && tokens[pos].ttype != TokenType::ArraySet) continue;
+
+         // arrays within structs always have a literal size, while arrays
+         //    declared within the loop may not exist ahead of it
+         int indexPos = skipExpression(tokens, pos + 1, size) + 1;
+         if (indexPos == 0 || indexPos > stmtEnd || tokens[indexPos].ttype != TokenType::Identifier
+            || tokens[indexPos].content != counter) continue;
+
+         typeInfo type;
+         if (!accessType(tokens, pos + 1, size, type) || !type.isArray
+            || (tokens[pos + 1].ttype == TokenType::Identifier && declared.count(tokens[pos + 1].content))) continue;
+
+         if (std::find(arraySizes.begin(), arraySizes.end(), type.arraySize) == arraySizes.end()) {
+            arraySizes.push_back(type.arraySize);
+         }
+         rangeCheckedAccesses[pos] = true;
+      }
+   }
+
+   bool isInclusive = (tokens[currPos + 2].ttype == TokenType::LEOp);
+   string cond = variableName(counter) + " " + tokenToCPPString(tokens[currPos + 2].ttype)
+      + " " + variableName(limit);
+   string last = isInclusive ? variableName(limit) : variableName(limit) + " - 1";
+
+   for (size_t i = 0; i < arraySizes.size(); i++) {
+      printIndent(indent);
+      cout << "if (" << cond << ") vurb_checkRange(" << variableName(counter) << ", " << last;
+      cout << ", " << arraySizes[i] << ");\n";
+   }
+}
+
+
+// returns true if the array access or set at currPos has its index checked
+//    ahead of its loop
+bool isRangeChecked(int currPos)
+{
+   return rangeCheckedAccesses.count(currPos) != 0;
+}
+
+
+// read the element access counts used to choose which struct elements are cold,
+//    one "structname elementname count" entry per line
+// returns false if the file cannot be read
+bool loadLayoutProfile(string path)
+{
+   std::ifstream profile(path);
+   if (!profile) return false;
+
+   string structName, elementName;
+   long count;
+   while (profile >> structName >> elementName >> count) {
+      elementAccesses[structName][elementName] += count;
+   }
+   return profile.eof();
+}
+
+
+// estimate the size and alignment of a value of the given type, as laid out
+//    by g++ on x86-64, either before or after struct layout
+// returns false if the size cannot be known
+static bool typeFootprint(const typeInfo &type, bool afterLayout, size_t &bytes, size_t &align)
+{
+   switch (type.ttype) {
+      case IntType:
+      case RealType:
+         bytes = 8;
+         align = 8;
+         break;
+      case BoolType:
+         bytes = 1;
+         align = 1;
+         break;
+      case TextType:
+         // std::string, or the lean runtime's string with its pointer, size,
+         //    capacity and 16 bytes of short text
+         bytes = options.leanRuntime ? 40 : 32;
+         align = 8;
+         break;
+      case StructType: {
+         auto it = structFootprints.find(type.structName);
+         if (it == structFootprints.end()) return false;
+         bytes = afterLayout ? it->second.after : it->second.before;
+         align = it->second.align;
+         break;
+      }
+      default:
+         return false;
+   }
+
+   if (type.isArray) {
+      if (type.arraySize.empty() || type.arraySize.find_first_not_of("0123456789") != string::npos) {
+         return false;
+      }
+      bytes *= std::stoul(type.arraySize);
+   }
+   return true;
+}
+
+
+// the size of a struct holding the given elements in order, padding each to
+//    its alignment and the whole to the largest alignment
+static size_t paddedSize(const vector<size_t> &bytes, const vector<size_t> &aligns, size_t align)
+{
+   size_t offset = 0;
+   for (size_t i = 0; i < bytes.size(); i++) {
+      offset = (offset + aligns[i] - 1) / aligns[i] * aligns[i] + bytes[i];
+   }
+   if (offset == 0) return 1;
+   return (offset + align - 1) / align * align;
+}
+
+
+// arrange the element declarations of a struct to minimize padding, moving
+//    rarely used large elements into a cold part at the end if profiled,
+//    and report the size of the struct before and after
+string layoutStruct(string structName, const vector<string> &names, const vector<string> &decls)
+{
+   string content = "";
+   vector<size_t> bytes(names.size()), aligns(names.size());
+   size_t align = 1;
+
+   for (size_t i = 0; i < names.size(); i++) {
+      const typeInfo *type = lookupElement(structName, names[i]);
+      if (!type || !typeFootprint(*type, false, bytes[i], aligns[i])) {
+         // leave structs whose layout cannot be estimated as they are
+         for (size_t j = 0; j < decls.size(); j++) content += decls[j];
+         return content;
+      }
+      align = std::max(align, aligns[i]);
+   }
+
+   size_t before = paddedSize(bytes, aligns, align);
+
+   // the most accesses to any one element, if the struct was profiled
+   long hottest = 0;
+   auto profiled = elementAccesses.find(structName);
+   if (profiled != elementAccesses.end()) {
+      for (auto it = profiled->second.begin(); it != profiled->second.end(); it++) {
+         hottest = std::max(hottest, it->second);
+      }
+   }
+
+   vector<size_t> hot, cold;
+   for (size_t i = 0; i < names.size(); i++) {
+      typeFootprint(*lookupElement(structName, names[i]), true, bytes[i], aligns[i]);
+
+      long accesses = 0;
+      if (hottest > 0 && profiled->second.count(names[i])) {
+         accesses = profiled->second[names[i]];
+      }
+
+      if (hottest > 0 && bytes[i] >= ColdElementBytes && accesses * ColdAccessDivisor < hottest) {
+         cold.push_back(i);
+         coldElements[structName][names[i]] = true;
+      } else {
+         hot.push_back(i);
+      }
+   }
+
+   // the most strictly aligned elements first leave no gaps between elements
+   auto byAlignment = [&aligns](size_t first, size_t second) {
+      return aligns[first] > aligns[second];
+   };
+   std::stable_sort(hot.begin(), hot.end(), byAlignment);
+   std::stable_sort(cold.begin(), cold.end(), byAlignment);
+
+   vector<size_t> laidBytes, laidAligns;
+   for (size_t i = 0; i < hot.size(); i++) {
+      content += decls[hot[i]];
+      laidBytes.push_back(bytes[hot[i]]);
+      laidAligns.push_back(aligns[hot[i]]);
+   }
+
+   size_t hotSize = paddedSize(laidBytes, laidAligns, align);
+
+   if (!cold.empty()) {
+      vector<size_t> coldBytes, coldAligns;
+      size_t coldAlign = 1;
+
+      content += INDENT + "struct vurb_" + structName + "Cold\n" + INDENT + "{\n";
+      for (size_t i = 0; i < cold.size(); i++) {
+         content += INDENT + decls[cold[i]];
+         coldBytes.push_back(bytes[cold[i]]);
+         coldAligns.push_back(aligns[cold[i]]);
+         coldAlign = std::max(coldAlign, aligns[cold[i]]);
+      }
+      content += INDENT + "} vurb_cold;\n";
+
+      laidBytes.push_back(paddedSize(coldBytes, coldAligns, coldAlign));
+      laidAligns.push_back(coldAlign);
+   }
+
+   size_t after = paddedSize(laidBytes, laidAligns, align);
+   structFootprints[structName] = {before, after, align};
+
+   cerr << "Note: struct " << structName << " is " << before << " bytes in declaration order, ";
+   cerr << after << " bytes after layout";
+   if (!cold.empty()) {
+      cerr << " (" << hotSize << " bytes hot)";
+   }
+   cerr << endl;
+
+   return content;
+}
+
+
+// returns the C++ path from a struct of the given type to one of its elements
+string structElementPath(string structName, string elementName)
+{
+   auto it = coldElements.find(structName);
+   if (it != coldElements.end() && it->second.count(elementName)) {
+      return "vurb_cold." + elementName;
+   }
+   return elementName;
+}
+
+
+// returns true if the expression at currPos is just the named variable
+static bool isNameOnly(token tokens[], int currPos, int size, string name)
+{
+   return (tokens[currPos].ttype == TokenType::Identifier && tokens[currPos].content == name
+      && skipExpression(tokens, currPos, size) == currPos);
+}
+
+
+// returns true if two arrays, named as seen from the position, may share storage
+static bool arraysMayAlias(int currPos, string first, string second)
+{
+   if (first == second) return true;
+
+   // only array parameters without restrict can refer to another array
+   const procedureInfo *proc = enclosingProcedure(currPos);
+   for (size_t i = 0; proc && i < proc->params.size(); i++) {
+      if (proc->params[i].isArray && !proc->params[i].isRestrict
+         && (proc->params[i].name == first || proc->params[i].name == second)) return true;
+   }
+   return false;
+}
+
+
+// returns true if the if loop at currPos counts up to a fixed limit, and no
+//    pass reads anything another pass writes except through reductions,
+//    storing the shape of the loop in loop
+bool planParallelLoop(token tokens[], int currPos, int size, parallelLoop &loop)
+{
+   int condEnd = matchCountedLoop(tokens, currPos, size, loop.counter, loop.limit);
+   if (condEnd == -1 || condEnd + 1 >= size || tokens[condEnd + 1].ttype != TokenType::Begin) return false;
+
+   loop.isInclusive = (tokens[currPos + 2].ttype == TokenType::LEOp);
+   loop.reductions.clear();
+   loop.reductionOps.clear();
+
+   int bodyStart = condEnd + 1;
+   int bodyEnd = findBlockEnd(tokens, bodyStart, size);
+   if (bodyEnd == -1) return false;
+
+   // the last statement of the body steps the counter up by one
+   loop.stepPos = bodyEnd - 4;
+   if (loop.stepPos <= bodyStart || tokens[loop.stepPos].ttype != TokenType::Left
+      || (tokens[loop.stepPos + 1].ttype != TokenType::AddAdd
+         && tokens[loop.stepPos + 1].ttype != TokenType::AddAddPre)
+      || tokens[loop.stepPos + 2].content != loop.counter
+      || skipStatement(tokens, loop.stepPos, size) != bodyEnd - 1) return false;
+
+   // variables declared within the body are private to each pass,
+   //    as long as they do not hide variables from outside it
+   unordered_map<string, bool> privates;
+   for (int pos = bodyStart; pos < bodyEnd; pos++) {
+      string name;
+      typeInfo type;
+      if (tokens[pos].ttype != TokenType::VarDef
+         || readDeclaration(tokens, pos + 1, size, name, type) == -1) continue;
+
+      if (lookupVariable(name)) return false;
+      privates[name] = true;
+   }
+
+   // the shared variables each pass adds to or multiplies by
+   unordered_map<string, int> reductionUses;
+   vector<string> writtenArrays;
+   bool writesStructArrays = false;
+
+   for (int pos = bodyStart + 1; pos < bodyEnd; pos++) {
+      switch (tokens[pos].ttype) {
+         case Read:
+         case Write:
+         case Return:
+            return false;
+         case Call: {
+            if (!procedureIsPure(tokens, size, tokens[pos + 1].content)) return false;
+            break;
+         }
+         case Set: {
+            int target = pos + 1;
+            while (tokens[target].ttype == TokenType::StructElemAccess
+               || tokens[target].ttype == TokenType::StructIndirElemAccess) target++;
+
+            string name = tokens[target].content;
+            if (privates.count(name)) break;
+            if (target != pos + 1) return false;
+
+            // set x left add|mul x value right, with the value not using x
+            const typeInfo *type = lookupVariable(name);
+            TokenType op = tokens[pos + 3].ttype;
+            if (!type || type->isArray || type->ttype != TokenType::IntType
+               || tokens[pos + 2].ttype != TokenType::Left
+               || (op != TokenType::Add && op != TokenType::Mul)
+               || !isNameOnly(tokens, pos + 4, size, name)) return false;
+
+            int valueEnd = skipExpression(tokens, pos + 5, size);
+            if (valueEnd == -1 || tokens[valueEnd + 1].ttype != TokenType::Right) return false;
+
+            size_t r = 0;
+            while (r < loop.reductions.size() && loop.reductions[r] != name) r++;
+            if (r == loop.reductions.size()) {
+               loop.reductions.push_back(name);
+               loop.reductionOps.push_back(op);
+            } else if (loop.reductionOps[r] != op) {
+               return false;
+            }
+            reductionUses[name] += 2;
+            break;
+         }
+         case AddAdd:
+         case SubSub:
+         case AddAddPre:
+         case SubSubPre:
+            if (!privates.count(tokens[pos + 1].content) && pos != loop.stepPos + 1) return false;
+            break;
+         case StructElemSet:
+         case StructIndirElemSet:
+            if (!privates.count(tokens[pos + 1].content)) return false;
+            break;
+         case ArraySet:
+            if (tokens[pos + 1].ttype != TokenType::Identifier) {
+               writesStructArrays = true;
+            } else if (!privates.count(tokens[pos + 1].content)) {
+               if (!isNameOnly(tokens, pos + 2, size, loop.counter)) return false;
+               writtenArrays.push_back(tokens[pos + 1].content);
+            }
+            break;
+         default:
+            break;
+      }
+   }
+
+   if (writesStructArrays) return false;
+
+   // arrays may only be read at another pass's index if no pass writes them
+   for (int pos = bodyStart + 1; pos < bodyEnd; pos++) {
+      if (tokens[pos].ttype != TokenType::ArrayAccess || writtenArrays.empty()) continue;
+
+      if (tokens[pos + 1].ttype != TokenType::Identifier) return false;
+
+      string name = tokens[pos + 1].content;
+      if (privates.count(name) || isNameOnly(tokens, pos + 2, size, loop.counter)) continue;
+
+      for (size_t i = 0; i < writtenArrays.size(); i++) {
+         if (arraysMayAlias(pos, name, writtenArrays[i])) return false;
+      }
+   }
+
+   // reduction variables cannot be read anywhere else, nor the counter
+   //    and limit be written anywhere else
+   for (int pos = bodyStart + 1; pos < bodyEnd; pos++) {
+      if (tokens[pos].ttype != TokenType::Identifier) continue;
+
+      string name = tokens[pos].content;
+      if (reductionUses.count(name)) reductionUses[name]--;
+
+      if ((name == loop.counter || name == loop.limit) && pos != loop.stepPos + 2) {
+         TokenType prev = tokens[pos - 1].ttype;
+         if (prev == TokenType::Set || isIncrementOperator(prev)) return false;
+      }
+   }
+
+   for (auto it = reductionUses.begin(); it != reductionUses.end(); it++) {
+      if (it->second != 0 || it->first == loop.counter || it->first == loop.limit) return false;
+   }
+
+   return true;
+}
+
+
+// returns the number of bytes taken by the array declared at currPos,
+//    or 0 if it is not an array of known size
+static size_t arrayBytes(token tokens[], int currPos, int size)
+{
+   string name;
+   typeInfo type;
+   size_t bytes, align;
+   if (currPos >= size || tokens[currPos].ttype != TokenType::Array
+      || readDeclaration(tokens, currPos, size, name, type) == -1
+      || !typeFootprint(type, false, bytes, align)) return 0;
+   return bytes;
+}
+
+
+// returns true if the array declared at currPos is too large to keep on the stack
+bool isLargeArray(token tokens[], int currPos, int size)
+{
+   return arrayBytes(tokens, currPos, size) > StackArrayBytes;
+}
+
+
+// returns true if the array declared at currPos is sized by an expression
+//    worked out when the declaration is reached
+bool isRuntimeSizedArray(token tokens[], int currPos, int size)
+{
+   return (currPos + 3 < size && tokens[currPos].ttype == TokenType::Array
+      && tokens[currPos + 3].ttype != TokenType::IntLit);
+}
+
+
+// returns true if the array declared at currPos should be backed by huge pages,
+//    for arrays sized as the program runs as long as they turn out large enough
+bool wantsHugePages(token tokens[], int currPos, int size)
+{
+   return options.hugePages && (isRuntimeSizedArray(tokens, currPos, size)
+      || arrayBytes(tokens, currPos, size) >= HugePageBytes);
+}
+
+
+// find the large local arrays declared within the body of the if loop at currPos,
+//    including nested loops, so they can be allocated once before the loop
+vector<int> findLoopArrays(token tokens[], int currPos, int size)
+{
+   vector<int> arrays;
+
+   int condEnd = findBracketEnd(tokens, currPos + 1, size);
+   if (condEnd == -1) return arrays;
+   int loopEnd = findBlockEnd(tokens, condEnd + 1, size);
+   if (loopEnd == -1) return arrays;
+
+   for (int pos = condEnd + 1; pos < loopEnd; pos++) {
+      if (tokens[pos].ttype == TokenType::VarDef && isLargeArray(tokens, pos + 1, size)) {
+         arrays.push_back(pos + 1);
+      }
+   }
+   return arrays;
+}
+
+
+// returns true if any array in the program is kept in storage of its own,
+//    on the heap or on huge pages
+bool hasSeparateArrays(token tokens[], int size)
+{
+   for (int pos = 0; pos + 1 < size; pos++) {
+      if (tokens[pos].ttype == TokenType::VarDef
+         && (isLargeArray(tokens, pos + 1, size) || isRuntimeSizedArray(tokens, pos + 1, size))) return true;
+      if (tokens[pos].ttype == TokenType::GlobalDef && wantsHugePages(tokens, pos + 1, size)) return true;
+   }
+   return false;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "tokenizing.h"
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+
+// a counted if loop whose passes do not depend on each other: the counter
+//    runs up to limit (inclusive for le) and is stepped by the statement at
+//    stepPos, and each reduction variable is only ever combined with reductionOp
+struct parallelLoop {
+   string counter;
+   string limit;
+   bool isInclusive;
+   int stepPos;
+   vector<string> reductions;
+   vector<TokenType> reductionOps;
+};
+
+
+// find the array and struct element loads that repeat within the straight-line
+//    statements of the body starting at currPos, and plan locals to cache them
+void planCachedLoads(token tokens[], int currPos, int size);
+
+
+// print the declarations of the cached loads first used by the statement at currPos
+void printCachedLoads(token tokens[], int currPos, int size, int indent);
+
+
+// returns true if the load expression at currPos is read from a cached local,
+//    storing the name of that local in name
+bool findCachedLoad(int currPos, string &name);
+
+
+// find the primitive globals that the if loop at currPos both reads and writes,
+//    if the loop makes no calls and cannot return, so they can be kept in locals
+vector<string> findPromotableGlobals(token tokens[], int currPos, int size);
+
+
+// returns true if the expression at currPos is a text or struct variable
+//    whose value is not needed afterwards, so it can be moved rather than copied
+bool isMovableValue(token tokens[], int currPos, int size);
+
+
+// returns true if the set statement at currPos only appends values to the end
+//    of a text variable, storing the positions of those values in order
+bool findAppendedValues(token tokens[], int currPos, int size, vector<int> &values);
+
+
+// print reservations for the text variables that the counted if loop at currPos
+//    appends literals to on every pass, so they do not keep growing their storage
+void printStringReserves(token tokens[], int currPos, int size, int indent);
+
+
+// print checks, ahead of the counted if loop at currPos, that every index its
+//    counter takes lies within the arrays the loop accesses by the counter on
+//    every pass, so those accesses need no checks of their own
+void printRangeChecks(token tokens[], int currPos, int size, int indent);
+
+
+// returns true if the array access or set at currPos has its index checked
+//    ahead of its loop
+bool isRangeChecked(int currPos);
+
+
+// read the element access counts used to choose which struct elements are cold,
+//    one "structname elementname count" entry per line
+// returns false if the file cannot be read
+bool loadLayoutProfile(string path);
+
+
+// arrange the element declarations of a struct to minimize padding, moving
+//    rarely used large elements into a cold part at the end if profiled,
+//    and report the size of the struct before and after
+string layoutStruct(string structName, const vector<string> &names, const vector<string> &decls);
+
+
+// returns the C++ path from a struct of the given type to one of its elements
+string structElementPath(string structName, string elementName);
+
+
+// returns true if the if loop at currPos counts up to a fixed limit, and no
+//    pass reads anything another pass writes except through reductions,
+//    storing the shape of the loop in loop
+bool planParallelLoop(token tokens[], int currPos, int size, parallelLoop &loop);
+
+
+// returns true if the array declared at currPos is too large to keep on the stack
+bool isLargeArray(token tokens[], int currPos, int size);
+
+
+// returns true if the array declared at currPos is sized by an expression
+//    worked out when the declaration is reached
+bool isRuntimeSizedArray(token tokens[], int currPos, int size);
+
+
+// returns true if the array declared at currPos should be backed by huge pages,
+//    for arrays sized as the program runs as long as they turn out large enough
+bool wantsHugePages(token tokens[], int currPos, int size);
+
+
+// find the large local arrays declared within the body of the if loop at currPos,
+//    including nested loops, so they can be allocated once before the loop
+vector<int> findLoopArrays(token tokens[], int currPos, int size);
+
+
+// returns true if any array in the program is kept in storage of its own,
+//    on the heap or on huge pages
+bool hasSeparateArrays(token tokens[], int size);
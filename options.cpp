@@ -0,0 +1,208 @@
+#include "options.h"
+#include "building.h"
+#include <cstdlib>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+translatorOptions options = {false, "", false, 10000, false, false, false, false, false, false, "", "", false, false, "", false, "", "", "release", "", "", false, "g++", false, "", 256, false};
+
+
+// print the options the translator accepts
+static void printUsage(string program)
+{
+   cerr << "Usage: " << program << " [options] < input.vurb > output.cpp" << endl;
+   cerr << "       " << program << " --run input.vurb < program-input" << endl;
+   cerr << "       " << program << " --bytecode < input.vurb > output.vurbc" << endl;
+   cerr << "       " << program << " --exec input.vurbc < program-input" << endl;
+   cerr << "       " << program << " --build input.vurb [--then-run] [options]" << endl;
+   cerr << "       " << program << " --cache-stats" << endl;
+   cerr << "   --pack-structs            reorder struct elements to minimize padding" << endl;
+   cerr << "   --layout-profile <file>   also move rarely used large struct elements" << endl;
+   cerr << "                             into a cold part, using the access counts in file" << endl;
+   cerr << "   --parallel                share independent counted loops between threads" << endl;
+   cerr << "                             with OpenMP (compile with -fopenmp)" << endl;
+   cerr << "   --parallel-min <count>    fewest passes for a loop to run in parallel" << endl;
+   cerr << "                             (default 10000)" << endl;
+   cerr << "   --iostream                write through cout, flushing every line, and read" << endl;
+   cerr << "                             through cin instead of the buffered runtime" << endl;
+   cerr << "   --lean-runtime            use a small text type of its own in place of" << endl;
+   cerr << "                             <iostream> and <string>" << endl;
+   cerr << "   --huge-pages              back arrays of 2 MiB or more with transparent" << endl;
+   cerr << "                             huge pages" << endl;
+   cerr << "   --checked                 stop with an error on array indexes out of range" << endl;
+   cerr << "                             and integer division by zero" << endl;
+   cerr << "   --narrow-arrays           store arrays whose values are known to fit in" << endl;
+   cerr << "                             narrower types, such as 8, 16 or 32 bit integers" << endl;
+   cerr << "   --text-arena              as --lean-runtime, taking text storage from an" << endl;
+   cerr << "                             arena kept for the whole run" << endl;
+   cerr << "   --source <file>           mark the C++ with #line directives naming file" << endl;
+   cerr << "                             as the source of each statement" << endl;
+   cerr << "   --map <file>              write the source line of each run of C++ lines" << endl;
+   cerr << "                             to file" << endl;
+   cerr << "   --profile                 count and time the calls of each procedure and" << endl;
+   cerr << "                             the passes of each loop, reporting at exit," << endl;
+   cerr << "                             and write struct element counts to layout.profile" << endl;
+   cerr << "   --asm                     write x86-64 assembly, to be linked with the" << endl;
+   cerr << "                             runtime in asmruntime.o, in place of C++" << endl;
+   cerr << "   --run <file>              translate file into machine code in memory and" << endl;
+   cerr << "                             run it at once, the program reading standard input" << endl;
+   cerr << "   --bytecode                write bytecode for --exec in place of C++" << endl;
+   cerr << "   --exec <file>             run the bytecode in file, or the program in it" << endl;
+   cerr << "                             compiled to bytecode, with the interpreter" << endl;
+   cerr << "   --build <file>            translate file and compile the C++ as it is" << endl;
+   cerr << "                             written, reporting the time of each stage" << endl;
+   cerr << "   --build-profile <name>    compile with the flags of debug (-O0 -g)," << endl;
+   cerr << "                             release (-O2 -march=native, the default) or" << endl;
+   cerr << "                             lto (release with -flto)" << endl;
+   cerr << "   --compiler <command>      compile with command in place of g++" << endl;
+   cerr << "   --output <file>           write the executable to file in place of" << endl;
+   cerr << "                             executables/<name>x" << endl;
+   cerr << "   --keep-cpp <file>         also write the C++ compiled to file" << endl;
+   cerr << "   --then-run                run the executable once it is built" << endl;
+   cerr << "   --no-cache                always compile, without looking in or storing" << endl;
+   cerr << "                             to the cache of executables --build keeps" << endl;
+   cerr << "   --cache-dir <dir>         keep the cache in dir in place of ~/.cache/vurb" << endl;
+   cerr << "   --cache-limit <MiB>       most the cache can hold before the least recently" << endl;
+   cerr << "                             used executables are removed (default 256)" << endl;
+   cerr << "   --cache-stats             print the cache's hits, misses, evictions and size" << endl;
+}
+
+
+// read the command line options into the settings
+// returns false, after printing the usage, if any option is not recognized
+bool readOptions(int argc, char *argv[])
+{
+   for (int i = 1; i < argc; i++) {
+      string option = argv[i];
+
+      if (option == "--pack-structs") {
+         options.packStructs = true;
+      } else if (option == "--layout-profile" && i + 1 < argc) {
+         options.packStructs = true;
+         options.layoutProfile = argv[++i];
+      } else if (option == "--parallel") {
+         options.parallel = true;
+      } else if (option == "--parallel-min" && i + 1 < argc) {
+         options.parallel = true;
+         options.parallelMin = std::atol(argv[++i]);
+      } else if (option == "--iostream") {
+         options.iostream = true;
+      } else if (option == "--lean-runtime") {
+         options.leanRuntime = true;
+      } else if (option == "--huge-pages") {
+         options.hugePages = true;
+      } else if (option == "--checked") {
+         options.checked = true;
+      } else if (option == "--narrow-arrays") {
+         options.narrowArrays = true;
+      } else if (option == "--text-arena") {
+         options.leanRuntime = true;
+         options.textArena = true;
+      } else if (option == "--source" && i + 1 < argc) {
+         options.sourceFile = argv[++i];
+      } else if (option == "--map" && i + 1 < argc) {
+         options.sourceMap = argv[++i];
+      } else if (option == "--profile") {
+         options.profile = true;
+      } else if (option == "--asm") {
+         options.assembly = true;
+      } else if (option == "--run" && i + 1 < argc) {
+         options.assembly = true;
+         options.runFile = argv[++i];
+      } else if (option == "--bytecode") {
+         options.bytecode = true;
+      } else if (option == "--exec" && i + 1 < argc) {
+         options.execFile = argv[++i];
+      } else if (option == "--build" && i + 1 < argc) {
+         options.buildFile = argv[++i];
+      } else if (option == "--build-profile" && i + 1 < argc) {
+         options.buildProfile = argv[++i];
+      } else if (option == "--compiler" && i + 1 < argc) {
+         options.compiler = argv[++i];
+      } else if (option == "--output" && i + 1 < argc) {
+         options.outputFile = argv[++i];
+      } else if (option == "--keep-cpp" && i + 1 < argc) {
+         options.keepCpp = argv[++i];
+      } else if (option == "--then-run") {
+         options.thenRun = true;
+      } else if (option == "--no-cache") {
+         options.noCache = true;
+      } else if (option == "--cache-dir" && i + 1 < argc) {
+         options.cacheDir = argv[++i];
+      } else if (option == "--cache-limit" && i + 1 < argc) {
+         options.cacheLimit = std::atol(argv[++i]);
+      } else if (option == "--cache-stats") {
+         options.cacheStats = true;
+      } else {
+         cerr << "Error: unrecognized option " << option << endl;
+         printUsage(argv[0]);
+         return false;
+      }
+   }
+
+   if (options.iostream && options.leanRuntime) {
+      cerr << "Error: --iostream cannot be combined with "
+           << (options.textArena ? "--text-arena" : "--lean-runtime") << endl;
+      return false;
+   }
+   if (options.profile && options.parallel) {
+      cerr << "Error: --profile cannot be combined with --parallel" << endl;
+      return false;
+   }
+
+   if (!isBuildProfile(options.buildProfile)) {
+      cerr << "Error: unknown build profile " << options.buildProfile << endl;
+      return false;
+   }
+
+   // the choices of how to build only apply to --build, which makes C++
+   if (options.buildFile == "") {
+      string other = "";
+      if (options.buildProfile != "release") other = "--build-profile";
+      if (options.compiler != "g++") other = "--compiler";
+      if (options.outputFile != "") other = "--output";
+      if (options.keepCpp != "") other = "--keep-cpp";
+      if (options.thenRun) other = "--then-run";
+      if (options.noCache) other = "--no-cache";
+      if (!options.cacheStats && options.cacheDir != "") other = "--cache-dir";
+      if (!options.cacheStats && options.cacheLimit != 256) other = "--cache-limit";
+      if (other != "") {
+         cerr << "Error: " << other << " can only be used with --build" << endl;
+         return false;
+      }
+   } else if (options.assembly || options.bytecode || options.execFile != "") {
+      string other = options.runFile != "" ? "--run" : "--asm";
+      if (options.bytecode) other = "--bytecode";
+      if (options.execFile != "") other = "--exec";
+      cerr << "Error: --build cannot be combined with " << other << endl;
+      return false;
+   }
+
+   // the assembly backend (which --run also uses) and the bytecode have their
+   //    own runtime, and none of the C++ choices
+   bool isBytecode = options.bytecode || options.execFile != "";
+   if (options.assembly || isBytecode) {
+      string other = "";
+      if (options.packStructs) other = options.layoutProfile != "" ? "--layout-profile" : "--pack-structs";
+      if (options.parallel) other = "--parallel";
+      if (options.iostream) other = "--iostream";
+      if (options.leanRuntime) other = options.textArena ? "--text-arena" : "--lean-runtime";
+      if (options.hugePages) other = "--huge-pages";
+      if (options.checked) other = "--checked";
+      if (options.narrowArrays) other = "--narrow-arrays";
+      if (options.sourceMap != "") other = "--map";
+      if (options.profile) other = "--profile";
+      if (isBytecode && options.sourceFile != "") other = "--source";
+      if (isBytecode && options.assembly) other = options.runFile != "" ? "--run" : "--asm";
+      if (options.bytecode && options.execFile != "") other = "--bytecode";
+      if (other != "") {
+         string chosen = options.runFile != "" ? "--run" : "--asm";
+         if (isBytecode) chosen = options.execFile != "" ? "--exec" : "--bytecode";
+         cerr << "Error: " << chosen << " cannot be combined with " << other << endl;
+         return false;
+      }
+   }
+   return true;
+}
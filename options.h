@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+
+using std::string;
+
+
+// the command line settings that change how a program is translated
+struct translatorOptions {
+   bool packStructs;
+   string layoutProfile;
+   bool parallel;
+   long parallelMin;
+   bool iostream;
+   bool leanRuntime;
+   bool hugePages;
+   bool checked;
+   bool narrowArrays;
+   bool textArena;
+   string sourceFile;
+   string sourceMap;
+   bool profile;
+   bool assembly;
+   string runFile;
+   bool bytecode;
+   string execFile;
+   string buildFile;
+   string buildProfile;
+   string keepCpp;
+   string outputFile;
+   bool thenRun;
+   string compiler;
+   bool noCache;
+   string cacheDir;
+   long cacheLimit;
+   bool cacheStats;
+};
+
+// the settings in effect for this run of the translator
+extern translatorOptions options;
+
+
+// read the command line options into the settings
+// returns false, after printing the usage, if any option is not recognized
+bool readOptions(int argc, char *argv[]);
@@ -1,45 +1,137 @@
 #include "parsing.h"
+#include "analyzing.h"
+#include "assembling.h"
+#include "evaluating.h"
+#include "narrowing.h"
+#include "optimizing.h"
+#include "options.h"
+#include "profiling.h"
+#include "runtime.h"
+#include "sourcemap.h"
+#include "symbols.h"
 
 const int DebugMode = false; // set to false to turn off debugging messages
 
+// the position of a statement left out of the translation, as the code
+//    around it already does its work, or -1 if there is none
+static int omittedStatement = -1;
+
+// whether a loop being translated is shared out between threads
+static bool inParallelLoop = false;
+
+// the positions of the large array declarations whose storage has already
+//    been set up ahead of the loops they are declared in
+static unordered_map<int, bool> hoistedArrays;
+
+// a statement for the next body translated to start with, which profiling
+//    uses to time procedures and count the passes of loops
+static string bodyStart = "";
+
+// the profile counters of the loops whose runs and passes are being counted
+//    in locals, starting with the outermost loop the statement being
+//    translated is within, which is timed and counts its own runs
+static vector<int> profiledLoops;
+
 // parse the token sequence and rewrite as C++,
 // writing the results to standard output,
 // with any error messages directed to standard error
-void parse(token tokens[], int size)
+// returns false if the program is malformed
+bool parse(token tokens[], int size)
 {
    // Prints full token contents when DebugMode is enabled
    if (DebugMode) {
       printTokens(tokens, size);
    }
 
+   collectProcedures(tokens, size);
+
+   if (options.narrowArrays) {
+      planNarrowArrays(tokens, size);
+   }
+
+   if (options.profile) {
+      planProfile(tokens, size);
+   }
+
    printPreamble();
+
+   // the report goes out after everything the program writes
+   if (options.profile) {
+      printProfileRuntime();
+   }
+
+   bool readsInput = false;
+   for (int i = 0; i < size; i++) {
+      if (tokens[i].ttype == TokenType::Read) readsInput = true;
+   }
+   printRuntime(readsInput);
+   if (hasSeparateArrays(tokens, size)) {
+      printArrayStorage();
+   }
+   if (options.checked) {
+      printChecks();
+   }
+
+   if (hasSiblingTailCalls(tokens, size)) {
+      printTailCallMacro();
+   }
+
    int currPos = 0;
    currPos = parseGlobals(tokens, currPos, size);
 
-   if (currPos >= size || currPos == -1) return;
+   if (currPos >= size || currPos == -1) return false;
 
    currPos = parseMain(tokens, currPos, size);
 
-   if (currPos >= size || currPos == -1) return;
+   if (currPos >= size || currPos == -1) return false;
 
    currPos++;
 
    if (currPos != size) {
       cerr << "Error: invalid content found after main routine.\n";
       cerr << (size - currPos) << " additional tokens found\n";
+      return false;
    }
+   return true;
 }
 
 
 // print the C++ preamble, featuring include statements
 // and namespace declaration
 void printPreamble() {
+   if (options.leanRuntime) {
+      // the runtime brings the rest of what the program needs
+      cout << "#include <utility>\n";
+      return;
+   }
+
    cout << "#include <iostream>\n";
    cout << "#include <string>\n";
+   cout << "#include <utility>\n";
    cout << "using namespace std;\n";
 }
 
 
+// print the definition of VURB_MUSTTAIL, which asks compilers that support it
+//    to turn a returned call into a jump
+void printTailCallMacro() {
+   // a profiled procedure is timed until it returns, so no call can replace it
+   if (options.profile) {
+      cout << "#define VURB_MUSTTAIL\n";
+      return;
+   }
+
+   cout << "#if defined(__has_cpp_attribute)\n";
+   cout << "#if __has_cpp_attribute(clang::musttail)\n";
+   cout << "#define VURB_MUSTTAIL [[clang::musttail]]\n";
+   cout << "#endif\n";
+   cout << "#endif\n";
+   cout << "#ifndef VURB_MUSTTAIL\n";
+   cout << "#define VURB_MUSTTAIL\n";
+   cout << "#endif\n";
+}
+
+
 // print the C++ main routine title
 int parseMain(token tokens[], int currPos, int size) {
 
@@ -50,8 +142,14 @@ int parseMain(token tokens[], int currPos, int size) {
       return -1;
    }
 
+   cout << "\n";
+   markProcedure(tokens[currPos], "main");
    cout << tokenToCPPString(tokens[currPos].ttype);
 
+   if (options.profile) {
+      bodyStart = "vurb_Scope vurb_scope(" + to_string(profileCounter(currPos)) + ");";
+   }
+
    currPos++;
 
    return parseBody(tokens, currPos, size, 0);
@@ -132,6 +230,8 @@ int parseGlobalVars(token tokens[], int currPos, int size) {
    currPos++;
    if (currPos >= size) return size;
 
+   int declPos = currPos;
+
    // If it is an array, parse it as an array
    if (tokens[currPos].ttype == TokenType::Array) {
       currPos = parseArrayDef(tokens, currPos, size, content);
@@ -159,6 +259,21 @@ int parseGlobalVars(token tokens[], int currPos, int size) {
 
    if (currPos == -1) return -1;
 
+   string name = "";
+   typeInfo type;
+   if (readDeclaration(tokens, declPos, size, name, type) != -1) {
+      declareVariable(name, type);
+   }
+
+   // very large arrays start on a huge page boundary and are advised onto
+   //    huge pages before they are first used
+   if (tokens[declPos].ttype == TokenType::Array && wantsHugePages(tokens, declPos, size)) {
+      cout << "alignas(" << (2 << 20) << ") " << content << ";\n";
+      cout << "static const bool vurb_huge_" << name << " = vurb_adviseHugePages(";
+      cout << name << ", sizeof(" << name << "));\n";
+      return currPos;
+   }
+
    cout << content << ";\n";
    return currPos;
 }
@@ -172,6 +287,7 @@ int parseProcedureDef(token tokens[], int currPos, int size) {
    string procname = "";
    string params = "";
    string retType = "";
+   int defPos = currPos;
 
    if (tokens[currPos].ttype != TokenType::ProcDef) {
       printError(tokens[currPos], currPos, tokenTypeToString(TokenType::ProcDef));
@@ -190,6 +306,9 @@ int parseProcedureDef(token tokens[], int currPos, int size) {
    currPos++;
    if (currPos >= size) return -1;
 
+   const procedureInfo *proc = findProcedure(procname);
+   size_t paramIndex = 0;
+
    if (tokens[currPos].ttype != TokenType::Left) {
       printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Left));
       return -1;
@@ -223,7 +342,17 @@ int parseProcedureDef(token tokens[], int currPos, int size) {
                return -1;
             }
 
-            params += tokens[currPos].content + "[]";
+            // arrays that can never share storage with another array in use
+            //    are marked so the C++ compiler can assume so as well
+            if (proc && paramIndex < proc->params.size() && proc->params[paramIndex].isRestrict) {
+               params += "*__restrict " + tokens[currPos].content;
+            } else {
+               params += tokens[currPos].content + "[]";
+            }
+
+            // followed by the number of elements in the array passed, which
+            //    bodies that neither check nor pass on the array leave unused
+            params += ", long " + arraySizeName(tokens[currPos].content) + " __attribute__((unused))";
          } else if (tokens[currPos].ttype == TokenType::StructType) {
             currPos++;
             if (currPos >= size) return -1;
@@ -245,7 +374,11 @@ int parseProcedureDef(token tokens[], int currPos, int size) {
 
             params += "&" + tokens[currPos].content;
          } else {
-            params += tokenToCPPString(tokens[currPos].ttype) + " ";
+            // text that is only ever read is passed by reference instead of copied
+            bool isConstRef = (proc && paramIndex < proc->params.size()
+               && proc->params[paramIndex].isConstRef);
+
+            params += (isConstRef ? "const " : "") + tokenToCPPString(tokens[currPos].ttype) + " ";
             currPos ++;
 
             if (currPos >= size) return -1;
@@ -255,9 +388,10 @@ int parseProcedureDef(token tokens[], int currPos, int size) {
                return -1;
             }
 
-            params += tokens[currPos].content;
+            params += (isConstRef ? "&" : "") + tokens[currPos].content;
          }
 
+         paramIndex++;
          currPos++;
          if (currPos >= size) return -1;
    }
@@ -279,9 +413,35 @@ int parseProcedureDef(token tokens[], int currPos, int size) {
       retType = tokenToCPPString(TokenType::VoidType);
    }
 
+   markProcedure(tokens[defPos], procname);
    cout << retType << " " << procname << "(" << params << ")\n";
 
-   return parseBody(tokens, currPos+1, size, 0);
+   // the parameters are visible within the procedure body
+   enterScope();
+   for (size_t i = 0; proc && i < proc->params.size(); i++) {
+      typeInfo type;
+      type.ttype = proc->params[i].structType.empty() ? proc->params[i].ptype : TokenType::StructType;
+      type.structName = proc->params[i].structType;
+      type.isArray = proc->params[i].isArray;
+      type.arraySize = type.isArray ? arraySizeName(proc->params[i].name) : "";
+      declareVariable(proc->params[i].name, type);
+   }
+
+   if (options.profile) {
+      bodyStart = "vurb_Scope vurb_scope(" + to_string(profileCounter(defPos)) + ");";
+   }
+
+   // self tail calls jump back to a label ahead of the body
+   if (hasSelfTailCall(tokens, size, procname)) {
+      cout << "{\n" << "vurb_tail:\n";
+      currPos = parseBody(tokens, currPos+1, size, 1);
+      cout << "}\n";
+   } else {
+      currPos = parseBody(tokens, currPos+1, size, 0);
+   }
+   exitScope();
+
+   return currPos;
 }
 
 
@@ -291,6 +451,8 @@ int parseStructDef(token tokens[], int currPos, int size) {
    
    string structname = "";
    string elements = "";
+   vector<string> elementNames;
+   vector<string> elementDecls;
 
    if (tokens[currPos].ttype != TokenType::StructDef) {
       printError(tokens[currPos], currPos, tokenTypeToString(TokenType::StructDef));
@@ -318,8 +480,18 @@ int parseStructDef(token tokens[], int currPos, int size) {
    if (currPos >= size) return -1;
 
    while (tokens[currPos].ttype == TokenType::Element) {
-      currPos = parseStructElem(tokens, currPos, size, elements);
+      string elementName = "";
+      string decl = "";
+      typeInfo type;
+      if (readDeclaration(tokens, currPos + 1, size, elementName, type) != -1) {
+         declareElement(structname, elementName, type);
+      }
+
+      currPos = parseStructElem(tokens, currPos, size, decl);
       if (currPos == -1) return -1;
+
+      elementNames.push_back(elementName);
+      elementDecls.push_back(decl);
       currPos++;
       if (currPos >= size) return -1;
    }
@@ -331,6 +503,14 @@ int parseStructDef(token tokens[], int currPos, int size) {
       return -1;
    }
 
+   if (options.packStructs) {
+      elements = layoutStruct(structname, elementNames, elementDecls);
+   } else {
+      for (size_t i = 0; i < elementDecls.size(); i++) {
+         elements += elementDecls[i];
+      }
+   }
+
    cout << "struct " << structname << "\n{\n" << elements << "};\n";
 
    return currPos;
@@ -391,23 +571,52 @@ int parseBody(token tokens[], int currPos, int size, int indent) {
 
    cout << tokenToCPPString(tokens[currPos].ttype) << "\n";
 
+   if (bodyStart != "") {
+      printIndent(indent + 1);
+      cout << bodyStart << "\n";
+      bodyStart = "";
+   }
+
+   enterScope();
+   planCachedLoads(tokens, currPos, size);
+
    currPos++;
    if (currPos >= size) return -1;
 
 
    while (tokens[currPos].ttype != TokenType::End) {
       string content = "";
+
+      if (currPos == omittedStatement) {
+         currPos = skipStatement(tokens, currPos, size);
+         if (currPos == -1) return -1;
+         currPos++;
+         if (currPos >= size) return -1;
+         continue;
+      }
+
+      markSourceLine(tokens[currPos]);
+      printCachedLoads(tokens, currPos, size, indent + 1);
+
       switch (tokens[currPos].ttype) {
-         case Call:
-            printIndent(indent + 1);
+         case Call: {
+            int callPos = currPos;
+            string literal = "";
+
             currPos = parseProcedureCall(tokens, currPos, size, content);
-            cout << content << ";\n";
+
+            // a call that can be evaluated at translation time has no effect
+            if (currPos != -1 && !evaluateCall(tokens, callPos, size, literal)) {
+               printIndent(indent + 1);
+               cout << content << ";\n";
+            }
             break;
+         }
          case Set:
             currPos = parseSetStmt(tokens, currPos, size, indent + 1);
             break;
          case Write:
-            currPos = parseOutput(tokens, currPos, size, indent + 1);
+            currPos = parseOutputRun(tokens, currPos, size, indent + 1);
             break;
          case Read:
             currPos = parseInput(tokens, currPos, size, indent + 1);
@@ -448,6 +657,9 @@ int parseBody(token tokens[], int currPos, int size, int indent) {
       return -1;
    }
 
+   exitScope();
+
+   markSourceLine(tokens[currPos]);
    printIndent(indent);
    cout << tokenToCPPString(tokens[currPos].ttype) << "\n";
 
@@ -470,8 +682,13 @@ int parseLocalVarDef(token tokens[], int currPos, int size, int indent) {
    currPos++;
    if (currPos >= size) return size;
 
+   int declPos = currPos;
+
+   // If it is an array sized by an expression, it gets storage of its own
+   if (isRuntimeSizedArray(tokens, currPos, size)) {
+      return parseRuntimeArrayDef(tokens, currPos, size, indent);
    // If it is an array, parse it as an array
-   if (tokens[currPos].ttype == TokenType::Array) {
+   } else if (tokens[currPos].ttype == TokenType::Array) {
       currPos = parseArrayDef(tokens, currPos, size, content);
    // If it is a struct, parse it as a struct
    } else if (tokens[currPos].ttype == TokenType::StructType) {
@@ -499,17 +716,92 @@ int parseLocalVarDef(token tokens[], int currPos, int size, int indent) {
 
    if (currPos == -1) return -1;
 
+   string name = "";
+   typeInfo type;
+   if (readDeclaration(tokens, declPos, size, name, type) != -1) {
+      declareVariable(name, type);
+   }
+
+   // arrays too large for the stack get storage of their own, which is set up
+   //    ahead of any loop they are declared in and reused on every pass
+   if (tokens[declPos].ttype == TokenType::Array && isLargeArray(tokens, declPos, size)) {
+      string storage = "vurb_storage" + to_string(declPos);
+
+      if (!hoistedArrays.count(declPos)) {
+         printArrayStorageDef(tokens, declPos, size, indent);
+      } else if (type.ttype == TokenType::TextType) {
+         printIndent(indent);
+         cout << storage << ".reset();\n";
+      }
+
+      printIndent(indent);
+      cout << arrayElementType(name, type.ttype) << " *" << name << " = " << storage << ".elements;\n";
+      return currPos;
+   }
+
    printIndent(indent);
    cout << content << ";\n";
    return currPos;
 }
 
 
+// parse a local array sized by an expression, working out its size and
+//    taking its storage when the declaration is reached
+int parseRuntimeArrayDef(token tokens[], int currPos, int size, int indent) {
+
+   int declPos = currPos;
+
+   if (currPos + 3 >= size) return size;
+
+   if (tokens[currPos + 1].ttype != TokenType::Identifier) {
+      printError(tokens[currPos + 1], currPos + 1, tokenTypeToString(TokenType::Identifier));
+      return -1;
+   }
+
+   if (!isVariableType(tokens[currPos + 2].ttype)) {
+      printError(tokens[currPos + 2], currPos + 2, "Type Specifier");
+      return -1;
+   }
+
+   // the size is worked out before the array is in scope
+   string length = "";
+   currPos = parseExpression(tokens, currPos + 3, size, length);
+   if (currPos == -1) return -1;
+
+   string name = "";
+   typeInfo type;
+   if (readDeclaration(tokens, declPos, size, name, type) == -1) return -1;
+   declareVariable(name, type);
+
+   printIndent(indent);
+   cout << "long " << type.arraySize << " = vurb_arrayLength(" << length << ");\n";
+   printArrayStorageDef(tokens, declPos, size, indent);
+   printIndent(indent);
+   cout << arrayElementType(name, type.ttype) << " *" << name << " = vurb_storage" << declPos << ".elements;\n";
+   return currPos;
+}
+
+
+// print the definition of the storage for the separately kept array declared at currPos
+void printArrayStorageDef(token tokens[], int currPos, int size, int indent) {
+
+   string name = "";
+   typeInfo type;
+   if (readDeclaration(tokens, currPos, size, name, type) == -1) return;
+
+   printIndent(indent);
+   cout << "vurb_Storage<" << arrayElementType(name, type.ttype) << "> vurb_storage" << currPos;
+   cout << "(" << type.arraySize << ", " << (wantsHugePages(tokens, currPos, size) ? "true" : "false");
+   cout << ");\n";
+}
+
+
 // parse a set variable statement
 int parseSetStmt(token tokens[], int currPos, int size, int indent) {
       
    if (currPos >= size) return currPos;
 
+   int setPos = currPos;
    string content = "";
    string assignValue = "";
 
@@ -525,7 +817,7 @@ int parseSetStmt(token tokens[], int currPos, int size, int indent) {
       || tokens[currPos].ttype == TokenType::StructIndirElemAccess) {
       currPos = parseStructAccess(tokens, currPos, size, content);
    } else if (tokens[currPos].ttype == TokenType::Identifier) {
-      content += tokens[currPos].content;
+      content += variableName(tokens[currPos].content);
    } else {
       printError(tokens[currPos], currPos, "Identifier or struct field");
       return -1;
@@ -535,6 +827,26 @@ int parseSetStmt(token tokens[], int currPos, int size, int indent) {
    currPos++;
    if (currPos >= size) return size;
 
+   // text built up by adding to its own end is appended to in place
+   vector<int> appended;
+   if (findAppendedValues(tokens, setPos, size, appended)) {
+      for (size_t i = 0; i < appended.size(); i++) {
+         assignValue = "";
+         if (parseExpression(tokens, appended[i], size, assignValue) == -1) return -1;
+
+         printIndent(indent);
+         cout << content << " += " << assignValue << ";\n";
+      }
+      return skipExpression(tokens, currPos, size);
+   }
+
+   // a text or struct value that is not needed afterwards is moved rather than copied
+   if (isMovableValue(tokens, currPos, size)) {
+      printIndent(indent);
+      cout << content << " = std::move(" << variableName(tokens[currPos].content) << ");\n";
+      return currPos;
+   }
+
    currPos = parseExpression(tokens, currPos, size, assignValue);
    if (currPos == -1) return -1;
 
@@ -564,7 +876,103 @@ int parseOutput(token tokens[], int currPos, int size, int indent) {
    if (currPos == -1) return -1;
 
    printIndent(indent);
-   cout << "cout << " << content << " << endl;\n";
+   cout << outputStream() << " << " << content << " << " << outputLineEnd() << ";\n";
+   return currPos;
+}
+
+
+// returns the text a literal is written out as, if it can be joined
+//    with neighbouring literal text at translation time
+static bool literalOutputText(token tok, string &text)
+{
+   if (tok.ttype == TokenType::TextLit) {
+      // escapes could run on into the text that follows them
+      if (tok.content.find('\\') != string::npos) return false;
+      text = tok.content.substr(1, tok.content.length() - 2);
+      return true;
+   } else if (tok.ttype == TokenType::IntLit) {
+      // leading zeros make C++ read the literal as octal
+      if (tok.content.length() > 1 && tok.content[0] == '0') return false;
+      text = tok.content;
+      return true;
+   } else if (tok.ttype == TokenType::BoolLit) {
+      text = (tok.content == "true") ? "1" : "0";
+      return true;
+   }
+   return false;
+}
+
+
+// parse a run of consecutive output statements as one output operation,
+//    or a single output statement if they cannot be combined
+int parseOutputRun(token tokens[], int currPos, int size, int indent) {
+
+   // only writes without calls or increments can be combined,
+   //    as nothing else they do can depend on the order of the output
+   vector<int> writes;
+
+   for (int pos = currPos; pos < size && tokens[pos].ttype == TokenType::Write; ) {
+      int writeEnd = skipExpression(tokens, pos + 1, size);
+      if (writeEnd == -1) break;
+
+      bool hasEffects = false;
+      for (int exprPos = pos + 1; exprPos <= writeEnd; exprPos++) {
+         if (tokens[exprPos].ttype == TokenType::Call || isIncrementOperator(tokens[exprPos].ttype)) {
+            hasEffects = true;
+         }
+      }
+      if (hasEffects) break;
+
+      writes.push_back(pos);
+      pos = writeEnd + 1;
+   }
+
+   if (writes.size() < 2) {
+      return parseOutput(tokens, currPos, size, indent);
+   }
+
+   // each value still goes on its own line, with adjacent literal text joined
+   string content = outputStream();
+   string text = "";
+   string continuation = "\n";
+   for (int i = 0; i <= indent; i++) {
+      continuation += INDENT;
+   }
+   bool hasValue = false;
+
+   for (size_t i = 0; i < writes.size(); i++) {
+      string literal = "";
+
+      if (i > 0) {
+         printCachedLoads(tokens, writes[i], size, indent);
+      }
+
+      if (literalOutputText(tokens[writes[i] + 1], literal)) {
+         text += literal;
+         currPos = writes[i] + 1;
+      } else {
+         if (text.length() != 0) {
+            content += (hasValue ? continuation + "<< \"" : " << \"") + text + "\"";
+            text = "";
+         }
+
+         content += " << ";
+         currPos = parseExpression(tokens, writes[i] + 1, size, content);
+         if (currPos == -1) return -1;
+         hasValue = true;
+      }
+
+      if (i + 1 < writes.size()) {
+         text += "\\n";
+      }
+   }
+
+   if (text.length() != 0) {
+      content += (hasValue ? continuation + "<< \"" : " << \"") + text + "\"";
+   }
+
+   printIndent(indent);
+   cout << content << " << " << outputLineEnd() << ";\n";
    return currPos;
 }
 
@@ -588,7 +996,7 @@ int parseInput(token tokens[], int currPos, int size, int indent) {
    }
 
    printIndent(indent);
-   cout << "cin >> " << tokens[currPos].content << ";\n";
+   cout << inputStatement(variableName(tokens[currPos].content)) << ";\n";
    return currPos;
 }
 
@@ -618,11 +1026,24 @@ int parseReturnStmt(token tokens[], int currPos, int size, int indent) {
       return -1;
    }
 
-   currPos ++;
-   if (currPos >= size) return -1;
+   // leaving loops early, their counts so far are kept
+   printLoopCounts(indent);
+
+   string literal = "";
+   if (isSelfTailCall(tokens, currPos, size) && !evaluateCall(tokens, currPos + 1, size, literal)) {
+      return parseTailJump(tokens, currPos + 1, size, indent);
+   }
 
    string content = "return ";
 
+   // the C++ compiler is asked to jump to another procedure of the same form
+   if (isSiblingTailCall(tokens, currPos, size)) {
+      content = "VURB_MUSTTAIL return ";
+   }
+
+   currPos ++;
+   if (currPos >= size) return -1;
+
    currPos = parseExpression(tokens, currPos, size, content);
 
    if (currPos >= size || currPos == -1) return -1;
@@ -634,6 +1055,88 @@ int parseReturnStmt(token tokens[], int currPos, int size, int indent) {
 }
 
 
+// parse a self tail call as assignments to the parameters
+//    and a jump back to the start of the procedure
+int parseTailJump(token tokens[], int currPos, int size, int indent) {
+
+   const procedureInfo *proc = enclosingProcedure(currPos);
+   if (!proc) return -1;
+
+   // the parameters passed something other than themselves,
+   //    with the C++ types of their values
+   vector<string> changed;
+   vector<string> types;
+   vector<string> values;
+   int argPos = currPos + 3;
+
+   for (size_t i = 0; i < proc->params.size(); i++) {
+      const paramInfo &param = proc->params[i];
+      if (argPos >= size) return -1;
+
+      int argEnd = skipExpression(tokens, argPos, size);
+      if (argEnd == -1) return -1;
+
+      if (argEnd != argPos || tokens[argPos].content != param.name) {
+         string value = "";
+         if (parseExpression(tokens, argPos, size, value) == -1) return -1;
+
+         changed.push_back(param.name);
+         types.push_back(tokenToCPPString(param.ptype) + (param.isArray ? " *" : " "));
+         values.push_back(value);
+
+         // an array brings its number of elements along with it
+         if (param.isArray) {
+            typeInfo argType;
+            if (!accessType(tokens, argPos, size, argType) || !argType.isArray) {
+               printError(tokens[argPos], argPos, "Array");
+               return -1;
+            }
+            changed.push_back(arraySizeName(param.name));
+            types.push_back("long ");
+            values.push_back(argType.arraySize);
+         }
+      }
+      argPos = argEnd + 1;
+   }
+
+   if (argPos >= size || tokens[argPos].ttype != TokenType::Right) {
+      printError(tokens[argPos], argPos, tokenTypeToString(TokenType::Right));
+      return -1;
+   }
+
+   printIndent(indent);
+   cout << "{\n";
+
+   if (changed.size() == 1) {
+      printIndent(indent + 1);
+      cout << changed[0] << " = " << values[0] << ";\n";
+   } else {
+      // every argument is worked out before any parameter changes
+      for (size_t i = 0; i < changed.size(); i++) {
+         printIndent(indent + 1);
+         cout << types[i] << "vurb_arg" << i << " = " << values[i] << ";\n";
+      }
+
+      for (size_t i = 0; i < changed.size(); i++) {
+         printIndent(indent + 1);
+         cout << changed[i] << " = ";
+         if (types[i] == tokenToCPPString(TokenType::TextType) + " ") {
+            cout << "std::move(vurb_arg" << i << ");\n";
+         } else {
+            cout << "vurb_arg" << i << ";\n";
+         }
+      }
+   }
+
+   printIndent(indent + 1);
+   cout << "goto vurb_tail;\n";
+   printIndent(indent);
+   cout << "}\n";
+
+   return argPos;
+}
+
+
 // parse an increment/decrement statement
 int parseIncrement(token tokens[], int currPos, int size, string &content) {
 
@@ -658,7 +1161,7 @@ int parseIncrement(token tokens[], int currPos, int size, string &content) {
          return -1;
       }
 
-      content += tokens[currPos].content;
+      content += variableName(tokens[currPos].content);
 
       currPos ++;
       if (currPos >= size) return -1;
@@ -681,7 +1184,7 @@ int parseIncrement(token tokens[], int currPos, int size, string &content) {
          return -1;
       }
 
-      content += tokens[currPos].content + op;
+      content += variableName(tokens[currPos].content) + op;
 
       currPos++;
       if (currPos >= size) return -1;
@@ -711,6 +1214,42 @@ int parseIfLoop(token tokens[], int currPos, int size, int indent) {
       return -1;
    }
 
+   // loops whose passes are independent may be shared out between threads,
+   //    though not from within another such loop
+   int loopPos = currPos;
+   parallelLoop loop;
+   bool isParallel = (options.parallel && !inParallelLoop
+      && planParallelLoop(tokens, currPos, size, loop));
+
+   // large arrays declared within the loop are allocated once ahead of it,
+   //    unless an enclosing loop has already done so, which would leave
+   //    them shared between the threads of a parallel loop
+   vector<int> loopArrays = findLoopArrays(tokens, currPos, size);
+   for (size_t i = 0; i < loopArrays.size(); i++) {
+      if (hoistedArrays.count(loopArrays[i])) isParallel = false;
+   }
+
+   // globals the loop both reads and writes are kept in locals while it runs,
+   //    so the C++ compiler can hold them in registers
+   vector<string> promoted;
+   if (!isParallel) {
+      promoted = findPromotableGlobals(tokens, currPos, size);
+   }
+   int loopIndent = indent;
+
+   if (!promoted.empty()) {
+      printIndent(indent);
+      cout << "{\n";
+      loopIndent = indent + 1;
+
+      for (size_t i = 0; i < promoted.size(); i++) {
+         printIndent(loopIndent);
+         cout << tokenToCPPString(lookupVariable(promoted[i])->ttype) << " vurb_" << promoted[i];
+         cout << " = " << promoted[i] << ";\n";
+         renameVariable(promoted[i], "vurb_" + promoted[i]);
+      }
+   }
+
    currPos++;
    if (currPos >= size) return size;
 
@@ -720,13 +1259,80 @@ int parseIfLoop(token tokens[], int currPos, int size, int indent) {
    currPos++;
    if (currPos >= size) return size;
 
-   printIndent(indent);
-   cout << tokenToCPPString(TokenType::If) << "(" << condStmt << ")\n";
+   if (options.checked) {
+      printRangeChecks(tokens, loopPos, size, loopIndent);
+   }
 
-   // parse the if loop body
-   currPos = parseBody(tokens, currPos, size, indent);
+   if (isParallel) {
+      currPos = parseParallelLoop(tokens, currPos, size, indent, loop);
+   } else {
+      for (size_t i = 0; i < loopArrays.size(); i++) {
+         if (hoistedArrays.count(loopArrays[i])) continue;
+         printArrayStorageDef(tokens, loopArrays[i], size, loopIndent);
+         hoistedArrays[loopArrays[i]] = true;
+      }
+
+      printStringReserves(tokens, loopPos, size, loopIndent);
+
+      // a profiled loop counts in locals, which the compiler can keep in
+      //    registers, adding them to the table once the outermost loop is done;
+      //    only that loop is timed, keeping the clock out of inner loops
+      int counter = options.profile ? profileCounter(loopPos) : -1;
+      bool isTimed = (counter != -1 && !isNestedLoop(loopPos));
+      int whileIndent = loopIndent;
+      if (isTimed) {
+         profiledLoops.push_back(counter);
+         vector<int> nested = nestedLoopCounters(loopPos);
+         profiledLoops.insert(profiledLoops.end(), nested.begin(), nested.end());
+
+         printIndent(loopIndent);
+         cout << "{\n";
+         whileIndent = loopIndent + 1;
+         printIndent(whileIndent);
+         cout << "vurb_Scope vurb_scope(" << counter << ");\n";
+         for (size_t i = 0; i < profiledLoops.size(); i++) {
+            printIndent(whileIndent);
+            cout << "long vurb_passes" << profiledLoops[i] << " = 0;\n";
+            if (i > 0) {
+               printIndent(whileIndent);
+               cout << "long vurb_runs" << profiledLoops[i] << " = 0;\n";
+            }
+         }
+      } else if (counter != -1) {
+         printIndent(loopIndent);
+         cout << "vurb_runs" << counter << "++;\n";
+      }
+      if (counter != -1) {
+         bodyStart = "vurb_passes" + to_string(counter) + "++;";
+      }
+
+      printIndent(whileIndent);
+      cout << tokenToCPPString(TokenType::If) << "(" << condStmt << ")\n";
+
+      // parse the if loop body
+      currPos = parseBody(tokens, currPos, size, whileIndent);
+
+      if (isTimed) {
+         printLoopCounts(whileIndent);
+         profiledLoops.clear();
+         printIndent(loopIndent);
+         cout << "}\n";
+      }
+   }
 
    if (currPos == -1) return -1;
+
+   if (!promoted.empty()) {
+      for (size_t i = 0; i < promoted.size(); i++) {
+         restoreVariableName(promoted[i]);
+         printIndent(loopIndent);
+         cout << promoted[i] << " = vurb_" << promoted[i] << ";\n";
+      }
+
+      printIndent(indent);
+      cout << "}\n";
+   }
+
    if (currPos + 1 >= size) return size;
 
    if (tokens[currPos + 1].ttype != TokenType::Else) {
@@ -742,12 +1348,74 @@ int parseIfLoop(token tokens[], int currPos, int size, int indent) {
 }
 
 
+// print the additions to the profile table of the runs and passes
+//    of the loops being counted in locals
+void printLoopCounts(int indent) {
+   for (size_t i = 0; i < profiledLoops.size(); i++) {
+      int counter = profiledLoops[i];
+      if (i > 0) {
+         printIndent(indent);
+         cout << "vurb_profile[" << counter << "].calls += vurb_runs" << counter << ";\n";
+      }
+      printIndent(indent);
+      cout << "vurb_profile[" << counter << "].passes += vurb_passes" << counter << ";\n";
+   }
+}
+
+
+// parse the body of a counted if loop whose passes are independent,
+//    as a loop shared out between threads once it runs long enough
+int parseParallelLoop(token tokens[], int currPos, int size, int indent, const parallelLoop &loop) {
+
+   string counter = variableName(loop.counter);
+   string limit = variableName(loop.limit);
+   string index = "vurb_par_" + loop.counter;
+   string op = loop.isInclusive ? " <= " : " < ";
+   string passes = "(" + limit + " - " + counter + (loop.isInclusive ? " + 1)" : ")");
+
+   printIndent(indent);
+   cout << "#pragma omp parallel for if(" << passes << " >= " << options.parallelMin << ")";
+   for (size_t i = 0; i < loop.reductions.size(); i++) {
+      cout << " reduction(" << tokenToCPPString(loop.reductionOps[i]) << ":";
+      cout << variableName(loop.reductions[i]) << ")";
+   }
+   cout << "\n";
+
+   printIndent(indent);
+   cout << "for (long " << index << " = " << counter << "; " << index << op << limit << "; ";
+   cout << index << "++)\n";
+
+   // the for loop steps its own index in place of the counter
+   renameVariable(loop.counter, index);
+   omittedStatement = loop.stepPos;
+   inParallelLoop = true;
+
+   currPos = parseBody(tokens, currPos, size, indent);
+
+   inParallelLoop = false;
+   omittedStatement = -1;
+   restoreVariableName(loop.counter);
+
+   if (currPos == -1) return -1;
+
+   // leave the counter where the original loop would have
+   printIndent(indent);
+   cout << "if (" << counter << op << limit << ") " << counter << " = " << limit;
+   cout << (loop.isInclusive ? " + 1;\n" : ";\n");
+
+   return currPos;
+}
+
+
 // parse a procedure call
 int parseProcedureCall(token tokens[], int currPos, int size, string &content) {
 
    if (currPos >= size) return currPos;
 
+   int callPos = currPos;
+   string procname = "";
    string args = "";
+   string literal = "";
 
    if (tokens[currPos].ttype != TokenType::Call) {
       printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Call));
@@ -762,7 +1430,7 @@ int parseProcedureCall(token tokens[], int currPos, int size, string &content) {
          return -1;
    }
 
-   content += tokens[currPos].content;
+   procname = tokens[currPos].content;
 
    currPos++;
    if (currPos >= size) return size;
@@ -775,15 +1443,38 @@ int parseProcedureCall(token tokens[], int currPos, int size, string &content) {
    currPos++;
    if (currPos >= size) return size;
 
+   const procedureInfo *proc = findProcedure(procname);
+   size_t argIndex = 0;
+
    while((tokens[currPos].ttype != TokenType::Right)) {
       if (args.length() != 0) {
          args += ", ";
       }
-
-      currPos = parseExpression(tokens, currPos, size, args);
+      int argPos = currPos;
+
+      // text passed by value is moved into the call if it is not needed afterwards
+      if (proc && argIndex < proc->params.size() && !proc->params[argIndex].isArray
+         && proc->params[argIndex].ptype == TokenType::TextType
+         && !proc->params[argIndex].isConstRef
+         && isMovableValue(tokens, currPos, size)) {
+         args += "std::move(" + variableName(tokens[currPos].content) + ")";
+      } else {
+         currPos = parseExpression(tokens, currPos, size, args);
+      }
 
       if (currPos == -1) return -1;
 
+      // arrays are passed along with their number of elements
+      if (proc && argIndex < proc->params.size() && proc->params[argIndex].isArray) {
+         typeInfo argType;
+         if (!accessType(tokens, argPos, size, argType) || !argType.isArray) {
+            printError(tokens[argPos], argPos, "Array");
+            return -1;
+         }
+         args += ", " + argType.arraySize;
+      }
+      argIndex++;
+
       currPos ++;
       if (currPos >= size) return -1;
    }
@@ -793,7 +1484,13 @@ int parseProcedureCall(token tokens[], int currPos, int size, string &content) {
       return -1;
    }
 
-   content += "(" + args + ")";
+   // pure procedures called with constant arguments are replaced by their result
+   if (evaluateCall(tokens, callPos, size, literal) && literal.length() != 0) {
+      content += literal;
+      return currPos;
+   }
+
+   content += procname + "(" + args + ")";
 
    return currPos;
 }
@@ -804,12 +1501,23 @@ int parseExpression(token tokens[], int currPos, int size, string &content) {
 
    if (currPos >= size) return -1;
 
-   if ((tokens[currPos].ttype == TokenType::Identifier)
-      || isLiteralValue(tokens[currPos].ttype)) {
+   // repeated loads may already be held in a local
+   string cachedLoad = "";
+   if (findCachedLoad(currPos, cachedLoad)) {
+      content += cachedLoad;
+      return skipExpression(tokens, currPos, size);
+   }
+
+   if (tokens[currPos].ttype == TokenType::Identifier) {
+         content += variableName(tokens[currPos].content);
+         return currPos;
+   } else if (isLiteralValue(tokens[currPos].ttype)) {
          content += tokens[currPos].content;
          return currPos;
    } else if (tokens[currPos].ttype == TokenType::ArrayAccess) {
       return parseArrayAccess(tokens, currPos, size, content);
+   } else if (tokens[currPos].ttype == TokenType::ArraySize) {
+      return parseArraySize(tokens, currPos, size, content);
    } else if (tokens[currPos].ttype == TokenType::StructElemAccess
       || tokens[currPos].ttype == TokenType::StructIndirElemAccess) {
       return parseStructAccess(tokens, currPos, size, content);
@@ -827,6 +1535,8 @@ int parseExpression(token tokens[], int currPos, int size, string &content) {
 
       if (isBinaryOperator(tokens[currPos].ttype)) {
          bool isCondExpOp = isCondExpOperator(tokens[currPos].ttype);
+         bool isDivision = (tokens[currPos].ttype == TokenType::Div || tokens[currPos].ttype == TokenType::Rem);
+         bool isIntegerResult = (valueType(tokens, currPos - 1, size) == TokenType::IntType);
          string binaryOp = tokenToCPPString(tokens[currPos].ttype);
 
          if (isCondExpOp) {
@@ -837,13 +1547,23 @@ int parseExpression(token tokens[], int currPos, int size, string &content) {
 
          if (currPos == -1) return -1;
          content += " " + binaryOp + " ";
-         
+
+         // integer divisors other than literals are checked in --checked mode,
+         //    while real division by zero gives infinity or nan as it does unchecked
+         bool checksDivisor = (options.checked && isDivision && isIntegerResult && currPos + 1 < size
+            && tokens[currPos + 1].ttype != TokenType::RealLit
+            && (tokens[currPos + 1].ttype != TokenType::IntLit
+               || tokens[currPos + 1].content.find_first_not_of('0') == string::npos));
+         if (checksDivisor) content += "vurb_checkDivisor(";
+
          if (isCondExpOp) {
             currPos = parseCondExpression(tokens, currPos + 1, size, content);
          } else {
             currPos = parseExpression(tokens, currPos + 1, size, content);
          }
 
+         if (checksDivisor) content += ")";
+
          if (currPos == -1) return -1;
       } else if (isUnaryOperator(tokens[currPos].ttype)) {
          bool isCondExpOp = isCondExpOperator(tokens[currPos].ttype);
@@ -893,9 +1613,10 @@ int parseCondExpression(token tokens[], int currPos, int size, string &content)
    if (currPos >= size) return -1;
 
    // expression is a boolean literal or identifier
-   if (tokens[currPos].ttype == TokenType::BoolLit
-   || tokens[currPos].ttype == TokenType::Identifier) {
+   if (tokens[currPos].ttype == TokenType::BoolLit) {
       content += tokens[currPos].content;
+   } else if (tokens[currPos].ttype == TokenType::Identifier) {
+      content += variableName(tokens[currPos].content);
    }
    // expression uses a binary operator
    else if (isBinaryOperator(tokens[currPos].ttype)) {
@@ -990,7 +1711,7 @@ int parseArrayDef(token tokens[], int currPos, int size, string &content) {
       return -1;
    }
 
-   arrayType = tokenToCPPString(tokens[currPos].ttype);
+   arrayType = arrayElementType(varname, tokens[currPos].ttype);
 
    currPos++;
    if (currPos >= size) return size;
@@ -1015,6 +1736,8 @@ int parseArraySet(token tokens[], int currPos, int size, string &content) {
    string index = "";
    string value = "";
 
+   int setPos = currPos;
+
    if (tokens[currPos].ttype != TokenType::ArraySet) {
       printError(tokens[currPos], currPos, tokenTypeToString(TokenType::ArraySet));
       return -1;
@@ -1029,7 +1752,7 @@ int parseArraySet(token tokens[], int currPos, int size, string &content) {
       currPos = parseStructAccess(tokens, currPos, size, varname);
    // Otherwise get the name of the variable, if its an identifier
    } else if (tokens[currPos].ttype == TokenType::Identifier) {
-      varname += tokens[currPos].content;
+      varname += variableName(tokens[currPos].content);
    // Otherwise its an error
    } else {
       printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Identifier));
@@ -1047,7 +1770,7 @@ int parseArraySet(token tokens[], int currPos, int size, string &content) {
       return -1;
    }
 
-   index += tokens[currPos].content;
+   index += checkedIndex(tokens, setPos, size, variableName(tokens[currPos].content));
 
    currPos++;
    if (currPos >= size) return size;
@@ -1069,6 +1792,8 @@ int parseArrayAccess(token tokens[], int currPos, int size, string &content) {
    string varname = "";
    string index = "";
 
+   int accessPos = currPos;
+
    if (tokens[currPos].ttype != TokenType::ArrayAccess) {
       printError(tokens[currPos], currPos, tokenTypeToString(TokenType::ArrayAccess));
       return -1;
@@ -1083,7 +1808,7 @@ int parseArrayAccess(token tokens[], int currPos, int size, string &content) {
       currPos = parseStructAccess(tokens, currPos, size, varname);
    // Otherwise get the name of the variable, if its an identifier
    } else if (tokens[currPos].ttype == TokenType::Identifier) {
-      varname += tokens[currPos].content;
+      varname += variableName(tokens[currPos].content);
    // Otherwise its an error
    } else {
       printError(tokens[currPos], currPos, tokenTypeToString(TokenType::Identifier));
@@ -1101,7 +1826,15 @@ int parseArrayAccess(token tokens[], int currPos, int size, string &content) {
       return -1;
    }
 
-   index += tokens[currPos].content;
+   index += checkedIndex(tokens, accessPos, size, variableName(tokens[currPos].content));
+
+   // elements of narrowed arrays are widened again before any arithmetic on them
+   if (tokens[accessPos + 1].ttype == TokenType::Identifier && isNarrowedArray(tokens[accessPos + 1].content)) {
+      typeInfo type;
+      accessType(tokens, accessPos, size, type);
+      content += "((" + tokenToCPPString(type.ttype) + ")" + varname + "[" + index + "])";
+      return currPos;
+   }
 
    content += varname + "[" + index + "]";
 
@@ -1109,6 +1842,62 @@ int parseArrayAccess(token tokens[], int currPos, int size, string &content) {
 }
 
 
+// returns true if both are literals of decimal digits and the first is the
+//    smaller, compared digit by digit so that literals too long for a long
+//    are compared too
+static bool isLessLiteral(string first, string second)
+{
+   if (first.empty() || second.empty() || first.find_first_not_of("0123456789") != string::npos
+      || second.find_first_not_of("0123456789") != string::npos) return false;
+
+   first.erase(0, std::min(first.find_first_not_of('0'), first.size() - 1));
+   second.erase(0, std::min(second.find_first_not_of('0'), second.size() - 1));
+   if (first.size() != second.size()) return first.size() < second.size();
+   return first < second;
+}
+
+
+// returns the C++ index for the array access or set at currPos, checked against
+//    the size of the array in --checked mode unless it is known to be in range
+string checkedIndex(token tokens[], int currPos, int size, string index) {
+
+   if (!options.checked || isRangeChecked(currPos)) return index;
+
+   typeInfo type;
+   if (!accessType(tokens, currPos + 1, size, type) || !type.isArray) return index;
+
+   // literal indexes into arrays of literal size are checked here instead
+   if (isLessLiteral(index, type.arraySize)) return index;
+
+   return "vurb_checkIndex(" + index + ", " + type.arraySize + ")";
+}
+
+
+// parse an array size expression
+int parseArraySize(token tokens[], int currPos, int size, string &content) {
+   if (currPos >= size) return currPos;
+
+   if (tokens[currPos].ttype != TokenType::ArraySize) {
+      printError(tokens[currPos], currPos, tokenTypeToString(TokenType::ArraySize));
+      return -1;
+   }
+
+   currPos++;
+   if (currPos >= size) return size;
+
+   // the size is known from the array's declaration, or passed along with it
+   typeInfo type;
+   if (!accessType(tokens, currPos, size, type) || !type.isArray) {
+      printError(tokens[currPos], currPos, "Array");
+      return -1;
+   }
+
+   content += type.arraySize;
+
+   return skipExpression(tokens, currPos, size);
+}
+
+
 // parse a struct build statement
 int parseStructBuild(token tokens[], int currPos, int size, string &content) {
    if (currPos >= size) return currPos;
@@ -1171,7 +1960,8 @@ int parseStructSet(token tokens[], int currPos, int size, int indent) {
       return -1;
    }
 
-   structname += tokens[currPos].content;
+   structname += variableName(tokens[currPos].content);
+   const typeInfo *structType = lookupVariable(tokens[currPos].content);
 
    currPos++;
    if (currPos >= size) return size;
@@ -1181,17 +1971,33 @@ int parseStructSet(token tokens[], int currPos, int size, int indent) {
       return -1;
    }
 
-   element += tokens[currPos].content;
+   // elements may have been moved into the cold part of the struct
+   string elementName = tokens[currPos].content;
+   if (structType) {
+      element += structElementPath(structType->structName, elementName);
+   } else {
+      element += elementName;
+   }
 
    currPos++;
    if (currPos >= size) return size;
 
-   currPos = parseExpression(tokens, currPos, size, value);
+   // a text or struct value that is not needed afterwards is moved rather than copied
+   if (isMovableValue(tokens, currPos, size)) {
+      value = "std::move(" + variableName(tokens[currPos].content) + ")";
+   } else {
+      currPos = parseExpression(tokens, currPos, size, value);
+   }
 
    if (currPos == -1) return -1;
 
    printIndent(indent);
-   cout << structname << op << element << " = " << value << ";\n";
+   if (structType) {
+      cout << countElementAccess(structType->structName, elementName, structname + op + element);
+   } else {
+      cout << structname << op << element;
+   }
+   cout << " = " << value << ";\n";
 
    return currPos;
 }
@@ -1216,11 +2022,13 @@ int parseStructAccess(token tokens[], int currPos, int size, string &content) {
    currPos++;
    if (currPos >= size) return size;
 
+   int structPos = currPos;
+
    if (tokens[currPos].ttype == TokenType::StructElemAccess
       || tokens[currPos].ttype == TokenType::StructIndirElemAccess) {
       currPos = parseStructAccess(tokens, currPos, size, leftSide);
    } else if (tokens[currPos].ttype == TokenType::Identifier) {
-      leftSide += tokens[currPos].content;
+      leftSide += variableName(tokens[currPos].content);
    } else {
       printError(tokens[currPos], currPos, "Struct identifier");
       return -1;
@@ -1236,9 +2044,15 @@ int parseStructAccess(token tokens[], int currPos, int size, string &content) {
       return -1;
    }
 
-   element += tokens[currPos].content;
-
-   content += leftSide + op + element;
+   // elements may have been moved into the cold part of the struct
+   typeInfo structType;
+   if (accessType(tokens, structPos, size, structType)) {
+      element += structElementPath(structType.structName, tokens[currPos].content);
+      content += countElementAccess(structType.structName, tokens[currPos].content, leftSide + op + element);
+   } else {
+      element += tokens[currPos].content;
+      content += leftSide + op + element;
+   }
 
    return currPos;
 }
@@ -1331,7 +2145,7 @@ string tokenToCPPString(TokenType type) {
       case StructElemSet:
          return ".";
       case Main:
-         return "\nint main()\n";
+         return "int main()\n";
       case If:
          return "while";
       case Return:
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tokenizing.h"
+#include "optimizing.h"
 #include <string>
 
 using std::string;
@@ -10,7 +11,8 @@ const string INDENT = "   ";
 // parse the token sequence and rewrite as C++,
 //    writing the results to standard output,
 // with any error messages directed to standard error
-void parse(token tokens[], int size);
+// returns false if the program is malformed
+bool parse(token tokens[], int size);
 
 
 // print the C++ preamble, featuring include statements
@@ -18,6 +20,11 @@ void parse(token tokens[], int size);
 void printPreamble();
 
 
+// print the definition of VURB_MUSTTAIL, which asks compilers that support it
+//    to turn a returned call into a jump
+void printTailCallMacro();
+
+
 // parse the main routine
 int parseMain(token tokens[], int currPos, int size);
 
@@ -50,6 +57,15 @@ int parseBody(token tokens[], int currPos, int size, int indent);
 int parseLocalVarDef(token tokens[], int currPos, int size, int indent);
 
 
+// parse a local array sized by an expression, working out its size and
+//    taking its storage when the declaration is reached
+int parseRuntimeArrayDef(token tokens[], int currPos, int size, int indent);
+
+
+// print the definition of the storage for the separately kept array declared at currPos
+void printArrayStorageDef(token tokens[], int currPos, int size, int indent);
+
+
 // parse a set variable statement
 int parseSetStmt(token tokens[], int currPos, int size, int indent);
 
@@ -58,6 +74,11 @@ int parseSetStmt(token tokens[], int currPos, int size, int indent);
 int parseOutput(token tokens[], int currPos, int size, int indent);
 
 
+// parse a run of consecutive output statements as one output operation,
+//    or a single output statement if they cannot be combined
+int parseOutputRun(token tokens[], int currPos, int size, int indent);
+
+
 // parse an input statement
 int parseInput(token tokens[], int currPos, int size, int indent);
 
@@ -70,6 +91,11 @@ int parseStandaloneStmt(token tokens[], int currPos, int size, int indent);
 int parseReturnStmt(token tokens[], int currPos, int size, int indent);
 
 
+// parse a self tail call as assignments to the parameters
+//    and a jump back to the start of the procedure
+int parseTailJump(token tokens[], int currPos, int size, int indent);
+
+
 // parse an increment/decrement statement
 int parseIncrement(token tokens[], int currPos, int size, string &content);
 
@@ -78,6 +104,16 @@ int parseIncrement(token tokens[], int currPos, int size, string &content);
 int parseIfLoop(token tokens[], int currPos, int size, int indent);
 
 
+// print the additions to the profile table of the runs and passes
+//    of the loops being counted in locals
+void printLoopCounts(int indent);
+
+
+// parse the body of a counted if loop whose passes are independent,
+//    as a loop shared out between threads once it runs long enough
+int parseParallelLoop(token tokens[], int currPos, int size, int indent, const parallelLoop &loop);
+
+
 // parse a procedure call
 int parseProcedureCall(token tokens[], int currPos, int size, string &content);
 
@@ -102,6 +138,15 @@ int parseArraySet(token tokens[], int currPos, int size, string &content);
 int parseArrayAccess(token tokens[], int currPos, int size, string &content);
 
 
+// returns the C++ index for the array access or set at currPos, checked against
+//    the size of the array in --checked mode unless it is known to be in range
+string checkedIndex(token tokens[], int currPos, int size, string index);
+
+
+// parse an array size expression
+int parseArraySize(token tokens[], int currPos, int size, string &content);
+
+
 // parse a struct build statement
 int parseStructBuild(token tokens[], int currPos, int size, string &content);
 
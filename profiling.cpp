@@ -0,0 +1,299 @@
+#include "profiling.h"
+#include "symbols.h"
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+using std::cout;
+using std::to_string;
+using std::unordered_map;
+using std::vector;
+
+// the profile counter of each procedure definition, main routine and if loop,
+//    by the position of its first token
+static unordered_map<int, int> profileCounters;
+
+// the name each counter is reported under, whether it counts a loop,
+//    and whether it is timed
+static vector<string> counterNames;
+static vector<bool> counterLoops;
+static vector<bool> counterTimes;
+
+// the counters of the loops within each loop that is not itself nested,
+//    by the position of the outer loop
+static unordered_map<int, vector<int>> nestedCounters;
+
+// the struct and element each element counter counts the accesses of,
+//    and the counter of each element, by struct and element name
+static vector<string> elementStructs;
+static vector<string> elementNames;
+static unordered_map<string, unordered_map<string, int>> elementCounters;
+
+// the file the element counts are written to, as a layout profile
+static const char *LayoutProfileFile = "layout.profile";
+
+
+// the clock the scopes are timed by, which on x86 is the time stamp counter,
+//    read in a few cycles, and elsewhere the monotonic clock in nanoseconds,
+//    the call that counts an access to a struct element, sequenced as a call
+//    so one expression can count the same element twice, and the type of the
+//    counters in the profile table
+static const char *profileRuntimeStart = R"(#include <cstdio>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+inline unsigned long long vurb_now() {
+   return __rdtsc();
+}
+#else
+#include <time.h>
+
+inline unsigned long long vurb_now() {
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+#endif
+
+template <typename T>
+inline T &vurb_counted(long &count, T &element) {
+   count++;
+   return element;
+}
+
+struct vurb_Counter {
+   const char *name;
+   bool isLoop;
+   bool isTimed;
+   long calls;
+   long passes;
+   long active;
+   unsigned long long total;
+   unsigned long long self;
+};
+)";
+
+// a scope times one call of a procedure or one run of a loop, taking the time
+//    spent in the scopes within it out of its self time, and timing a
+//    procedure that calls itself as a whole only at its outermost call;
+//    the report is printed as the program ends, busiest first, leaving out
+//    the times of loops nested in others, which are part of the outer loop's,
+//    and the struct element counts are then written out
+static const char *profileRuntimeEnd = R"(
+struct vurb_Scope;
+static vurb_Scope *vurb_innermost = nullptr;
+
+struct vurb_Scope {
+   vurb_Counter &counter;
+   vurb_Scope *outer;
+   unsigned long long start;
+   unsigned long long inner;
+
+   explicit vurb_Scope(int index) : counter(vurb_profile[index]), outer(vurb_innermost), inner(0) {
+      counter.calls++;
+      counter.active++;
+      vurb_innermost = this;
+      start = vurb_now();
+   }
+
+   ~vurb_Scope() {
+      unsigned long long spent = vurb_now() - start;
+      counter.self += spent - inner;
+      if (--counter.active == 0) counter.total += spent;
+      if (outer) outer->inner += spent;
+      vurb_innermost = outer;
+   }
+
+   vurb_Scope(const vurb_Scope &) = delete;
+   vurb_Scope &operator=(const vurb_Scope &) = delete;
+};
+
+struct vurb_ProfileReport {
+   ~vurb_ProfileReport() {
+      int order[vurb_profileSize];
+      int count = 0;
+      unsigned long long run = 0;
+      for (int i = 0; i < vurb_profileSize; i++) {
+         if (vurb_profile[i].calls == 0) continue;
+         int j = count++;
+         while (j > 0 && vurb_profile[order[j - 1]].self < vurb_profile[i].self) {
+            order[j] = order[j - 1];
+            j--;
+         }
+         order[j] = i;
+         run += vurb_profile[i].self;
+      }
+
+      fprintf(stderr, "%-40s %12s %14s %18s %18s %7s\n",
+         "profile", "calls", "passes", "total ticks", "self ticks", "self");
+      for (int i = 0; i < count; i++) {
+         const vurb_Counter &counter = vurb_profile[order[i]];
+         char passes[24] = "-";
+         if (counter.isLoop) snprintf(passes, sizeof(passes), "%ld", counter.passes);
+         if (!counter.isTimed) {
+            fprintf(stderr, "%-40s %12ld %14s %18s %18s %7s\n",
+               counter.name, counter.calls, passes, "-", "-", "-");
+            continue;
+         }
+         fprintf(stderr, "%-40s %12ld %14s %18llu %18llu %6.1f%%\n",
+            counter.name, counter.calls, passes, counter.total, counter.self,
+            run ? 100.0 * counter.self / run : 0.0);
+      }
+      vurb_writeElementCounts();
+   }
+};
+
+static vurb_ProfileReport vurb_profileReport;
+)";
+
+
+// give each procedure, the main routine, each if loop and each struct element
+//    of the program a counter of its own in the profile table
+void planProfile(token tokens[], int size)
+{
+   string procedure = "";
+
+   // the depth of begin and end each open loop body started at,
+   //    and the outermost of those loops
+   vector<int> loopBodies;
+   int depth = 0;
+   int outerLoop = -1;
+   bool bodyNext = false;
+
+   for (int pos = 0; pos < size; pos++) {
+      string name = "";
+      bool isLoop = false;
+      bool isNested = false;
+
+      if (tokens[pos].ttype == TokenType::StructDef && pos + 1 < size) {
+         // each element of the struct is counted, up to the end of its definition
+         string structName = tokens[pos + 1].content;
+         for (pos += 2; pos < size && tokens[pos].ttype != TokenType::End; pos++) {
+            string element;
+            typeInfo type;
+            if (tokens[pos].ttype != TokenType::Element
+               || readDeclaration(tokens, pos + 1, size, element, type) == -1) continue;
+            elementCounters[structName][element] = (int)elementStructs.size();
+            elementStructs.push_back(structName);
+            elementNames.push_back(element);
+         }
+         continue;
+      } else if (tokens[pos].ttype == TokenType::Begin) {
+         depth++;
+         if (bodyNext) loopBodies.push_back(depth);
+         bodyNext = false;
+         continue;
+      } else if (tokens[pos].ttype == TokenType::End) {
+         if (!loopBodies.empty() && loopBodies.back() == depth) loopBodies.pop_back();
+         depth--;
+         continue;
+      } else if (tokens[pos].ttype == TokenType::ProcDef && pos + 1 < size) {
+         procedure = tokens[pos + 1].content;
+         name = procedure;
+      } else if (tokens[pos].ttype == TokenType::Main) {
+         procedure = "main";
+         name = procedure;
+      } else if (tokens[pos].ttype == TokenType::If) {
+         name = procedure + " loop at line " + to_string(tokens[pos].line);
+         isLoop = true;
+         isNested = !loopBodies.empty();
+         if (!isNested) outerLoop = pos;
+         bodyNext = true;
+      } else {
+         continue;
+      }
+
+      int counter = (int)counterNames.size();
+      profileCounters[pos] = counter;
+      counterNames.push_back(name);
+      counterLoops.push_back(isLoop);
+      counterTimes.push_back(!isNested);
+      if (isNested) nestedCounters[outerLoop].push_back(counter);
+   }
+}
+
+
+// returns the profile counter of the procedure definition, main routine
+//    or if loop at currPos, or -1 if it has none
+int profileCounter(int currPos)
+{
+   auto found = profileCounters.find(currPos);
+   return (found == profileCounters.end()) ? -1 : found->second;
+}
+
+
+// returns true if the if loop at currPos is within the body of another loop
+//    of its procedure, so it is counted but not timed apart from that loop
+bool isNestedLoop(int currPos)
+{
+   int counter = profileCounter(currPos);
+   return counter != -1 && !counterTimes[counter];
+}
+
+
+// returns the profile counters of the loops within the body of the if loop
+//    at currPos
+vector<int> nestedLoopCounters(int currPos)
+{
+   auto found = nestedCounters.find(currPos);
+   return (found == nestedCounters.end()) ? vector<int>() : found->second;
+}
+
+
+// returns the access to the element of a value of the named struct, given in
+//    C++, counting it in the profile table if the element has a counter
+string countElementAccess(const string &structName, const string &element, const string &access)
+{
+   auto found = elementCounters.find(structName);
+   if (found == elementCounters.end() || found->second.count(element) == 0) return access;
+   return "vurb_counted(vurb_elements[" + to_string(found->second[element]) + "].count, " + access + ")";
+}
+
+
+// print the support code for programs translated with --profile: the tables
+//    of counters, the scopes that time procedures and loops, and the report
+//    printed when the program ends
+void printProfileRuntime()
+{
+   cout << profileRuntimeStart;
+
+   // the table is laid out in full when the program is compiled
+   cout << "\nstatic const int vurb_profileSize = " << counterNames.size() << ";\n";
+   cout << "static vurb_Counter vurb_profile[vurb_profileSize] = {\n";
+   for (size_t i = 0; i < counterNames.size(); i++) {
+      cout << "   {\"" << counterNames[i] << "\", " << (counterLoops[i] ? "true" : "false");
+      cout << ", " << (counterTimes[i] ? "true" : "false") << ", 0, 0, 0, 0, 0},\n";
+   }
+   cout << "};\n";
+
+   // as is the table of struct elements, whose counts are written out as a
+   //    layout profile for --layout-profile to read
+   cout << "\nstruct vurb_ElementCount {\n";
+   cout << "   const char *structName;\n";
+   cout << "   const char *element;\n";
+   cout << "   long count;\n";
+   cout << "};\n\n";
+   if (elementStructs.empty()) {
+      cout << "static void vurb_writeElementCounts() {}\n";
+   } else {
+      cout << "static vurb_ElementCount vurb_elements[" << elementStructs.size() << "] = {\n";
+      for (size_t i = 0; i < elementStructs.size(); i++) {
+         cout << "   {\"" << elementStructs[i] << "\", \"" << elementNames[i] << "\", 0},\n";
+      }
+      cout << "};\n\n";
+      cout << "static void vurb_writeElementCounts() {\n";
+      cout << "   FILE *file = fopen(\"" << LayoutProfileFile << "\", \"w\");\n";
+      cout << "   if (!file) {\n";
+      cout << "      fprintf(stderr, \"unable to write " << LayoutProfileFile << "\\n\");\n";
+      cout << "      return;\n";
+      cout << "   }\n";
+      cout << "   for (const vurb_ElementCount &element : vurb_elements) {\n";
+      cout << "      fprintf(file, \"%s %s %ld\\n\", element.structName, element.element, element.count);\n";
+      cout << "   }\n";
+      cout << "   fclose(file);\n";
+      cout << "   fprintf(stderr, \"struct element counts written to " << LayoutProfileFile << "\\n\");\n";
+      cout << "}\n";
+   }
+
+   cout << profileRuntimeEnd;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "tokenizing.h"
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+
+// give each procedure, the main routine, each if loop and each struct element
+//    of the program a counter of its own in the profile table
+void planProfile(token tokens[], int size);
+
+
+// returns the profile counter of the procedure definition, main routine
+//    or if loop at currPos, or -1 if it has none
+int profileCounter(int currPos);
+
+
+// returns true if the if loop at currPos is within the body of another loop
+//    of its procedure, so it is counted but not timed apart from that loop
+bool isNestedLoop(int currPos);
+
+
+// returns the profile counters of the loops within the body of the if loop
+//    at currPos
+vector<int> nestedLoopCounters(int currPos);
+
+
+// returns the access to the element of a value of the named struct, given in
+//    C++, counting it in the profile table if the element has a counter
+string countElementAccess(const string &structName, const string &element, const string &access);
+
+
+// print the support code for programs translated with --profile: the tables
+//    of counters, the scopes that time procedures and loops, and the report
+//    printed when the program ends
+void printProfileRuntime();
@@ -0,0 +1,755 @@
+#include "runtime.h"
+#include "options.h"
+#include <iostream>
+
+using std::cout;
+
+// number conversions written for the standard library: to_chars and from_chars
+//    rather than locales, with reals written to the same 6 significant digits
+//    as cout and every number read the way cin would read it, including a
+//    leading plus sign, saturating on overflow and setting 0 when nothing fits
+static const char *standardConversions = R"(#include <cfloat>
+#include <charconv>
+#include <climits>
+#include <cstdlib>
+
+inline char *vurb_formatInteger(char *digits, long value) {
+   return to_chars(digits, digits + 24, value).ptr;
+}
+
+inline char *vurb_formatReal(char *digits, double value) {
+   return to_chars(digits, digits + 32, value, chars_format::general, 6).ptr;
+}
+
+// skip a plus sign that cin would accept but from_chars does not
+inline const char *vurb_skipPlus(const char *first, const char *last) {
+   if (last - first > 1 && *first == '+' && *(first + 1) != '-') return first + 1;
+   return first;
+}
+
+inline bool vurb_parseInteger(const char *&next, const char *last, long &value) {
+   const char *first = vurb_skipPlus(next, last);
+   from_chars_result result = from_chars(first, last, value);
+   if (result.ec == errc::invalid_argument) {
+      value = 0;
+      return false;
+   }
+   next = result.ptr;
+   if (result.ec == errc::result_out_of_range) {
+      value = (*first == '-') ? LONG_MIN : LONG_MAX;
+      return false;
+   }
+   return true;
+}
+
+inline bool vurb_parseReal(const char *&next, const char *last, double &value) {
+   const char *first = vurb_skipPlus(next, last);
+   // cin only reads reals written out in digits, not inf or nan,
+   //    and gives up on an exponent without digits
+   const char *digits = (first < last && *first == '-') ? first + 1 : first;
+   from_chars_result result = from_chars(first, last, value);
+   if (digits == last || !((*digits >= '0' && *digits <= '9') || *digits == '.')
+      || (result.ptr < last && (*result.ptr == 'e' || *result.ptr == 'E'))
+      || result.ec == errc::invalid_argument) {
+      value = 0;
+      return false;
+   }
+   next = result.ptr;
+   if (result.ec == errc::result_out_of_range) {
+      // too small reals become zero, too large ones fail at the largest real
+      value = strtod(string(first, result.ptr).c_str(), nullptr);
+      if (value > DBL_MAX || value < -DBL_MAX) {
+         value = (value > 0) ? DBL_MAX : -DBL_MAX;
+         return false;
+      }
+   }
+   return true;
+}
+)";
+
+// where the lean text type gets the blocks for text too long to keep inside
+//    the value: bytes may be rounded up, and the text uses all of them
+static const char *textFromMalloc = R"(#include <cstdlib>
+
+inline char *vurb_takeText(size_t &bytes) {
+   return (char *)malloc(bytes);
+}
+
+inline void vurb_giveText(char *block, size_t) {
+   free(block);
+}
+)";
+
+// the same from an arena for text, kept for the whole run of the program:
+//    blocks are a power of two in size, cut one after another from chunks of
+//    a megabyte and, once given back, kept on a list for their size to be
+//    taken again, so they need no header and are never returned to malloc;
+//    text too large for the arena goes to malloc as before
+static const char *textFromArena = R"(#include <cstdlib>
+
+struct vurb_TextArena {
+   static const size_t smallest = 32;
+   static const size_t largest = 64 << 10;
+   static const size_t chunk = 1 << 20;
+   static const int classes = 12;
+   char *blocks[classes] = {};
+   char *next = nullptr;
+   char *last = nullptr;
+
+   static int sizeClass(size_t &bytes) {
+      if (bytes <= smallest) {
+         bytes = smallest;
+         return 0;
+      }
+      int top = 64 - __builtin_clzl(bytes - 1);
+      bytes = (size_t)1 << top;
+      return top - 5;
+   }
+
+   char *take(size_t &bytes) {
+      if (bytes > largest) return (char *)malloc(bytes);
+      int sc = sizeClass(bytes);
+      char *block = blocks[sc];
+      if (!block) return cut(bytes);
+      blocks[sc] = *(char **)block;
+      return block;
+   }
+
+   // kept out of line so that text appends stay small enough to inline
+   __attribute__((noinline)) char *cut(size_t bytes) {
+      if ((size_t)(last - next) < bytes) {
+         next = (char *)malloc(chunk);
+         if (!next) abort();
+         last = next + chunk;
+      }
+      char *block = next;
+      next += bytes;
+      return block;
+   }
+
+   void give(char *block, size_t bytes) {
+      if (bytes > largest) {
+         free(block);
+         return;
+      }
+      int sc = sizeClass(bytes);
+      *(char **)block = blocks[sc];
+      blocks[sc] = block;
+   }
+};
+
+static thread_local vurb_TextArena vurb_textArena;
+
+inline char *vurb_takeText(size_t &bytes) {
+   return vurb_textArena.take(bytes);
+}
+
+inline void vurb_giveText(char *block, size_t bytes) {
+   vurb_textArena.give(block, bytes);
+}
+)";
+
+// a text type with the parts of std::string that generated programs use,
+//    keeping short text inside the value itself as std::string does
+static const char *leanText = R"(#include <cfloat>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+class string {
+public:
+   string() { local[0] = '\0'; }
+
+   string(const char *source) : string() { append(source, strlen(source)); }
+
+   string(const char *first, const char *last) : string() { append(first, last - first); }
+
+   string(const string &other) : string() { append(other.text, other.count); }
+
+   string(string &&other) noexcept : string() { take(other); }
+
+   ~string() {
+      if (text != local) vurb_giveText(text, capacity + 1);
+   }
+
+   string &operator=(const string &other) {
+      if (this != &other) {
+         clear();
+         append(other.text, other.count);
+      }
+      return *this;
+   }
+
+   string &operator=(string &&other) noexcept {
+      if (this != &other) {
+         clear();
+         take(other);
+      }
+      return *this;
+   }
+
+   string &operator+=(const string &other) { return append(other.text, other.count); }
+
+   string &operator+=(const char *source) { return append(source, strlen(source)); }
+
+   string &append(const char *first, const char *last) { return append(first, last - first); }
+
+   string &append(const char *source, size_t length) {
+      if (count + length > capacity) {
+         // copy before freeing, as the source may be this text
+         size_t bytes = ((count + length > 2 * capacity) ? count + length : 2 * capacity) + 1;
+         char *grown = vurb_takeText(bytes);
+         memcpy(grown, text, count);
+         memcpy(grown + count, source, length);
+         if (text != local) vurb_giveText(text, capacity + 1);
+         text = grown;
+         capacity = bytes - 1;
+      } else {
+         memmove(text + count, source, length);
+      }
+      count += length;
+      text[count] = '\0';
+      return *this;
+   }
+
+   void reserve(size_t wanted) {
+      if (wanted <= capacity) return;
+      size_t bytes = wanted + 1;
+      char *grown = vurb_takeText(bytes);
+      memcpy(grown, text, count + 1);
+      if (text != local) vurb_giveText(text, capacity + 1);
+      text = grown;
+      capacity = bytes - 1;
+   }
+
+   void clear() {
+      count = 0;
+      text[0] = '\0';
+   }
+
+   size_t size() const { return count; }
+   size_t length() const { return count; }
+   const char *data() const { return text; }
+   const char *c_str() const { return text; }
+
+   int compare(const string &other) const {
+      int order = memcmp(text, other.text, (count < other.count) ? count : other.count);
+      if (order != 0) return order;
+      return (count < other.count) ? -1 : (count > other.count);
+   }
+
+private:
+   char *text = local;
+   size_t count = 0;
+   size_t capacity = sizeof(local) - 1;
+   char local[16];
+
+   // take over the text of another string, which is left empty
+   void take(string &other) {
+      if (other.text == other.local) {
+         append(other.text, other.count);
+      } else {
+         if (text != local) vurb_giveText(text, capacity + 1);
+         text = other.text;
+         count = other.count;
+         capacity = other.capacity;
+         other.text = other.local;
+         other.capacity = sizeof(other.local) - 1;
+      }
+      other.clear();
+   }
+};
+
+inline string operator+(const string &lhs, const string &rhs) {
+   string result;
+   result.reserve(lhs.size() + rhs.size());
+   result += lhs;
+   result += rhs;
+   return result;
+}
+
+inline string operator+(string &&lhs, const string &rhs) {
+   lhs += rhs;
+   return std::move(lhs);
+}
+
+inline bool operator==(const string &lhs, const string &rhs) { return lhs.compare(rhs) == 0; }
+inline bool operator!=(const string &lhs, const string &rhs) { return lhs.compare(rhs) != 0; }
+inline bool operator<(const string &lhs, const string &rhs) { return lhs.compare(rhs) < 0; }
+inline bool operator<=(const string &lhs, const string &rhs) { return lhs.compare(rhs) <= 0; }
+inline bool operator>(const string &lhs, const string &rhs) { return lhs.compare(rhs) > 0; }
+inline bool operator>=(const string &lhs, const string &rhs) { return lhs.compare(rhs) >= 0; }
+)";
+
+// the same conversions as the standard ones, by hand and through the C library
+static const char *leanConversions = R"(
+inline char *vurb_formatInteger(char *digits, long value) {
+   char reversed[24];
+   int length = 0;
+   unsigned long magnitude = (value < 0) ? 0 - (unsigned long)value : value;
+   do {
+      reversed[length++] = '0' + magnitude % 10;
+      magnitude /= 10;
+   } while (magnitude != 0);
+   if (value < 0) *digits++ = '-';
+   while (length > 0) *digits++ = reversed[--length];
+   return digits;
+}
+
+inline char *vurb_formatReal(char *digits, double value) {
+   return digits + snprintf(digits, 32, "%.6g", value);
+}
+
+inline bool vurb_parseInteger(const char *&next, const char *last, long &value) {
+   const char *scan = next;
+   bool negative = false;
+   if (last - scan > 1 && (*scan == '+' || *scan == '-')) negative = (*scan++ == '-');
+   if (scan == last || *scan < '0' || *scan > '9') {
+      value = 0;
+      return false;
+   }
+   unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : LONG_MAX;
+   unsigned long magnitude = 0;
+   bool overflow = false;
+   for (; scan < last && *scan >= '0' && *scan <= '9'; scan++) {
+      unsigned long digit = *scan - '0';
+      if (magnitude > (limit - digit) / 10) {
+         overflow = true;
+      } else {
+         magnitude = magnitude * 10 + digit;
+      }
+   }
+   next = scan;
+   if (overflow) {
+      value = negative ? LONG_MIN : LONG_MAX;
+      return false;
+   }
+   value = negative ? (long)(0 - magnitude) : (long)magnitude;
+   return true;
+}
+
+inline bool vurb_parseReal(const char *&next, const char *last, double &value) {
+   // find the decimal digits cin would take, as strtod also reads hex, inf and nan
+   const char *scan = next;
+   if (scan < last && (*scan == '+' || *scan == '-')) scan++;
+   const char *mantissa = scan;
+   while (scan < last && *scan >= '0' && *scan <= '9') scan++;
+   bool hasDigits = (scan != mantissa);
+   if (scan < last && *scan == '.') {
+      const char *fraction = ++scan;
+      while (scan < last && *scan >= '0' && *scan <= '9') scan++;
+      hasDigits = hasDigits || (scan != fraction);
+   }
+   if (hasDigits && scan < last && (*scan == 'e' || *scan == 'E')) {
+      scan++;
+      if (scan < last && (*scan == '+' || *scan == '-')) scan++;
+      if (scan == last || *scan < '0' || *scan > '9') hasDigits = false;
+      while (scan < last && *scan >= '0' && *scan <= '9') scan++;
+   }
+   if (!hasDigits) {
+      value = 0;
+      return false;
+   }
+   string number(next, scan);
+   next = scan;
+   value = strtod(number.c_str(), nullptr);
+   if (value > DBL_MAX || value < -DBL_MAX) {
+      value = (value > 0) ? DBL_MAX : -DBL_MAX;
+      return false;
+   }
+   return true;
+}
+)";
+
+// buffers everything written until it is full, input is waited for or the
+//    program ends
+static const char *outputRuntime = R"(#include <cstring>
+#include <unistd.h>
+
+struct vurb_Output {
+   char buffer[1 << 16];
+   size_t used = 0;
+
+   ~vurb_Output() { flush(); }
+
+   void send(const char *text, size_t length) {
+      while (length > 0) {
+         ssize_t count = ::write(1, text, length);
+         if (count <= 0) return;
+         text += count;
+         length -= count;
+      }
+   }
+
+   void flush() {
+      send(buffer, used);
+      used = 0;
+   }
+
+   void put(const char *text, size_t length) {
+      if (length > sizeof(buffer) - used) {
+         flush();
+         if (length > sizeof(buffer)) {
+            send(text, length);
+            return;
+         }
+      }
+      memcpy(buffer + used, text, length);
+      used += length;
+   }
+
+   vurb_Output &operator<<(char c) {
+      if (used == sizeof(buffer)) flush();
+      buffer[used++] = c;
+      return *this;
+   }
+
+   vurb_Output &operator<<(const char *text) {
+      put(text, strlen(text));
+      return *this;
+   }
+
+   vurb_Output &operator<<(const string &text) {
+      put(text.data(), text.size());
+      return *this;
+   }
+
+   vurb_Output &operator<<(bool value) { return *this << (value ? '1' : '0'); }
+
+   vurb_Output &operator<<(int value) { return *this << (long)value; }
+
+   vurb_Output &operator<<(long value) {
+      char digits[24];
+      put(digits, vurb_formatInteger(digits, value) - digits);
+      return *this;
+   }
+
+   vurb_Output &operator<<(double value) {
+      char digits[32];
+      put(digits, vurb_formatReal(digits, value) - digits);
+      return *this;
+   }
+} vurb_out;
+)";
+
+// reads standard input in large blocks, or maps it when it is a file, and
+//    parses each whitespace separated value in place, leaving every later
+//    read alone once one has failed as cin does;
+//    output is flushed before waiting for more input, so prompts still appear
+static const char *inputRuntime = R"(#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct vurb_Input {
+   char buffer[1 << 16];
+   const char *next = buffer;
+   const char *end = buffer;
+   bool atEnd = false;
+   bool failed = false;
+
+   vurb_Input() {
+      struct stat info;
+      off_t offset = lseek(0, 0, SEEK_CUR);
+      if (fstat(0, &info) == 0 && S_ISREG(info.st_mode) && offset >= 0 && offset < info.st_size) {
+         void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, 0, 0);
+         if (mapped != MAP_FAILED) {
+            next = (const char *)mapped + offset;
+            end = (const char *)mapped + info.st_size;
+            atEnd = true;
+         }
+      }
+   }
+
+   static bool isSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+   // keep the unread input and add as much more as can be read at once
+   bool refill() {
+      if (atEnd) return false;
+      size_t kept = end - next;
+      if (kept == sizeof(buffer)) return false;
+      memmove(buffer, next, kept);
+      next = buffer;
+      end = buffer + kept;
+      vurb_out.flush();
+      ssize_t count = ::read(0, buffer + kept, sizeof(buffer) - kept);
+      if (count <= 0) {
+         atEnd = true;
+         return false;
+      }
+      end += count;
+      return true;
+   }
+
+   // skip to the next value, returning false if there is none
+   bool start() {
+      if (failed) return false;
+      for (;;) {
+         while (next < end && isSpace(*next)) next++;
+         if (next < end) return true;
+         if (!refill()) {
+            failed = true;
+            return false;
+         }
+      }
+   }
+
+   // returns the end of the value at next, with all of it in memory
+   const char *word() {
+      const char *scan = next;
+      for (;;) {
+         while (scan < end && !isSpace(*scan)) scan++;
+         if (scan < end) return scan;
+
+         // refilling moves the unread input to the front of the buffer,
+         //    even when there is no more to read
+         size_t length = scan - next;
+         bool isRefilled = refill();
+         scan = next + length;
+         if (!isRefilled) return scan;
+      }
+   }
+};
+
+static vurb_Input vurb_in;
+
+void vurb_read(long &value) {
+   if (!vurb_in.start()) return;
+   const char *last = vurb_in.word();
+   if (!vurb_parseInteger(vurb_in.next, last, value)) vurb_in.failed = true;
+}
+
+void vurb_read(bool &value) {
+   long number;
+   if (!vurb_in.start()) return;
+   const char *last = vurb_in.word();
+   if (!vurb_parseInteger(vurb_in.next, last, number)) {
+      value = (number != 0);
+      vurb_in.failed = true;
+   } else if (number == 0 || number == 1) {
+      value = (number == 1);
+   } else {
+      value = true;
+      vurb_in.failed = true;
+   }
+}
+
+void vurb_read(double &value) {
+   if (!vurb_in.start()) return;
+   const char *last = vurb_in.word();
+   if (!vurb_parseReal(vurb_in.next, last, value)) vurb_in.failed = true;
+}
+
+void vurb_read(string &value) {
+   if (!vurb_in.start()) return;
+   value.clear();
+   for (;;) {
+      const char *scan = vurb_in.next;
+      while (scan < vurb_in.end && !vurb_Input::isSpace(*scan)) scan++;
+      value.append(vurb_in.next, scan);
+      vurb_in.next = scan;
+      if (scan < vurb_in.end || !vurb_in.refill()) return;
+   }
+}
+)";
+
+
+// storage allocated for an array too large for the stack or sized as the program
+//    runs; blocks come from a pool of free blocks sorted into size classes a
+//    quarter of a power of two apart, so arrays declared again and again in
+//    procedures and loops reuse memory rather than going back to malloc,
+//    while arrays of 2 MiB or more can be aligned to and advised onto huge pages
+//    instead; the elements start out as in a fresh array, and reset returns
+//    text elements to that state when the storage is reused
+static const char *arrayStorage = R"(#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+struct vurb_Pool {
+   static const size_t smallest = 64;
+   static const size_t largest = 64 << 20;
+   static const int classes = 81;
+   void *blocks[classes];
+
+   static int sizeClass(size_t &bytes) {
+      if (bytes <= smallest) {
+         bytes = smallest;
+         return 0;
+      }
+      size_t last = bytes - 1;
+      int top = 63 - __builtin_clzl(last);
+      size_t quarter = last >> (top - 2);
+      bytes = (quarter + 1) << (top - 2);
+      return (top - 6) * 4 + (int)quarter - 3;
+   }
+
+   void *take(size_t bytes) {
+      if (bytes > largest) return malloc(bytes);
+      int sc = sizeClass(bytes);
+      void *block = blocks[sc];
+      if (!block) return malloc(bytes);
+      blocks[sc] = *(void **)block;
+      return block;
+   }
+
+   void give(void *block, size_t bytes) {
+      if (bytes > largest) {
+         free(block);
+         return;
+      }
+      int sc = sizeClass(bytes);
+      *(void **)block = blocks[sc];
+      blocks[sc] = block;
+   }
+};
+
+static thread_local vurb_Pool vurb_pool;
+
+inline long vurb_arrayLength(long count) {
+   return count > 0 ? count : 0;
+}
+
+template <typename T>
+struct vurb_Storage {
+   T *elements;
+   size_t count;
+   bool hugePages;
+
+   vurb_Storage(size_t count, bool hugePages)
+      : count(count), hugePages(hugePages && count * sizeof(T) >= (2 << 20)) {
+      size_t bytes = count * sizeof(T);
+      if (this->hugePages) {
+         size_t hugePage = 2 << 20;
+         bytes = (bytes + hugePage - 1) / hugePage * hugePage;
+         elements = (T *)aligned_alloc(hugePage, bytes);
+         if (elements) madvise(elements, bytes, MADV_HUGEPAGE);
+      } else {
+         elements = (T *)vurb_pool.take(bytes);
+      }
+      if (!elements) abort();
+      for (size_t i = 0; i < count; i++) new (elements + i) T;
+   }
+
+   ~vurb_Storage() {
+      for (size_t i = 0; i < count; i++) elements[i].~T();
+      if (hugePages) {
+         free(elements);
+      } else {
+         vurb_pool.give(elements, count * sizeof(T));
+      }
+   }
+
+   vurb_Storage(const vurb_Storage &) = delete;
+   vurb_Storage &operator=(const vurb_Storage &) = delete;
+
+   void reset() {
+      for (size_t i = 0; i < count; i++) elements[i] = T();
+   }
+};
+
+inline bool vurb_adviseHugePages(void *start, size_t bytes) {
+   return madvise(start, bytes, MADV_HUGEPAGE) == 0;
+}
+)";
+
+
+// the checks made by programs translated with --checked, which report the first
+//    index or divisor found out of range and end the program once the output
+//    so far has been written; a range check stands in for the checks of every
+//    access a loop makes by its counter
+static const char *checkRuntimeStart = R"(#include <cstdio>
+#include <cstdlib>
+
+[[noreturn]] __attribute__((cold, noinline)) void vurb_fail(const char *message, long a, long b, long c) {
+)";
+
+static const char *checkRuntimeEnd = R"(   fprintf(stderr, message, a, b, c);
+   exit(1);
+}
+
+inline long vurb_checkIndex(long index, long count) {
+   if (__builtin_expect((unsigned long)index >= (unsigned long)count, 0)) {
+      vurb_fail("Error: array index %ld is out of range for an array of %ld elements\n", index, count, 0);
+   }
+   return index;
+}
+
+inline void vurb_checkRange(long first, long last, long count) {
+   if (__builtin_expect(first < 0 || last >= count, 0)) {
+      vurb_fail("Error: array indexes %ld to %ld used by a loop are out of range for an array of %ld elements\n",
+         first, last, count);
+   }
+}
+
+inline int vurb_checkDivisor(int divisor) {
+   if (__builtin_expect(divisor == 0, 0)) vurb_fail("Error: division by zero\n", 0, 0, 0);
+   return divisor;
+}
+
+inline long vurb_checkDivisor(long divisor) {
+   if (__builtin_expect(divisor == 0, 0)) vurb_fail("Error: division by zero\n", 0, 0, 0);
+   return divisor;
+}
+
+inline double vurb_checkDivisor(double divisor) {
+   return divisor;
+}
+)";
+
+
+// print the support code that generated programs use for their input and output,
+//    leaving out the input part for programs that never read
+void printRuntime(bool readsInput)
+{
+   if (options.iostream) return;
+
+   if (options.leanRuntime) {
+      cout << (options.textArena ? textFromArena : textFromMalloc);
+      cout << leanText << leanConversions;
+   } else {
+      cout << standardConversions;
+   }
+
+   cout << outputRuntime;
+   if (readsInput) {
+      cout << inputRuntime;
+   }
+}
+
+
+// print the support code for arrays kept in storage of their own
+void printArrayStorage()
+{
+   cout << arrayStorage;
+}
+
+
+// print the checks that programs translated with --checked make on array
+//    indexes and divisors
+void printChecks()
+{
+   cout << checkRuntimeStart;
+   cout << "   " << outputStream() << ".flush();\n";
+   cout << checkRuntimeEnd;
+}
+
+
+// returns the C++ stream that write statements send their values to
+string outputStream()
+{
+   return options.iostream ? "cout" : "vurb_out";
+}
+
+
+// returns what write statements end each line with
+string outputLineEnd()
+{
+   // endl flushes every line, so only the iostream runtime uses it
+   return options.iostream ? "endl" : "'\\n'";
+}
+
+
+// returns the C++ statement that reads a value into the named variable
+string inputStatement(string name)
+{
+   return options.iostream ? "cin >> " + name : "vurb_read(" + name + ")";
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+using std::string;
+
+
+// print the support code that generated programs use for their input and output,
+//    leaving out the input part for programs that never read
+void printRuntime(bool readsInput);
+
+
+// print the support code for arrays kept in storage of their own
+void printArrayStorage();
+
+
+// print the checks that programs translated with --checked make on array
+//    indexes and divisors
+void printChecks();
+
+
+// returns the C++ stream that write statements send their values to
+string outputStream();
+
+
+// returns what write statements end each line with
+string outputLineEnd();
+
+
+// returns the C++ statement that reads a value into the named variable
+string inputStatement(string name);
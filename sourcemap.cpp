@@ -0,0 +1,132 @@
+#include "sourcemap.h"
+#include "options.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::ofstream;
+using std::streambuf;
+using std::streamsize;
+using std::vector;
+
+
+// passes everything written to standard output on to its usual buffer,
+//    counting the lines as they go by
+class lineCountingBuffer : public streambuf {
+public:
+   streambuf *target = nullptr;
+   int lines = 0;
+
+protected:
+   int overflow(int c) override {
+      if (c == EOF) return 0;
+      if (c == '\n') lines++;
+      return target->sputc(c);
+   }
+
+   streamsize xsputn(const char *text, streamsize count) override {
+      for (streamsize i = 0; i < count; i++) {
+         if (text[i] == '\n') lines++;
+      }
+      return target->sputn(text, count);
+   }
+
+   int sync() override {
+      return target->pubsync();
+   }
+};
+
+
+// the source that a run of C++ lines, starting at cppLine, was translated from
+struct sourceMapEntry {
+   int cppLine;
+   int line;
+   int column;
+   string procedure;
+};
+
+static lineCountingBuffer countingBuffer;
+static vector<sourceMapEntry> mapEntries;
+static string currentProcedure = "";
+
+
+// returns the source file name quoted as a C++ string literal
+static string quotedSourceFile()
+{
+   string quoted = "\"";
+   for (char c : options.sourceFile) {
+      if (c == '"' || c == '\\') quoted += '\\';
+      quoted += c;
+   }
+   return quoted + "\"";
+}
+
+
+// start counting the lines of C++ written, if a source map was asked for
+void startSourceMap()
+{
+   if (options.sourceMap == "") return;
+
+   countingBuffer.target = cout.rdbuf();
+   cout.rdbuf(&countingBuffer);
+}
+
+
+// name the source file the assembly's line marks refer to, if it is known
+void markSourceFile()
+{
+   if (options.sourceFile != "") cout << "\t.file 1 " << quotedSourceFile() << "\n";
+}
+
+
+// mark the start of the procedure (or main routine) named name at tok,
+//    whose statements the following marks belong to
+void markProcedure(const token &tok, string name)
+{
+   currentProcedure = name;
+   markSourceLine(tok);
+}
+
+
+// mark the C++ about to be written as the translation of the source at tok,
+//    with a #line directive (or, for assembly, a .loc directive) if the source
+//    file is known, and an entry in the source map if one was asked for
+void markSourceLine(const token &tok)
+{
+   if (options.sourceFile != "" && options.assembly) {
+      cout << "\t.loc 1 " << tok.line << " " << tok.column << "\n";
+   } else if (options.sourceFile != "") {
+      cout << "#line " << tok.line << " " << quotedSourceFile() << "\n";
+   }
+
+   if (options.sourceMap == "") return;
+
+   sourceMapEntry entry = {countingBuffer.lines + 1, tok.line, tok.column, currentProcedure};
+
+   // a mark with no C++ of its own is replaced by the one that follows it
+   if (!mapEntries.empty() && mapEntries.back().cppLine == entry.cppLine) {
+      mapEntries.back() = entry;
+   } else {
+      mapEntries.push_back(entry);
+   }
+}
+
+
+// stop counting lines and write the source map, if one was asked for
+// returns false if the map cannot be written
+bool finishSourceMap()
+{
+   if (options.sourceMap == "") return true;
+
+   cout.rdbuf(countingBuffer.target);
+
+   ofstream map(options.sourceMap);
+   if (!map) return false;
+
+   map << "# cpp_line source_line source_column procedure\n";
+   for (const sourceMapEntry &entry : mapEntries) {
+      map << entry.cppLine << " " << entry.line << " " << entry.column << " " << entry.procedure << "\n";
+   }
+   return map.good();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "tokenizing.h"
+#include <string>
+
+using std::string;
+
+
+// start counting the lines of C++ written, if a source map was asked for
+void startSourceMap();
+
+
+// name the source file the assembly's line marks refer to, if it is known
+void markSourceFile();
+
+
+// mark the start of the procedure (or main routine) named name at tok,
+//    whose statements the following marks belong to
+void markProcedure(const token &tok, string name);
+
+
+// mark the C++ about to be written as the translation of the source at tok,
+//    with a #line directive (or, for assembly, a .loc directive) if the source
+//    file is known, and an entry in the source map if one was asked for
+void markSourceLine(const token &tok);
+
+
+// stop counting lines and write the source map, if one was asked for
+// returns false if the map cannot be written
+bool finishSourceMap();
@@ -0,0 +1,197 @@
+#include "symbols.h"
+#include "analyzing.h"
+
+// the variables visible at the current point of translation, innermost scope last
+static vector<unordered_map<string, typeInfo>> scopes(1);
+
+// the C++ names used in place of variables' own names
+static unordered_map<string, string> renamedVariables;
+
+// the elements of every struct type, keyed by struct name then element name
+static unordered_map<string, unordered_map<string, typeInfo>> structElements;
+
+
+// begin a new innermost scope for variable declarations
+void enterScope()
+{
+   scopes.push_back(unordered_map<string, typeInfo>());
+}
+
+
+// discard the innermost scope and all variables declared in it
+void exitScope()
+{
+   // the outermost scope holds the globals and is never discarded
+   if (scopes.size() > 1) {
+      scopes.pop_back();
+   }
+}
+
+
+// record a variable in the innermost scope
+void declareVariable(string name, typeInfo type)
+{
+   scopes.back()[name] = type;
+}
+
+
+// returns the type of the visible variable with the given name,
+// or nullptr if no such variable is in scope
+const typeInfo *lookupVariable(string name)
+{
+   for (size_t i = scopes.size(); i > 0; i--) {
+      auto it = scopes[i - 1].find(name);
+      if (it != scopes[i - 1].end()) return &it->second;
+   }
+   return nullptr;
+}
+
+
+// returns true if the visible variable with the given name is a global
+bool isGlobalVariable(string name)
+{
+   for (size_t i = scopes.size(); i > 0; i--) {
+      if (scopes[i - 1].count(name)) return (i == 1);
+   }
+   return false;
+}
+
+
+// returns the C++ name to use for a variable
+string variableName(string name)
+{
+   auto it = renamedVariables.find(name);
+   return (it != renamedVariables.end()) ? it->second : name;
+}
+
+
+// use a different C++ name for a variable until it is restored
+void renameVariable(string name, string cppName)
+{
+   renamedVariables[name] = cppName;
+}
+
+
+// go back to using a variable's own name in C++
+void restoreVariableName(string name)
+{
+   renamedVariables.erase(name);
+}
+
+
+// returns the C++ name of the number of elements passed along with an array parameter,
+//    or worked out when an array sized by an expression is declared
+string arraySizeName(string name)
+{
+   return "vurb_size_" + name;
+}
+
+
+// record an element of a struct type
+void declareElement(string structName, string elementName, typeInfo type)
+{
+   structElements[structName][elementName] = type;
+}
+
+
+// returns the type of an element of a struct type,
+// or nullptr if the struct has no such element
+const typeInfo *lookupElement(string structName, string elementName)
+{
+   auto structIt = structElements.find(structName);
+   if (structIt == structElements.end()) return nullptr;
+
+   auto elemIt = structIt->second.find(elementName);
+   return (elemIt != structIt->second.end()) ? &elemIt->second : nullptr;
+}
+
+
+// read the name and type of a declaration, starting just after its
+//    gdef, vdef or element keyword
+// returns the position of the last token of the declaration, or -1 if malformed
+int readDeclaration(token tokens[], int currPos, int size, string &name, typeInfo &type)
+{
+   type.isArray = false;
+   type.structName = "";
+   type.arraySize = "";
+
+   if (currPos >= size) return -1;
+
+   if (tokens[currPos].ttype == TokenType::Array) {
+      // array name type size, where a size other than a literal is worked out
+      //    when the declaration is reached and kept in a variable of its own
+      if (currPos + 3 >= size) return -1;
+      name = tokens[currPos + 1].content;
+      type.ttype = tokens[currPos + 2].ttype;
+      type.isArray = true;
+      if (tokens[currPos + 3].ttype == TokenType::IntLit) {
+         type.arraySize = tokens[currPos + 3].content;
+         return currPos + 3;
+      }
+      type.arraySize = arraySizeName(name);
+      return skipExpression(tokens, currPos + 3, size);
+   } else if (tokens[currPos].ttype == TokenType::StructType) {
+      // structtype structname name
+      if (currPos + 2 >= size) return -1;
+      type.ttype = TokenType::StructType;
+      type.structName = tokens[currPos + 1].content;
+      name = tokens[currPos + 2].content;
+      return currPos + 2;
+   }
+
+   // name type
+   if (currPos + 1 >= size) return -1;
+   name = tokens[currPos].content;
+   type.ttype = tokens[currPos + 1].ttype;
+   return currPos + 1;
+}
+
+
+// find the type of an identifier, array access or struct access expression
+// returns false if the expression is not one of these or its type is unknown
+bool accessType(token tokens[], int currPos, int size, typeInfo &type)
+{
+   if (currPos >= size) return false;
+
+   if (tokens[currPos].ttype == TokenType::Identifier) {
+      const typeInfo *var = lookupVariable(tokens[currPos].content);
+      if (!var) return false;
+      type = *var;
+      return true;
+   }
+
+   if (tokens[currPos].ttype == TokenType::ArrayAccess) {
+      if (!accessType(tokens, currPos + 1, size, type) || !type.isArray) return false;
+      type.isArray = false;
+      type.arraySize = "";
+      return true;
+   }
+
+   if (tokens[currPos].ttype == TokenType::StructElemAccess
+      || tokens[currPos].ttype == TokenType::StructIndirElemAccess) {
+      typeInfo structType;
+      if (!accessType(tokens, currPos + 1, size, structType)) return false;
+      if (structType.isArray || structType.ttype != TokenType::StructType) return false;
+
+      // the element name follows the (possibly nested) struct expression
+      int elemPos = skipExpression(tokens, currPos + 1, size) + 1;
+      if (elemPos == 0 || elemPos >= size) return false;
+
+      const typeInfo *elem = lookupElement(structType.structName, tokens[elemPos].content);
+      if (!elem) return false;
+      type = *elem;
+      return true;
+   }
+
+   return false;
+}
+
+
+// returns true if the type is a single integer, real or boolean value
+bool isPrimitiveValue(const typeInfo &type)
+{
+   return (!type.isArray
+      && (type.ttype == TokenType::IntType
+         || type.ttype == TokenType::RealType
+         || type.ttype == TokenType::BoolType));
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "tokenizing.h"
+#include <string>
+
+using std::string;
+
+
+// the type of a variable, parameter or struct element:
+//    ttype is IntType, RealType, TextType, BoolType or StructType,
+//    structName names the struct type for StructType,
+//    and arrays also record their number of elements
+struct typeInfo {
+   TokenType ttype;
+   string structName;
+   bool isArray;
+   string arraySize;
+};
+
+
+// begin a new innermost scope for variable declarations
+void enterScope();
+
+
+// discard the innermost scope and all variables declared in it
+void exitScope();
+
+
+// record a variable in the innermost scope
+void declareVariable(string name, typeInfo type);
+
+
+// returns the type of the visible variable with the given name,
+// or nullptr if no such variable is in scope
+const typeInfo *lookupVariable(string name);
+
+
+// returns true if the visible variable with the given name is a global
+bool isGlobalVariable(string name);
+
+
+// returns the C++ name to use for a variable
+string variableName(string name);
+
+
+// use a different C++ name for a variable until it is restored
+void renameVariable(string name, string cppName);
+
+
+// go back to using a variable's own name in C++
+void restoreVariableName(string name);
+
+
+// returns the C++ name of the number of elements passed along with an array parameter,
+//    or worked out when an array sized by an expression is declared
+string arraySizeName(string name);
+
+
+// record an element of a struct type
+void declareElement(string structName, string elementName, typeInfo type);
+
+
+// returns the type of an element of a struct type,
+// or nullptr if the struct has no such element
+const typeInfo *lookupElement(string structName, string elementName);
+
+
+// read the name and type of a declaration, starting just after its
+//    gdef, vdef or element keyword
+// returns the position of the last token of the declaration, or -1 if malformed
+int readDeclaration(token tokens[], int currPos, int size, string &name, typeInfo &type);
+
+
+// find the type of an identifier, array access or struct access expression
+// returns false if the expression is not one of these or its type is unknown
+bool accessType(token tokens[], int currPos, int size, typeInfo &type);
+
+
+// returns true if the type is a single integer, real or boolean value
+bool isPrimitiveValue(const typeInfo &type);
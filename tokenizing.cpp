@@ -1,5 +1,9 @@
 #include "tokenizing.h"
 
+// the line and column of the next character to be read from input
+static int inputLine = 1;
+static int inputColumn = 1;
+
 
 // read each word from standard input,
 //    displaying error messages for invalid tokens encountered,
@@ -9,8 +13,9 @@ int tokenize(token tokens[])
 {
    int pos = 0;
    string word = "";
+   int line, column;
 
-   while (cin >> word) {
+   while (readWord(word, line, column)) {
       if (pos >= MaxTokens) {
          return pos;
       }
@@ -34,6 +39,8 @@ int tokenize(token tokens[])
          tokens[pos].ttype = TokenType::TextLit;
          tokens[pos].content = textString;
          tokens[pos].pos = pos;
+         tokens[pos].line = line;
+         tokens[pos].column = column;
          pos++;
       } else if (newTok == TokenType::EndText) {
          // Print an error message for incorrectly formatted text strings
@@ -43,6 +50,8 @@ int tokenize(token tokens[])
          tokens[pos].ttype = newTok;
          tokens[pos].content = word;
          tokens[pos].pos = pos;
+         tokens[pos].line = line;
+         tokens[pos].column = column;
          pos++;
       }
    }
@@ -83,12 +92,42 @@ TokenType matchTokens(string input) {
    return TokenType::Invalid;
 }
 
+// read the next whitespace separated word from input,
+//    storing the line and column it starts at
+// returns false at the end of input
+bool readWord(string &word, int &line, int &column) {
+   int next = cin.get();
+   while (next != EOF && isspace(next)) {
+      if (next == '\n') {
+         inputLine++;
+         inputColumn = 1;
+      } else {
+         inputColumn++;
+      }
+      next = cin.get();
+   }
+   if (next == EOF) return false;
+
+   line = inputLine;
+   column = inputColumn;
+   word.clear();
+   while (next != EOF && !isspace(next)) {
+      word += (char)next;
+      inputColumn++;
+      next = cin.get();
+   }
+   // leave the whitespace after the word to be counted by the next read
+   if (next != EOF) cin.unget();
+   return true;
+}
+
 // Gathers and returns a text string from input
 // Returns false if the text wasn't terminated correctly
 bool getTextString(string &textString) {
    string word;
    TokenType newTok;
-   while (cin >> word) {
+   int line, column;
+   while (readWord(word, line, column)) {
       newTok = matchTokens(word);
 
       textString += " " + word;
@@ -104,6 +143,10 @@ bool getTextString(string &textString) {
 // Ignores input until the next endline
 void skipToEndline() {
    cin.ignore(10000, '\n');
+   if (!cin.eof()) {
+      inputLine++;
+      inputColumn = 1;
+   }
 }
 
 // Takes a tokentype and returns a string that describes it
@@ -16,7 +16,7 @@ enum TokenType {
    Comment = -5, LoneQuote = -4, EndText = -3, StartText = -2, Invalid = -1,
    Begin, End, Main, IntLit, RealLit, TextLit, BoolLit, Identifier,
    GlobalDef, ProcDef, VarDef, Set, Call, Read, Write,
-   Left, Right, If, Else, Return, Array, ArraySet, ArrayAccess,
+   Left, Right, If, Else, Return, Array, ArraySet, ArrayAccess, ArraySize,
    StructDef, StructType, StructElemSet, StructIndirElemSet, 
    StructElemAccess, StructIndirElemAccess, Element,
    LTOp, GTOp, LEOp, GEOp, EQOp, NEOp, AndOp, OrOp, NotOp, Negate,
@@ -77,6 +77,7 @@ const unordered_map<TokenType, string> TokenName = {
    {StructType, "StructType"},
    {ArraySet, "ArraySet"},
    {ArrayAccess, "ArrayAccess"},
+   {ArraySize, "ArraySize"},
    {Array, "Array"},
    {Return, "Return"},
 };
@@ -129,6 +130,7 @@ const vector<pair<TokenType, regex>> TokenRegex = {
    {StructType, regex("^structtype")},
    {ArraySet, regex("^arrayset")},
    {ArrayAccess, regex("^arrayaccess")},
+   {ArraySize, regex("^arraysize")},
    {Array, regex("^array")},
    {Return, regex("^return")},
    {RealLit, regex("^[0-9]+[.][0-9]+")},
@@ -148,12 +150,15 @@ const int MaxTokens = 1024;
 
 
 // each token has a type (from the TokenTypes enum),
-//    the associated token text content, and
-//    its position in the sequence of valid tokens
+//    the associated token text content,
+//    its position in the sequence of valid tokens, and
+//    the line and column of the source it starts at
 struct token {
    TokenType ttype;
    string content;
    int pos;
+   int line;
+   int column;
 };
 
 
@@ -173,6 +178,12 @@ TokenType matchTokens(string input);
 void printTokens(token tokens[], int size);
 
 
+// read the next whitespace separated word from input,
+//    storing the line and column it starts at
+// returns false at the end of input
+bool readWord(string &word, int &line, int &column);
+
+
 // Gathers and returns a text string from input
 // Returns false if the text wasn't terminated correctly
 bool getTextString(string &textString);